@@ -0,0 +1,86 @@
+# CSR matrix-matrix products with heterogeneous weights on CPU, with the Taichi
+# kernels tiled over the dense columns and with the generic CSR lowering of JAX.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+from jax.experimental.sparse import csr
+
+import braintaichi as bti
+
+jax.config.update('jax_platform_name', 'cpu')
+
+shape = [
+  1000,
+  5000,
+  10000,
+  20000,
+]
+batch = [
+  1,
+  16,
+  64,
+  256,
+]
+conn_num = [
+  100,
+]
+transpose = [
+  True,
+  False,
+]
+backends = [
+  'taichi',
+  'jax',
+]
+
+ITERATION = 20
+
+
+def _random_csr(n_pre, n_post, conn_num, seed=1234):
+  rng = np.random.default_rng(seed)
+  indices = np.sort(rng.integers(0, n_post, (n_pre, conn_num)), axis=1).astype(np.int32).flatten()
+  indptr = (np.arange(n_pre + 1) * conn_num).astype(np.int32)
+  return jnp.asarray(indices), jnp.asarray(indptr)
+
+
+def test_heter(shape, batch, conn_num, transpose, backend):
+  indices, indptr = _random_csr(shape, shape, conn_num)
+  rng = np.random.default_rng(4321)
+  weight = jnp.asarray(rng.random(indices.shape), dtype=jnp.float32)
+  matrix = jnp.asarray(rng.random((shape, batch)), dtype=jnp.float32)
+
+  if backend == 'taichi':
+    f = jax.jit(lambda w, m: bti.csrmm(w, indices, indptr, m, shape=(shape, shape), transpose=transpose))
+  else:
+    f = jax.jit(lambda w, m: csr.csr_matmat_p.bind(w, indices, indptr, m, shape=(shape, shape), transpose=transpose))
+  for _ in range(5):
+    jax.block_until_ready(f(weight, matrix))
+
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(weight, matrix)
+  jax.block_until_ready(r)
+  time1 = time.time()
+  per_call = (time1 - time0) / ITERATION * 1e3
+
+  print(f'shape: {shape}, batch: {batch}, conn_num: {conn_num}, transpose: {transpose}, '
+        f'backend: {backend}, per call: {per_call:.3f} ms')
+  return per_call
+
+
+if __name__ == '__main__':
+  print(f'cores: {os.cpu_count()}')
+  df = pd.DataFrame(columns=['shape', 'batch', 'conn num', 'transpose', 'backend', 'per call (ms)'])
+  for _s in shape:
+    for _b in batch:
+      for _c in conn_num:
+        for _t in transpose:
+          for _k in backends:
+            df.loc[len(df)] = [_s, _b, _c, _t, _k, test_heter(_s, _b, _c, _t, _k)]
+  os.makedirs('./csrmm_heter_cpu', exist_ok=True)
+  df.to_csv(f'./csrmm_heter_cpu/cpu_{os.cpu_count()}_cores.csv', index=False)
@@ -0,0 +1,87 @@
+# CSR and event CSR matrix-vector products on int32 column indices versus indices
+# compressed into uint16 offsets, which the kernels decode on the fly. The products
+# are bound by the memory traffic of the values and the indices.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+
+shape = [
+  10000,
+  50000,
+  100000,
+]
+conn_num = [
+  100,
+  500,
+]
+transpose = [
+  True,
+  False,
+]
+kinds = [
+  'csrmv',
+  'event_csrmv',
+]
+index_types = [
+  'int32',
+  'compressed',
+]
+
+ITERATION = 100
+
+
+def _random_csr(n_pre, n_post, conn_num, seed=1234):
+  rng = np.random.default_rng(seed)
+  indices = np.sort(rng.integers(0, n_post, (n_pre, conn_num)), axis=1).astype(np.int32).flatten()
+  indptr = (np.arange(n_pre + 1) * conn_num).astype(np.int32)
+  return jnp.asarray(indices), jnp.asarray(indptr)
+
+
+def test_compressed(shape, conn_num, transpose, kind, index_type):
+  indices, indptr = _random_csr(shape, shape, conn_num)
+  if index_type == 'compressed':
+    indices = bti.compress_indices(indices, indptr)
+  rng = np.random.default_rng(4321)
+  data = jnp.asarray(rng.random(conn_num * shape), dtype=jnp.float32)
+  if kind == 'csrmv':
+    vector = jnp.asarray(rng.random(shape), dtype=jnp.float32)
+    op = bti.csrmv
+  else:
+    vector = jnp.asarray(rng.random(shape) < 0.05)
+    op = bti.event_csrmv
+
+  f = jax.jit(lambda d, ind, v: op(d, ind, indptr, v, shape=(shape, shape), transpose=transpose))
+  for _ in range(5):
+    jax.block_until_ready(f(data, indices, vector))
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(data, indices, vector)
+  jax.block_until_ready(r)
+  per_call = (time.time() - time0) / ITERATION * 1e3
+
+  print(f'shape: {shape}, conn_num: {conn_num}, transpose: {transpose}, kind: {kind}, '
+        f'indices: {index_type}, per call: {per_call:.3f} ms')
+  return per_call
+
+
+if __name__ == '__main__':
+  platform = jax.default_backend()
+  df = pd.DataFrame(columns=['shape', 'conn num', 'transpose', 'kind', 'indices', 'per call (ms)'])
+  for _s in shape:
+    for _c in conn_num:
+      for _t in transpose:
+        for _k in kinds:
+          for _i in index_types:
+            df.loc[len(df)] = [_s, _c, _t, _k, _i, test_compressed(_s, _c, _t, _k, _i)]
+  os.makedirs('./csrmv_compressed_VS_int32', exist_ok=True)
+  if platform == 'cpu':
+    df.to_csv(f'./csrmv_compressed_VS_int32/cpu_{os.cpu_count()}_cores.csv', index=False)
+  else:
+    df.to_csv(f'./csrmv_compressed_VS_int32/{platform}.csv', index=False)
@@ -0,0 +1,76 @@
+# CSR matrix-vector products on float32 values versus float16 and bfloat16 values,
+# which are read in 16 bits and accumulated in float32. The products are bound by
+# the memory traffic of the values and the indices.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+
+shape = [
+  10000,
+  50000,
+  100000,
+]
+conn_num = [
+  100,
+  500,
+]
+transpose = [
+  True,
+  False,
+]
+dtypes = [
+  'float32',
+  'float16',
+  'bfloat16',
+]
+
+ITERATION = 100
+
+
+def _random_csr(n_pre, n_post, conn_num, seed=1234):
+  rng = np.random.default_rng(seed)
+  indices = np.sort(rng.integers(0, n_post, (n_pre, conn_num)), axis=1).astype(np.int32).flatten()
+  indptr = (np.arange(n_pre + 1) * conn_num).astype(np.int32)
+  return jnp.asarray(indices), jnp.asarray(indptr)
+
+
+def test_half(shape, conn_num, transpose, dtype):
+  indices, indptr = _random_csr(shape, shape, conn_num)
+  rng = np.random.default_rng(4321)
+  data = jnp.asarray(rng.random(indices.shape[0])).astype(dtype)
+  vector = jnp.asarray(rng.random(shape)).astype(dtype)
+
+  f = jax.jit(lambda d, v: bti.csrmv(d, indices, indptr, v, shape=(shape, shape), transpose=transpose))
+  for _ in range(5):
+    jax.block_until_ready(f(data, vector))
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(data, vector)
+  jax.block_until_ready(r)
+  per_call = (time.time() - time0) / ITERATION * 1e3
+
+  print(f'shape: {shape}, conn_num: {conn_num}, transpose: {transpose}, dtype: {dtype}, '
+        f'per call: {per_call:.3f} ms')
+  return per_call
+
+
+if __name__ == '__main__':
+  platform = jax.default_backend()
+  df = pd.DataFrame(columns=['shape', 'conn num', 'transpose', 'dtype', 'per call (ms)'])
+  for _s in shape:
+    for _c in conn_num:
+      for _t in transpose:
+        for _d in dtypes:
+          df.loc[len(df)] = [_s, _c, _t, _d, test_half(_s, _c, _t, _d)]
+  os.makedirs('./csrmv_half_VS_float32', exist_ok=True)
+  if platform == 'cpu':
+    df.to_csv(f'./csrmv_half_VS_float32/cpu_{os.cpu_count()}_cores.csv', index=False)
+  else:
+    df.to_csv(f'./csrmv_half_VS_float32/{platform}.csv', index=False)
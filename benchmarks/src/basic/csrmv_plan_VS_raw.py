@@ -0,0 +1,91 @@
+# CSR and event CSR matrix-vector products on raw indices versus a connectivity plan,
+# which caches the transposed matrix, balances the parallel tasks over skewed
+# in-degrees and optionally reorders the matrix. The plan is built once, outside
+# of the timing.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+
+shape = [
+  10000,
+  50000,
+  100000,
+]
+conn_num = [
+  100,
+  500,
+]
+transpose = [
+  True,
+  False,
+]
+kinds = [
+  'csrmv',
+  'event_csrmv',
+]
+plans = [
+  'raw',
+  'plan',
+  'plan-rcm',
+]
+
+ITERATION = 100
+
+
+def _random_csr(n_pre, n_post, conn_num, seed=1234):
+  # skewed in-degrees, with "conn_num" connections per row on average
+  rng = np.random.default_rng(seed)
+  counts = np.minimum(rng.geometric(1 / conn_num, n_pre), n_post)
+  indices = np.concatenate([np.sort(rng.choice(n_post, c, replace=False)) for c in counts]).astype(np.int32)
+  indptr = np.concatenate([[0], np.cumsum(counts)]).astype(np.int32)
+  return jnp.asarray(indices), jnp.asarray(indptr)
+
+
+def test_plan(shape, conn_num, transpose, kind, plan):
+  indices, indptr = _random_csr(shape, shape, conn_num)
+  rng = np.random.default_rng(4321)
+  data = jnp.asarray(rng.random(indices.shape[0]), dtype=jnp.float32)
+  if plan != 'raw':
+    indices = bti.csr_plan(indices, indptr, shape=(shape, shape), reorder='rcm' if plan == 'plan-rcm' else None)
+  if kind == 'csrmv':
+    vector = jnp.asarray(rng.random(shape), dtype=jnp.float32)
+    op = bti.csrmv
+  else:
+    vector = jnp.asarray(rng.random(shape) < 0.05)
+    op = bti.event_csrmv
+
+  f = jax.jit(lambda d, ind, v: op(d, ind, indptr, v, shape=(shape, shape), transpose=transpose))
+  for _ in range(5):
+    jax.block_until_ready(f(data, indices, vector))
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(data, indices, vector)
+  jax.block_until_ready(r)
+  per_call = (time.time() - time0) / ITERATION * 1e3
+
+  print(f'shape: {shape}, conn_num: {conn_num}, transpose: {transpose}, kind: {kind}, '
+        f'plan: {plan}, per call: {per_call:.3f} ms')
+  return per_call
+
+
+if __name__ == '__main__':
+  platform = jax.default_backend()
+  df = pd.DataFrame(columns=['shape', 'conn num', 'transpose', 'kind', 'plan', 'per call (ms)'])
+  for _s in shape:
+    for _c in conn_num:
+      for _t in transpose:
+        for _k in kinds:
+          for _p in plans:
+            df.loc[len(df)] = [_s, _c, _t, _k, _p, test_plan(_s, _c, _t, _k, _p)]
+  os.makedirs('./csrmv_plan_VS_raw', exist_ok=True)
+  if platform == 'cpu':
+    df.to_csv(f'./csrmv_plan_VS_raw/cpu_{os.cpu_count()}_cores.csv', index=False)
+  else:
+    df.to_csv(f'./csrmv_plan_VS_raw/{platform}.csv', index=False)
@@ -0,0 +1,99 @@
+# Transposed CSR matrix-vector products on CPU with the serialized scatter and
+# with the two parallel strategies. The number of threads of the Taichi runtime
+# follows the number of cores of the machine.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+from braintaichi._eventop import _event_csrmv
+from braintaichi._sparseop import _sparse_utils
+
+jax.config.update('jax_platform_name', 'cpu')
+
+# the event products are measured without compacting the events
+_event_csrmv.event_active_set = 'off'
+
+shape = [
+  1000,
+  2500,
+  5000,
+  10000,
+  25000,
+  50000,
+]
+conn_num = [
+  100,
+  500,
+]
+values_type = [
+  'homo',
+  'heter',
+]
+events_type = [
+  'float',
+  'bool',
+]
+strategies = [
+  'serial',
+  'atomic',
+  'partial',
+]
+
+ITERATION = 100
+
+
+def _random_csr(n_pre, n_post, conn_num, seed=1234):
+  rng = np.random.default_rng(seed)
+  indices = np.sort(rng.integers(0, n_post, (n_pre, conn_num)), axis=1).astype(np.int32).flatten()
+  indptr = (np.arange(n_pre + 1) * conn_num).astype(np.int32)
+  return jnp.asarray(indices), jnp.asarray(indptr)
+
+
+def test_strategy(shape, conn_num, values_type, events_type, strategy):
+  _sparse_utils.cpu_transpose_strategy = strategy
+
+  indices, indptr = _random_csr(shape, shape, conn_num)
+  rng = np.random.default_rng(4321)
+  if events_type == 'bool':
+    vector = jnp.asarray(rng.random(shape) < 0.1)
+    op = bti.event_csrmv
+  else:
+    vector = jnp.asarray(rng.random(shape), dtype=jnp.float32)
+    op = bti.csrmv
+  weight = jnp.asarray([1.], dtype=jnp.float32)
+  if values_type == 'heter':
+    weight = jnp.ones(indices.shape, dtype=jnp.float32)
+
+  f = jax.jit(lambda w, v: op(w, indices, indptr, v, shape=(shape, shape), transpose=True))
+  for _ in range(5):
+    jax.block_until_ready(f(weight, vector))
+
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(weight, vector)
+  jax.block_until_ready(r)
+  time1 = time.time()
+  per_call = (time1 - time0) / ITERATION * 1e3
+
+  print(f'shape: {shape}, conn_num: {conn_num}, values_type: {values_type}, events_type: {events_type}, '
+        f'strategy: {strategy}, per call: {per_call:.3f} ms')
+  return per_call
+
+
+if __name__ == '__main__':
+  print(f'cores: {os.cpu_count()}')
+  df = pd.DataFrame(columns=['shape', 'conn num', 'values type', 'events type', 'strategy', 'per call (ms)'])
+  for _s in shape:
+    for _c in conn_num:
+      for _v in values_type:
+        for _e in events_type:
+          for _st in strategies:
+            df.loc[len(df)] = [_s, _c, _v, _e, _st, test_strategy(_s, _c, _v, _e, _st)]
+  os.makedirs('./csrmv_transpose_cpu_strategies', exist_ok=True)
+  df.to_csv(f'./csrmv_transpose_cpu_strategies/cpu_{os.cpu_count()}_cores.csv', index=False)
@@ -12,6 +12,8 @@ import numpy as np
 import pandas as pd
 import taichi as ti
 
+import braintaichi as bti
+
 bm.set_platform('cpu')
 
 size = [
@@ -36,7 +38,7 @@ events_type = ['bool',
                'float',
                ]
 transpose = [
-  # True,
+  True,
   False
 ]
 
@@ -51,7 +53,7 @@ print(bm.get_platform())
 def csrmm(weight, indices, indptr, matrix, shape, transpose):
   r = 0
   for i in range(ITERATION):
-    r += bm.sparse.csrmm(weight, indices, indptr, matrix, shape=shape, transpose=transpose)
+    r += bti.csrmm(weight, indices, indptr, matrix, shape=shape, transpose=transpose)
   return r
 
 
@@ -59,7 +61,7 @@ def csrmm(weight, indices, indptr, matrix, shape, transpose):
 def event_csrmm(weight, indices, indptr, matrix, shape, transpose):
   r = 0
   for i in range(ITERATION):
-    r += bm.event.csrmm(weight, indices, indptr, matrix, shape=shape, transpose=transpose)
+    r += bti.event_csrmm(weight, indices, indptr, matrix, shape=shape, transpose=transpose)
   return r
 
 
@@ -74,6 +76,8 @@ def test_sparse_csrmm(shape, values_type, events_type, transpose):
 
   if events_type == 'float':
     matrix = matrix.astype(bm.float32)
+  else:
+    matrix = matrix < 0.1
   if values_type == 'heter':
     heter_data = bm.ones(indices.shape) * weight
     weight = heter_data
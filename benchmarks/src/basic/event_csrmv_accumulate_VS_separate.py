@@ -0,0 +1,92 @@
+# The update of a synaptic conductance ``g = g * decay + event_csrmv(...)`` over the
+# time steps of a simulation, computed by the plain operator followed by the decay,
+# versus "event_csrmv_accumulate", which writes the decayed state and the input
+# into the buffer of the state in one kernel, without allocating or zeroing an
+# output.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+
+num_pre = [
+  4000,
+  20000,
+  80000,
+]
+conn_num = [
+  20,
+  80,
+]
+values_type = [
+  'homo',
+  'heter',
+]
+transpose = [
+  True,
+  False,
+]
+methods = [
+  'separate',
+  'accumulate',
+]
+
+NUM_STEP = 1000
+ITERATION = 10
+
+
+def _random_csr(n_pre, n_post, conn_num, seed=1234):
+  rng = np.random.default_rng(seed)
+  indices = rng.integers(0, n_post, (n_pre, conn_num)).astype(np.int32).flatten()
+  indptr = (np.arange(n_pre + 1) * conn_num).astype(np.int32)
+  return jnp.asarray(indices), jnp.asarray(indptr)
+
+
+def test_accumulate(num_pre, conn_num, values_type, transpose, method):
+  shape = (num_pre, num_pre)
+  indices, indptr = _random_csr(*shape, conn_num)
+  rng = np.random.default_rng(4321)
+  data = jnp.ones(1 if values_type == 'homo' else indices.shape[0], dtype=jnp.float32)
+  spikes = jnp.asarray(rng.random((NUM_STEP, num_pre)) < 0.05)
+
+  if method == 'separate':
+    def step(g, spk):
+      return g * 0.9 + bti.event_csrmv(data, indices, indptr, spk, shape=shape, transpose=transpose), None
+  else:
+    def step(g, spk):
+      return bti.event_csrmv_accumulate(g, data, indices, indptr, spk, shape=shape, transpose=transpose,
+                                        alpha=0.9), None
+
+  f = jax.jit(lambda g, s: jax.lax.scan(step, g, s)[0], donate_argnums=0)
+  g = jnp.zeros(num_pre, dtype=jnp.float32)
+  g = jax.block_until_ready(f(g, spikes))
+  time0 = time.time()
+  for _ in range(ITERATION):
+    g = f(g, spikes)
+  jax.block_until_ready(g)
+  per_step = (time.time() - time0) / ITERATION / NUM_STEP * 1e3
+
+  print(f'num_pre: {num_pre}, conn_num: {conn_num}, values_type: {values_type}, transpose: {transpose}, '
+        f'method: {method}, per step: {per_step:.4f} ms')
+  return per_step
+
+
+if __name__ == '__main__':
+  platform = jax.default_backend()
+  df = pd.DataFrame(columns=['num pre', 'conn num', 'values type', 'transpose', 'method', 'per step (ms)'])
+  for _n in num_pre:
+    for _c in conn_num:
+      for _v in values_type:
+        for _t in transpose:
+          for _m in methods:
+            df.loc[len(df)] = [_n, _c, _v, _t, _m, test_accumulate(_n, _c, _v, _t, _m)]
+  os.makedirs('./event_csrmv_accumulate_VS_separate', exist_ok=True)
+  if platform == 'cpu':
+    df.to_csv(f'./event_csrmv_accumulate_VS_separate/cpu_{os.cpu_count()}_cores.csv', index=False)
+  else:
+    df.to_csv(f'./event_csrmv_accumulate_VS_separate/{platform}.csv', index=False)
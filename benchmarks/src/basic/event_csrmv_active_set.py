@@ -0,0 +1,98 @@
+# Transposed event CSR matrix-vector products on CPU with and without compacting
+# the events into the list of active rows first, over a range of firing rates.
+# Above 1 / "_active_set_max_ratio", the compacting kernels scan all the rows.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+from braintaichi._eventop import _event_csrmv
+
+jax.config.update('jax_platform_name', 'cpu')
+
+shape = [
+  10000,
+  50000,
+  100000,
+]
+conn_num = [
+  100,
+  500,
+]
+values_type = [
+  'homo',
+  'heter',
+]
+events_type = [
+  'bool',
+  'float',
+]
+rates = [
+  0.001,
+  0.01,
+  0.05,
+  0.2,
+  0.5,
+]
+modes = [
+  'off',
+  'on',
+]
+
+ITERATION = 100
+
+
+def _random_csr(n_pre, n_post, conn_num, seed=1234):
+  rng = np.random.default_rng(seed)
+  indices = np.sort(rng.integers(0, n_post, (n_pre, conn_num)), axis=1).astype(np.int32).flatten()
+  indptr = (np.arange(n_pre + 1) * conn_num).astype(np.int32)
+  return jnp.asarray(indices), jnp.asarray(indptr)
+
+
+def test_active_set(shape, conn_num, values_type, events_type, rate, mode):
+  _event_csrmv.event_active_set = mode
+
+  indices, indptr = _random_csr(shape, shape, conn_num)
+  rng = np.random.default_rng(4321)
+  events = rng.random(shape) < rate
+  if events_type == 'float':
+    events = events.astype(np.float32)
+  events = jnp.asarray(events)
+  weight = jnp.asarray([1.], dtype=jnp.float32)
+  if values_type == 'heter':
+    weight = jnp.ones(indices.shape, dtype=jnp.float32)
+
+  f = jax.jit(lambda w, e: bti.event_csrmv(w, indices, indptr, e, shape=(shape, shape), transpose=True))
+  for _ in range(5):
+    jax.block_until_ready(f(weight, events))
+
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(weight, events)
+  jax.block_until_ready(r)
+  time1 = time.time()
+  per_call = (time1 - time0) / ITERATION * 1e3
+
+  print(f'shape: {shape}, conn_num: {conn_num}, values_type: {values_type}, events_type: {events_type}, '
+        f'rate: {rate}, active set: {mode}, per call: {per_call:.3f} ms')
+  return per_call
+
+
+if __name__ == '__main__':
+  print(f'cores: {os.cpu_count()}')
+  df = pd.DataFrame(columns=['shape', 'conn num', 'values type', 'events type', 'rate', 'active set',
+                             'per call (ms)'])
+  for _s in shape:
+    for _c in conn_num:
+      for _v in values_type:
+        for _e in events_type:
+          for _r in rates:
+            for _m in modes:
+              df.loc[len(df)] = [_s, _c, _v, _e, _r, _m, test_active_set(_s, _c, _v, _e, _r, _m)]
+  os.makedirs('./event_csrmv_active_set', exist_ok=True)
+  df.to_csv(f'./event_csrmv_active_set/cpu_{os.cpu_count()}_cores.csv', index=False)
@@ -0,0 +1,91 @@
+# Several event CSR projections of the same presynaptic spikes, such as the
+# excitatory and inhibitory targets of a population or the projections between the
+# areas of a multi-area model, computed by one "event_csrmv" per projection versus a
+# single "event_csrmv_grouped", which reads the spikes once and launches once.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+
+num_pre = [
+  4000,
+  20000,
+  80000,
+]
+num_projection = [
+  2,
+  8,
+  32,
+]
+conn_num = [
+  20,
+  80,
+]
+values_type = [
+  'homo',
+  'heter',
+]
+methods = [
+  'separate',
+  'grouped',
+]
+
+ITERATION = 100
+
+
+def _random_csr(n_pre, n_post, conn_num, seed):
+  rng = np.random.default_rng(seed)
+  indices = rng.integers(0, n_post, (n_pre, conn_num)).astype(np.int32).flatten()
+  indptr = (np.arange(n_pre + 1) * conn_num).astype(np.int32)
+  return jnp.asarray(indices), jnp.asarray(indptr)
+
+
+def test_grouped(num_pre, num_projection, conn_num, values_type, method):
+  rng = np.random.default_rng(4321)
+  shapes = [(num_pre, num_pre // num_projection)] * num_projection
+  indices, indptr, data = [], [], []
+  for k, shape in enumerate(shapes):
+    ind, ptr = _random_csr(*shape, conn_num // num_projection + 1, seed=k)
+    indices.append(ind)
+    indptr.append(ptr)
+    data.append(jnp.ones(1 if values_type == 'homo' else ind.shape[0], dtype=jnp.float32))
+  events = jnp.asarray(rng.random(num_pre) < 0.05)
+
+  if method == 'separate':
+    f = jax.jit(lambda d, e: [bti.event_csrmv(d[k], indices[k], indptr[k], e, shape=shapes[k], transpose=True)
+                              for k in range(num_projection)])
+  else:
+    f = jax.jit(lambda d, e: bti.event_csrmv_grouped(d, indices, indptr, e, shapes=shapes, transpose=True))
+  for _ in range(5):
+    jax.block_until_ready(f(data, events))
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(data, events)
+  jax.block_until_ready(r)
+  per_call = (time.time() - time0) / ITERATION * 1e3
+
+  print(f'num_pre: {num_pre}, num_projection: {num_projection}, conn_num: {conn_num}, '
+        f'values_type: {values_type}, method: {method}, per call: {per_call:.3f} ms')
+  return per_call
+
+
+if __name__ == '__main__':
+  platform = jax.default_backend()
+  df = pd.DataFrame(columns=['num pre', 'num projection', 'conn num', 'values type', 'method', 'per call (ms)'])
+  for _n in num_pre:
+    for _p in num_projection:
+      for _c in conn_num:
+        for _v in values_type:
+          for _m in methods:
+            df.loc[len(df)] = [_n, _p, _c, _v, _m, test_grouped(_n, _p, _c, _v, _m)]
+  os.makedirs('./event_csrmv_grouped_VS_separate', exist_ok=True)
+  if platform == 'cpu':
+    df.to_csv(f'./event_csrmv_grouped_VS_separate/cpu_{os.cpu_count()}_cores.csv', index=False)
+  else:
+    df.to_csv(f'./event_csrmv_grouped_VS_separate/{platform}.csv', index=False)
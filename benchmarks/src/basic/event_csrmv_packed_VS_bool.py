@@ -0,0 +1,90 @@
+# Event CSR matrix-vector products on boolean events versus bit-packed events, over
+# a range of firing rates. The time to pack the events is reported separately, as
+# the models which produce packed spikes do not pay it.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+
+shape = [
+  10000,
+  50000,
+  100000,
+]
+conn_num = [
+  100,
+  500,
+]
+transpose = [
+  True,
+  False,
+]
+events_type = [
+  'bool',
+  'packed',
+]
+rates = [
+  0.001,
+  0.01,
+  0.05,
+  0.2,
+]
+
+ITERATION = 100
+
+
+def _random_csr(n_pre, n_post, conn_num, seed=1234):
+  rng = np.random.default_rng(seed)
+  indices = np.sort(rng.integers(0, n_post, (n_pre, conn_num)), axis=1).astype(np.int32).flatten()
+  indptr = (np.arange(n_pre + 1) * conn_num).astype(np.int32)
+  return jnp.asarray(indices), jnp.asarray(indptr)
+
+
+def _timeit(f, *args):
+  for _ in range(5):
+    jax.block_until_ready(f(*args))
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(*args)
+  jax.block_until_ready(r)
+  return (time.time() - time0) / ITERATION * 1e3
+
+
+def test_packed(shape, conn_num, transpose, events_type, rate):
+  indices, indptr = _random_csr(shape, shape, conn_num)
+  events = jnp.asarray(np.random.default_rng(4321).random(shape) < rate)
+  weight = jnp.asarray([1.], dtype=jnp.float32)
+
+  pack_time = 0.
+  if events_type == 'packed':
+    pack_time = _timeit(jax.jit(bti.pack_events), events)
+    events = bti.pack_events(events)
+  f = jax.jit(lambda w, e: bti.event_csrmv(w, indices, indptr, e, shape=(shape, shape), transpose=transpose))
+  per_call = _timeit(f, weight, events)
+
+  print(f'shape: {shape}, conn_num: {conn_num}, transpose: {transpose}, events_type: {events_type}, '
+        f'rate: {rate}, pack: {pack_time:.3f} ms, per call: {per_call:.3f} ms')
+  return pack_time, per_call
+
+
+if __name__ == '__main__':
+  platform = jax.default_backend()
+  df = pd.DataFrame(columns=['shape', 'conn num', 'transpose', 'events type', 'rate',
+                             'pack (ms)', 'per call (ms)'])
+  for _s in shape:
+    for _c in conn_num:
+      for _t in transpose:
+        for _e in events_type:
+          for _r in rates:
+            df.loc[len(df)] = [_s, _c, _t, _e, _r, *test_packed(_s, _c, _t, _e, _r)]
+  os.makedirs('./event_csrmv_packed_VS_bool', exist_ok=True)
+  if platform == 'cpu':
+    df.to_csv(f'./event_csrmv_packed_VS_bool/cpu_{os.cpu_count()}_cores.csv', index=False)
+  else:
+    df.to_csv(f'./event_csrmv_packed_VS_bool/{platform}.csv', index=False)
@@ -0,0 +1,82 @@
+# Per-call overhead of the typed-FFI custom call versus the legacy custom call
+# with descriptor operands, measured on CPU with problems small enough that the
+# kernel itself costs next to nothing.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+from braintaichi._primitive import _mlir_translation_rule
+
+jax.config.update('jax_platform_name', 'cpu')
+
+shape = [
+  10,
+  100,
+  1000,
+  10000,
+]
+values_type = [
+  'homo',
+  'heter',
+]
+transpose = [
+  True,
+  False,
+]
+apis = [
+  'legacy',
+  'ffi',
+]
+
+ITERATION = 10000
+
+
+def _random_csr(n_pre, n_post, prob=0.05, seed=1234):
+  rng = np.random.default_rng(seed)
+  dense = rng.random((n_pre, n_post)) < prob
+  indptr = np.concatenate([[0], np.cumsum(dense.sum(1))]).astype(np.int32)
+  indices = np.nonzero(dense)[1].astype(np.int32)
+  return jnp.asarray(indices), jnp.asarray(indptr)
+
+
+def test_overhead(shape, values_type, transpose, api):
+  _mlir_translation_rule.custom_call_api = api
+
+  indices, indptr = _random_csr(shape, shape)
+  vector = jnp.ones(shape, dtype=jnp.float32)
+  weight = 1.
+  if values_type == 'heter':
+    weight = jnp.ones(indices.shape, dtype=jnp.float32)
+
+  # a fresh jit function, so that it is lowered with the selected custom call
+  f = jax.jit(lambda w, v: bti.csrmv(w, indices, indptr, v, shape=(shape, shape), transpose=transpose))
+  for _ in range(10):
+    jax.block_until_ready(f(weight, vector))
+
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(weight, vector)
+  jax.block_until_ready(r)
+  time1 = time.time()
+  per_call = (time1 - time0) / ITERATION * 1e6
+
+  print(f'shape: {shape}, values_type: {values_type}, transpose: {transpose}, '
+        f'api: {api}, per call: {per_call:.2f} us')
+  return per_call
+
+
+if __name__ == '__main__':
+  df = pd.DataFrame(columns=['shape', 'values type', 'transpose', 'api', 'per call (us)'])
+  for _s in shape:
+    for _v in values_type:
+      for _t in transpose:
+        for _a in apis:
+          df.loc[len(df)] = [_s, _v, _t, _a, test_overhead(_s, _v, _t, _a)]
+  os.makedirs('./ffi_VS_legacy_custom_call', exist_ok=True)
+  df.to_csv('./ffi_VS_legacy_custom_call/cpu.csv', index=False)
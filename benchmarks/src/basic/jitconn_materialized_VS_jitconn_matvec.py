@@ -0,0 +1,87 @@
+# Just-in-time connectivity matrix-vector products which regenerate M at every
+# call, versus products which generate M once into a cached CSR matrix and reuse
+# it. The time of the first call, which materializes M, is reported separately.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+from braintaichi._jitconnop import _jit_materialize
+
+shape = [
+  (1000, 1000),
+  (10000, 10000),
+  (20000, 20000),
+]
+kinds = [
+  'homo',
+  'uniform',
+  'event',
+]
+outdim_parallel = [
+  True,
+  False,
+]
+modes = [
+  'off',
+  'on',
+]
+
+conn_prob = 0.05
+ITERATION = 20
+
+
+def test_jitconn(shape, kind, outdim_parallel, mode):
+  _jit_materialize.jitconn_materialize = mode
+  _jit_materialize._cache.clear()
+
+  rng = np.random.default_rng(1234)
+  if kind == 'homo':
+    vector = jnp.asarray(rng.random(shape[1]), dtype=jnp.float32)
+    mv = lambda v: bti.jitc_mv_prob_homo(v, 1., conn_prob, 123, shape=shape, outdim_parallel=outdim_parallel)
+  elif kind == 'uniform':
+    vector = jnp.asarray(rng.random(shape[1]), dtype=jnp.float32)
+    mv = lambda v: bti.jitc_mv_prob_uniform(v, 0., 1., conn_prob, 123, shape=shape, outdim_parallel=outdim_parallel)
+  else:
+    vector = jnp.asarray(rng.random(shape[1]) < 0.1)
+    mv = lambda v: bti.jitc_event_mv_prob_homo(v, 1., conn_prob, 123, shape=shape, outdim_parallel=outdim_parallel)
+
+  # a fresh jit function, so that it is traced with the selected mode
+  f = jax.jit(mv)
+  time0 = time.time()
+  jax.block_until_ready(f(vector))
+  first_call = (time.time() - time0) * 1e3
+  for _ in range(5):
+    jax.block_until_ready(f(vector))
+
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(vector)
+  jax.block_until_ready(r)
+  time1 = time.time()
+  per_call = (time1 - time0) / ITERATION * 1e3
+
+  print(f'shape: {shape}, kind: {kind}, outdim_parallel: {outdim_parallel}, materialize: {mode}, '
+        f'first call: {first_call:.3f} ms, per call: {per_call:.3f} ms')
+  return first_call, per_call
+
+
+if __name__ == '__main__':
+  platform = jax.default_backend()
+  df = pd.DataFrame(columns=['shape', 'kind', 'outdim parallel', 'materialize',
+                             'first call (ms)', 'per call (ms)'])
+  for _s in shape:
+    for _k in kinds:
+      for _o in outdim_parallel:
+        for _m in modes:
+          df.loc[len(df)] = [_s, _k, _o, _m, *test_jitconn(_s, _k, _o, _m)]
+  os.makedirs('./jitconn_materialized_VS_jitconn_matvec', exist_ok=True)
+  if platform == 'cpu':
+    df.to_csv(f'./jitconn_materialized_VS_jitconn_matvec/cpu_{os.cpu_count()}_cores.csv', index=False)
+  else:
+    df.to_csv(f'./jitconn_materialized_VS_jitconn_matvec/{platform}.csv', index=False)
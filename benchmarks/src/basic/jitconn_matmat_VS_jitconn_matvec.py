@@ -0,0 +1,85 @@
+# Products of the just-in-time connectivity with a dense or a spike matrix, with
+# the matrix-matrix operators, which generate the connectivity once, and with one
+# matrix-vector product per column, which generates it once for each column.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+
+shape = [
+  1000,
+  5000,
+  10000,
+  20000,
+]
+batch = [
+  16,
+  64,
+  256,
+]
+kinds = [
+  'float',
+  'event',
+]
+outdim_parallel = [
+  True,
+  False,
+]
+methods = [
+  'matmat',
+  'matvec',
+]
+
+conn_prob = 0.05
+ITERATION = 20
+
+
+def test_jitconn(shape, batch, kind, outdim_parallel, method):
+  rng = np.random.default_rng(1234)
+  if kind == 'float':
+    matrix = jnp.asarray(rng.random((shape, batch)), dtype=jnp.float32)
+    mm, mv = bti.jitc_mm_prob_homo, bti.jitc_mv_prob_homo
+  else:
+    matrix = jnp.asarray(rng.random((shape, batch)) < 0.1)
+    mm, mv = bti.jitc_event_mm_prob_homo, bti.jitc_event_mv_prob_homo
+  kwargs = dict(shape=(shape, shape), outdim_parallel=outdim_parallel)
+
+  if method == 'matmat':
+    f = jax.jit(lambda m: mm(m, 1., conn_prob, 123, **kwargs))
+  else:
+    f = jax.jit(lambda m: jax.lax.map(lambda v: mv(v, 1., conn_prob, 123, **kwargs), m.T).T)
+  for _ in range(5):
+    jax.block_until_ready(f(matrix))
+
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(matrix)
+  jax.block_until_ready(r)
+  time1 = time.time()
+  per_call = (time1 - time0) / ITERATION * 1e3
+
+  print(f'shape: {shape}, batch: {batch}, kind: {kind}, outdim_parallel: {outdim_parallel}, '
+        f'method: {method}, per call: {per_call:.3f} ms')
+  return per_call
+
+
+if __name__ == '__main__':
+  platform = jax.default_backend()
+  df = pd.DataFrame(columns=['shape', 'batch', 'kind', 'outdim parallel', 'method', 'per call (ms)'])
+  for _s in shape:
+    for _b in batch:
+      for _t in kinds:
+        for _o in outdim_parallel:
+          for _m in methods:
+            df.loc[len(df)] = [_s, _b, _t, _o, _m, test_jitconn(_s, _b, _t, _o, _m)]
+  os.makedirs('./jitconn_matmat_VS_jitconn_matvec', exist_ok=True)
+  if platform == 'cpu':
+    df.to_csv(f'./jitconn_matmat_VS_jitconn_matvec/cpu_{os.cpu_count()}_cores.csv', index=False)
+  else:
+    df.to_csv(f'./jitconn_matmat_VS_jitconn_matvec/{platform}.csv', index=False)
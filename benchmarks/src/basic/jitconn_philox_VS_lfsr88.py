@@ -0,0 +1,84 @@
+# Just-in-time connectivity matrix-vector products with the LFSR88 generator,
+# whose rows are sequential streams, and with the counter-based Philox generator,
+# whose rows are split into chunks generated in parallel. Only Philox generates
+# the same M for transpose=False and transpose=True in both orientations.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+
+shape = [
+  (1000, 1000),
+  (10000, 10000),
+  (20000, 20000),
+  (100, 100000),
+  (100000, 100),
+]
+kinds = [
+  'float',
+  'event',
+]
+transpose = [
+  True,
+  False,
+]
+generators = [
+  ('lfsr88', True),
+  ('lfsr88', False),
+  ('philox', True),
+]
+
+conn_prob = 0.05
+ITERATION = 20
+
+
+def test_jitconn(shape, kind, transpose, rng, outdim_parallel):
+  n = shape[0] if transpose else shape[1]
+  rng_np = np.random.default_rng(1234)
+  if kind == 'float':
+    vector = jnp.asarray(rng_np.random(n), dtype=jnp.float32)
+    mv = bti.jitc_mv_prob_homo
+  else:
+    vector = jnp.asarray(rng_np.random(n) < 0.1)
+    mv = bti.jitc_event_mv_prob_homo
+
+  f = jax.jit(lambda v: mv(v, 1., conn_prob, 123, shape=shape, transpose=transpose,
+                           outdim_parallel=outdim_parallel, rng=rng))
+  for _ in range(5):
+    jax.block_until_ready(f(vector))
+
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(vector)
+  jax.block_until_ready(r)
+  time1 = time.time()
+  per_call = (time1 - time0) / ITERATION * 1e3
+  # the number of generated connections per second
+  throughput = conn_prob * shape[0] * shape[1] / (per_call * 1e-3)
+
+  print(f'shape: {shape}, kind: {kind}, transpose: {transpose}, rng: {rng}, '
+        f'outdim_parallel: {outdim_parallel}, per call: {per_call:.3f} ms, '
+        f'throughput: {throughput / 1e6:.1f} M connections/s')
+  return per_call, throughput
+
+
+if __name__ == '__main__':
+  platform = jax.default_backend()
+  df = pd.DataFrame(columns=['shape', 'kind', 'transpose', 'rng', 'outdim parallel',
+                             'per call (ms)', 'connections per second'])
+  for _s in shape:
+    for _k in kinds:
+      for _t in transpose:
+        for _r, _o in generators:
+          df.loc[len(df)] = [_s, _k, _t, _r, _o, *test_jitconn(_s, _k, _t, _r, _o)]
+  os.makedirs('./jitconn_philox_VS_lfsr88', exist_ok=True)
+  if platform == 'cpu':
+    df.to_csv(f'./jitconn_philox_VS_lfsr88/cpu_{os.cpu_count()}_cores.csv', index=False)
+  else:
+    df.to_csv(f'./jitconn_philox_VS_lfsr88/{platform}.csv', index=False)
@@ -0,0 +1,78 @@
+# Time spent lowering braintaichi operators, with and without the in-process
+# memo of kernel fingerprints and compiled kernels. Every kernel is already in
+# the AOT cache, so the numbers only contain the lowering overhead.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+from braintaichi._primitive import _mlir_translation_rule
+
+jax.config.update('jax_platform_name', 'cpu')
+
+shape = [
+  100,
+  1000,
+  10000,
+]
+values_type = [
+  'homo',
+  'heter',
+]
+memoized = [
+  True,
+  False,
+]
+
+ITERATION = 200
+
+
+def _random_csr(n_pre, n_post, prob=0.05, seed=1234):
+  rng = np.random.default_rng(seed)
+  dense = rng.random((n_pre, n_post)) < prob
+  indptr = np.concatenate([[0], np.cumsum(dense.sum(1))]).astype(np.int32)
+  indices = np.nonzero(dense)[1].astype(np.int32)
+  return jnp.asarray(indices), jnp.asarray(indptr)
+
+
+def _lower(weight, indices, indptr, vector, shape):
+  # a fresh function every time, so that jax does not reuse its own lowering
+  f = lambda w, v: bti.csrmv(w, indices, indptr, v, shape=(shape, shape), transpose=True)
+  return jax.jit(f).lower(weight, vector)
+
+
+def test_lowering(shape, values_type, memoized):
+  indices, indptr = _random_csr(shape, shape)
+  vector = jnp.ones(shape, dtype=jnp.float32)
+  weight = 1.
+  if values_type == 'heter':
+    weight = jnp.ones(indices.shape, dtype=jnp.float32)
+  _lower(weight, indices, indptr, vector, shape)  # build the kernel into the AOT cache
+
+  time0 = time.time()
+  for _ in range(ITERATION):
+    if not memoized:
+      _mlir_translation_rule._kernel_fingerprints.clear()
+      _mlir_translation_rule._compiled_kernels.clear()
+    _lower(weight, indices, indptr, vector, shape)
+  time1 = time.time()
+  per_lowering = (time1 - time0) / ITERATION * 1e3
+
+  print(f'shape: {shape}, values_type: {values_type}, memoized: {memoized}, '
+        f'per lowering: {per_lowering:.3f} ms')
+  return per_lowering
+
+
+if __name__ == '__main__':
+  df = pd.DataFrame(columns=['shape', 'values type', 'memoized', 'per lowering (ms)'])
+  for _s in shape:
+    for _v in values_type:
+      for _m in memoized:
+        df.loc[len(df)] = [_s, _v, _m, test_lowering(_s, _v, _m)]
+  os.makedirs('./lowering_time', exist_ok=True)
+  df.to_csv('./lowering_time/cpu.csv', index=False)
@@ -0,0 +1,109 @@
+# CSR versus sliced ELLPACK (SELL-C-sigma) matrix-vector and event matrix-vector
+# products, at the sparsity levels of the CSR benchmarks. The SELL kernels compute
+# the "C" rows of a slice in lockstep, which vectorizes on CPU. A fixed number of
+# connections per row needs no padding, while a random one is padded to the longest
+# row of each slice, which sorting the rows within windows reduces.
+
+import os
+import time
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pandas as pd
+
+import braintaichi as bti
+
+shape = [
+  1000,
+  5000,
+  10000,
+]
+prob = [
+  0.1,
+  0.2,
+  0.3,
+  0.4,
+  0.5,
+]
+connectivity = [
+  'fixed',
+  'random',
+]
+transpose = [
+  True,
+  False,
+]
+kinds = [
+  'csrmv',
+  'event_csrmv',
+]
+formats = [
+  'csr',
+  'sell',
+  'sell-sorted',
+]
+
+ITERATION = 100
+
+
+def _random_csr(n_pre, n_post, prob, connectivity, seed=1234):
+  rng = np.random.default_rng(seed)
+  if connectivity == 'fixed':
+    counts = np.full(n_pre, int(n_post * prob))
+  else:
+    counts = rng.binomial(n_post, prob, n_pre)
+  indices = np.concatenate([np.sort(rng.choice(n_post, c, replace=False)) for c in counts]).astype(np.int32)
+  indptr = np.concatenate([[0], np.cumsum(counts)]).astype(np.int32)
+  return indices, indptr
+
+
+def test_sell(shape, prob, connectivity, transpose, kind, fmt):
+  indices, indptr = _random_csr(shape, shape, prob, connectivity)
+  rng = np.random.default_rng(4321)
+  data = jnp.asarray(rng.random(indices.shape[0]), dtype=jnp.float32)
+  if kind == 'csrmv':
+    vector = jnp.asarray(rng.random(shape), dtype=jnp.float32)
+  else:
+    vector = jnp.asarray(rng.random(shape) < 0.05)
+
+  if fmt == 'csr':
+    indices, indptr = jnp.asarray(indices), jnp.asarray(indptr)
+    op = bti.csrmv if kind == 'csrmv' else bti.event_csrmv
+    f = jax.jit(lambda d, v: op(d, indices, indptr, v, shape=(shape, shape), transpose=transpose))
+  else:
+    slice_size = 8 if jax.default_backend() == 'cpu' else 32
+    sell = bti.csr_to_sell(indices, indptr, shape=(shape, shape), slice_size=slice_size,
+                           sort_window=slice_size * 32 if fmt == 'sell-sorted' else None)
+    data = bti.sell_values(data, sell)
+    op = bti.sellmv if kind == 'csrmv' else bti.event_sellmv
+    f = jax.jit(lambda d, v: op(d, sell, v, shape=(shape, shape), transpose=transpose))
+
+  for _ in range(5):
+    jax.block_until_ready(f(data, vector))
+  time0 = time.time()
+  for _ in range(ITERATION):
+    r = f(data, vector)
+  jax.block_until_ready(r)
+  per_call = (time.time() - time0) / ITERATION * 1e3
+
+  print(f'shape: {shape}, prob: {prob}, connectivity: {connectivity}, transpose: {transpose}, kind: {kind}, '
+        f'format: {fmt}, per call: {per_call:.3f} ms')
+  return per_call
+
+
+if __name__ == '__main__':
+  platform = jax.default_backend()
+  df = pd.DataFrame(columns=['shape', 'prob', 'connectivity', 'transpose', 'kind', 'format', 'per call (ms)'])
+  for _s in shape:
+    for _p in prob:
+      for _c in connectivity:
+        for _t in transpose:
+          for _k in kinds:
+            for _f in formats:
+              df.loc[len(df)] = [_s, _p, _c, _t, _k, _f, test_sell(_s, _p, _c, _t, _k, _f)]
+  os.makedirs('./sellmv_VS_csrmv', exist_ok=True)
+  if platform == 'cpu':
+    df.to_csv(f'./sellmv_VS_csrmv/cpu_{os.cpu_count()}_cores.csv', index=False)
+  else:
+    df.to_csv(f'./sellmv_VS_csrmv/{platform}.csv', index=False)
@@ -0,0 +1,63 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+"""
+Command line tools of braintaichi.
+
+Pre-populate the AOT kernel cache, e.g., when building a container image::
+
+  python -m braintaichi precompile my_package.warmup:KERNELS --platform cpu --workers 8
+
+where ``my_package.warmup.KERNELS`` is an ``(ops, signatures)`` pair accepted
+by :py:func:`braintaichi.precompile`, or a function returning one.
+"""
+
+import argparse
+import importlib
+import sys
+
+
+def _load_spec(spec: str):
+  module_name, _, attr = spec.partition(':')
+  if not module_name or not attr:
+    raise ValueError(f'Expected a "module:attribute" spec, but got {spec!r}.')
+  target = importlib.import_module(module_name)
+  for name in attr.split('.'):
+    target = getattr(target, name)
+  return target() if callable(target) else target
+
+
+def main(argv=None):
+  parser = argparse.ArgumentParser(prog='python -m braintaichi')
+  commands = parser.add_subparsers(dest='command', required=True)
+  cmd = commands.add_parser('precompile', help='Build Taichi kernels into the AOT cache.')
+  cmd.add_argument('spec', nargs='+', help='"module:attribute" giving an (ops, signatures) pair.')
+  cmd.add_argument('--platform', action='append', choices=['cpu', 'gpu'],
+                   help='The platform to compile for. Can be repeated. Defaults to cpu.')
+  cmd.add_argument('--workers', type=int, default=None, help='The number of build processes.')
+  args = parser.parse_args(argv)
+
+  import braintaichi as bti
+  for spec in args.spec:
+    ops, signatures = _load_spec(spec)
+    keys = bti.precompile(ops, signatures, platforms=args.platform or ['cpu'], num_workers=args.workers)
+    print(f'{spec}: {len(set(keys))} kernels ready in the AOT cache.')
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
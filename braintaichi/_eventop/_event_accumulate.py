@@ -0,0 +1,366 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+"""
+The accumulating event CSR products ``alpha * state + beta * (A @ events)``, which
+are written into the buffer of ``state``, see "_sparse_accumulate.py".
+
+The boolean events have their own kernels. The float events are computed by the
+accumulating CSR products, as in "event_csrmv", and the packed events are unpacked
+into boolean ones.
+"""
+
+from typing import Tuple
+
+import jax
+import jax.numpy as jnp
+import taichi as ti
+
+from braintaichi._primitive._xla_custom_op import XLACustomOp
+from braintaichi._sparseop._sparse_accumulate import raw_csrmv_accumulate_taichi as normal_csrmv_accumulate_taichi
+from braintaichi._sparseop._sparse_compressed import CompressedIndices
+from braintaichi._sparseop._sparse_plan import CSRPlan
+from braintaichi._sparseop._sparse_utils import _use_atomic_cpu_scatter, is_half
+from ._event_csrmv import raw_csrmv_taichi as event_csrmv_taichi
+from ._event_packed import is_packed, raw_unpack_events
+
+
+def raw_event_csrmv_accumulate_taichi(
+    state: jax.Array,
+    alpha: jax.Array,
+    beta: jax.Array,
+    data: jax.Array,
+    indices: jax.Array,
+    indptr: jax.Array,
+    events: jax.Array,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool,
+):
+  # the plans, the compressed indices and the 16-bit values compute the product
+  # with their own kernels, and XLA fuses the epilogue into one pass
+  if isinstance(indices, (CSRPlan, CompressedIndices)) or is_half(data.dtype):
+    r = event_csrmv_taichi(data, indices, indptr, events, shape=shape, transpose=transpose)[0]
+    return [alpha[0] * state + beta[0] * r.astype(state.dtype)]
+  if is_packed(events):
+    events = raw_unpack_events(events, shape[0] if transpose else shape[1])
+  if events.dtype != jnp.bool_:
+    return normal_csrmv_accumulate_taichi(state, alpha, beta, data, indices, indptr, events,
+                                          shape=shape, transpose=transpose)
+
+  homo = data.shape[0] == 1
+  if transpose:
+    prim = _event_csrmv_accumulate_transpose_homo_p if homo else _event_csrmv_accumulate_transpose_heter_p
+    if _use_atomic_cpu_scatter(shape[1], indices.shape[0]):
+      prim = (_event_csrmv_accumulate_transpose_homo_atomic_p
+              if homo else
+              _event_csrmv_accumulate_transpose_heter_atomic_p)
+  else:
+    prim = _event_csrmv_accumulate_homo_p if homo else _event_csrmv_accumulate_heter_p
+  return prim(state,
+              alpha,
+              beta,
+              data,
+              indices,
+              indptr,
+              events,
+              outs=[jax.ShapeDtypeStruct(state.shape, dtype=state.dtype)],
+              transpose=transpose,
+              shape=shape)
+
+
+# -------------
+# CPU operators
+# -------------
+
+@ti.kernel
+def _event_csr_matvec_accumulate_transpose_homo_cpu(state: ti.types.ndarray(ndim=1),
+                                                    alpha: ti.types.ndarray(ndim=1),
+                                                    beta: ti.types.ndarray(ndim=1),
+                                                    values: ti.types.ndarray(ndim=1),
+                                                    indices: ti.types.ndarray(ndim=1),
+                                                    indptr: ti.types.ndarray(ndim=1),
+                                                    events: ti.types.ndarray(ndim=1),
+                                                    out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  value = beta[0] * values[0]
+  for col_i in range(out.shape[0]):
+    out[col_i] = a * state[col_i]
+  ti.loop_config(serialize=True)
+  for row_i in range(indptr.shape[0] - 1):
+    if events[row_i]:
+      for j in range(indptr[row_i], indptr[row_i + 1]):
+        out[indices[j]] += value
+
+
+@ti.kernel
+def _event_csr_matvec_accumulate_transpose_heter_cpu(state: ti.types.ndarray(ndim=1),
+                                                     alpha: ti.types.ndarray(ndim=1),
+                                                     beta: ti.types.ndarray(ndim=1),
+                                                     values: ti.types.ndarray(ndim=1),
+                                                     indices: ti.types.ndarray(ndim=1),
+                                                     indptr: ti.types.ndarray(ndim=1),
+                                                     events: ti.types.ndarray(ndim=1),
+                                                     out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  b = beta[0]
+  for col_i in range(out.shape[0]):
+    out[col_i] = a * state[col_i]
+  ti.loop_config(serialize=True)
+  for row_i in range(indptr.shape[0] - 1):
+    if events[row_i]:
+      for j in range(indptr[row_i], indptr[row_i + 1]):
+        out[indices[j]] += b * values[j]
+
+
+@ti.kernel
+def _event_csr_matvec_accumulate_transpose_homo_atomic_cpu(state: ti.types.ndarray(ndim=1),
+                                                           alpha: ti.types.ndarray(ndim=1),
+                                                           beta: ti.types.ndarray(ndim=1),
+                                                           values: ti.types.ndarray(ndim=1),
+                                                           indices: ti.types.ndarray(ndim=1),
+                                                           indptr: ti.types.ndarray(ndim=1),
+                                                           events: ti.types.ndarray(ndim=1),
+                                                           out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  value = beta[0] * values[0]
+  for col_i in range(out.shape[0]):
+    out[col_i] = a * state[col_i]
+  for row_i in range(indptr.shape[0] - 1):
+    if events[row_i]:
+      for j in range(indptr[row_i], indptr[row_i + 1]):
+        out[indices[j]] += value
+
+
+@ti.kernel
+def _event_csr_matvec_accumulate_transpose_heter_atomic_cpu(state: ti.types.ndarray(ndim=1),
+                                                            alpha: ti.types.ndarray(ndim=1),
+                                                            beta: ti.types.ndarray(ndim=1),
+                                                            values: ti.types.ndarray(ndim=1),
+                                                            indices: ti.types.ndarray(ndim=1),
+                                                            indptr: ti.types.ndarray(ndim=1),
+                                                            events: ti.types.ndarray(ndim=1),
+                                                            out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  b = beta[0]
+  for col_i in range(out.shape[0]):
+    out[col_i] = a * state[col_i]
+  for row_i in range(indptr.shape[0] - 1):
+    if events[row_i]:
+      for j in range(indptr[row_i], indptr[row_i + 1]):
+        out[indices[j]] += b * values[j]
+
+
+@ti.kernel
+def _event_csr_matvec_accumulate_homo_cpu(state: ti.types.ndarray(ndim=1),
+                                          alpha: ti.types.ndarray(ndim=1),
+                                          beta: ti.types.ndarray(ndim=1),
+                                          values: ti.types.ndarray(ndim=1),
+                                          indices: ti.types.ndarray(ndim=1),
+                                          indptr: ti.types.ndarray(ndim=1),
+                                          events: ti.types.ndarray(ndim=1),
+                                          out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  value = beta[0] * values[0]
+  for row_i in range(indptr.shape[0] - 1):
+    r = 0.
+    for j in range(indptr[row_i], indptr[row_i + 1]):
+      if events[indices[j]]:
+        r += value
+    out[row_i] = a * state[row_i] + r
+
+
+@ti.kernel
+def _event_csr_matvec_accumulate_heter_cpu(state: ti.types.ndarray(ndim=1),
+                                           alpha: ti.types.ndarray(ndim=1),
+                                           beta: ti.types.ndarray(ndim=1),
+                                           values: ti.types.ndarray(ndim=1),
+                                           indices: ti.types.ndarray(ndim=1),
+                                           indptr: ti.types.ndarray(ndim=1),
+                                           events: ti.types.ndarray(ndim=1),
+                                           out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  b = beta[0]
+  for row_i in range(indptr.shape[0] - 1):
+    r = 0.
+    for j in range(indptr[row_i], indptr[row_i + 1]):
+      if events[indices[j]]:
+        r += values[j]
+    out[row_i] = a * state[row_i] + b * r
+
+
+# -------------
+# GPU operators
+# -------------
+
+@ti.kernel
+def _event_csr_matvec_accumulate_transpose_homo_gpu(state: ti.types.ndarray(ndim=1),
+                                                    alpha: ti.types.ndarray(ndim=1),
+                                                    beta: ti.types.ndarray(ndim=1),
+                                                    values: ti.types.ndarray(ndim=1),
+                                                    indices: ti.types.ndarray(ndim=1),
+                                                    indptr: ti.types.ndarray(ndim=1),
+                                                    events: ti.types.ndarray(ndim=1),
+                                                    out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  value = beta[0] * values[0]
+  for col_i in range(out.shape[0]):
+    out[col_i] = a * state[col_i]
+  for i in range((indptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    if events[row_i]:
+      j = indptr[row_i] + index
+      end_index = indptr[row_i + 1]
+      while j < end_index:
+        out[indices[j]] += value
+        j += 32
+
+
+@ti.kernel
+def _event_csr_matvec_accumulate_transpose_heter_gpu(state: ti.types.ndarray(ndim=1),
+                                                     alpha: ti.types.ndarray(ndim=1),
+                                                     beta: ti.types.ndarray(ndim=1),
+                                                     values: ti.types.ndarray(ndim=1),
+                                                     indices: ti.types.ndarray(ndim=1),
+                                                     indptr: ti.types.ndarray(ndim=1),
+                                                     events: ti.types.ndarray(ndim=1),
+                                                     out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  b = beta[0]
+  for col_i in range(out.shape[0]):
+    out[col_i] = a * state[col_i]
+  for i in range((indptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    if events[row_i]:
+      j = indptr[row_i] + index
+      end_index = indptr[row_i + 1]
+      while j < end_index:
+        out[indices[j]] += b * values[j]
+        j += 32
+
+
+@ti.kernel
+def _event_csr_matvec_accumulate_homo_gpu(state: ti.types.ndarray(ndim=1),
+                                          alpha: ti.types.ndarray(ndim=1),
+                                          beta: ti.types.ndarray(ndim=1),
+                                          values: ti.types.ndarray(ndim=1),
+                                          indices: ti.types.ndarray(ndim=1),
+                                          indptr: ti.types.ndarray(ndim=1),
+                                          events: ti.types.ndarray(ndim=1),
+                                          out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  value = beta[0] * values[0]
+  for row_i in range(out.shape[0]):
+    out[row_i] = a * state[row_i]
+  for i in range((indptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    r = 0.
+    j = indptr[row_i] + index
+    end_index = indptr[row_i + 1]
+    while j < end_index:
+      if events[indices[j]]:
+        r += value
+      j += 32
+    out[row_i] += r
+
+
+@ti.kernel
+def _event_csr_matvec_accumulate_heter_gpu(state: ti.types.ndarray(ndim=1),
+                                           alpha: ti.types.ndarray(ndim=1),
+                                           beta: ti.types.ndarray(ndim=1),
+                                           values: ti.types.ndarray(ndim=1),
+                                           indices: ti.types.ndarray(ndim=1),
+                                           indptr: ti.types.ndarray(ndim=1),
+                                           events: ti.types.ndarray(ndim=1),
+                                           out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  b = beta[0]
+  for row_i in range(out.shape[0]):
+    out[row_i] = a * state[row_i]
+  for i in range((indptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    r = 0.
+    j = indptr[row_i] + index
+    end_index = indptr[row_i + 1]
+    while j < end_index:
+      if events[indices[j]]:
+        r += values[j]
+      j += 32
+    out[row_i] += b * r
+
+
+# The events are boolean, so they have no tangents, see "_sparse_accumulate.py" for
+# the others.
+
+def _event_csrmv_product(values, indices, indptr, events, shape, transpose):
+  return event_csrmv_taichi(values, indices, indptr, events, shape=shape, transpose=transpose)[0]
+
+
+def _event_csrmv_accumulate_jvp_state(state_dot, state, alpha, beta, values, indices, indptr, events, *, outs,
+                                      transpose, shape):
+  return [alpha[0] * state_dot]
+
+
+def _event_csrmv_accumulate_jvp_alpha(alpha_dot, state, alpha, beta, values, indices, indptr, events, *, outs,
+                                      transpose, shape):
+  return [alpha_dot[0] * state]
+
+
+def _event_csrmv_accumulate_jvp_beta(beta_dot, state, alpha, beta, values, indices, indptr, events, *, outs,
+                                     transpose, shape):
+  return [beta_dot[0] * _event_csrmv_product(values, indices, indptr, events, shape, transpose)]
+
+
+def _event_csrmv_accumulate_jvp_values(val_dot, state, alpha, beta, values, indices, indptr, events, *, outs,
+                                       transpose, shape):
+  return [beta[0] * _event_csrmv_product(val_dot, indices, indptr, events, shape, transpose)]
+
+
+def _define_op(cpu_kernel, gpu_kernel):
+  # the output is written into the buffer of the state, and starts with its contents
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, input_output_aliases={0: 0},
+                     output_init=('input',))
+  prim.defjvp(_event_csrmv_accumulate_jvp_state,
+              _event_csrmv_accumulate_jvp_alpha,
+              _event_csrmv_accumulate_jvp_beta,
+              _event_csrmv_accumulate_jvp_values,
+              None,
+              None,
+              None)
+  return prim
+
+
+_event_csrmv_accumulate_transpose_homo_p = _define_op(
+  cpu_kernel=_event_csr_matvec_accumulate_transpose_homo_cpu,
+  gpu_kernel=_event_csr_matvec_accumulate_transpose_homo_gpu)
+_event_csrmv_accumulate_transpose_heter_p = _define_op(
+  cpu_kernel=_event_csr_matvec_accumulate_transpose_heter_cpu,
+  gpu_kernel=_event_csr_matvec_accumulate_transpose_heter_gpu)
+_event_csrmv_accumulate_transpose_homo_atomic_p = _define_op(
+  cpu_kernel=_event_csr_matvec_accumulate_transpose_homo_atomic_cpu,
+  gpu_kernel=_event_csr_matvec_accumulate_transpose_homo_gpu)
+_event_csrmv_accumulate_transpose_heter_atomic_p = _define_op(
+  cpu_kernel=_event_csr_matvec_accumulate_transpose_heter_atomic_cpu,
+  gpu_kernel=_event_csr_matvec_accumulate_transpose_heter_gpu)
+_event_csrmv_accumulate_homo_p = _define_op(cpu_kernel=_event_csr_matvec_accumulate_homo_cpu,
+                                            gpu_kernel=_event_csr_matvec_accumulate_homo_gpu)
+_event_csrmv_accumulate_heter_p = _define_op(cpu_kernel=_event_csr_matvec_accumulate_heter_cpu,
+                                             gpu_kernel=_event_csr_matvec_accumulate_heter_gpu)
@@ -22,13 +22,17 @@ import jax
 import numpy as np
 import taichi as ti
 from jax import numpy as jnp
-from jax.experimental.sparse import csr
 from jax.interpreters import ad
 
-from braintaichi._primitive._batch_utils import register_general_batching
 from braintaichi._primitive._xla_custom_op import XLACustomOp
+from braintaichi._sparseop._sparse_compressed import CompressedIndices, decompress_indices
 from braintaichi._sparseop._sparse_csrmm import raw_csrmm_taichi as normal_csrmm
-from braintaichi._sparseop._sparse_utils import csr_to_coo
+from braintaichi._sparseop._sparse_plan import CSRPlan, plan_values, plan_input, plan_output
+from braintaichi._sparseop._sparse_utils import csr_to_coo, _cpu_transpose_strategy, _scratch_free_lowering, is_half
+from ._event_packed import is_packed, num_words, as_words32, raw_unpack_events, _ctz, _bit
+
+# the number of output columns of each parallel task of the transposed CPU kernels
+_transpose_col_tile = 16
 
 
 def raw_event_csrmm_taichi(
@@ -42,6 +46,19 @@ def raw_event_csrmm_taichi(
 ):
   assert len(shape) == 2
 
+  # the products of a plan are computed on its reordered matrix, whose packed events
+  # are unpacked to be reordered
+  if isinstance(indices, CSRPlan):
+    plan = indices
+    matrix = jnp.asarray(matrix)
+    if is_packed(matrix) and (plan.row_perm if transpose else plan.col_perm) is not None:
+      matrix = raw_unpack_events(matrix, shape[0] if transpose else shape[1])
+    r = raw_event_csrmm_taichi(plan_values(jnp.atleast_1d(data), plan), plan.indices, plan.indptr,
+                               plan_input(plan, matrix, transpose), shape=shape, transpose=transpose)[0]
+    return [plan_output(plan, r, transpose)]
+  # the dense columns amortize the index stream, so compressed indices are decompressed
+  if isinstance(indices, CompressedIndices):
+    indices = decompress_indices(indices, indptr)
   data = jnp.atleast_1d(data)
   if np.ndim(data) == 1:
     if data.shape[0] not in [1, indices.shape[0]]:
@@ -62,15 +79,20 @@ def raw_event_csrmm_taichi(
   if indices.shape[0] == 0:
     return [jnp.zeros(result_shape, dtype=data.dtype), ]
 
+  # 16-bit values are computed in float32, the heter ones by "normal_csrmm"
+  if is_half(data.dtype) and (data.shape[0] == 1 or is_packed(matrix)):
+    r = raw_event_csrmm_taichi(data.astype(jnp.float32), indices, indptr, matrix, shape=shape, transpose=transpose)[0]
+    return [r.astype(data.dtype)]
+
+  if is_packed(matrix):
+    return _raw_packed_csrmm_taichi(data, indices, indptr, as_words32(matrix), shape=shape, transpose=transpose)
+
   assert matrix.shape[0] == (shape[0] if transpose else shape[1])
 
   # homo -> taichi
-  # heter -> cusparse
+  # heter -> taichi on CPU, cusparse on GPU
   if data.shape[0] != 1:
-    if matrix.dtype == jnp.bool_:
-      # change dtype to float
-      matrix = matrix.astype(jnp.float64 if jax.config.read('jax_enable_x64') else jnp.float32)
-    return [_csr_matmat_cusparse_p.bind(data, indices, indptr, matrix, shape=shape, transpose=transpose), ]
+    return normal_csrmm(data, indices, indptr, matrix, shape=shape, transpose=transpose)
   else:
     if transpose:
       if matrix.dtype == jnp.bool_:
@@ -82,43 +104,229 @@ def raw_event_csrmm_taichi(
         prim = _event_csr_matmat_bool_homo_p
       else:
         return normal_csrmm(data, indices, indptr, matrix, shape=shape, transpose=transpose)
+    outs = [jax.ShapeDtypeStruct(result_shape, dtype=data.dtype)]
+    if transpose:
+      prim = _blocked_transpose_prim(prim, _event_csr_matmat_transpose_homo_partial_p, outs,
+                                     matrix.shape[0], indices.shape[0])
     return prim(data,
                 indices,
                 indptr,
                 matrix,
-                outs=[jax.ShapeDtypeStruct(result_shape, dtype=data.dtype)],
+                outs=outs,
                 transpose=transpose,
-                shape=shape)
+                shape=shape)[:1]
+
+
+def _raw_packed_csrmm_taichi(data, indices, indptr, matrix, *, shape, transpose):
+  num_event = shape[0] if transpose else shape[1]
+  if matrix.shape[0] != num_words(num_event, matrix.dtype):
+    raise ValueError(f'Shape mismatch, {num_event} packed rows of events need {num_words(num_event, matrix.dtype)} '
+                     f'words, but got {matrix.shape[0]}.')
+  outs = [jax.ShapeDtypeStruct((shape[1] if transpose else shape[0], matrix.shape[1]), dtype=data.dtype)]
+  if transpose:
+    if data.shape[0] == 1:
+      prim = _blocked_transpose_prim(_event_csr_matmat_transpose_packed_homo_p,
+                                     _event_csr_matmat_transpose_packed_homo_partial_p,
+                                     outs, matrix.shape[0], indices.shape[0])
+    else:
+      prim = _blocked_transpose_prim(_event_csr_matmat_transpose_packed_heter_p,
+                                     _event_csr_matmat_transpose_packed_heter_partial_p,
+                                     outs, matrix.shape[0], indices.shape[0])
+  else:
+    prim = _event_csr_matmat_packed_homo_p if data.shape[0] == 1 else _event_csr_matmat_packed_heter_p
+  return prim(data,
+              indices,
+              indptr,
+              matrix,
+              outs=outs,
+              transpose=transpose,
+              shape=shape)[:1]
+
+
+def _blocked_transpose_prim(prim, partial_prim, outs: list, num_row: int, nnz: int):
+  """The operator of a transposed product on CPU, tiled over the columns of its output.
+
+  When the tiles are fewer than the blocks of the "partial" strategy, the rows of the
+  events are also split into blocks, and the scratch output of ``partial_prim`` is
+  appended to ``outs``.
+  """
+  out_shape = outs[0].shape
+  strategy, num_block = _cpu_transpose_strategy(out_shape[0] * out_shape[1], nnz)
+  num_tile = (out_shape[1] + _transpose_col_tile - 1) // _transpose_col_tile
+  num_block = min((num_block + num_tile - 1) // num_tile, num_row)
+  if strategy == 'partial' and num_block > 1:
+    outs.append(jax.ShapeDtypeStruct((num_block,) + out_shape, dtype=outs[0].dtype))
+    return partial_prim
+  return prim
 
 
 # taichi kernels
 
+# The transposed kernels scatter each non-zero of the rows with an event once, for
+# each of the event columns, which costs O(nnz x active columns) rather than testing
+# every non-zero against every output element. On CPU, the columns of the output are
+# split into tiles which are processed in parallel. Each tile owns its columns of
+# "out", so that the assignments are written out, rather than "+=", and are not
+# compiled into atomics. Few columns make few tiles, so with the "partial" strategy
+# the "partial" kernels below also split the rows into blocks. On GPU, every
+# (row, column) pair is a thread and the scatter is atomic.
+
 @ti.kernel
-def _event_csr_matmat_transpose_heter(values: ti.types.ndarray(ndim=1),
-                                      col_indices: ti.types.ndarray(ndim=1),
-                                      row_ptr: ti.types.ndarray(ndim=1),
-                                      matrix: ti.types.ndarray(ndim=2),
-                                      out: ti.types.ndarray(ndim=2)):
-  for col_i, row_k in ti.ndrange(out.shape[1], out.shape[0]):
+def _event_csr_matmat_transpose_heter_cpu(values: ti.types.ndarray(ndim=1),
+                                          col_indices: ti.types.ndarray(ndim=1),
+                                          row_ptr: ti.types.ndarray(ndim=1),
+                                          matrix: ti.types.ndarray(ndim=2),
+                                          out: ti.types.ndarray(ndim=2)):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_col = out.shape[1]
+  for tile_i in range((num_col + _transpose_col_tile - 1) // _transpose_col_tile):
+    col_end = ti.min((tile_i + 1) * _transpose_col_tile, num_col)
     for row_j in range(matrix.shape[0]):
-      if matrix[row_j, col_i] != 0.:
-        for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
-          if col_indices[j] == row_k:
-            out[row_k, col_i] += values[j] * matrix[row_j, col_i]
+      for col_i in range(tile_i * _transpose_col_tile, col_end):
+        if matrix[row_j, col_i] != 0.:
+          for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+            out[col_indices[j], col_i] = out[col_indices[j], col_i] + values[j] * matrix[row_j, col_i]
 
 
 @ti.kernel
-def _event_csr_matmat_transpose_bool_heter(values: ti.types.ndarray(ndim=1),
-                                           col_indices: ti.types.ndarray(ndim=1),
-                                           row_ptr: ti.types.ndarray(ndim=1),
-                                           matrix: ti.types.ndarray(ndim=2),
-                                           out: ti.types.ndarray(ndim=2)):
-  for col_i, row_k in ti.ndrange(out.shape[1], out.shape[0]):
+def _event_csr_matmat_transpose_heter_gpu(values: ti.types.ndarray(ndim=1),
+                                          col_indices: ti.types.ndarray(ndim=1),
+                                          row_ptr: ti.types.ndarray(ndim=1),
+                                          matrix: ti.types.ndarray(ndim=2),
+                                          out: ti.types.ndarray(ndim=2)):
+  for row_j, col_i in ti.ndrange(matrix.shape[0], matrix.shape[1]):
+    if matrix[row_j, col_i] != 0.:
+      for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+        out[col_indices[j], col_i] += values[j] * matrix[row_j, col_i]
+
+
+@ti.kernel
+def _event_csr_matmat_transpose_bool_heter_cpu(values: ti.types.ndarray(ndim=1),
+                                               col_indices: ti.types.ndarray(ndim=1),
+                                               row_ptr: ti.types.ndarray(ndim=1),
+                                               matrix: ti.types.ndarray(ndim=2),
+                                               out: ti.types.ndarray(ndim=2)):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_col = out.shape[1]
+  for tile_i in range((num_col + _transpose_col_tile - 1) // _transpose_col_tile):
+    col_end = ti.min((tile_i + 1) * _transpose_col_tile, num_col)
     for row_j in range(matrix.shape[0]):
-      if matrix[row_j, col_i]:
-        for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
-          if col_indices[j] == row_k:
-            out[row_k, col_i] += values[j] * matrix[row_j, col_i]
+      for col_i in range(tile_i * _transpose_col_tile, col_end):
+        if matrix[row_j, col_i]:
+          for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+            out[col_indices[j], col_i] = out[col_indices[j], col_i] + values[j]
+
+
+@ti.kernel
+def _event_csr_matmat_transpose_bool_heter_gpu(values: ti.types.ndarray(ndim=1),
+                                               col_indices: ti.types.ndarray(ndim=1),
+                                               row_ptr: ti.types.ndarray(ndim=1),
+                                               matrix: ti.types.ndarray(ndim=2),
+                                               out: ti.types.ndarray(ndim=2)):
+  for row_j, col_i in ti.ndrange(matrix.shape[0], matrix.shape[1]):
+    if matrix[row_j, col_i]:
+      for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+        out[col_indices[j], col_i] += values[j]
+
+
+@ti.kernel
+def _event_csr_matmat_transpose_homo_cpu(values: ti.types.ndarray(ndim=1),
+                                         col_indices: ti.types.ndarray(ndim=1),
+                                         row_ptr: ti.types.ndarray(ndim=1),
+                                         matrix: ti.types.ndarray(ndim=2),
+                                         out: ti.types.ndarray(ndim=2)):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  value = values[0]
+  num_col = out.shape[1]
+  for tile_i in range((num_col + _transpose_col_tile - 1) // _transpose_col_tile):
+    col_end = ti.min((tile_i + 1) * _transpose_col_tile, num_col)
+    for row_j in range(matrix.shape[0]):
+      for col_i in range(tile_i * _transpose_col_tile, col_end):
+        if matrix[row_j, col_i] != 0.:
+          for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+            out[col_indices[j], col_i] = out[col_indices[j], col_i] + value * matrix[row_j, col_i]
+
+
+@ti.kernel
+def _event_csr_matmat_transpose_homo_gpu(values: ti.types.ndarray(ndim=1),
+                                         col_indices: ti.types.ndarray(ndim=1),
+                                         row_ptr: ti.types.ndarray(ndim=1),
+                                         matrix: ti.types.ndarray(ndim=2),
+                                         out: ti.types.ndarray(ndim=2)):
+  value = values[0]
+  for row_j, col_i in ti.ndrange(matrix.shape[0], matrix.shape[1]):
+    if matrix[row_j, col_i] != 0.:
+      for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+        out[col_indices[j], col_i] += value * matrix[row_j, col_i]
+
+
+@ti.kernel
+def _event_csr_matmat_transpose_bool_homo_cpu(values: ti.types.ndarray(ndim=1),
+                                              col_indices: ti.types.ndarray(ndim=1),
+                                              row_ptr: ti.types.ndarray(ndim=1),
+                                              matrix: ti.types.ndarray(ndim=2),
+                                              out: ti.types.ndarray(ndim=2)):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  value = values[0]
+  num_col = out.shape[1]
+  for tile_i in range((num_col + _transpose_col_tile - 1) // _transpose_col_tile):
+    col_end = ti.min((tile_i + 1) * _transpose_col_tile, num_col)
+    for row_j in range(matrix.shape[0]):
+      for col_i in range(tile_i * _transpose_col_tile, col_end):
+        if matrix[row_j, col_i]:
+          for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+            out[col_indices[j], col_i] = out[col_indices[j], col_i] + value
+
+
+@ti.kernel
+def _event_csr_matmat_transpose_bool_homo_gpu(values: ti.types.ndarray(ndim=1),
+                                              col_indices: ti.types.ndarray(ndim=1),
+                                              row_ptr: ti.types.ndarray(ndim=1),
+                                              matrix: ti.types.ndarray(ndim=2),
+                                              out: ti.types.ndarray(ndim=2)):
+  value = values[0]
+  for row_j, col_i in ti.ndrange(matrix.shape[0], matrix.shape[1]):
+    if matrix[row_j, col_i]:
+      for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+        out[col_indices[j], col_i] += value
+
+
+# When the output has fewer column tiles than threads, the rows of the events are
+# also split into blocks. Each (block, tile) task zeroes and scatters into its own
+# part of "partial", whose blocks are then summed into "out" in parallel.
+
+@ti.kernel
+def _event_csr_matmat_transpose_homo_partial_cpu(values: ti.types.ndarray(ndim=1),
+                                                 col_indices: ti.types.ndarray(ndim=1),
+                                                 row_ptr: ti.types.ndarray(ndim=1),
+                                                 matrix: ti.types.ndarray(ndim=2),
+                                                 out: ti.types.ndarray(ndim=2),
+                                                 partial: ti.types.ndarray(ndim=3)):
+  value = values[0]
+  num_row = matrix.shape[0]
+  num_col = out.shape[1]
+  num_block = partial.shape[0]
+  block_size = (num_row + num_block - 1) // num_block
+  for block_i, tile_i in ti.ndrange(num_block, (num_col + _transpose_col_tile - 1) // _transpose_col_tile):
+    col_end = ti.min((tile_i + 1) * _transpose_col_tile, num_col)
+    for i in range(out.shape[0]):
+      for col_i in range(tile_i * _transpose_col_tile, col_end):
+        partial[block_i, i, col_i] = 0.
+    for row_j in range(block_i * block_size, ti.min((block_i + 1) * block_size, num_row)):
+      for col_i in range(tile_i * _transpose_col_tile, col_end):
+        if matrix[row_j, col_i] != 0.:
+          for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+            partial[block_i, col_indices[j], col_i] = (partial[block_i, col_indices[j], col_i] +
+                                                       value * matrix[row_j, col_i])
+  for i, k in ti.ndrange(out.shape[0], out.shape[1]):
+    r = 0.
+    for block_i in range(num_block):
+      r += partial[block_i, i, k]
+    out[i, k] = r
 
 
 @ti.kernel
@@ -149,36 +357,6 @@ def _event_csr_matmat_bool_heter(values: ti.types.ndarray(ndim=1),
     out[row_i, col_k] = r
 
 
-@ti.kernel
-def _event_csr_matmat_transpose_homo(values: ti.types.ndarray(ndim=1),
-                                     col_indices: ti.types.ndarray(ndim=1),
-                                     row_ptr: ti.types.ndarray(ndim=1),
-                                     matrix: ti.types.ndarray(ndim=2),
-                                     out: ti.types.ndarray(ndim=2)):
-  value = values[0]
-  for col_i, row_k in ti.ndrange(out.shape[1], out.shape[0]):
-    for row_j in range(matrix.shape[0]):
-      if matrix[row_j, col_i] != 0.:
-        for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
-          if col_indices[j] == row_k:
-            out[row_k, col_i] += value * matrix[row_j, col_i]
-
-
-@ti.kernel
-def _event_csr_matmat_transpose_bool_homo(values: ti.types.ndarray(ndim=1),
-                                          col_indices: ti.types.ndarray(ndim=1),
-                                          row_ptr: ti.types.ndarray(ndim=1),
-                                          matrix: ti.types.ndarray(ndim=2),
-                                          out: ti.types.ndarray(ndim=2)):
-  value = values[0]
-  for col_i, row_k in ti.ndrange(out.shape[1], out.shape[0]):
-    for row_j in range(matrix.shape[0]):
-      if matrix[row_j, col_i]:
-        for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
-          if col_indices[j] == row_k:
-            out[row_k, col_i] += value * matrix[row_j, col_i]
-
-
 @ti.kernel
 def _event_csr_matmat_homo(values: ti.types.ndarray(ndim=1),
                            col_indices: ti.types.ndarray(ndim=1),
@@ -209,6 +387,188 @@ def _event_csr_matmat_bool_homo(values: ti.types.ndarray(ndim=1),
     out[row_i, col_k] = r * value
 
 
+# The packed kernels visit the set bits of the words of each column of events with
+# count-trailing-zeros, and skip the all-zero words. The transposed ones are tiled,
+# and blocked over the words, as the boolean ones.
+
+@ti.kernel
+def _event_csr_matmat_transpose_packed_homo_cpu(values: ti.types.ndarray(ndim=1),
+                                                col_indices: ti.types.ndarray(ndim=1),
+                                                row_ptr: ti.types.ndarray(ndim=1),
+                                                matrix: ti.types.ndarray(ndim=2),
+                                                out: ti.types.ndarray(ndim=2)):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  value = values[0]
+  num_row = row_ptr.shape[0] - 1
+  num_col = out.shape[1]
+  for tile_i in range((num_col + _transpose_col_tile - 1) // _transpose_col_tile):
+    col_end = ti.min((tile_i + 1) * _transpose_col_tile, num_col)
+    for word_j in range(matrix.shape[0]):
+      for col_i in range(tile_i * _transpose_col_tile, col_end):
+        word = matrix[word_j, col_i]
+        while word != 0:
+          row_j = word_j * 32 + _ctz(word)
+          word &= word - 1
+          if row_j < num_row:
+            for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+              out[col_indices[j], col_i] = out[col_indices[j], col_i] + value
+
+
+@ti.kernel
+def _event_csr_matmat_transpose_packed_homo_gpu(values: ti.types.ndarray(ndim=1),
+                                                col_indices: ti.types.ndarray(ndim=1),
+                                                row_ptr: ti.types.ndarray(ndim=1),
+                                                matrix: ti.types.ndarray(ndim=2),
+                                                out: ti.types.ndarray(ndim=2)):
+  value = values[0]
+  num_row = row_ptr.shape[0] - 1
+  for word_j, col_i in ti.ndrange(matrix.shape[0], matrix.shape[1]):
+    word = matrix[word_j, col_i]
+    while word != 0:
+      row_j = word_j * 32 + _ctz(word)
+      word &= word - 1
+      if row_j < num_row:
+        for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+          out[col_indices[j], col_i] += value
+
+
+@ti.kernel
+def _event_csr_matmat_transpose_packed_heter_cpu(values: ti.types.ndarray(ndim=1),
+                                                 col_indices: ti.types.ndarray(ndim=1),
+                                                 row_ptr: ti.types.ndarray(ndim=1),
+                                                 matrix: ti.types.ndarray(ndim=2),
+                                                 out: ti.types.ndarray(ndim=2)):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = row_ptr.shape[0] - 1
+  num_col = out.shape[1]
+  for tile_i in range((num_col + _transpose_col_tile - 1) // _transpose_col_tile):
+    col_end = ti.min((tile_i + 1) * _transpose_col_tile, num_col)
+    for word_j in range(matrix.shape[0]):
+      for col_i in range(tile_i * _transpose_col_tile, col_end):
+        word = matrix[word_j, col_i]
+        while word != 0:
+          row_j = word_j * 32 + _ctz(word)
+          word &= word - 1
+          if row_j < num_row:
+            for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+              out[col_indices[j], col_i] = out[col_indices[j], col_i] + values[j]
+
+
+@ti.kernel
+def _event_csr_matmat_transpose_packed_heter_gpu(values: ti.types.ndarray(ndim=1),
+                                                 col_indices: ti.types.ndarray(ndim=1),
+                                                 row_ptr: ti.types.ndarray(ndim=1),
+                                                 matrix: ti.types.ndarray(ndim=2),
+                                                 out: ti.types.ndarray(ndim=2)):
+  num_row = row_ptr.shape[0] - 1
+  for word_j, col_i in ti.ndrange(matrix.shape[0], matrix.shape[1]):
+    word = matrix[word_j, col_i]
+    while word != 0:
+      row_j = word_j * 32 + _ctz(word)
+      word &= word - 1
+      if row_j < num_row:
+        for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+          out[col_indices[j], col_i] += values[j]
+
+
+@ti.kernel
+def _event_csr_matmat_transpose_packed_homo_partial_cpu(values: ti.types.ndarray(ndim=1),
+                                                         col_indices: ti.types.ndarray(ndim=1),
+                                                         row_ptr: ti.types.ndarray(ndim=1),
+                                                         matrix: ti.types.ndarray(ndim=2),
+                                                         out: ti.types.ndarray(ndim=2),
+                                                         partial: ti.types.ndarray(ndim=3)):
+  value = values[0]
+  num_row = row_ptr.shape[0] - 1
+  num_word = matrix.shape[0]
+  num_col = out.shape[1]
+  num_block = partial.shape[0]
+  block_size = (num_word + num_block - 1) // num_block
+  for block_i, tile_i in ti.ndrange(num_block, (num_col + _transpose_col_tile - 1) // _transpose_col_tile):
+    col_end = ti.min((tile_i + 1) * _transpose_col_tile, num_col)
+    for i in range(out.shape[0]):
+      for col_i in range(tile_i * _transpose_col_tile, col_end):
+        partial[block_i, i, col_i] = 0.
+    for word_j in range(block_i * block_size, ti.min((block_i + 1) * block_size, num_word)):
+      for col_i in range(tile_i * _transpose_col_tile, col_end):
+        word = matrix[word_j, col_i]
+        while word != 0:
+          row_j = word_j * 32 + _ctz(word)
+          word &= word - 1
+          if row_j < num_row:
+            for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+              partial[block_i, col_indices[j], col_i] = partial[block_i, col_indices[j], col_i] + value
+  for i, k in ti.ndrange(out.shape[0], out.shape[1]):
+    r = 0.
+    for block_i in range(num_block):
+      r += partial[block_i, i, k]
+    out[i, k] = r
+
+
+@ti.kernel
+def _event_csr_matmat_transpose_packed_heter_partial_cpu(values: ti.types.ndarray(ndim=1),
+                                                          col_indices: ti.types.ndarray(ndim=1),
+                                                          row_ptr: ti.types.ndarray(ndim=1),
+                                                          matrix: ti.types.ndarray(ndim=2),
+                                                          out: ti.types.ndarray(ndim=2),
+                                                          partial: ti.types.ndarray(ndim=3)):
+  num_row = row_ptr.shape[0] - 1
+  num_word = matrix.shape[0]
+  num_col = out.shape[1]
+  num_block = partial.shape[0]
+  block_size = (num_word + num_block - 1) // num_block
+  for block_i, tile_i in ti.ndrange(num_block, (num_col + _transpose_col_tile - 1) // _transpose_col_tile):
+    col_end = ti.min((tile_i + 1) * _transpose_col_tile, num_col)
+    for i in range(out.shape[0]):
+      for col_i in range(tile_i * _transpose_col_tile, col_end):
+        partial[block_i, i, col_i] = 0.
+    for word_j in range(block_i * block_size, ti.min((block_i + 1) * block_size, num_word)):
+      for col_i in range(tile_i * _transpose_col_tile, col_end):
+        word = matrix[word_j, col_i]
+        while word != 0:
+          row_j = word_j * 32 + _ctz(word)
+          word &= word - 1
+          if row_j < num_row:
+            for j in range(row_ptr[row_j], row_ptr[row_j + 1]):
+              partial[block_i, col_indices[j], col_i] = partial[block_i, col_indices[j], col_i] + values[j]
+  for i, k in ti.ndrange(out.shape[0], out.shape[1]):
+    r = 0.
+    for block_i in range(num_block):
+      r += partial[block_i, i, k]
+    out[i, k] = r
+
+
+@ti.kernel
+def _event_csr_matmat_packed_homo(values: ti.types.ndarray(ndim=1),
+                                  col_indices: ti.types.ndarray(ndim=1),
+                                  row_ptr: ti.types.ndarray(ndim=1),
+                                  matrix: ti.types.ndarray(ndim=2),
+                                  out: ti.types.ndarray(ndim=2)):
+  value = values[0]
+  for row_i, col_k in ti.ndrange(out.shape[0], out.shape[1]):
+    r = 0.
+    for row_j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      if _bit(matrix[col_indices[row_j] >> 5, col_k], col_indices[row_j]):
+        r += value
+    out[row_i, col_k] = r
+
+
+@ti.kernel
+def _event_csr_matmat_packed_heter(values: ti.types.ndarray(ndim=1),
+                                   col_indices: ti.types.ndarray(ndim=1),
+                                   row_ptr: ti.types.ndarray(ndim=1),
+                                   matrix: ti.types.ndarray(ndim=2),
+                                   out: ti.types.ndarray(ndim=2)):
+  for row_i, col_k in ti.ndrange(out.shape[0], out.shape[1]):
+    r = 0.
+    for row_j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      if _bit(matrix[col_indices[row_j] >> 5, col_k], col_indices[row_j]):
+        r += values[row_j]
+    out[row_i, col_k] = r
+
+
 def _event_csr_matmat_jvp_values(val_dot, values, col_indices, row_ptr, matrix, *, outs, transpose, shape):
   return normal_csrmm(val_dot, col_indices, row_ptr, matrix, shape=shape, transpose=transpose)
 
@@ -241,45 +601,146 @@ def _event_csr_matmat_transpose(
     return ct_data, indices, indptr, matrix
 
 
-def _define_op(cpu_kernel, gpu_kernel):
-  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel)
+# Packed events are integer words, so only the values are differentiable.
+
+def _event_csr_matmat_packed_jvp_values(val_dot, values, col_indices, row_ptr, matrix, *, outs, transpose, shape):
+  return _raw_packed_csrmm_taichi(val_dot, col_indices, row_ptr, matrix, shape=shape, transpose=transpose)
+
+
+def _event_csr_matmat_packed_transpose(ct, data, indices, indptr, matrix, *, outs, transpose, shape):
+  if ad.is_undefined_primal(indices) or ad.is_undefined_primal(indptr):
+    raise ValueError("Cannot transpose with respect to sparse indices.")
+  assert not ad.is_undefined_primal(matrix), 'Cannot differentiate through packed events.'
+  if type(ct[0]) is ad.Zero:
+    ct_data = ad.Zero(data)
+  elif data.aval.shape[0] == 1:  # scalar
+    ct_data = _raw_packed_csrmm_taichi(jnp.ones(1, dtype=ct[0].dtype), indices, indptr, matrix,
+                                       shape=shape, transpose=transpose)[0]
+    ct_data = jnp.sum(ct[0] * ct_data)
+  else:  # heter
+    mask = raw_unpack_events(matrix, shape[0] if transpose else shape[1]).astype(ct[0].dtype)
+    row, col = csr_to_coo(indices, indptr)
+    ct_data = (ct[0][col] * mask[row]).sum(1) if transpose else (ct[0][row] * mask[col]).sum(1)
+  return ct_data, indices, indptr, matrix
+
+
+# The kernels without transposition assign every element of their output, which
+# therefore need not be zeroed. The CPU kernels with transposition zero it in a
+# parallel loop before they scatter into it, and the GPU ones scatter into a zeroed
+# output.
+_overwrite = ('overwrite',)
+_cpu_overwrite = {'cpu': ('overwrite',), 'gpu': ('zero',)}
+
+
+def _define_packed_op(cpu_kernel, gpu_kernel, output_init=_cpu_overwrite):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=output_init)
+  prim.defjvp(_event_csr_matmat_packed_jvp_values, None, None, None)
+  prim.def_transpose_rule(_event_csr_matmat_packed_transpose)
+  return prim
+
+
+def _define_op(cpu_kernel, gpu_kernel, output_init=_cpu_overwrite):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=output_init)
   prim.defjvp(_event_csr_matmat_jvp_values, None, None, _event_csr_matmat_jvp_matrix)
   prim.def_transpose_rule(_event_csr_matmat_transpose)
   return prim
 
 
+def _with_zero_scratch(jvp_rule):
+  if jvp_rule is None:
+    return None
+
+  def rule(*args, outs, **kwargs):
+    return list(jvp_rule(*args, outs=outs[:1], **kwargs)) + [ad.Zero(jax.core.ShapedArray(o.shape, o.dtype))
+                                                             for o in outs[1:]]
+
+  return rule
+
+
+def _with_scratch_cotangent(transpose_rule):
+  def rule(ct, *args, outs, **kwargs):
+    return transpose_rule(ct[:1], *args, outs=outs[:1], **kwargs)
+
+  return rule
+
+
+def _define_partial_op(cpu_kernel, op, jvp_rules, transpose_rule):
+  # on GPU, "op" computes the output without the scratch output
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, output_init=('overwrite', 'overwrite'))
+  prim.def_mlir_lowering('gpu', _scratch_free_lowering(op))
+  prim.defjvp(*[_with_zero_scratch(r) for r in jvp_rules])
+  prim.def_transpose_rule(_with_scratch_cotangent(transpose_rule))
+  return prim
+
+
 # transpose heter
-_event_csr_matmat_transpose_heter_p = _define_op(cpu_kernel=_event_csr_matmat_transpose_heter,
-                                                 gpu_kernel=_event_csr_matmat_transpose_heter)
+_event_csr_matmat_transpose_heter_p = _define_op(cpu_kernel=_event_csr_matmat_transpose_heter_cpu,
+                                                 gpu_kernel=_event_csr_matmat_transpose_heter_gpu)
 
 # no transpose heter
 _event_csr_matmat_heter_p = _define_op(cpu_kernel=_event_csr_matmat_heter,
-                                       gpu_kernel=_event_csr_matmat_heter)
+                                       gpu_kernel=_event_csr_matmat_heter,
+                                       output_init=_overwrite)
 
 # transpose homo
-_event_csr_matmat_transpose_homo_p = _define_op(cpu_kernel=_event_csr_matmat_transpose_homo,
-                                                gpu_kernel=_event_csr_matmat_transpose_homo)
+_event_csr_matmat_transpose_homo_p = _define_op(cpu_kernel=_event_csr_matmat_transpose_homo_cpu,
+                                                gpu_kernel=_event_csr_matmat_transpose_homo_gpu)
 
 # no transpose homo
 _event_csr_matmat_homo_p = _define_op(cpu_kernel=_event_csr_matmat_homo,
-                                      gpu_kernel=_event_csr_matmat_homo)
+                                      gpu_kernel=_event_csr_matmat_homo,
+                                      output_init=_overwrite)
 
 # bool transpose heter
-_event_csr_matmat_transpose_bool_heter_p = _define_op(cpu_kernel=_event_csr_matmat_transpose_bool_heter,
-                                                      gpu_kernel=_event_csr_matmat_transpose_bool_heter)
+_event_csr_matmat_transpose_bool_heter_p = _define_op(cpu_kernel=_event_csr_matmat_transpose_bool_heter_cpu,
+                                                      gpu_kernel=_event_csr_matmat_transpose_bool_heter_gpu)
 
 # bool no transpose heter
 _event_csr_matmat_bool_heter_p = _define_op(cpu_kernel=_event_csr_matmat_bool_heter,
-                                            gpu_kernel=_event_csr_matmat_bool_heter)
+                                            gpu_kernel=_event_csr_matmat_bool_heter,
+                                            output_init=_overwrite)
 
 # bool transpose homo
-_event_csr_matmat_transpose_bool_homo_p = _define_op(cpu_kernel=_event_csr_matmat_transpose_bool_homo,
-                                                     gpu_kernel=_event_csr_matmat_transpose_bool_homo)
+_event_csr_matmat_transpose_bool_homo_p = _define_op(cpu_kernel=_event_csr_matmat_transpose_bool_homo_cpu,
+                                                     gpu_kernel=_event_csr_matmat_transpose_bool_homo_gpu)
 
 # bool no transpose homo
 _event_csr_matmat_bool_homo_p = _define_op(cpu_kernel=_event_csr_matmat_bool_homo,
-                                           gpu_kernel=_event_csr_matmat_bool_homo)
-
-# heter CUSPARSE
-_csr_matmat_cusparse_p = csr.csr_matmat_p
-register_general_batching(_csr_matmat_cusparse_p)
+                                           gpu_kernel=_event_csr_matmat_bool_homo,
+                                           output_init=_overwrite)
+
+# packed transpose homo
+_event_csr_matmat_transpose_packed_homo_p = _define_packed_op(cpu_kernel=_event_csr_matmat_transpose_packed_homo_cpu,
+                                                              gpu_kernel=_event_csr_matmat_transpose_packed_homo_gpu)
+
+# packed transpose heter
+_event_csr_matmat_transpose_packed_heter_p = _define_packed_op(cpu_kernel=_event_csr_matmat_transpose_packed_heter_cpu,
+                                                               gpu_kernel=_event_csr_matmat_transpose_packed_heter_gpu)
+
+# packed no transpose homo
+_event_csr_matmat_packed_homo_p = _define_packed_op(cpu_kernel=_event_csr_matmat_packed_homo,
+                                                    gpu_kernel=_event_csr_matmat_packed_homo,
+                                                    output_init=_overwrite)
+
+# packed no transpose heter
+_event_csr_matmat_packed_heter_p = _define_packed_op(cpu_kernel=_event_csr_matmat_packed_heter,
+                                                     gpu_kernel=_event_csr_matmat_packed_heter,
+                                                     output_init=_overwrite)
+
+# transpose homo, blocked over the rows of the events on CPU
+_event_csr_matmat_transpose_homo_partial_p = _define_partial_op(
+  _event_csr_matmat_transpose_homo_partial_cpu, _event_csr_matmat_transpose_homo_p,
+  (_event_csr_matmat_jvp_values, None, None, _event_csr_matmat_jvp_matrix), _event_csr_matmat_transpose
+)
+
+# packed transpose homo, blocked over the words of the events on CPU
+_event_csr_matmat_transpose_packed_homo_partial_p = _define_partial_op(
+  _event_csr_matmat_transpose_packed_homo_partial_cpu, _event_csr_matmat_transpose_packed_homo_p,
+  (_event_csr_matmat_packed_jvp_values, None, None, None), _event_csr_matmat_packed_transpose
+)
+
+# packed transpose heter, blocked over the words of the events on CPU
+_event_csr_matmat_transpose_packed_heter_partial_p = _define_partial_op(
+  _event_csr_matmat_transpose_packed_heter_partial_cpu, _event_csr_matmat_transpose_packed_heter_p,
+  (_event_csr_matmat_packed_jvp_values, None, None, None), _event_csr_matmat_packed_transpose
+)
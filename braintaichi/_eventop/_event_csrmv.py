@@ -21,10 +21,12 @@ Key points for the operator customization:
 
 1. `index` has two kinds of types: int32, int64
 2. `data` has two kinds of types: float32, float64
-3. `events` has three kinds of types: bool (True or False), float32, float64
+3. `events` has three kinds of types: bool (True or False), float32, float64,
+   or they are bit-packed into uint32 or uint64 words, see "_event_packed.py"
 
 """
 
+import os
 from typing import Union, Tuple
 
 import jax
@@ -32,9 +34,45 @@ import jax.numpy as jnp
 import taichi as ti
 from jax.interpreters import ad
 
+from braintaichi._primitive._batch_utils import register_vector_batching
 from braintaichi._primitive._xla_custom_op import XLACustomOp
+from braintaichi._sparseop._sparse_compressed import (CompressedIndices, compressed_to_coo, decompress_indices,
+                                                      compressed_col)
 from braintaichi._sparseop._sparse_csrmv import raw_csrmv_taichi as normal_csrmv_taichi
-from braintaichi._sparseop._sparse_utils import csr_to_coo
+from braintaichi._sparseop import _sparse_utils
+from braintaichi._sparseop._sparse_plan import CSRPlan, plan_values, plan_input, plan_output
+from braintaichi._sparseop._sparse_utils import (csr_to_coo, _cpu_transpose_strategy, _transpose_prim,
+                                                 _scratch_free_lowering, is_half, bf16_to_f32)
+from ._event_csrmm import raw_event_csrmm_taichi
+from ._event_packed import is_packed, num_words, as_words32, raw_unpack_events, _ctz, _bit
+
+# Whether the transposed products on CPU first compact the events into the list of
+# active rows and then only visit those ("on"), or scan all the rows ("off"). "auto"
+# compacts when there are enough rows for it to pay off, and the transposed products
+# would run in parallel, that is, unless "cpu_transpose_strategy" is forced or
+# chooses "serial". Either way, the kernels fall back to scanning all the rows when
+# too many of them are active, see "_active_set_max_ratio".
+event_active_set = os.environ.get('BRAINTAICHI_EVENT_ACTIVE_SET', 'auto')
+
+# below this number of rows, the compaction costs more than it saves
+_active_set_min_rows = 1 << 12
+
+# the number of rows compacted by each thread
+_compact_block_size = 1 << 10
+
+# the active-set kernels scan all the rows when more than one in this many is active
+_active_set_max_ratio = 4
+
+
+def _use_active_set(num_row: int, num_col: int, nnz: int) -> bool:
+  mode = event_active_set
+  if mode == 'auto':
+    return (num_row >= _active_set_min_rows and
+            _sparse_utils.cpu_transpose_strategy == 'auto' and
+            _cpu_transpose_strategy(num_col, nnz)[0] != 'serial')
+  elif mode not in ('on', 'off'):
+    raise ValueError(f'Unknown event active-set mode: {mode}. Should be "auto", "on" or "off".')
+  return mode == 'on'
 
 
 def raw_csrmv_taichi(
@@ -46,157 +84,312 @@ def raw_csrmv_taichi(
     shape: Tuple[int, int],
     transpose: bool = False
 ):
-  if transpose:
-    if events.dtype == jnp.bool_:
-      if data.shape[0] == 1:
-        prim = _event_csrmv_transpose_bool_homo_p
-      else:
-        prim = _event_csrmv_transpose_bool_heter_p
-    else:
-      return normal_csrmv_taichi(data, indices, indptr, events, shape=shape, transpose=transpose)
+  if isinstance(indices, CSRPlan):
+    return _raw_planned_csrmv_taichi(data, indices, events, shape=shape, transpose=transpose)
+  if isinstance(indices, CompressedIndices):
+    return _raw_compressed_csrmv_taichi(data, indices, indptr, events, shape=shape, transpose=transpose)
+  if is_half(data.dtype):
+    return _raw_half_csrmv_taichi(data, indices, indptr, events, shape=shape, transpose=transpose)
+  if is_packed(events):
+    return _raw_packed_csrmv_taichi(data, indices, indptr, as_words32(events), shape=shape, transpose=transpose)
+
+  bool_event = events.dtype == jnp.bool_
+  outs = [jax.ShapeDtypeStruct(shape=(shape[1] if transpose else shape[0],), dtype=data.dtype)]
+  if transpose and _use_active_set(shape[0], shape[1], indices.shape[0]):
+    prim = _event_csrmv_transpose_active_p
+    num_block = (shape[0] + _compact_block_size - 1) // _compact_block_size
+    outs.append(jax.ShapeDtypeStruct(shape=(shape[0],), dtype=jnp.int32))
+    outs.append(jax.ShapeDtypeStruct(shape=(num_block + 1,), dtype=jnp.int32))
+  elif not bool_event:
+    return normal_csrmv_taichi(data, indices, indptr, events, shape=shape, transpose=transpose)
+  elif transpose:
+    prim = _transpose_prim(_event_csrmv_p, _event_csrmv_transpose_atomic_p, _event_csrmv_transpose_partial_p,
+                           outs, indices.shape[0])
   else:
-    if events.dtype == jnp.bool_:
-      if data.shape[0] == 1:
-        prim = _event_csrmv_bool_homo_p
-      else:
-        prim = _event_csrmv_bool_heter_p
-    else:
-      return normal_csrmv_taichi(data, indices, indptr, events, shape=shape, transpose=transpose)
+    prim = _event_csrmv_p
 
   # computing
   return prim(data,
               indices,
               indptr,
               events,
-              outs=[jax.ShapeDtypeStruct(shape=(shape[1] if transpose else shape[0],), dtype=data.dtype)],
+              outs=outs,
+              transpose=transpose,
+              shape=shape,
+              homo=data.shape[0] == 1,
+              bool_event=bool_event)[:1]
+
+
+# 16-bit values are read in 16 bits and accumulated in float32 by the boolean heter
+# kernels, and the product is rounded to their dtype. The float events are computed
+# by "normal_csrmv_taichi", which does the same, and the others in float32.
+
+def _raw_half_csrmv_taichi(data, indices, indptr, events, *, shape, transpose):
+  if events.dtype != jnp.bool_ and not is_packed(events):
+    return normal_csrmv_taichi(data, indices, indptr, events, shape=shape, transpose=transpose)
+  if data.shape[0] == 1 or is_packed(events):
+    r = raw_csrmv_taichi(data.astype(jnp.float32), indices, indptr, events, shape=shape, transpose=transpose)[0]
+  else:
+    r = _half_event_csrmv_f32(data, indices, indptr, events, shape=shape, transpose=transpose)[0]
+  return [r.astype(data.dtype)]
+
+
+def _half_event_csrmv_f32(data, indices, indptr, events, *, shape, transpose):
+  bf16 = data.dtype == jnp.bfloat16
+  outs = [jax.ShapeDtypeStruct(shape=(shape[1] if transpose else shape[0],), dtype=jnp.float32)]
+  if transpose and bf16:
+    prim = _transpose_prim(_event_csrmv_transpose_bf16_p, _event_csrmv_transpose_bf16_atomic_p,
+                           _event_csrmv_transpose_bf16_partial_p, outs, indices.shape[0])
+  elif transpose:
+    prim = _transpose_prim(_event_csrmv_half_p, _event_csrmv_transpose_half_atomic_p,
+                           _event_csrmv_transpose_half_partial_p, outs, indices.shape[0])
+  else:
+    prim = _event_csrmv_bf16_p if bf16 else _event_csrmv_half_p
+  return prim(data,
+              indices,
+              indptr,
+              events,
+              outs=outs,
+              transpose=transpose,
+              shape=shape,
+              homo=False,
+              bool_event=True)[:1]
+
+
+def _raw_packed_csrmv_taichi(data, indices, indptr, events, *, shape, transpose):
+  num_event = shape[0] if transpose else shape[1]
+  if events.shape[0] != num_words(num_event, events.dtype):
+    raise ValueError(f'Shape mismatch, {num_event} packed events need {num_words(num_event, events.dtype)} '
+                     f'words, but got {events.shape[0]}.')
+  outs = [jax.ShapeDtypeStruct(shape=(shape[1] if transpose else shape[0],), dtype=data.dtype)]
+  prim = _event_csrmv_packed_p
+  if transpose:
+    prim = _transpose_prim(_event_csrmv_packed_p, _event_csrmv_transpose_packed_atomic_p,
+                           _event_csrmv_transpose_packed_partial_p, outs, indices.shape[0])
+  return prim(data,
+              indices,
+              indptr,
+              events,
+              outs=outs,
               transpose=transpose,
-              shape=shape)
+              shape=shape,
+              homo=data.shape[0] == 1)[:1]
+
+
+# The compressed indices are decoded by their own kernels with boolean events. Packed
+# events are unpacked, float events are computed by "normal_csrmv_taichi", and 16-bit
+# values in float32.
+
+def _raw_compressed_csrmv_taichi(data, indices, indptr, events, *, shape, transpose):
+  if is_packed(events):
+    events = raw_unpack_events(events, shape[0] if transpose else shape[1])
+  if events.dtype != jnp.bool_:
+    return normal_csrmv_taichi(data, indices, indptr, events, shape=shape, transpose=transpose)
+  if is_half(data.dtype):
+    r = _raw_compressed_csrmv_taichi(data.astype(jnp.float32), indices, indptr, events,
+                                     shape=shape, transpose=transpose)[0]
+    return [r.astype(data.dtype)]
+  outs = [jax.ShapeDtypeStruct(shape=(shape[1] if transpose else shape[0],), dtype=data.dtype)]
+  prim = _event_csrmv_compressed_p
+  if transpose:
+    prim = _transpose_prim(_event_csrmv_compressed_p, _event_csrmv_transpose_compressed_atomic_p,
+                           _event_csrmv_transpose_compressed_partial_p, outs, indices.shape[0])
+  return prim(data,
+              indices.offsets,
+              indices.bases,
+              indices.block_ptr,
+              indices.block_shift,
+              indptr,
+              events,
+              outs=outs,
+              transpose=transpose,
+              shape=shape,
+              homo=data.shape[0] == 1)[:1]
+
+
+# With a plan, the transposed products scatter the active rows of the reordered
+# matrix, whose heterogeneous values are gathered into its order at every call. The
+# other products gather over its rows with boolean events, whose parallel tasks are
+# its balanced splits. Float events are computed by "normal_csrmv_taichi".
+
+def _raw_planned_csrmv_taichi(data, plan, events, *, shape, transpose):
+  if events.dtype != jnp.bool_ and not is_packed(events):
+    return normal_csrmv_taichi(data, plan, None, events, shape=shape, transpose=transpose)
+  if transpose:
+    if is_packed(events) and plan.row_perm is not None:
+      events = raw_unpack_events(events, shape[0])
+    r = raw_csrmv_taichi(plan_values(data, plan), plan.indices, plan.indptr, plan_input(plan, events, True),
+                         shape=shape, transpose=True)[0]
+    return [plan_output(plan, r, True)]
+  if is_packed(events):
+    events = raw_unpack_events(events, shape[1])
+  if is_half(data.dtype):
+    r = _raw_planned_csrmv_taichi(data.astype(jnp.float32), plan, events, shape=shape, transpose=False)[0]
+    return [r.astype(data.dtype)]
+  r = _planned_event_csrmv(data, plan.value_idx, plan.indices, plan.indptr, plan.splits,
+                           plan_input(plan, events, False))[0]
+  return [plan_output(plan, r, False)]
+
+
+def _planned_event_csrmv(data, value_idx, indices, indptr, splits, events):
+  outs = [jax.ShapeDtypeStruct((indptr.shape[0] - 1,), dtype=data.dtype)]
+  if data.shape[0] == 1:
+    return _event_csrmv_planned_homo_p(data, indices, indptr, splits, events, outs=outs)
+  elif value_idx is None:
+    return _event_csrmv_planned_heter_p(data, indices, indptr, splits, events, outs=outs)
+  else:
+    return _event_csrmv_planned_indirect_p(data, value_idx, indices, indptr, splits, events, outs=outs)
 
 
 # -------------
 # CPU operators
 # -------------
 
-# 1. The benchmarking shows that the performance of the following transpose
-#    kernels is maximized when using serialized mode
-# 2. Since our Taichi-JAX kernel does not support the non-differentiable/non-jittable
-#    arguments, we have to define each kernel separately when the
-#    non-differentiable/non-jittable arguments are different.
+# 1. The serialized transpose kernels are the fastest for small matrices. Larger
+#    ones use the "atomic" or "partial" parallel kernels, see
+#    "braintaichi._sparseop._sparse_utils.cpu_transpose_strategy". With many rows,
+#    the "active" kernels are used instead, see "event_active_set".
+# 2. The kernels take the static flags "transpose", "homo", whether the matrix has
+#    one value for all its non-zeros, and "bool_event", whether the events are
+#    boolean, so that one kernel source covers all these variants.
 
-@ti.kernel
-def _event_csr_matvec_transpose_bool_homo_cpu(values: ti.types.ndarray(ndim=1),
-                                              indices: ti.types.ndarray(ndim=1),
-                                              indptr: ti.types.ndarray(ndim=1),
-                                              events: ti.types.ndarray(ndim=1),
-                                              out: ti.types.ndarray(ndim=1)):
-  value = values[0]
-  ti.loop_config(serialize=True)
-  for row_i in range(indptr.shape[0] - 1):
-    if events[row_i]:
-      for j in range(indptr[row_i], indptr[row_i + 1]):
-        out[indices[j]] += value
+@ti.func
+def _csr_value(values, j, homo: ti.template()):
+  # the value of the non-zero "j"
+  v = values[0]
+  if ti.static(not homo):
+    v = values[j]
+  return v
 
 
-@ti.kernel
-def _event_csr_matvec_transpose_bool_heter_cpu(values: ti.types.ndarray(ndim=1),
-                                               indices: ti.types.ndarray(ndim=1),
-                                               indptr: ti.types.ndarray(ndim=1),
-                                               events: ti.types.ndarray(ndim=1),
-                                               out: ti.types.ndarray(ndim=1)):
-  ti.loop_config(serialize=True)
-  for row_i in range(indptr.shape[0] - 1):
-    if events[row_i]:
-      for j in range(indptr[row_i], indptr[row_i + 1]):
-        out[indices[j]] += values[j]
+@ti.func
+def _event_value(values, j, event, homo: ti.template(), bool_event: ti.template()):
+  # the boolean events select the value of the non-zero "j", and the float ones scale it
+  v = _csr_value(values, j, homo)
+  if ti.static(not bool_event):
+    v *= event
+  return v
 
 
 @ti.kernel
-def _event_csr_matvec_transpose_homo_cpu(values: ti.types.ndarray(ndim=1),
-                                         indices: ti.types.ndarray(ndim=1),
-                                         indptr: ti.types.ndarray(ndim=1),
-                                         events: ti.types.ndarray(ndim=1),
-                                         out: ti.types.ndarray(ndim=1)):
-  value = values[0]
-  ti.loop_config(serialize=True)
-  for row_i in range(indptr.shape[0] - 1):
-    if events[row_i] != 0.:
+def _event_csr_matvec_cpu(values: ti.types.ndarray(ndim=1),
+                          indices: ti.types.ndarray(ndim=1),
+                          indptr: ti.types.ndarray(ndim=1),
+                          events: ti.types.ndarray(ndim=1),
+                          out: ti.types.ndarray(ndim=1),
+                          transpose: ti.template(),
+                          homo: ti.template(),
+                          bool_event: ti.template()):
+  if ti.static(transpose):
+    for col_i in range(out.shape[0]):
+      out[col_i] = 0.
+    ti.loop_config(serialize=True)
+    for row_i in range(indptr.shape[0] - 1):
+      if events[row_i] != 0:
+        for j in range(indptr[row_i], indptr[row_i + 1]):
+          out[indices[j]] += _event_value(values, j, events[row_i], homo, bool_event)
+  else:
+    for row_i in range(indptr.shape[0] - 1):
+      r = 0.
       for j in range(indptr[row_i], indptr[row_i + 1]):
-        out[indices[j]] += value
+        if events[indices[j]] != 0:
+          r += _event_value(values, j, events[indices[j]], homo, bool_event)
+      out[row_i] = r
 
 
 @ti.kernel
-def _event_csr_matvec_transpose_heter_cpu(values: ti.types.ndarray(ndim=1),
-                                          indices: ti.types.ndarray(ndim=1),
-                                          indptr: ti.types.ndarray(ndim=1),
-                                          events: ti.types.ndarray(ndim=1),
-                                          out: ti.types.ndarray(ndim=1)):
-  ti.loop_config(serialize=True)
+def _event_csr_matvec_transpose_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                           indices: ti.types.ndarray(ndim=1),
+                                           indptr: ti.types.ndarray(ndim=1),
+                                           events: ti.types.ndarray(ndim=1),
+                                           out: ti.types.ndarray(ndim=1),
+                                           homo: ti.template(),
+                                           bool_event: ti.template()):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
   for row_i in range(indptr.shape[0] - 1):
-    if events[row_i] != 0.:
+    if events[row_i] != 0:
       for j in range(indptr[row_i], indptr[row_i + 1]):
-        out[indices[j]] += values[j]
+        out[indices[j]] += _event_value(values, j, events[row_i], homo, bool_event)
 
 
-@ti.kernel
-def _event_csr_matvec_bool_homo_cpu(values: ti.types.ndarray(ndim=1),
-                                    indices: ti.types.ndarray(ndim=1),
-                                    indptr: ti.types.ndarray(ndim=1),
-                                    events: ti.types.ndarray(ndim=1),
-                                    out: ti.types.ndarray(ndim=1)):
-  value = values[0]
-  # ti.loop_config(serialize=True)
-  for row_i in range(indptr.shape[0] - 1):
-    r = 0.
-    for j in range(indptr[row_i], indptr[row_i + 1]):
-      if events[indices[j]]:
-        r += value
-    out[row_i] = r
-
+# Each block of rows zeroes its own row of "partial" and scatters into it. The
+# assignments are written out, rather than "+=", so that they are not compiled
+# into atomics.
 
 @ti.kernel
-def _event_csr_matvec_bool_heter_cpu(values: ti.types.ndarray(ndim=1),
-                                     indices: ti.types.ndarray(ndim=1),
-                                     indptr: ti.types.ndarray(ndim=1),
-                                     events: ti.types.ndarray(ndim=1),
-                                     out: ti.types.ndarray(ndim=1)):
-  # ti.loop_config(serialize=True)
-  for row_i in range(indptr.shape[0] - 1):
+def _event_csr_matvec_transpose_partial_cpu(values: ti.types.ndarray(ndim=1),
+                                            indices: ti.types.ndarray(ndim=1),
+                                            indptr: ti.types.ndarray(ndim=1),
+                                            events: ti.types.ndarray(ndim=1),
+                                            out: ti.types.ndarray(ndim=1),
+                                            partial: ti.types.ndarray(ndim=2),
+                                            homo: ti.template(),
+                                            bool_event: ti.template()):
+  num_row = indptr.shape[0] - 1
+  num_block = partial.shape[0]
+  block_size = (num_row + num_block - 1) // num_block
+  for block_i in range(num_block):
+    for col_i in range(partial.shape[1]):
+      partial[block_i, col_i] = 0.
+    for row_i in range(block_i * block_size, ti.min((block_i + 1) * block_size, num_row)):
+      if events[row_i] != 0:
+        for j in range(indptr[row_i], indptr[row_i + 1]):
+          partial[block_i, indices[j]] = (partial[block_i, indices[j]] +
+                                          _event_value(values, j, events[row_i], homo, bool_event))
+  for col_i in range(out.shape[0]):
     r = 0.
-    for j in range(indptr[row_i], indptr[row_i + 1]):
-      if events[indices[j]]:
-        r += values[j]
-    out[row_i] = r
+    for block_i in range(num_block):
+      r += partial[block_i, col_i]
+    out[col_i] = r
 
 
-@ti.kernel
-def _event_csr_matvec_homo_cpu(values: ti.types.ndarray(ndim=1),
-                               indices: ti.types.ndarray(ndim=1),
-                               indptr: ti.types.ndarray(ndim=1),
-                               events: ti.types.ndarray(ndim=1),
-                               out: ti.types.ndarray(ndim=1)):
-  value = values[0]
-  # ti.loop_config(serialize=True)
-  for row_i in range(indptr.shape[0] - 1):
-    r = 0.
-    for j in range(indptr[row_i], indptr[row_i + 1]):
-      if events[indices[j]] != 0.:
-        r += value
-    out[row_i] = r
-
+# The "active" kernels compact the rows with events into "active" before scattering
+# them, so that the parallel scatter only visits active rows and spreads them evenly
+# over the threads. Each block of rows first counts its events, with a branch-free
+# loop which vectorizes, the counts are scanned into "offsets", and each block then
+# writes its active rows from its offset. With too many active rows, all the rows
+# are scanned instead.
 
 @ti.kernel
-def _event_csr_matvec_heter_cpu(values: ti.types.ndarray(ndim=1),
-                                indices: ti.types.ndarray(ndim=1),
-                                indptr: ti.types.ndarray(ndim=1),
-                                events: ti.types.ndarray(ndim=1),
-                                out: ti.types.ndarray(ndim=1)):
-  # ti.loop_config(serialize=True)
-  for row_i in range(indptr.shape[0] - 1):
-    r = 0.
+def _event_csr_matvec_transpose_active_cpu(values: ti.types.ndarray(ndim=1),
+                                           indices: ti.types.ndarray(ndim=1),
+                                           indptr: ti.types.ndarray(ndim=1),
+                                           events: ti.types.ndarray(ndim=1),
+                                           out: ti.types.ndarray(ndim=1),
+                                           active: ti.types.ndarray(ndim=1),
+                                           offsets: ti.types.ndarray(ndim=1),
+                                           homo: ti.template(),
+                                           bool_event: ti.template()):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  num_row = indptr.shape[0] - 1
+  num_block = offsets.shape[0] - 1
+  for block_i in range(num_block):
+    count = 0
+    for row_i in range(block_i * _compact_block_size, ti.min((block_i + 1) * _compact_block_size, num_row)):
+      count += ti.cast(events[row_i] != 0, ti.i32)
+    offsets[block_i + 1] = count
+  offsets[0] = 0
+  ti.loop_config(serialize=True)
+  for block_i in range(num_block):
+    offsets[block_i + 1] += offsets[block_i]
+  for block_i in range(num_block):
+    k = offsets[block_i]
+    for row_i in range(block_i * _compact_block_size, ti.min((block_i + 1) * _compact_block_size, num_row)):
+      if events[row_i] != 0:
+        active[k] = row_i
+        k += 1
+  num_active = offsets[num_block]
+  dense = num_active * _active_set_max_ratio > num_row
+  for k in range(ti.select(dense, 0, num_active)):
+    row_i = active[k]
     for j in range(indptr[row_i], indptr[row_i + 1]):
-      if events[indices[j]] != 0.:
-        r += values[j]
-    out[row_i] = r
+      out[indices[j]] += _event_value(values, j, events[row_i], homo, bool_event)
+  for row_i in range(ti.select(dense, num_row, 0)):
+    if events[row_i] != 0:
+      for j in range(indptr[row_i], indptr[row_i + 1]):
+        out[indices[j]] += _event_value(values, j, events[row_i], homo, bool_event)
 
 
 # -------------
@@ -206,77 +399,262 @@ def _event_csr_matvec_heter_cpu(values: ti.types.ndarray(ndim=1),
 # 1. GPU kernels are different from the CPU ones, since the GPU kernels need
 #    to use warp-level parallelism to achieve the best performance.
 
+# TODO
+# It is important to note that the following warp-based kernels
+# should be improved, since the atomic_add for each thread is not
+# very efficient. Instead, the warp-level reduction primitive
+# should be used.
+# see ``warp_reduce_sum()`` function in tifunc.py.
+# However, currently Taichi does not support general warp-level primitives.
+
 @ti.kernel
-def _event_csr_matvec_transpose_bool_homo_gpu(values: ti.types.ndarray(ndim=1),
-                                              indices: ti.types.ndarray(ndim=1),
-                                              indptr: ti.types.ndarray(ndim=1),
-                                              events: ti.types.ndarray(ndim=1),
-                                              out: ti.types.ndarray(ndim=1)):
-  value = values[0]
+def _event_csr_matvec_gpu(values: ti.types.ndarray(ndim=1),
+                          indices: ti.types.ndarray(ndim=1),
+                          indptr: ti.types.ndarray(ndim=1),
+                          events: ti.types.ndarray(ndim=1),
+                          out: ti.types.ndarray(ndim=1),
+                          transpose: ti.template(),
+                          homo: ti.template(),
+                          bool_event: ti.template()):
   for i in range((indptr.shape[0] - 1) * 32):
     row_i = i >> 5
     index = i & 31
-    if events[row_i]:
+    if ti.static(transpose):
+      if events[row_i] != 0:
+        j = indptr[row_i] + index
+        end_index = indptr[row_i + 1]
+        while j < end_index:
+          out[indices[j]] += _event_value(values, j, events[row_i], homo, bool_event)
+          j += 32
+    else:
+      r = 0.
       j = indptr[row_i] + index
       end_index = indptr[row_i + 1]
       while j < end_index:
-        out[indices[j]] += value
+        if events[indices[j]] != 0:
+          r += _event_value(values, j, events[indices[j]], homo, bool_event)
         j += 32
+      out[row_i] += r  # TODO: warp-level primitive
 
 
+# ----------------------
+# Packed event operators
+# ----------------------
+
+# The transposed kernels skip the all-zero words of events and scatter the rows of
+# the set bits of the other ones. On CPU, the words are walked by one thread, or
+# processed in parallel with atomic adds or in blocks, see "cpu_transpose_strategy".
+# On GPU, every row is processed by one warp, as with boolean events. The kernels
+# take the flags "transpose" and "homo".
+
 @ti.kernel
-def _event_csr_matvec_transpose_homo_gpu(values: ti.types.ndarray(ndim=1),
-                                         indices: ti.types.ndarray(ndim=1),
-                                         indptr: ti.types.ndarray(ndim=1),
-                                         events: ti.types.ndarray(ndim=1),
-                                         out: ti.types.ndarray(ndim=1)):
-  value = values[0]
+def _event_csr_matvec_packed_cpu(values: ti.types.ndarray(ndim=1),
+                                 indices: ti.types.ndarray(ndim=1),
+                                 indptr: ti.types.ndarray(ndim=1),
+                                 events: ti.types.ndarray(ndim=1),
+                                 out: ti.types.ndarray(ndim=1),
+                                 transpose: ti.template(),
+                                 homo: ti.template()):
+  if ti.static(transpose):
+    for col_i in range(out.shape[0]):
+      out[col_i] = 0.
+    num_row = indptr.shape[0] - 1
+    ti.loop_config(serialize=True)
+    for word_i in range(events.shape[0]):
+      word = events[word_i]
+      while word != 0:
+        row_i = word_i * 32 + _ctz(word)
+        word &= word - 1
+        if row_i < num_row:
+          for j in range(indptr[row_i], indptr[row_i + 1]):
+            out[indices[j]] += _csr_value(values, j, homo)
+  else:
+    for row_i in range(indptr.shape[0] - 1):
+      r = 0.
+      for j in range(indptr[row_i], indptr[row_i + 1]):
+        if _bit(events[indices[j] >> 5], indices[j]):
+          r += _csr_value(values, j, homo)
+      out[row_i] = r
+
+
+@ti.kernel
+def _event_csr_matvec_transpose_packed_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                                  indices: ti.types.ndarray(ndim=1),
+                                                  indptr: ti.types.ndarray(ndim=1),
+                                                  events: ti.types.ndarray(ndim=1),
+                                                  out: ti.types.ndarray(ndim=1),
+                                                  homo: ti.template()):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  num_row = indptr.shape[0] - 1
+  for word_i in range(events.shape[0]):
+    word = events[word_i]
+    while word != 0:
+      row_i = word_i * 32 + _ctz(word)
+      word &= word - 1
+      if row_i < num_row:
+        for j in range(indptr[row_i], indptr[row_i + 1]):
+          out[indices[j]] += _csr_value(values, j, homo)
+
+
+# Each block of words zeroes its own row of "partial" and scatters the rows of their
+# set bits into it, as with boolean events.
+
+@ti.kernel
+def _event_csr_matvec_transpose_packed_partial_cpu(values: ti.types.ndarray(ndim=1),
+                                                   indices: ti.types.ndarray(ndim=1),
+                                                   indptr: ti.types.ndarray(ndim=1),
+                                                   events: ti.types.ndarray(ndim=1),
+                                                   out: ti.types.ndarray(ndim=1),
+                                                   partial: ti.types.ndarray(ndim=2),
+                                                   homo: ti.template()):
+  num_row = indptr.shape[0] - 1
+  num_word = events.shape[0]
+  num_block = partial.shape[0]
+  block_size = (num_word + num_block - 1) // num_block
+  for block_i in range(num_block):
+    for col_i in range(partial.shape[1]):
+      partial[block_i, col_i] = 0.
+    for word_i in range(block_i * block_size, ti.min((block_i + 1) * block_size, num_word)):
+      word = events[word_i]
+      while word != 0:
+        row_i = word_i * 32 + _ctz(word)
+        word &= word - 1
+        if row_i < num_row:
+          for j in range(indptr[row_i], indptr[row_i + 1]):
+            partial[block_i, indices[j]] = partial[block_i, indices[j]] + _csr_value(values, j, homo)
+  for col_i in range(out.shape[0]):
+    r = 0.
+    for block_i in range(num_block):
+      r += partial[block_i, col_i]
+    out[col_i] = r
+
+
+@ti.kernel
+def _event_csr_matvec_packed_gpu(values: ti.types.ndarray(ndim=1),
+                                 indices: ti.types.ndarray(ndim=1),
+                                 indptr: ti.types.ndarray(ndim=1),
+                                 events: ti.types.ndarray(ndim=1),
+                                 out: ti.types.ndarray(ndim=1),
+                                 transpose: ti.template(),
+                                 homo: ti.template()):
   for i in range((indptr.shape[0] - 1) * 32):
     row_i = i >> 5
     index = i & 31
-    if events[row_i] != 0.:
+    if ti.static(transpose):
+      if _bit(events[row_i >> 5], row_i):
+        j = indptr[row_i] + index
+        end_index = indptr[row_i + 1]
+        while j < end_index:
+          out[indices[j]] += _csr_value(values, j, homo)
+          j += 32
+    else:
+      r = 0.
       j = indptr[row_i] + index
       end_index = indptr[row_i + 1]
       while j < end_index:
-        out[indices[j]] += value
+        if _bit(events[indices[j] >> 5], indices[j]):
+          r += _csr_value(values, j, homo)
         j += 32
+      out[row_i] += r
 
 
-# TODO
-# It is important to note that the following warp-based kernels
-# should be improved, since the atomic_add for each thread is not
-# very efficient. Instead, the warp-level reduction primitive
-# should be used.
-# see ``warp_reduce_sum()`` function in tifunc.py.
-# However, currently Taichi does not support general warp-level primitives.
+# --------------------------------
+# bfloat16 values, boolean events
+# --------------------------------
+# The float16 values are read by the boolean heter kernels above. The bfloat16
+# ones are given as their uint16 bits, and decoded here.
 
 @ti.kernel
-def _event_csr_matvec_bool_homo_gpu(values: ti.types.ndarray(ndim=1),
-                                    indices: ti.types.ndarray(ndim=1),
-                                    indptr: ti.types.ndarray(ndim=1),
-                                    events: ti.types.ndarray(ndim=1),
-                                    out: ti.types.ndarray(ndim=1)):
-  value = values[0]
+def _event_csr_matvec_transpose_bf16_cpu(values: ti.types.ndarray(ndim=1),
+                                         indices: ti.types.ndarray(ndim=1),
+                                         indptr: ti.types.ndarray(ndim=1),
+                                         events: ti.types.ndarray(ndim=1),
+                                         out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  ti.loop_config(serialize=True)
+  for row_i in range(indptr.shape[0] - 1):
+    if events[row_i]:
+      for j in range(indptr[row_i], indptr[row_i + 1]):
+        out[indices[j]] += bf16_to_f32(values[j])
+
+
+@ti.kernel
+def _event_csr_matvec_transpose_bf16_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                                indices: ti.types.ndarray(ndim=1),
+                                                indptr: ti.types.ndarray(ndim=1),
+                                                events: ti.types.ndarray(ndim=1),
+                                                out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  for row_i in range(indptr.shape[0] - 1):
+    if events[row_i]:
+      for j in range(indptr[row_i], indptr[row_i + 1]):
+        out[indices[j]] += bf16_to_f32(values[j])
+
+
+@ti.kernel
+def _event_csr_matvec_transpose_bf16_partial_cpu(values: ti.types.ndarray(ndim=1),
+                                                 indices: ti.types.ndarray(ndim=1),
+                                                 indptr: ti.types.ndarray(ndim=1),
+                                                 events: ti.types.ndarray(ndim=1),
+                                                 out: ti.types.ndarray(ndim=1),
+                                                 partial: ti.types.ndarray(ndim=2)):
+  num_row = indptr.shape[0] - 1
+  num_block = partial.shape[0]
+  block_size = (num_row + num_block - 1) // num_block
+  for block_i in range(num_block):
+    for col_i in range(partial.shape[1]):
+      partial[block_i, col_i] = 0.
+    for row_i in range(block_i * block_size, ti.min((block_i + 1) * block_size, num_row)):
+      if events[row_i]:
+        for j in range(indptr[row_i], indptr[row_i + 1]):
+          partial[block_i, indices[j]] = partial[block_i, indices[j]] + bf16_to_f32(values[j])
+  for col_i in range(out.shape[0]):
+    r = 0.
+    for block_i in range(num_block):
+      r += partial[block_i, col_i]
+    out[col_i] = r
+
+
+@ti.kernel
+def _event_csr_matvec_bf16_cpu(values: ti.types.ndarray(ndim=1),
+                               indices: ti.types.ndarray(ndim=1),
+                               indptr: ti.types.ndarray(ndim=1),
+                               events: ti.types.ndarray(ndim=1),
+                               out: ti.types.ndarray(ndim=1)):
+  for row_i in range(indptr.shape[0] - 1):
+    r = 0.
+    for j in range(indptr[row_i], indptr[row_i + 1]):
+      if events[indices[j]]:
+        r += bf16_to_f32(values[j])
+    out[row_i] = r
+
+
+@ti.kernel
+def _event_csr_matvec_transpose_bf16_gpu(values: ti.types.ndarray(ndim=1),
+                                         indices: ti.types.ndarray(ndim=1),
+                                         indptr: ti.types.ndarray(ndim=1),
+                                         events: ti.types.ndarray(ndim=1),
+                                         out: ti.types.ndarray(ndim=1)):
   for i in range((indptr.shape[0] - 1) * 32):
     row_i = i >> 5
     index = i & 31
-    r = 0.
-    j = indptr[row_i] + index
-    end_index = indptr[row_i + 1]
-    while j < end_index:
-      if events[indices[j]]:
-        r += value
-      j += 32
-    out[row_i] += r  # TODO: warp-level primitive
+    if events[row_i]:
+      j = indptr[row_i] + index
+      end_index = indptr[row_i + 1]
+      while j < end_index:
+        out[indices[j]] += bf16_to_f32(values[j])
+        j += 32
 
 
 @ti.kernel
-def _event_csr_matvec_homo_gpu(values: ti.types.ndarray(ndim=1),
+def _event_csr_matvec_bf16_gpu(values: ti.types.ndarray(ndim=1),
                                indices: ti.types.ndarray(ndim=1),
                                indptr: ti.types.ndarray(ndim=1),
                                events: ti.types.ndarray(ndim=1),
                                out: ti.types.ndarray(ndim=1)):
-  value = values[0]
   for i in range((indptr.shape[0] - 1) * 32):
     row_i = i >> 5
     index = i & 31
@@ -284,52 +662,221 @@ def _event_csr_matvec_homo_gpu(values: ti.types.ndarray(ndim=1),
     j = indptr[row_i] + index
     end_index = indptr[row_i + 1]
     while j < end_index:
-      if events[indices[j]] != 0.:
-        r += value
+      if events[indices[j]]:
+        r += bf16_to_f32(values[j])
       j += 32
-    out[row_i] += r  # TODO: warp-level primitive
+    out[row_i] += r
+
 
+# ------------------------------------
+# compressed indices, boolean events
+# ------------------------------------
+# The columns are decoded from the compressed indices with "compressed_col". The
+# transposed kernels on CPU follow "cpu_transpose_strategy", as with the other
+# indices. The kernels take the flags "transpose" and "homo".
 
 @ti.kernel
-def _event_csr_matvec_transpose_bool_heter_gpu(values: ti.types.ndarray(ndim=1),
-                                               indices: ti.types.ndarray(ndim=1),
-                                               indptr: ti.types.ndarray(ndim=1),
-                                               events: ti.types.ndarray(ndim=1),
-                                               out: ti.types.ndarray(ndim=1)):
+def _event_csr_matvec_compressed_cpu(values: ti.types.ndarray(ndim=1),
+                                     offsets: ti.types.ndarray(ndim=1),
+                                     bases: ti.types.ndarray(ndim=1),
+                                     block_ptr: ti.types.ndarray(ndim=1),
+                                     block_shift: ti.types.ndarray(ndim=1),
+                                     indptr: ti.types.ndarray(ndim=1),
+                                     events: ti.types.ndarray(ndim=1),
+                                     out: ti.types.ndarray(ndim=1),
+                                     transpose: ti.template(),
+                                     homo: ti.template()):
+  shift = block_shift[0]
+  if ti.static(transpose):
+    for col_i in range(out.shape[0]):
+      out[col_i] = 0.
+    ti.loop_config(serialize=True)
+    for row_i in range(indptr.shape[0] - 1):
+      if events[row_i]:
+        start = indptr[row_i]
+        for j in range(start, indptr[row_i + 1]):
+          out[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)] += _csr_value(values, j, homo)
+  else:
+    for row_i in range(indptr.shape[0] - 1):
+      r = 0.
+      start = indptr[row_i]
+      for j in range(start, indptr[row_i + 1]):
+        if events[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)]:
+          r += _csr_value(values, j, homo)
+      out[row_i] = r
+
+
+@ti.kernel
+def _event_csr_matvec_transpose_compressed_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                                      offsets: ti.types.ndarray(ndim=1),
+                                                      bases: ti.types.ndarray(ndim=1),
+                                                      block_ptr: ti.types.ndarray(ndim=1),
+                                                      block_shift: ti.types.ndarray(ndim=1),
+                                                      indptr: ti.types.ndarray(ndim=1),
+                                                      events: ti.types.ndarray(ndim=1),
+                                                      out: ti.types.ndarray(ndim=1),
+                                                      homo: ti.template()):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  shift = block_shift[0]
+  for row_i in range(indptr.shape[0] - 1):
+    if events[row_i]:
+      start = indptr[row_i]
+      for j in range(start, indptr[row_i + 1]):
+        out[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)] += _csr_value(values, j, homo)
+
+
+@ti.kernel
+def _event_csr_matvec_transpose_compressed_partial_cpu(values: ti.types.ndarray(ndim=1),
+                                                       offsets: ti.types.ndarray(ndim=1),
+                                                       bases: ti.types.ndarray(ndim=1),
+                                                       block_ptr: ti.types.ndarray(ndim=1),
+                                                       block_shift: ti.types.ndarray(ndim=1),
+                                                       indptr: ti.types.ndarray(ndim=1),
+                                                       events: ti.types.ndarray(ndim=1),
+                                                       out: ti.types.ndarray(ndim=1),
+                                                       partial: ti.types.ndarray(ndim=2),
+                                                       homo: ti.template()):
+  shift = block_shift[0]
+  num_row = indptr.shape[0] - 1
+  num_block = partial.shape[0]
+  block_size = (num_row + num_block - 1) // num_block
+  for block_i in range(num_block):
+    for col_i in range(partial.shape[1]):
+      partial[block_i, col_i] = 0.
+    for row_i in range(block_i * block_size, ti.min((block_i + 1) * block_size, num_row)):
+      if events[row_i]:
+        start = indptr[row_i]
+        for j in range(start, indptr[row_i + 1]):
+          col_i = compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)
+          partial[block_i, col_i] = partial[block_i, col_i] + _csr_value(values, j, homo)
+  for col_i in range(out.shape[0]):
+    r = 0.
+    for block_i in range(num_block):
+      r += partial[block_i, col_i]
+    out[col_i] = r
+
+
+@ti.kernel
+def _event_csr_matvec_compressed_gpu(values: ti.types.ndarray(ndim=1),
+                                     offsets: ti.types.ndarray(ndim=1),
+                                     bases: ti.types.ndarray(ndim=1),
+                                     block_ptr: ti.types.ndarray(ndim=1),
+                                     block_shift: ti.types.ndarray(ndim=1),
+                                     indptr: ti.types.ndarray(ndim=1),
+                                     events: ti.types.ndarray(ndim=1),
+                                     out: ti.types.ndarray(ndim=1),
+                                     transpose: ti.template(),
+                                     homo: ti.template()):
+  shift = block_shift[0]
   for i in range((indptr.shape[0] - 1) * 32):
     row_i = i >> 5
     index = i & 31
-    if events[row_i]:
-      j = indptr[row_i] + index
+    if ti.static(transpose):
+      if events[row_i]:
+        start = indptr[row_i]
+        j = start + index
+        end_index = indptr[row_i + 1]
+        while j < end_index:
+          out[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)] += _csr_value(values, j, homo)
+          j += 32
+    else:
+      r = 0.
+      start = indptr[row_i]
+      j = start + index
       end_index = indptr[row_i + 1]
       while j < end_index:
-        out[indices[j]] += values[j]
+        if events[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)]:
+          r += _csr_value(values, j, homo)
         j += 32
+      out[row_i] += r
 
 
+# --------------------------------
+# planned matrix, boolean events
+# --------------------------------
+# On CPU, every parallel task walks the rows of its split of "splits". On GPU, every
+# row is processed by one warp, and the splits are not read. The "indirect" kernels
+# read the values through "value_idx".
+
 @ti.kernel
-def _event_csr_matvec_transpose_heter_gpu(values: ti.types.ndarray(ndim=1),
-                                          indices: ti.types.ndarray(ndim=1),
-                                          indptr: ti.types.ndarray(ndim=1),
-                                          events: ti.types.ndarray(ndim=1),
-                                          out: ti.types.ndarray(ndim=1)):
+def _event_csr_matvec_planned_homo_cpu(values: ti.types.ndarray(ndim=1),
+                                       indices: ti.types.ndarray(ndim=1),
+                                       indptr: ti.types.ndarray(ndim=1),
+                                       splits: ti.types.ndarray(ndim=1),
+                                       events: ti.types.ndarray(ndim=1),
+                                       out: ti.types.ndarray(ndim=1)):
+  value = values[0]
+  for part_i in range(splits.shape[0] - 1):
+    for row_i in range(splits[part_i], splits[part_i + 1]):
+      r = 0.
+      for j in range(indptr[row_i], indptr[row_i + 1]):
+        if events[indices[j]]:
+          r += value
+      out[row_i] = r
+
+
+@ti.kernel
+def _event_csr_matvec_planned_heter_cpu(values: ti.types.ndarray(ndim=1),
+                                        indices: ti.types.ndarray(ndim=1),
+                                        indptr: ti.types.ndarray(ndim=1),
+                                        splits: ti.types.ndarray(ndim=1),
+                                        events: ti.types.ndarray(ndim=1),
+                                        out: ti.types.ndarray(ndim=1)):
+  for part_i in range(splits.shape[0] - 1):
+    for row_i in range(splits[part_i], splits[part_i + 1]):
+      r = 0.
+      for j in range(indptr[row_i], indptr[row_i + 1]):
+        if events[indices[j]]:
+          r += values[j]
+      out[row_i] = r
+
+
+@ti.kernel
+def _event_csr_matvec_planned_indirect_cpu(values: ti.types.ndarray(ndim=1),
+                                           value_idx: ti.types.ndarray(ndim=1),
+                                           indices: ti.types.ndarray(ndim=1),
+                                           indptr: ti.types.ndarray(ndim=1),
+                                           splits: ti.types.ndarray(ndim=1),
+                                           events: ti.types.ndarray(ndim=1),
+                                           out: ti.types.ndarray(ndim=1)):
+  for part_i in range(splits.shape[0] - 1):
+    for row_i in range(splits[part_i], splits[part_i + 1]):
+      r = 0.
+      for j in range(indptr[row_i], indptr[row_i + 1]):
+        if events[indices[j]]:
+          r += values[value_idx[j]]
+      out[row_i] = r
+
+
+@ti.kernel
+def _event_csr_matvec_planned_homo_gpu(values: ti.types.ndarray(ndim=1),
+                                       indices: ti.types.ndarray(ndim=1),
+                                       indptr: ti.types.ndarray(ndim=1),
+                                       splits: ti.types.ndarray(ndim=1),
+                                       events: ti.types.ndarray(ndim=1),
+                                       out: ti.types.ndarray(ndim=1)):
+  value = values[0]
   for i in range((indptr.shape[0] - 1) * 32):
     row_i = i >> 5
     index = i & 31
-    if events[row_i] != 0.:
-      j = indptr[row_i] + index
-      end_index = indptr[row_i + 1]
-      while j < end_index:
-        out[indices[j]] += values[j]
-        j += 32
+    r = 0.
+    j = indptr[row_i] + index
+    end_index = indptr[row_i + 1]
+    while j < end_index:
+      if events[indices[j]]:
+        r += value
+      j += 32
+    out[row_i] += r
 
 
 @ti.kernel
-def _event_csr_matvec_bool_heter_gpu(values: ti.types.ndarray(ndim=1),
-                                     indices: ti.types.ndarray(ndim=1),
-                                     indptr: ti.types.ndarray(ndim=1),
-                                     events: ti.types.ndarray(ndim=1),
-                                     out: ti.types.ndarray(ndim=1)):
+def _event_csr_matvec_planned_heter_gpu(values: ti.types.ndarray(ndim=1),
+                                        indices: ti.types.ndarray(ndim=1),
+                                        indptr: ti.types.ndarray(ndim=1),
+                                        splits: ti.types.ndarray(ndim=1),
+                                        events: ti.types.ndarray(ndim=1),
+                                        out: ti.types.ndarray(ndim=1)):
   for i in range((indptr.shape[0] - 1) * 32):
     row_i = i >> 5
     index = i & 31
@@ -340,15 +887,17 @@ def _event_csr_matvec_bool_heter_gpu(values: ti.types.ndarray(ndim=1),
       if events[indices[j]]:
         r += values[j]
       j += 32
-    out[row_i] += r  # TODO: warp-level primitive
+    out[row_i] += r
 
 
 @ti.kernel
-def _event_csr_matvec_heter_gpu(values: ti.types.ndarray(ndim=1),
-                                indices: ti.types.ndarray(ndim=1),
-                                indptr: ti.types.ndarray(ndim=1),
-                                events: ti.types.ndarray(ndim=1),
-                                out: ti.types.ndarray(ndim=1)):
+def _event_csr_matvec_planned_indirect_gpu(values: ti.types.ndarray(ndim=1),
+                                           value_idx: ti.types.ndarray(ndim=1),
+                                           indices: ti.types.ndarray(ndim=1),
+                                           indptr: ti.types.ndarray(ndim=1),
+                                           splits: ti.types.ndarray(ndim=1),
+                                           events: ti.types.ndarray(ndim=1),
+                                           out: ti.types.ndarray(ndim=1)):
   for i in range((indptr.shape[0] - 1) * 32):
     row_i = i >> 5
     index = i & 31
@@ -356,22 +905,22 @@ def _event_csr_matvec_heter_gpu(values: ti.types.ndarray(ndim=1),
     j = indptr[row_i] + index
     end_index = indptr[row_i + 1]
     while j < end_index:
-      if events[indices[j]] != 0.:
-        r += values[j]
+      if events[indices[j]]:
+        r += values[value_idx[j]]
       j += 32
-    out[row_i] += r  # TODO: warp-level primitive
+    out[row_i] += r
 
 
-def _event_csr_matvec_jvp_values_taichi(val_dot, values, indices, indptr, events, *, outs, transpose, shape):
+def _event_csr_matvec_jvp_values_taichi(val_dot, values, indices, indptr, events, *, outs, transpose, shape, **kwargs):
   return normal_csrmv_taichi(val_dot, indices, indptr, events, shape=shape, transpose=transpose)
 
 
-def _event_csr_matvec_jvp_events_taichi(evt_dot, values, indices, indptr, events, *, outs, transpose, shape):
+def _event_csr_matvec_jvp_events_taichi(evt_dot, values, indices, indptr, events, *, outs, transpose, shape, **kwargs):
   return normal_csrmv_taichi(values, indices, indptr, evt_dot, shape=shape, transpose=transpose)
 
 
 def _event_csr_matvec_transpose_taichi(
-    ct, values, indices, indptr, events, *, outs, transpose, shape
+    ct, values, indices, indptr, events, *, outs, transpose, shape, **kwargs
 ):
   if ad.is_undefined_primal(indices) or ad.is_undefined_primal(indptr):
     raise ValueError("Cannot transpose with respect to sparse indices.")
@@ -391,41 +940,297 @@ def _event_csr_matvec_transpose_taichi(
     return ct_values, indices, indptr, events
 
 
+# A batch of event vectors is multiplied as one event matrix, which streams the
+# sparse structure once for all the vectors.
+
+def _event_csr_matvec_batched(values, indices, indptr, events, *, outs, transpose, shape, **kwargs):
+  return raw_event_csrmm_taichi(values, indices, indptr, events, shape=shape, transpose=transpose)[0]
+
+
+# Packed events are integer words, so only the values are differentiable.
+
+def _event_csr_matvec_packed_jvp_values(val_dot, values, indices, indptr, events, *, outs, transpose, shape, **kwargs):
+  return _raw_packed_csrmv_taichi(val_dot, indices, indptr, events, shape=shape, transpose=transpose)
+
+
+def _event_csr_matvec_packed_transpose(ct, values, indices, indptr, events, *, outs, transpose, shape, **kwargs):
+  if ad.is_undefined_primal(indices) or ad.is_undefined_primal(indptr):
+    raise ValueError("Cannot transpose with respect to sparse indices.")
+  assert not ad.is_undefined_primal(events), 'Cannot differentiate through packed events.'
+  if type(ct[0]) is ad.Zero:
+    ct_values = ad.Zero(values)
+  elif values.aval.shape[0] == 1:  # scalar
+    ct_values = _raw_packed_csrmv_taichi(jnp.ones(1, dtype=ct[0].dtype), indices, indptr, events,
+                                         shape=shape, transpose=transpose)[0]
+    ct_values = jnp.inner(ct[0], ct_values)
+  else:  # heterogeneous values
+    mask = raw_unpack_events(events, shape[0] if transpose else shape[1]).astype(ct[0].dtype)
+    row, col = csr_to_coo(indices, indptr)
+    ct_values = mask[row] * ct[0][col] if transpose else mask[col] * ct[0][row]
+  return ct_values, indices, indptr, events
+
+
+# The 16-bit operators output float32, which their rules keep, and their cotangents
+# of the values are rounded to the dtype of the values.
+
+def _half_event_csr_matvec_jvp_values(val_dot, values, indices, indptr, events, *, outs, transpose, shape, **kwargs):
+  return _half_event_csrmv_f32(val_dot, indices, indptr, events, shape=shape, transpose=transpose)
+
+
+def _half_event_csr_matvec_transpose(ct, values, indices, indptr, events, *, outs, transpose, shape, **kwargs):
+  if ad.is_undefined_primal(indices) or ad.is_undefined_primal(indptr):
+    raise ValueError("Cannot transpose with respect to sparse indices.")
+  assert not ad.is_undefined_primal(events), 'Cannot differentiate through boolean events.'
+  if type(ct[0]) is ad.Zero:
+    ct_values = ad.Zero(values)
+  else:
+    row, col = csr_to_coo(indices, indptr)
+    mask = events.astype(ct[0].dtype)
+    ct_values = mask[row] * ct[0][col] if transpose else mask[col] * ct[0][row]
+    ct_values = ct_values.astype(values.aval.dtype)
+  return ct_values, indices, indptr, events
+
+
+def _half_event_csr_matvec_batched(values, indices, indptr, events, *, outs, transpose, shape, **kwargs):
+  return raw_event_csrmm_taichi(values.astype(jnp.float32), indices, indptr, events,
+                                shape=shape, transpose=transpose)[0]
+
+
+# The compressed operators take the compressed indices as four arguments, from
+# "offsets" to "block_shift". Their events are boolean, so only the values are
+# differentiable.
+
+def _compressed_event_csr_matvec_jvp_values(val_dot, values, offsets, bases, block_ptr, block_shift, indptr, events, *,
+                                            outs, transpose, shape, **kwargs):
+  indices = CompressedIndices(offsets, bases, block_ptr, block_shift)
+  return _raw_compressed_csrmv_taichi(val_dot, indices, indptr, events, shape=shape, transpose=transpose)
+
+
+def _compressed_event_csr_matvec_transpose(ct, values, offsets, bases, block_ptr, block_shift, indptr, events, *,
+                                           outs, transpose, shape, **kwargs):
+  if any(ad.is_undefined_primal(x) for x in (offsets, bases, block_ptr, block_shift, indptr)):
+    raise ValueError("Cannot transpose with respect to sparse indices.")
+  assert not ad.is_undefined_primal(events), 'Cannot differentiate through boolean events.'
+  indices = CompressedIndices(offsets, bases, block_ptr, block_shift)
+  if type(ct[0]) is ad.Zero:
+    ct_values = ad.Zero(values)
+  elif values.aval.shape[0] == 1:  # scalar
+    ct_values = _raw_compressed_csrmv_taichi(jnp.ones(1, dtype=ct[0].dtype), indices, indptr, events,
+                                             shape=shape, transpose=transpose)[0]
+    ct_values = jnp.inner(ct[0], ct_values)
+  else:  # heterogeneous values
+    row, col = compressed_to_coo(indices, indptr)
+    mask = events.astype(ct[0].dtype)
+    ct_values = mask[row] * ct[0][col] if transpose else mask[col] * ct[0][row]
+  return ct_values, offsets, bases, block_ptr, block_shift, indptr, events
+
+
+def _compressed_event_csr_matvec_batched(values, offsets, bases, block_ptr, block_shift, indptr, events, *,
+                                         outs, transpose, shape, **kwargs):
+  indices = decompress_indices(CompressedIndices(offsets, bases, block_ptr, block_shift), indptr)
+  return raw_event_csrmm_taichi(values, indices, indptr, events, shape=shape, transpose=transpose)[0]
+
+
+# The CPU kernels assign every element of their output, or zero it in a parallel
+# loop before they scatter into it, so that it need not be zeroed, while their GPU
+# kernels reduce into a zeroed output.
+_cpu_overwrite = {'cpu': ('overwrite',), 'gpu': ('zero',)}
+
+
+def _define_compressed_op(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_compressed_event_csr_matvec_jvp_values, None, None, None, None, None, None)
+  prim.def_transpose_rule(_compressed_event_csr_matvec_transpose)
+  register_vector_batching(prim.primitive, _compressed_event_csr_matvec_batched, 6)
+  return prim
+
+
+# The planned operators compute the product of the matrix they are given, without
+# transposition, on boolean events, so only the values are differentiable.
+
+def _planned_event_csr_matvec_ct_values(ct, values, value_idx, indices, indptr, events):
+  if any(ad.is_undefined_primal(x) for x in (value_idx, indices, indptr)):
+    raise ValueError("Cannot transpose with respect to sparse indices.")
+  assert not ad.is_undefined_primal(events), 'Cannot differentiate through boolean events.'
+  if type(ct[0]) is ad.Zero:
+    return ad.Zero(values)
+  row, col = csr_to_coo(indices, indptr)
+  ct_values = events[col].astype(ct[0].dtype) * ct[0][row]
+  if values.aval.shape[0] == 1:  # scalar
+    return jnp.sum(ct_values, keepdims=True)
+  if value_idx is None:
+    return ct_values
+  return jnp.zeros(values.aval.shape, ct_values.dtype).at[value_idx].add(ct_values)
+
+
+def _planned_event_csr_matvec_jvp_values(val_dot, values, indices, indptr, splits, events, *, outs):
+  return _planned_event_csrmv(val_dot, None, indices, indptr, splits, events)
+
+
+def _planned_event_csr_matvec_transpose(ct, values, indices, indptr, splits, events, *, outs):
+  ct_values = _planned_event_csr_matvec_ct_values(ct, values, None, indices, indptr, events)
+  return ct_values, indices, indptr, splits, events
+
+
+def _planned_event_csr_matvec_batched(values, indices, indptr, splits, events, *, outs):
+  return raw_event_csrmm_taichi(values, indices, indptr, events, shape=(indptr.shape[0] - 1, events.shape[0]))[0]
+
+
+def _indirect_event_csr_matvec_jvp_values(val_dot, values, value_idx, indices, indptr, splits, events, *, outs):
+  return _planned_event_csrmv(val_dot, value_idx, indices, indptr, splits, events)
+
+
+def _indirect_event_csr_matvec_transpose(ct, values, value_idx, indices, indptr, splits, events, *, outs):
+  ct_values = _planned_event_csr_matvec_ct_values(ct, values, value_idx, indices, indptr, events)
+  return ct_values, value_idx, indices, indptr, splits, events
+
+
+def _indirect_event_csr_matvec_batched(values, value_idx, indices, indptr, splits, events, *, outs):
+  return raw_event_csrmm_taichi(values[value_idx], indices, indptr, events,
+                                shape=(indptr.shape[0] - 1, events.shape[0]))[0]
+
+
+def _define_planned_op(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_planned_event_csr_matvec_jvp_values, None, None, None, None)
+  prim.def_transpose_rule(_planned_event_csr_matvec_transpose)
+  register_vector_batching(prim.primitive, _planned_event_csr_matvec_batched, 4)
+  return prim
+
+
+def _define_indirect_op(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_indirect_event_csr_matvec_jvp_values, None, None, None, None, None)
+  prim.def_transpose_rule(_indirect_event_csr_matvec_transpose)
+  register_vector_batching(prim.primitive, _indirect_event_csr_matvec_batched, 5)
+  return prim
+
+
+def _define_half_op(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_half_event_csr_matvec_jvp_values, None, None, None)
+  prim.def_transpose_rule(_half_event_csr_matvec_transpose)
+  register_vector_batching(prim.primitive, _half_event_csr_matvec_batched, 3)
+  return prim
+
+
+def _define_packed_op(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_event_csr_matvec_packed_jvp_values, None, None, None)
+  prim.def_transpose_rule(_event_csr_matvec_packed_transpose)
+  register_vector_batching(prim.primitive, _event_csr_matvec_batched, 3)
+  return prim
+
+
 def _define_op(cpu_kernel, gpu_kernel):
-  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel)
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
   prim.defjvp(_event_csr_matvec_jvp_values_taichi, None, None, _event_csr_matvec_jvp_events_taichi)
   prim.def_transpose_rule(_event_csr_matvec_transpose_taichi)
+  register_vector_batching(prim.primitive, _event_csr_matvec_batched, 3)
   return prim
 
 
-# transpose bool homo
-_event_csrmv_transpose_bool_homo_p = _define_op(_event_csr_matvec_transpose_bool_homo_cpu,
-                                                _event_csr_matvec_transpose_bool_homo_gpu)
+# The "partial" and "active" operators have scratch outputs after their first
+# result, which are discarded, so their tangents and cotangents are always zero.
+# Their other rules are those of the operator "op" without the scratch outputs,
+# which also computes their result on GPU.
 
-# transpose homo
-_event_csrmv_transpose_homo_p = _define_op(_event_csr_matvec_transpose_homo_cpu,
-                                           _event_csr_matvec_transpose_homo_gpu)
+def _with_zero_scratch(jvp_rule):
+  if jvp_rule is None:
+    return None
 
-# not transpose bool homo
-_event_csrmv_bool_homo_p = _define_op(_event_csr_matvec_bool_homo_cpu,
-                                      _event_csr_matvec_bool_homo_gpu)
+  def rule(*args, outs, **kwargs):
+    return list(jvp_rule(*args, outs=outs[:1], **kwargs)) + [ad.Zero(jax.core.ShapedArray(o.shape, o.dtype))
+                                                             for o in outs[1:]]
 
-# not transpose homo
-_event_csrmv_homo_p = _define_op(_event_csr_matvec_homo_cpu,
-                                 _event_csr_matvec_homo_gpu)
+  return rule
 
-# transpose bool heter
-_event_csrmv_transpose_bool_heter_p = _define_op(_event_csr_matvec_transpose_bool_heter_cpu,
-                                                 _event_csr_matvec_transpose_bool_heter_gpu)
 
-# transpose heter
-_event_csrmv_transpose_heter_p = _define_op(_event_csr_matvec_transpose_heter_cpu,
-                                            _event_csr_matvec_transpose_heter_gpu)
+def _with_scratch_cotangent(transpose_rule):
+  def rule(ct, *args, outs, **kwargs):
+    return transpose_rule(ct[:1], *args, outs=outs[:1], **kwargs)
+
+  return rule
+
+
+def _define_scratch_op(cpu_kernel, output_init, op, jvp_rules, transpose_rule, batched_rule, batched_arg):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, output_init=output_init)
+  prim.def_mlir_lowering('gpu', _scratch_free_lowering(op))
+  prim.defjvp(*[_with_zero_scratch(r) for r in jvp_rules])
+  prim.def_transpose_rule(_with_scratch_cotangent(transpose_rule))
+  register_vector_batching(prim.primitive, batched_rule, batched_arg)
+  return prim
 
-# not transpose bool heter
-_event_csrmv_bool_heter_p = _define_op(_event_csr_matvec_bool_heter_cpu,
-                                       _event_csr_matvec_bool_heter_gpu)
 
-# not transpose heter
-_event_csrmv_heter_p = _define_op(_event_csr_matvec_heter_cpu,
-                                  _event_csr_matvec_heter_gpu)
+def _define_bool_scratch_op(cpu_kernel, output_init):
+  return _define_scratch_op(cpu_kernel, output_init, _event_csrmv_p,
+                            (_event_csr_matvec_jvp_values_taichi, None, None, _event_csr_matvec_jvp_events_taichi),
+                            _event_csr_matvec_transpose_taichi, _event_csr_matvec_batched, 3)
+
+
+def _define_packed_partial_op(cpu_kernel):
+  return _define_scratch_op(cpu_kernel, ('overwrite', 'overwrite'), _event_csrmv_packed_p,
+                            (_event_csr_matvec_packed_jvp_values, None, None, None),
+                            _event_csr_matvec_packed_transpose, _event_csr_matvec_batched, 3)
+
+
+def _define_half_partial_op(cpu_kernel, op):
+  return _define_scratch_op(cpu_kernel, ('overwrite', 'overwrite'), op,
+                            (_half_event_csr_matvec_jvp_values, None, None, None),
+                            _half_event_csr_matvec_transpose, _half_event_csr_matvec_batched, 3)
+
+
+def _define_compressed_partial_op(cpu_kernel):
+  return _define_scratch_op(cpu_kernel, ('overwrite', 'overwrite'), _event_csrmv_compressed_p,
+                            (_compressed_event_csr_matvec_jvp_values, None, None, None, None, None, None),
+                            _compressed_event_csr_matvec_transpose, _compressed_event_csr_matvec_batched, 6)
+
+
+# the kernels take the flags "transpose", "homo" and "bool_event"
+_event_csrmv_p = _define_op(_event_csr_matvec_cpu, _event_csr_matvec_gpu)
+
+# transpose, parallel on CPU
+_event_csrmv_transpose_atomic_p = _define_op(_event_csr_matvec_transpose_atomic_cpu, _event_csr_matvec_gpu)
+_event_csrmv_transpose_partial_p = _define_bool_scratch_op(_event_csr_matvec_transpose_partial_cpu,
+                                                           output_init=('overwrite', 'overwrite'))
+
+# transpose, compacted on CPU
+_event_csrmv_transpose_active_p = _define_bool_scratch_op(_event_csr_matvec_transpose_active_cpu,
+                                                          output_init=('overwrite', 'overwrite', 'overwrite'))
+
+# packed events, the kernels take the flags "transpose" and "homo"
+_event_csrmv_packed_p = _define_packed_op(_event_csr_matvec_packed_cpu, _event_csr_matvec_packed_gpu)
+_event_csrmv_transpose_packed_atomic_p = _define_packed_op(_event_csr_matvec_transpose_packed_atomic_cpu,
+                                                           _event_csr_matvec_packed_gpu)
+_event_csrmv_transpose_packed_partial_p = _define_packed_partial_op(_event_csr_matvec_transpose_packed_partial_cpu)
+
+# 16-bit heter values, boolean events
+_event_csrmv_half_p = _define_half_op(_event_csr_matvec_cpu, _event_csr_matvec_gpu)
+_event_csrmv_transpose_half_atomic_p = _define_half_op(_event_csr_matvec_transpose_atomic_cpu,
+                                                       _event_csr_matvec_gpu)
+_event_csrmv_transpose_half_partial_p = _define_half_partial_op(_event_csr_matvec_transpose_partial_cpu,
+                                                                _event_csrmv_half_p)
+_event_csrmv_transpose_bf16_p = _define_half_op(_event_csr_matvec_transpose_bf16_cpu,
+                                                _event_csr_matvec_transpose_bf16_gpu)
+_event_csrmv_transpose_bf16_atomic_p = _define_half_op(_event_csr_matvec_transpose_bf16_atomic_cpu,
+                                                       _event_csr_matvec_transpose_bf16_gpu)
+_event_csrmv_transpose_bf16_partial_p = _define_half_partial_op(_event_csr_matvec_transpose_bf16_partial_cpu,
+                                                                _event_csrmv_transpose_bf16_p)
+_event_csrmv_bf16_p = _define_half_op(_event_csr_matvec_bf16_cpu,
+                                      _event_csr_matvec_bf16_gpu)
+
+# compressed indices, boolean events, the kernels take the flags "transpose" and "homo"
+_event_csrmv_compressed_p = _define_compressed_op(_event_csr_matvec_compressed_cpu, _event_csr_matvec_compressed_gpu)
+_event_csrmv_transpose_compressed_atomic_p = _define_compressed_op(_event_csr_matvec_transpose_compressed_atomic_cpu,
+                                                                   _event_csr_matvec_compressed_gpu)
+_event_csrmv_transpose_compressed_partial_p = _define_compressed_partial_op(
+  _event_csr_matvec_transpose_compressed_partial_cpu
+)
+
+# planned matrix, boolean events
+_event_csrmv_planned_homo_p = _define_planned_op(_event_csr_matvec_planned_homo_cpu,
+                                                 _event_csr_matvec_planned_homo_gpu)
+_event_csrmv_planned_heter_p = _define_planned_op(_event_csr_matvec_planned_heter_cpu,
+                                                  _event_csr_matvec_planned_heter_gpu)
+_event_csrmv_planned_indirect_p = _define_indirect_op(_event_csr_matvec_planned_indirect_cpu,
+                                                      _event_csr_matvec_planned_indirect_gpu)
@@ -0,0 +1,288 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+# Grouped event CSR products.
+#
+# The projections of a group share their event vector. Without transposition, they
+# share their columns, and their rows are stacked into one CSR matrix, whose product
+# is a single "event_csrmv". With transposition, they share their rows, and their
+# columns are laid side by side: their indices are concatenated, shifted by the
+# offset of their outputs in the concatenated output, and their row pointers, shifted
+# by the offset of their non-zeros, make the rows of a 2D "indptr". A row with an
+# event is then scattered into all the projections, in a single launch which reads
+# the events once.
+
+from typing import Sequence, Tuple
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import taichi as ti
+from jax.interpreters import ad
+
+from braintaichi._primitive._batch_utils import register_vector_batching
+from braintaichi._primitive._xla_custom_op import XLACustomOp
+from braintaichi._sparseop._sparse_csrmv import raw_csrmv_taichi as normal_csrmv_taichi
+from braintaichi._sparseop._sparse_utils import _use_atomic_cpu_scatter, is_half
+from ._event_csrmv import raw_csrmv_taichi
+from ._event_packed import is_packed, raw_unpack_events
+
+
+def raw_event_csrmv_grouped_taichi(
+    data: Sequence[jax.Array],
+    indices: Sequence[jax.Array],
+    indptr: Sequence[jax.Array],
+    events: jax.Array,
+    *,
+    shapes: Sequence[Tuple[int, int]],
+    transpose: bool = False,
+):
+  if is_packed(events):
+    events = raw_unpack_events(events, shapes[0][0] if transpose else shapes[0][1])
+  if not transpose:
+    return _stacked_event_csrmv(data, indices, indptr, events, shapes=shapes)
+  if events.dtype != jnp.bool_:
+    return [normal_csrmv_taichi(d, ind, ptr, events, shape=s, transpose=True)[0]
+            for d, ind, ptr, s in zip(data, indices, indptr, shapes)]
+  dtype = jnp.result_type(*data)
+  # 16-bit values are computed in float32
+  if is_half(dtype):
+    rs = raw_event_csrmv_grouped_taichi([d.astype(jnp.float32) for d in data], indices, indptr, events,
+                                        shapes=shapes, transpose=transpose)
+    return [r.astype(dtype) for r in rs]
+
+  sizes = tuple(s[1] for s in shapes)
+  col_offsets = np.cumsum((0,) + sizes)
+  nnz_offsets = np.cumsum([0] + [ind.shape[0] for ind in indices])
+  cat_indices = jnp.concatenate([ind.astype(jnp.int32) + col_offsets[k] for k, ind in enumerate(indices)])
+  cat_indptr = jnp.stack([ptr.astype(jnp.int32) + nnz_offsets[k] for k, ptr in enumerate(indptr)])
+  homo = all(d.shape[0] == 1 for d in data)
+  if homo:
+    values = jnp.concatenate([d.astype(dtype) for d in data])
+  else:
+    values = jnp.concatenate([jnp.broadcast_to(d.astype(dtype), ind.shape) for d, ind in zip(data, indices)])
+  r = grouped_event_matvec(values, cat_indices, cat_indptr, events, homo=homo, num_out=int(col_offsets[-1]))[0]
+  return list(jnp.split(r, col_offsets[1:-1]))
+
+
+def _stacked_event_csrmv(data, indices, indptr, events, *, shapes):
+  # the rows of the projections stacked into one matrix
+  sizes = tuple(s[0] for s in shapes)
+  row_offsets = np.cumsum((0,) + sizes)
+  nnz_offsets = np.cumsum([0] + [ind.shape[0] for ind in indices])
+  dtype = jnp.result_type(*data)
+  if len(data) == 1:
+    values = data[0]
+  else:
+    values = jnp.concatenate([jnp.broadcast_to(d.astype(dtype), ind.shape) for d, ind in zip(data, indices)])
+  cat_indices = jnp.concatenate([ind.astype(jnp.int32) for ind in indices])
+  cat_indptr = jnp.concatenate([ptr[:-1].astype(jnp.int32) + nnz_offsets[k] for k, ptr in enumerate(indptr)] +
+                               [jnp.asarray([nnz_offsets[-1]], dtype=jnp.int32)])
+  r = raw_csrmv_taichi(values, cat_indices, cat_indptr, events,
+                       shape=(int(row_offsets[-1]), shapes[0][1]), transpose=False)[0]
+  return list(jnp.split(r, row_offsets[1:-1]))
+
+
+def grouped_event_matvec(values, indices, indptr, events, *, homo, num_out):
+  """Scatter the rows with events into the concatenated outputs of the projections.
+
+  With ``homo``, ``values`` holds one value per projection, otherwise one per non-zero.
+  """
+  prim = _event_csrmv_grouped_homo_p if homo else _event_csrmv_grouped_heter_p
+  if _use_atomic_cpu_scatter(num_out, indices.shape[0]):
+    prim = _event_csrmv_grouped_homo_atomic_p if homo else _event_csrmv_grouped_heter_atomic_p
+  return prim(values,
+              indices,
+              indptr,
+              events,
+              outs=[jax.ShapeDtypeStruct((num_out,), dtype=values.dtype)],
+              homo=homo)
+
+
+# -------------
+# CPU operators
+# -------------
+# The homo kernels read the value of the projection "k" at "values[k]". The kernels
+# are either serial or atomic, see "cpu_transpose_strategy", the "partial" strategy
+# using the atomic ones.
+
+@ti.kernel
+def _event_csr_matvec_grouped_homo_cpu(values: ti.types.ndarray(ndim=1),
+                                       indices: ti.types.ndarray(ndim=1),
+                                       indptr: ti.types.ndarray(ndim=2),
+                                       events: ti.types.ndarray(ndim=1),
+                                       out: ti.types.ndarray(ndim=1)):
+  for row_i in range(out.shape[0]):
+    out[row_i] = 0.
+  num_group = indptr.shape[0]
+  ti.loop_config(serialize=True)
+  for row_i in range(indptr.shape[1] - 1):
+    if events[row_i]:
+      for k in range(num_group):
+        value = values[k]
+        for j in range(indptr[k, row_i], indptr[k, row_i + 1]):
+          out[indices[j]] += value
+
+
+@ti.kernel
+def _event_csr_matvec_grouped_heter_cpu(values: ti.types.ndarray(ndim=1),
+                                        indices: ti.types.ndarray(ndim=1),
+                                        indptr: ti.types.ndarray(ndim=2),
+                                        events: ti.types.ndarray(ndim=1),
+                                        out: ti.types.ndarray(ndim=1)):
+  for row_i in range(out.shape[0]):
+    out[row_i] = 0.
+  num_group = indptr.shape[0]
+  ti.loop_config(serialize=True)
+  for row_i in range(indptr.shape[1] - 1):
+    if events[row_i]:
+      for k in range(num_group):
+        for j in range(indptr[k, row_i], indptr[k, row_i + 1]):
+          out[indices[j]] += values[j]
+
+
+@ti.kernel
+def _event_csr_matvec_grouped_homo_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                              indices: ti.types.ndarray(ndim=1),
+                                              indptr: ti.types.ndarray(ndim=2),
+                                              events: ti.types.ndarray(ndim=1),
+                                              out: ti.types.ndarray(ndim=1)):
+  for row_i in range(out.shape[0]):
+    out[row_i] = 0.
+  num_group = indptr.shape[0]
+  for row_i in range(indptr.shape[1] - 1):
+    if events[row_i]:
+      for k in range(num_group):
+        value = values[k]
+        for j in range(indptr[k, row_i], indptr[k, row_i + 1]):
+          out[indices[j]] += value
+
+
+@ti.kernel
+def _event_csr_matvec_grouped_heter_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                               indices: ti.types.ndarray(ndim=1),
+                                               indptr: ti.types.ndarray(ndim=2),
+                                               events: ti.types.ndarray(ndim=1),
+                                               out: ti.types.ndarray(ndim=1)):
+  for row_i in range(out.shape[0]):
+    out[row_i] = 0.
+  num_group = indptr.shape[0]
+  for row_i in range(indptr.shape[1] - 1):
+    if events[row_i]:
+      for k in range(num_group):
+        for j in range(indptr[k, row_i], indptr[k, row_i + 1]):
+          out[indices[j]] += values[j]
+
+
+# -------------
+# GPU operators
+# -------------
+# A warp scatters a row into all the projections.
+
+@ti.kernel
+def _event_csr_matvec_grouped_homo_gpu(values: ti.types.ndarray(ndim=1),
+                                       indices: ti.types.ndarray(ndim=1),
+                                       indptr: ti.types.ndarray(ndim=2),
+                                       events: ti.types.ndarray(ndim=1),
+                                       out: ti.types.ndarray(ndim=1)):
+  num_group = indptr.shape[0]
+  for i in range((indptr.shape[1] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    if events[row_i]:
+      for k in range(num_group):
+        value = values[k]
+        j = indptr[k, row_i] + index
+        end_index = indptr[k, row_i + 1]
+        while j < end_index:
+          out[indices[j]] += value
+          j += 32
+
+
+@ti.kernel
+def _event_csr_matvec_grouped_heter_gpu(values: ti.types.ndarray(ndim=1),
+                                        indices: ti.types.ndarray(ndim=1),
+                                        indptr: ti.types.ndarray(ndim=2),
+                                        events: ti.types.ndarray(ndim=1),
+                                        out: ti.types.ndarray(ndim=1)):
+  num_group = indptr.shape[0]
+  for i in range((indptr.shape[1] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    if events[row_i]:
+      for k in range(num_group):
+        j = indptr[k, row_i] + index
+        end_index = indptr[k, row_i + 1]
+        while j < end_index:
+          out[indices[j]] += values[j]
+          j += 32
+
+
+def _grouped_slots(indptr, num_slot):
+  # the row and the projection of each non-zero
+  num_group, num_row = indptr.shape[0], indptr.shape[1] - 1
+  rows = jnp.repeat(jnp.tile(jnp.arange(num_row, dtype=jnp.int32), num_group),
+                    jnp.diff(indptr, axis=1).flatten(), total_repeat_length=num_slot)
+  groups = jnp.repeat(jnp.arange(num_group, dtype=jnp.int32), indptr[:, -1] - indptr[:, 0],
+                      total_repeat_length=num_slot)
+  return rows, groups
+
+
+def _grouped_matvec_jvp_values(val_dot, values, indices, indptr, events, *, outs, homo):
+  return grouped_event_matvec(val_dot, indices, indptr, events, homo=homo, num_out=outs[0].shape[0])
+
+
+def _grouped_matvec_transpose(ct, values, indices, indptr, events, *, outs, homo):
+  if ad.is_undefined_primal(indices) or ad.is_undefined_primal(indptr):
+    raise ValueError("Cannot transpose with respect to sparse indices.")
+  if ad.is_undefined_primal(events):
+    raise ValueError("Cannot transpose with respect to the boolean events.")
+  if type(ct[0]) is ad.Zero:
+    return ad.Zero(values), indices, indptr, events
+  rows, groups = _grouped_slots(indptr, indices.shape[0])
+  ct_values = jnp.where(events[rows], ct[0][indices], 0)
+  if homo:
+    ct_values = jax.ops.segment_sum(ct_values, groups, num_segments=indptr.shape[0])
+  return ct_values, indices, indptr, events
+
+
+def _grouped_matvec_batched(values, indices, indptr, matrix, *, outs, homo):
+  rows, groups = _grouped_slots(indptr, indices.shape[0])
+  weights = values[groups] if homo else values
+  return jax.ops.segment_sum(weights[:, None] * matrix[rows].astype(values.dtype), indices,
+                             num_segments=outs[0].shape[0])
+
+
+# The CPU kernels zero their output in a parallel loop before they scatter into it,
+# and the GPU ones scatter into a zeroed output.
+def _define_op(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel,
+                     output_init={'cpu': ('overwrite',), 'gpu': ('zero',)})
+  prim.defjvp(_grouped_matvec_jvp_values, None, None, None)
+  prim.def_transpose_rule(_grouped_matvec_transpose)
+  register_vector_batching(prim.primitive, _grouped_matvec_batched, 3)
+  return prim
+
+
+_event_csrmv_grouped_homo_p = _define_op(_event_csr_matvec_grouped_homo_cpu,
+                                         _event_csr_matvec_grouped_homo_gpu)
+_event_csrmv_grouped_heter_p = _define_op(_event_csr_matvec_grouped_heter_cpu,
+                                          _event_csr_matvec_grouped_heter_gpu)
+_event_csrmv_grouped_homo_atomic_p = _define_op(_event_csr_matvec_grouped_homo_atomic_cpu,
+                                                _event_csr_matvec_grouped_homo_gpu)
+_event_csrmv_grouped_heter_atomic_p = _define_op(_event_csr_matvec_grouped_heter_atomic_cpu,
+                                                 _event_csr_matvec_grouped_heter_gpu)
@@ -0,0 +1,123 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+# Bit-packed events.
+#
+# A packed event vector stores the event of the neuron ``i`` in the bit ``i % 32``
+# of its ``uint32`` word ``i // 32``, which takes 8x less memory than boolean
+# events. The kernels skip the all-zero words and visit the set bits of the other
+# ones with count-trailing-zeros, so a scan at a low firing rate reads little more
+# than the words. ``uint64`` words hold the same bits as two ``uint32`` words,
+# the low one first, and the operators view them as such. Event matrices are
+# packed along their first axis. The padding bits of the last word must be zero.
+
+import jax
+import taichi as ti
+from jax import numpy as jnp
+
+from braintaichi._primitive._xla_custom_op import XLACustomOp
+
+# the number of events in each word of the kernels
+_word_bits = 32
+
+
+def is_packed(events) -> bool:
+  return events.dtype in (jnp.uint32, jnp.uint64)
+
+
+def num_words(num_event: int, dtype) -> int:
+  """The number of ``dtype`` words of ``num_event`` packed events."""
+  bits = jnp.dtype(dtype).itemsize * 8
+  return (num_event + bits - 1) // bits
+
+
+def as_words32(words: jax.Array) -> jax.Array:
+  """View packed ``uint64`` words, along the first axis, as ``uint32`` words."""
+  if words.dtype == jnp.uint32:
+    return words
+  words32 = jax.lax.bitcast_convert_type(words, jnp.uint32)
+  return jnp.moveaxis(words32, -1, 1).reshape((-1,) + words.shape[1:])
+
+
+def raw_pack_events(events: jax.Array, dtype) -> jax.Array:
+  dtype = jnp.dtype(dtype)
+  if dtype not in (jnp.uint32, jnp.uint64):
+    raise ValueError(f'Events can only be packed into uint32 or uint64 words, but got {dtype}.')
+  if dtype == jnp.uint64 and not jax.config.read('jax_enable_x64'):
+    raise ValueError('Packing events into uint64 words requires "jax_enable_x64".')
+  if events.ndim not in (1, 2):
+    raise ValueError(f'Only event vectors and matrices can be packed, but got {events.ndim}-D events.')
+
+  matrix = events.reshape(events.shape[0], -1)
+  num_word32 = num_words(events.shape[0], dtype) * (dtype.itemsize // 4)
+  words = _pack_events_p(matrix, outs=[jax.ShapeDtypeStruct((num_word32, matrix.shape[1]), jnp.uint32)])[0]
+  if dtype == jnp.uint64:
+    words = jnp.moveaxis(words.reshape(num_word32 // 2, 2, matrix.shape[1]), 1, -1)
+    words = jax.lax.bitcast_convert_type(words, jnp.uint64)
+  return words.reshape((words.shape[0],) + events.shape[1:])
+
+
+def raw_unpack_events(words: jax.Array, num_event: int) -> jax.Array:
+  words = as_words32(words)
+  shifts = jnp.arange(_word_bits, dtype=jnp.uint32).reshape((1, _word_bits) + (1,) * (words.ndim - 1))
+  bits = (jnp.expand_dims(words, 1) >> shifts) & 1
+  return bits.reshape((-1,) + words.shape[1:])[:num_event].astype(jnp.bool_)
+
+
+@ti.func
+def _ctz(word):
+  # the index of the lowest set bit of a non-zero word, by binary search
+  n = 0
+  x = word
+  if (x & 0xFFFF) == 0:
+    n += 16
+    x >>= 16
+  if (x & 0xFF) == 0:
+    n += 8
+    x >>= 8
+  if (x & 0xF) == 0:
+    n += 4
+    x >>= 4
+  if (x & 0x3) == 0:
+    n += 2
+    x >>= 2
+  if (x & 0x1) == 0:
+    n += 1
+  return n
+
+
+@ti.func
+def _bit(word, i):
+  # whether the event "i" is set in its word
+  return (word >> (i & 31)) & 1
+
+
+@ti.kernel
+def _pack_events(events: ti.types.ndarray(ndim=2),
+                 words: ti.types.ndarray(ndim=2)):
+  num_event = events.shape[0]
+  for word_i, col_i in ti.ndrange(words.shape[0], words.shape[1]):
+    word = ti.u32(0)
+    for bit_i in range(_word_bits):
+      event_i = word_i * _word_bits + bit_i
+      if event_i < num_event:
+        if events[event_i, col_i] != 0:
+          word |= ti.u32(1) << bit_i
+    words[word_i, col_i] = word
+
+
+_pack_events_p = XLACustomOp(cpu_kernel=_pack_events, gpu_kernel=_pack_events)
@@ -0,0 +1,347 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+from typing import Tuple
+
+import jax
+import jax.numpy as jnp
+import taichi as ti
+from jax.interpreters import ad
+
+from braintaichi._primitive._batch_utils import register_vector_batching
+from braintaichi._primitive._xla_custom_op import XLACustomOp
+from braintaichi._sparseop._sparse_sell import SELLIndices, sell_input, sell_output, sell_slots, sell_matmat
+from braintaichi._sparseop._sparse_sellmv import raw_sellmv_taichi as normal_sellmv_taichi
+from braintaichi._sparseop._sparse_utils import _use_atomic_cpu_scatter, is_half
+from ._event_packed import is_packed, raw_unpack_events
+
+
+def raw_event_sellmv_taichi(
+    data: jax.Array,
+    indices: SELLIndices,
+    events: jax.Array,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+):
+  if is_packed(events):
+    events = raw_unpack_events(events, shape[0] if transpose else shape[1])
+  if events.dtype != jnp.bool_:
+    return normal_sellmv_taichi(data, indices, events, shape=shape, transpose=transpose)
+  # 16-bit values are computed in float32
+  if is_half(data.dtype):
+    r = raw_event_sellmv_taichi(data.astype(jnp.float32), indices, events, shape=shape, transpose=transpose)[0]
+    return [r.astype(data.dtype)]
+  if transpose:
+    events = sell_input(indices, events)
+    return event_sell_matvec(data, indices.indices, indices.slice_ptr, indices.row_len, events,
+                             transpose=True, num_out=shape[1])
+  r = event_sell_matvec(data, indices.indices, indices.slice_ptr, indices.row_len, events,
+                        transpose=False, num_out=indices.row_len.shape[0])[0]
+  return [sell_output(indices, r, shape[0])]
+
+
+def event_sell_matvec(values, indices, slice_ptr, row_len, events, *, transpose, num_out):
+  """The product over the rows in the order of the slices, which are those of ``events`` when transposed."""
+  homo = values.shape[0] == 1
+  if transpose:
+    prim = _event_sell_matvec_transpose_homo_p if homo else _event_sell_matvec_transpose_heter_p
+    if _use_atomic_cpu_scatter(num_out, indices.shape[0]):
+      prim = _event_sell_matvec_transpose_homo_atomic_p if homo else _event_sell_matvec_transpose_heter_atomic_p
+  else:
+    prim = _event_sell_matvec_homo_p if homo else _event_sell_matvec_heter_p
+  return prim(values,
+              indices,
+              slice_ptr,
+              row_len,
+              events,
+              outs=[jax.ShapeDtypeStruct((num_out,), dtype=values.dtype)],
+              transpose=transpose)
+
+
+# -------------
+# CPU operators
+# -------------
+# As in "_sparse_sellmv.py", the innermost loop of the forward kernels runs over
+# the "C" slots of the rows of a slice, and selects the values of the slots whose
+# columns have events. The transposed kernels skip the rows without events.
+
+@ti.kernel
+def _event_sell_matvec_homo_cpu(values: ti.types.ndarray(ndim=1),
+                                indices: ti.types.ndarray(ndim=1),
+                                slice_ptr: ti.types.ndarray(ndim=1),
+                                row_len: ti.types.ndarray(ndim=1),
+                                events: ti.types.ndarray(ndim=1),
+                                out: ti.types.ndarray(ndim=1)):
+  for row_i in range(out.shape[0]):
+    out[row_i] = 0.
+  value = values[0]
+  num_slice = slice_ptr.shape[0] - 1
+  size = row_len.shape[0] // num_slice
+  for slice_i in range(num_slice):
+    start = slice_ptr[slice_i]
+    row_0 = slice_i * size
+    for k in range((slice_ptr[slice_i + 1] - start) // size):
+      for lane in range(size):
+        j = start + k * size + lane
+        out[row_0 + lane] = out[row_0 + lane] + ti.select(k < row_len[row_0 + lane],
+                                                          ti.select(events[indices[j]], value, 0.), 0.)
+
+
+@ti.kernel
+def _event_sell_matvec_heter_cpu(values: ti.types.ndarray(ndim=1),
+                                 indices: ti.types.ndarray(ndim=1),
+                                 slice_ptr: ti.types.ndarray(ndim=1),
+                                 row_len: ti.types.ndarray(ndim=1),
+                                 events: ti.types.ndarray(ndim=1),
+                                 out: ti.types.ndarray(ndim=1)):
+  for row_i in range(out.shape[0]):
+    out[row_i] = 0.
+  num_slice = slice_ptr.shape[0] - 1
+  size = row_len.shape[0] // num_slice
+  for slice_i in range(num_slice):
+    start = slice_ptr[slice_i]
+    row_0 = slice_i * size
+    for k in range((slice_ptr[slice_i + 1] - start) // size):
+      for lane in range(size):
+        j = start + k * size + lane
+        out[row_0 + lane] = out[row_0 + lane] + ti.select(events[indices[j]], values[j], 0.)
+
+
+@ti.kernel
+def _event_sell_matvec_transpose_homo_cpu(values: ti.types.ndarray(ndim=1),
+                                          indices: ti.types.ndarray(ndim=1),
+                                          slice_ptr: ti.types.ndarray(ndim=1),
+                                          row_len: ti.types.ndarray(ndim=1),
+                                          events: ti.types.ndarray(ndim=1),
+                                          out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  value = values[0]
+  num_slice = slice_ptr.shape[0] - 1
+  size = row_len.shape[0] // num_slice
+  ti.loop_config(serialize=True)
+  for slice_i in range(num_slice):
+    start = slice_ptr[slice_i]
+    row_0 = slice_i * size
+    for lane in range(size):
+      if events[row_0 + lane]:
+        for k in range(row_len[row_0 + lane]):
+          out[indices[start + k * size + lane]] += value
+
+
+@ti.kernel
+def _event_sell_matvec_transpose_heter_cpu(values: ti.types.ndarray(ndim=1),
+                                           indices: ti.types.ndarray(ndim=1),
+                                           slice_ptr: ti.types.ndarray(ndim=1),
+                                           row_len: ti.types.ndarray(ndim=1),
+                                           events: ti.types.ndarray(ndim=1),
+                                           out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  num_slice = slice_ptr.shape[0] - 1
+  size = row_len.shape[0] // num_slice
+  ti.loop_config(serialize=True)
+  for slice_i in range(num_slice):
+    start = slice_ptr[slice_i]
+    row_0 = slice_i * size
+    for lane in range(size):
+      if events[row_0 + lane]:
+        for k in range(row_len[row_0 + lane]):
+          j = start + k * size + lane
+          out[indices[j]] += values[j]
+
+
+@ti.kernel
+def _event_sell_matvec_transpose_homo_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                                 indices: ti.types.ndarray(ndim=1),
+                                                 slice_ptr: ti.types.ndarray(ndim=1),
+                                                 row_len: ti.types.ndarray(ndim=1),
+                                                 events: ti.types.ndarray(ndim=1),
+                                                 out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  value = values[0]
+  num_slice = slice_ptr.shape[0] - 1
+  size = row_len.shape[0] // num_slice
+  for slice_i in range(num_slice):
+    start = slice_ptr[slice_i]
+    row_0 = slice_i * size
+    for lane in range(size):
+      if events[row_0 + lane]:
+        for k in range(row_len[row_0 + lane]):
+          out[indices[start + k * size + lane]] += value
+
+
+@ti.kernel
+def _event_sell_matvec_transpose_heter_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                                  indices: ti.types.ndarray(ndim=1),
+                                                  slice_ptr: ti.types.ndarray(ndim=1),
+                                                  row_len: ti.types.ndarray(ndim=1),
+                                                  events: ti.types.ndarray(ndim=1),
+                                                  out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  num_slice = slice_ptr.shape[0] - 1
+  size = row_len.shape[0] // num_slice
+  for slice_i in range(num_slice):
+    start = slice_ptr[slice_i]
+    row_0 = slice_i * size
+    for lane in range(size):
+      if events[row_0 + lane]:
+        for k in range(row_len[row_0 + lane]):
+          j = start + k * size + lane
+          out[indices[j]] += values[j]
+
+
+# -------------
+# GPU operators
+# -------------
+# A thread computes a row, see "_sparse_sellmv.py".
+
+@ti.kernel
+def _event_sell_matvec_homo_gpu(values: ti.types.ndarray(ndim=1),
+                                indices: ti.types.ndarray(ndim=1),
+                                slice_ptr: ti.types.ndarray(ndim=1),
+                                row_len: ti.types.ndarray(ndim=1),
+                                events: ti.types.ndarray(ndim=1),
+                                out: ti.types.ndarray(ndim=1)):
+  value = values[0]
+  num_row = row_len.shape[0]
+  size = num_row // (slice_ptr.shape[0] - 1)
+  for row_i in range(num_row):
+    j = slice_ptr[row_i // size] + row_i % size
+    r = 0.
+    for k in range(row_len[row_i]):
+      if events[indices[j]]:
+        r += value
+      j += size
+    out[row_i] = r
+
+
+@ti.kernel
+def _event_sell_matvec_heter_gpu(values: ti.types.ndarray(ndim=1),
+                                 indices: ti.types.ndarray(ndim=1),
+                                 slice_ptr: ti.types.ndarray(ndim=1),
+                                 row_len: ti.types.ndarray(ndim=1),
+                                 events: ti.types.ndarray(ndim=1),
+                                 out: ti.types.ndarray(ndim=1)):
+  num_row = row_len.shape[0]
+  size = num_row // (slice_ptr.shape[0] - 1)
+  for row_i in range(num_row):
+    j = slice_ptr[row_i // size] + row_i % size
+    r = 0.
+    for k in range(row_len[row_i]):
+      if events[indices[j]]:
+        r += values[j]
+      j += size
+    out[row_i] = r
+
+
+@ti.kernel
+def _event_sell_matvec_transpose_homo_gpu(values: ti.types.ndarray(ndim=1),
+                                          indices: ti.types.ndarray(ndim=1),
+                                          slice_ptr: ti.types.ndarray(ndim=1),
+                                          row_len: ti.types.ndarray(ndim=1),
+                                          events: ti.types.ndarray(ndim=1),
+                                          out: ti.types.ndarray(ndim=1)):
+  value = values[0]
+  num_row = row_len.shape[0]
+  size = num_row // (slice_ptr.shape[0] - 1)
+  for row_i in range(num_row):
+    if events[row_i]:
+      j = slice_ptr[row_i // size] + row_i % size
+      for k in range(row_len[row_i]):
+        out[indices[j]] += value
+        j += size
+
+
+@ti.kernel
+def _event_sell_matvec_transpose_heter_gpu(values: ti.types.ndarray(ndim=1),
+                                           indices: ti.types.ndarray(ndim=1),
+                                           slice_ptr: ti.types.ndarray(ndim=1),
+                                           row_len: ti.types.ndarray(ndim=1),
+                                           events: ti.types.ndarray(ndim=1),
+                                           out: ti.types.ndarray(ndim=1)):
+  num_row = row_len.shape[0]
+  size = num_row // (slice_ptr.shape[0] - 1)
+  for row_i in range(num_row):
+    if events[row_i]:
+      j = slice_ptr[row_i // size] + row_i % size
+      for k in range(row_len[row_i]):
+        out[indices[j]] += values[j]
+        j += size
+
+
+def _event_sell_matvec_jvp_values(val_dot, values, indices, slice_ptr, row_len, events, *, outs, transpose):
+  return event_sell_matvec(val_dot, indices, slice_ptr, row_len, events, transpose=transpose,
+                           num_out=outs[0].shape[0])
+
+
+def _event_sell_matvec_transpose(ct, values, indices, slice_ptr, row_len, events, *, outs, transpose):
+  if any(ad.is_undefined_primal(x) for x in (indices, slice_ptr, row_len)):
+    raise ValueError("Cannot transpose with respect to sparse indices.")
+  if ad.is_undefined_primal(events):
+    raise ValueError("Cannot transpose with respect to the boolean events.")
+  if type(ct[0]) is ad.Zero:
+    ct_values = ad.Zero(values)
+  elif values.aval.shape[0] == 1:  # scalar
+    ct_values = event_sell_matvec(jnp.ones(1, dtype=ct[0].dtype), indices, slice_ptr, row_len, events,
+                                  transpose=transpose, num_out=ct[0].shape[0])[0]
+    ct_values = jnp.inner(ct[0], ct_values)
+  else:
+    rows, valid = sell_slots(slice_ptr, row_len, indices.shape[0])
+    mask = (events[rows] if transpose else events[indices]) & valid
+    ct_values = jnp.where(mask, ct[0][indices] if transpose else ct[0][rows], 0)
+  return ct_values, indices, slice_ptr, row_len, events
+
+
+def _event_sell_matvec_batched(values, indices, slice_ptr, row_len, matrix, *, outs, transpose):
+  return sell_matmat(values, indices, slice_ptr, row_len, matrix.astype(values.dtype),
+                     transpose=transpose, num_out=outs[0].shape[0])
+
+
+# The CPU kernels zero their output in a parallel loop before they accumulate the
+# slots of a slice into it, and the GPU kernels without transposition assign every
+# row of it, so that these need not be zeroed. The transposed GPU kernels scatter
+# into a zeroed output.
+_overwrite = ('overwrite',)
+_cpu_overwrite = {'cpu': ('overwrite',), 'gpu': ('zero',)}
+
+
+def _define_op(cpu_kernel, gpu_kernel, output_init=_cpu_overwrite):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=output_init)
+  prim.defjvp(_event_sell_matvec_jvp_values, None, None, None, None)
+  prim.def_transpose_rule(_event_sell_matvec_transpose)
+  register_vector_batching(prim.primitive, _event_sell_matvec_batched, 4)
+  return prim
+
+
+_event_sell_matvec_homo_p = _define_op(cpu_kernel=_event_sell_matvec_homo_cpu,
+                                       gpu_kernel=_event_sell_matvec_homo_gpu,
+                                       output_init=_overwrite)
+_event_sell_matvec_heter_p = _define_op(cpu_kernel=_event_sell_matvec_heter_cpu,
+                                        gpu_kernel=_event_sell_matvec_heter_gpu,
+                                        output_init=_overwrite)
+_event_sell_matvec_transpose_homo_p = _define_op(cpu_kernel=_event_sell_matvec_transpose_homo_cpu,
+                                                 gpu_kernel=_event_sell_matvec_transpose_homo_gpu)
+_event_sell_matvec_transpose_heter_p = _define_op(cpu_kernel=_event_sell_matvec_transpose_heter_cpu,
+                                                  gpu_kernel=_event_sell_matvec_transpose_heter_gpu)
+_event_sell_matvec_transpose_homo_atomic_p = _define_op(cpu_kernel=_event_sell_matvec_transpose_homo_atomic_cpu,
+                                                        gpu_kernel=_event_sell_matvec_transpose_homo_gpu)
+_event_sell_matvec_transpose_heter_atomic_p = _define_op(cpu_kernel=_event_sell_matvec_transpose_heter_atomic_cpu,
+                                                         gpu_kernel=_event_sell_matvec_transpose_heter_gpu)
@@ -14,22 +14,88 @@
 # ==============================================================================
 
 
-from typing import Union, Tuple
+from typing import Union, Tuple, Sequence, List
 
 import brainunit as u
 import jax
 import jax.numpy as jnp
 import numpy as np
 
+from braintaichi._sparseop._sparse_plan import CSRPlan
+from braintaichi._sparseop._sparse_sell import SELLIndices
+from braintaichi._sparseop._sparse_shard import ShardedCSR, sharded_matvec
+from braintaichi._sparseop._sparse_utils import _check_accumulate_state
+from ._event_accumulate import raw_event_csrmv_accumulate_taichi
 from ._event_csrmm import raw_event_csrmm_taichi
 from ._event_csrmv import raw_csrmv_taichi
+from ._event_grouped import raw_event_csrmv_grouped_taichi
+from ._event_packed import is_packed, num_words, raw_pack_events, raw_unpack_events
+from ._event_sellmv import raw_event_sellmv_taichi
 
 __all__ = [
   'event_csrmv',
+  'event_csrmv_accumulate',
   'event_csrmm',
+  'event_csrmv_grouped',
+  'event_sellmv',
+  'pack_events',
+  'unpack_events',
 ]
 
 
+def pack_events(
+    events: jax.typing.ArrayLike,
+    dtype=jnp.uint32,
+) -> jax.Array:
+  """Pack the events into the bits of ``uint32`` or ``uint64`` words.
+
+  The event ``i`` is stored in the bit ``i % bits`` of the word ``i // bits``,
+  where ``bits`` is the width of ``dtype``. The packed events can be given to
+  :func:`event_csrmv`, :func:`event_csrmm` and the ``jitc_event_mv_prob_*``
+  operators in place of the boolean events. They take 8x less memory, and the
+  operators skip whole words of silent neurons.
+
+  Parameters
+  ----------
+  events: ndarray
+    A vector of events, or a matrix of events which is packed along its first
+    axis. Nonzero values are events.
+  dtype: dtype
+    ``jnp.uint32`` or ``jnp.uint64``. ``jnp.uint64`` requires ``jax_enable_x64``.
+
+  Returns
+  -------
+  words : Array
+    The array of shape ``(ceil(n / bits),) + events.shape[1:]``, whose padding
+    bits are zero.
+  """
+  return raw_pack_events(jnp.asarray(events), dtype)
+
+
+def unpack_events(
+    words: jax.typing.ArrayLike,
+    num: int,
+) -> jax.Array:
+  """Unpack the events packed by :func:`pack_events`.
+
+  Parameters
+  ----------
+  words: ndarray
+    The ``uint32`` or ``uint64`` words of the packed events.
+  num: int
+    The number of events.
+
+  Returns
+  -------
+  events : Array
+    The boolean array of shape ``(num,) + words.shape[1:]``.
+  """
+  words = jnp.asarray(words)
+  if not is_packed(words):
+    raise ValueError(f'Packed events should be uint32 or uint64 words, but got {words.dtype}.')
+  return raw_unpack_events(words, num)
+
+
 def event_csrmm(
     data: Union[jax.typing.ArrayLike, u.Quantity],
     indices: jax.typing.ArrayLike,
@@ -43,10 +109,11 @@ def event_csrmm(
 
   Args:
       data : array of shape ``(nse,)``, float.
-      indices : array of shape ``(nse,)``
+      indices : array of shape ``(nse,)``, its compressed form, see
+                :func:`compress_indices`, or its plan, see :func:`csr_plan`
       indptr : array of shape ``(shape[0] + 1,)`` and dtype ``indices.dtype``
       matrix : array of shape ``(shape[0] if transpose else shape[1], cols)`` and
-               dtype ``data.dtype``
+               dtype ``data.dtype``, or its packed words, see :func:`pack_events`
       shape : length-2 tuple representing the matrix shape
       transpose : boolean specifying whether to transpose the sparse matrix
                   before computing.
@@ -76,13 +143,17 @@ def event_csrmv(
   ----------
   data: ndarray, float
     An array of shape ``(nse,)``.
-  indices: ndarray
-    An array of shape ``(nse,)``.
+  indices: ndarray, CompressedIndices, CSRPlan, ShardedCSR
+    An array of shape ``(nse,)``, its compressed form, see
+    :func:`compress_indices`, its plan, see :func:`csr_plan`, or its rows
+    split over devices, see :func:`csr_shard`.
   indptr: ndarray
     An array of shape ``(shape[0] + 1,)`` and dtype ``indices.dtype``.
+    It is not read with a plan or a sharded matrix.
   events: ndarray
     An array of shape ``(shape[0] if transpose else shape[1],)``
-    and dtype ``data.dtype``.
+    and dtype ``data.dtype``, or its packed ``uint32`` or ``uint64``
+    words, see :func:`pack_events`.
   shape: tuple
     A length-2 tuple representing the matrix shape.
   transpose: bool
@@ -97,8 +168,26 @@ def event_csrmv(
     The array of shape ``(shape[1] if transpose else shape[0],)`` representing
     the matrix vector product.
   """
-  # checking
+  if isinstance(indices, ShardedCSR):
+    # the packed words are not split along the rows of the blocks
+    if transpose and is_packed(events):
+      events = raw_unpack_events(events, shape[0])
+    return sharded_matvec(event_csrmv, data, indices, events, shape=shape, transpose=transpose)
+
+  data, indptr = _check_event_csrmv(data, indices, indptr, events, shape=shape, transpose=transpose)
+
+  # if the shape of indices is (0,), then we return a zero vector
+  if indices.shape[0] == 0:
+    return jnp.zeros(shape[1] if transpose else shape[0], dtype=data.dtype)
+
+  return raw_csrmv_taichi(data, indices, indptr, events, shape=shape, transpose=transpose)[0]
+
+
+def _check_event_csrmv(data, indices, indptr, events, *, shape, transpose):
   data = jnp.atleast_1d(data)
+  # a plan has its own row pointers
+  if isinstance(indices, CSRPlan):
+    indptr = indices.indptr
   if np.ndim(data) == 1:
     if data.shape[0] not in [1, indices.shape[0]]:
       raise ValueError('The size of data should be 1 or be consistent with indices.'
@@ -120,15 +209,233 @@ def event_csrmv(
     raise ValueError('events should be a 1D vector.')
   if len(shape) != 2:
     raise ValueError('shape should be a length-2 tuple.')
-  if transpose:
+  num_event = shape[0] if transpose else shape[1]
+  if is_packed(events):
+    if events.shape[0] != num_words(num_event, events.dtype):
+      raise ValueError(f'Shape mismatch, {num_event} packed events need {num_words(num_event, events.dtype)} '
+                       f'words, but got {events.shape[0]}.')
+  elif transpose:
     if events.shape[0] != shape[0]:
       raise ValueError(f'Shape mismatch, vec ({events.shape[0]},) @ mat {shape}.')
   else:
     if events.shape[0] != shape[1]:
       raise ValueError(f'Shape mismatch, mat {shape} @ vec ({events.shape[0]},).')
 
-  # if the shape of indices is (0,), then we return a zero vector
+  return data, indptr
+
+
+def event_csrmv_accumulate(
+    state: jax.Array,
+    data: Union[jax.typing.ArrayLike, u.Quantity],
+    indices: jax.Array,
+    indptr: jax.Array,
+    events: jax.Array,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    alpha: Union[float, jax.typing.ArrayLike] = 1.,
+    beta: Union[float, jax.typing.ArrayLike] = 1.,
+) -> jax.Array:
+  """Accumulate the product of a sparse CSR matrix and a dense event vector into a state.
+
+  It computes ``alpha * state + beta * event_csrmv(data, indices, indptr, events)``
+  in one kernel, which writes the result into the buffer of ``state`` through
+  XLA input/output aliasing. For instance, the decay and the input of a synaptic
+  conductance ``g = g * decay + event_csrmv(...)`` become one pass over ``g``,
+  without zeroing or allocating an output. To update the buffer in place rather
+  than a copy of it, ``state`` should be donated to the jitted function, such as
+  with ``jax.jit(..., donate_argnums=...)``, or be carried by a loop.
+
+  This function supports JAX transformations, including `jit()`, `grad()`,
+  `vmap()` and `pmap()`.
+
+  Parameters
+  ----------
+  state: ndarray
+    An array of shape ``(shape[1] if transpose else shape[0],)`` and dtype
+    ``data.dtype``, or ``float32`` for 16-bit values.
+  data: ndarray, float
+    An array of shape ``(nse,)`` or ``(1,)``.
+  indices: ndarray, CompressedIndices, CSRPlan
+    An array of shape ``(nse,)``, its compressed form, see
+    :func:`compress_indices`, or its plan, see :func:`csr_plan`.
+  indptr: ndarray
+    An array of shape ``(shape[0] + 1,)`` and dtype ``indices.dtype``.
+    It is not read with a plan.
+  events: ndarray
+    An array of shape ``(shape[0] if transpose else shape[1],)``, or its
+    packed ``uint32`` or ``uint64`` words, see :func:`pack_events`.
+  shape: tuple
+    A length-2 tuple representing the matrix shape.
+  transpose: bool
+    A boolean specifying whether to transpose the sparse matrix
+    before computing.
+  alpha: float, ndarray
+    The scale of the state.
+  beta: float, ndarray
+    The scale of the product.
+
+  Returns
+  -------
+  y : Array
+    The array ``alpha * state + beta * (A @ events)`` of the shape and dtype of ``state``.
+  """
+  data, indptr = _check_event_csrmv(data, indices, indptr, events, shape=shape, transpose=transpose)
+  state = jnp.asarray(state)
+  _check_accumulate_state(state, data, shape=shape, transpose=transpose)
+  alpha = jnp.reshape(jnp.asarray(alpha, dtype=state.dtype), (1,))
+  beta = jnp.reshape(jnp.asarray(beta, dtype=state.dtype), (1,))
+
+  # without non-zeros, only the state is scaled
+  if indices.shape[0] == 0:
+    return alpha[0] * state
+
+  return raw_event_csrmv_accumulate_taichi(state, alpha, beta, data, indices, indptr, events,
+                                           shape=shape, transpose=transpose)[0]
+
+
+def event_csrmv_grouped(
+    data: Sequence[Union[jax.typing.ArrayLike, u.Quantity]],
+    indices: Sequence[jax.Array],
+    indptr: Sequence[jax.Array],
+    events: jax.Array,
+    *,
+    shapes: Sequence[Tuple[int, int]],
+    transpose: bool = False,
+) -> List[jax.Array]:
+  """Products of several sparse CSR matrices and the same dense event vector.
+
+  It computes ``[event_csrmv(data[k], indices[k], indptr[k], events, shape=shapes[k],
+  transpose=transpose) for k in range(len(shapes))]`` in a single launch, such as the
+  projections of the same presynaptic neurons onto several targets. With
+  ``transpose=True``, the rows with events are found once, and each of them is
+  scattered into all the projections. Without, the rows of the projections are
+  stacked into one matrix.
+
+  This function supports JAX transformations, including `jit()`, `grad()`,
+  `vmap()` and `pmap()`.
+
+  Parameters
+  ----------
+  data: sequence of ndarray
+    The values of each projection, of shape ``(nse,)`` or ``(1,)``. They are
+    concatenated at each call, unless all of them are of shape ``(1,)``.
+  indices: sequence of ndarray
+    The column indices of each projection, of shape ``(nse,)``.
+  indptr: sequence of ndarray
+    The row pointers of each projection, of shape ``(shapes[k][0] + 1,)``.
+  events: ndarray
+    An array of shape ``(shapes[k][0] if transpose else shapes[k][1],)``,
+    the same for all the projections, or its packed ``uint32`` or ``uint64``
+    words, see :func:`pack_events`.
+  shapes: sequence of tuple
+    The shape of each projection.
+  transpose: bool
+    A boolean specifying whether to transpose the sparse matrices
+    before computing.
+
+  Returns
+  -------
+  ys : list of Array
+    The product of each projection, of shape
+    ``(shapes[k][1] if transpose else shapes[k][0],)``.
+  """
+  data = [jnp.atleast_1d(d) for d in data]
+  indices = [jnp.asarray(ind) for ind in indices]
+  indptr = [jnp.asarray(ptr) for ptr in indptr]
+  if not (len(data) == len(indices) == len(indptr) == len(shapes)) or len(shapes) == 0:
+    raise ValueError('data, indices, indptr and shapes should describe the same, non-zero '
+                     f'number of projections, but got {len(data)}, {len(indices)}, {len(indptr)} '
+                     f'and {len(shapes)}.')
+  num_event = shapes[0][0] if transpose else shapes[0][1]
+  for d, ind, ptr, shape in zip(data, indices, indptr, shapes):
+    if (ind.ndim != 1 or ptr.ndim != 1 or not jnp.issubdtype(ind.dtype, jnp.integer)
+        or not jnp.issubdtype(ptr.dtype, jnp.integer)):
+      raise ValueError('The indices and indptr of the projections should be 1D integer arrays.')
+    if np.ndim(d) != 1 or d.shape[0] not in [1, ind.shape[0]]:
+      raise ValueError('The size of data should be 1 or be consistent with indices.'
+                       f'But we got {d.shape} != {ind.shape}, {d.shape} != 1.')
+    if ptr.shape[0] != shape[0] + 1:
+      raise ValueError(f'indptr should be of shape ({shape[0] + 1},), but got {ptr.shape}.')
+    if (shape[0] if transpose else shape[1]) != num_event:
+      raise ValueError(f'The projections should share their {"rows" if transpose else "columns"}, '
+                       f'but got the shapes {shapes}.')
+  if np.ndim(events) != 1:
+    raise ValueError('events should be a 1D vector.')
+  if is_packed(events):
+    if events.shape[0] != num_words(num_event, events.dtype):
+      raise ValueError(f'Shape mismatch, {num_event} packed events need {num_words(num_event, events.dtype)} '
+                       f'words, but got {events.shape[0]}.')
+  elif events.shape[0] != num_event:
+    raise ValueError(f'Shape mismatch, the events ({events.shape[0]},) with the matrices {shapes} '
+                     f'and transpose={transpose}.')
+
+  return raw_event_csrmv_grouped_taichi(data, indices, indptr, events,
+                                        shapes=[tuple(s) for s in shapes], transpose=transpose)
+
+
+def event_sellmv(
+    data: Union[jax.typing.ArrayLike, u.Quantity],
+    indices: SELLIndices,
+    events: jax.Array,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+) -> jax.Array:
+  """Product of a sparse matrix in the sliced ELLPACK format and a dense event vector.
+
+  The ``C`` rows of each slice are computed in lockstep, see :func:`csr_to_sell`.
+
+  This function supports JAX transformations, including `jit()`, `grad()`,
+  `vmap()` and `pmap()`.
+
+  Parameters
+  ----------
+  data: ndarray, float
+    An array of shape ``(num_slot,)`` in the order of ``indices``, see
+    :func:`sell_values`, or of shape ``(1,)``.
+  indices: SELLIndices
+    The structure of the matrix, see :func:`csr_to_sell`.
+  events: ndarray
+    An array of shape ``(shape[0] if transpose else shape[1],)``
+    and dtype ``data.dtype``, or its packed ``uint32`` or ``uint64``
+    words, see :func:`pack_events`.
+  shape: tuple
+    A length-2 tuple representing the matrix shape.
+  transpose: bool
+    A boolean specifying whether to transpose the sparse matrix
+    before computing.
+    If ``transpose=True``, the operator will compute based on the
+    event-driven property of the ``events`` vector.
+
+  Returns
+  -------
+  y : Array
+    The array of shape ``(shape[1] if transpose else shape[0],)`` representing
+    the matrix vector product.
+  """
+  # checking
+  data = jnp.atleast_1d(data)
+  if not isinstance(indices, SELLIndices):
+    raise TypeError(f'indices should be built by "csr_to_sell", but got {type(indices)}.')
+  if np.ndim(data) != 1 or data.shape[0] not in [1, indices.shape[0]]:
+    raise ValueError('The size of data should be 1 or be consistent with indices. '
+                     f'But we got {data.shape} != {indices.shape}.')
+  if np.ndim(events) != 1:
+    raise ValueError('events should be a 1D vector.')
+  if len(shape) != 2:
+    raise ValueError('shape should be a length-2 tuple.')
+  num_event = shape[0] if transpose else shape[1]
+  if is_packed(events):
+    if events.shape[0] != num_words(num_event, events.dtype):
+      raise ValueError(f'Shape mismatch, {num_event} packed events need {num_words(num_event, events.dtype)} '
+                       f'words, but got {events.shape[0]}.')
+  elif events.shape[0] != num_event:
+    raise ValueError(f'Shape mismatch, the events ({events.shape[0]},) with the matrix {shape} '
+                     f'and transpose={transpose}.')
+
+  # without non-zeros, return a zero vector
   if indices.shape[0] == 0:
     return jnp.zeros(shape[1] if transpose else shape[0], dtype=data.dtype)
 
-  return raw_csrmv_taichi(data, indices, indptr, events, shape=shape, transpose=transpose)[0]
+  return raw_event_sellmv_taichi(data, indices, events, shape=shape, transpose=transpose)[0]
@@ -0,0 +1,732 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+# Products of the just-in-time connectivity with a dense matrix. Column ``b`` of
+# the result is the matrix-vector product of ``_jit_csrmv.py`` with column ``b``
+# of the matrix, so the kernels below generate the same random connectivity as
+# their matrix-vector counterparts, but walk it once for all the columns.
+
+from typing import Tuple
+
+import jax
+import taichi as ti
+from jax import numpy as jnp
+from jax.interpreters import ad
+
+from braintaichi._misc import _get_dtype
+from braintaichi._primitive._batch_utils import register_vector_batching
+from braintaichi._primitive._xla_custom_op import XLACustomOp
+from ._jit_csrmv import (_reverse,
+                         _cpu_overwrite,
+                         _mv_prob_homo_p,
+                         _mv_prob_uniform_p,
+                         _mv_prob_uniform_outdim_parallel_p,
+                         _mv_prob_normal_p,
+                         _mv_prob_normal_outdim_parallel_p)
+from ._taichi_rand import (lfsr88_key, lfsr88_random_integers, lfsr88_uniform, lfsr88_normal)
+
+# the number of matrix columns of each parallel task of the CPU kernels
+_mm_col_tile = 32
+
+
+def raw_mm_prob_homo(
+    matrix: jax.Array,
+    weight: jax.Array,  # vector with size 1
+    clen: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  mat_shape, out_shape = _non_event_mm_checking(matrix, clen, seed, shape, outdim_parallel, transpose, weight)
+
+  if outdim_parallel:
+    prim = _mm_prob_homo_outdim_parallel_p
+  else:
+    prim = _mm_prob_homo_p
+
+  return prim(matrix,
+              weight,
+              clen.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=matrix.dtype)],
+              shape=mat_shape,
+              transpose=transpose,
+              outdim_parallel=outdim_parallel)
+
+
+def raw_mm_prob_uniform(
+    matrix: jax.Array,
+    w_low: jax.Array,
+    w_high: jax.Array,
+    conn_len: jax.Array,
+    seed: jax.Array,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  mat_shape, out_shape = _non_event_mm_checking(matrix, conn_len, seed, shape, outdim_parallel, transpose, w_low, w_high)
+
+  if outdim_parallel:
+    prim = _mm_prob_uniform_outdim_parallel_p
+  else:
+    prim = _mm_prob_uniform_p
+
+  return prim(matrix,
+              w_low,
+              w_high,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=matrix.dtype)],
+              shape=mat_shape,
+              transpose=transpose,
+              outdim_parallel=outdim_parallel)
+
+
+def raw_mm_prob_normal(
+    matrix: jax.Array,
+    w_mu: jax.Array,
+    w_sigma: jax.Array,
+    conn_len: jax.Array,
+    seed: jax.Array,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  mat_shape, out_shape = _non_event_mm_checking(matrix, conn_len, seed, shape, outdim_parallel, transpose, w_mu, w_sigma)
+
+  if outdim_parallel:
+    prim = _mm_prob_normal_outdim_parallel_p
+  else:
+    prim = _mm_prob_normal_p
+
+  return prim(matrix,
+              w_mu,
+              w_sigma,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=matrix.dtype)],
+              shape=mat_shape,
+              transpose=transpose,
+              outdim_parallel=outdim_parallel)
+
+
+def _general_mm_checking(matrix, clen, seed, shape, outdim_parallel, transpose, *weights):
+  if matrix.ndim != 2:
+    raise ValueError('matrix should be a 2D matrix.')
+  if len(shape) != 2:
+    raise ValueError('shape should be a length-2 tuple.')
+  if seed.ndim != 1:
+    raise ValueError('seed must be a 1D scalar.')
+  if clen.ndim != 1:
+    raise ValueError('conn_prob must be a 1D scalar.')
+
+  assert _get_dtype(clen) in [jnp.int16, jnp.int32, jnp.int64, jnp.uint16, jnp.uint32, jnp.uint64]
+  assert _get_dtype(seed) in [jnp.int16, jnp.int32, jnp.int64, jnp.uint16, jnp.uint32, jnp.uint64]
+
+  for weight in weights:
+    if weight.ndim != 1:
+      raise ValueError('weight must be a 1D scalar.')
+    assert _get_dtype(weight) in [jnp.float16, jnp.float32, jnp.float64], '"weight" must be float valued.'
+
+  if not isinstance(outdim_parallel, bool):
+    raise ValueError('outdim_parallel must be boolean value.')
+  if not isinstance(transpose, bool):
+    raise ValueError('transpose must be boolean value.')
+
+  if transpose:
+    out_shape = (shape[1], matrix.shape[1])
+    if matrix.shape[0] != shape[0]:
+      raise ValueError(f'Shape mismatch, mat {matrix.shape} @ mat {shape}.')
+    shape = _reverse(shape)
+  else:
+    if matrix.shape[0] != shape[1]:
+      raise ValueError(f'Shape mismatch, mat {shape} @ mat {matrix.shape}.')
+    out_shape = (shape[0], matrix.shape[1])
+
+  return shape, out_shape
+
+
+def _non_event_mm_checking(matrix, clen, seed, shape, outdim_parallel, transpose, *weights):
+  assert _get_dtype(matrix) in [jnp.float16, jnp.float32, jnp.float64]
+  return _general_mm_checking(matrix, clen, seed, shape, outdim_parallel, transpose, *weights)
+
+
+# -------------
+# CPU function
+# -------------
+# The columns of the matrix are split into tiles. Each (row, tile) pair generates
+# the random connectivity of its row once and applies it to all the columns of the
+# tile, whose elements are contiguous in memory.
+#
+# -------------
+# GPU function
+# -------------
+# The same warp-based generation as the matrix-vector GPU kernels, applied to all
+# the columns of the matrix.
+
+@ti.kernel
+def _mm_prob_homo_cpu(
+    matrix: ti.types.ndarray(ndim=2),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=2)
+):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = out.shape[0]
+  num_col = matrix.shape[0]
+  num_batch = out.shape[1]
+  weight0 = weight[0]
+  num_tile = (num_batch + _mm_col_tile - 1) // _mm_col_tile
+
+  for i_col, i_tile in ti.ndrange(num_col, num_tile):
+    end_b = ti.min((i_tile + 1) * _mm_col_tile, num_batch)
+    key = lfsr88_key(seed + i_col)
+    key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+    while i_row < num_row:
+      for b in range(i_tile * _mm_col_tile, end_b):
+        out[i_row, b] += matrix[i_col, b] * weight0
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_row += inc
+
+
+@ti.kernel
+def _mm_prob_homo_outdim_parallel_cpu(
+    matrix: ti.types.ndarray(ndim=2),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=2)
+):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = out.shape[0]
+  num_col = matrix.shape[0]
+  num_batch = out.shape[1]
+  weight0 = weight[0]
+  num_tile = (num_batch + _mm_col_tile - 1) // _mm_col_tile
+
+  for i_row, i_tile in ti.ndrange(num_row, num_tile):
+    end_b = ti.min((i_tile + 1) * _mm_col_tile, num_batch)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      for b in range(i_tile * _mm_col_tile, end_b):
+        out[i_row, b] = out[i_row, b] + matrix[i_col, b]
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+    for b in range(i_tile * _mm_col_tile, end_b):
+      out[i_row, b] = out[i_row, b] * weight0
+
+
+@ti.kernel
+def _mm_prob_homo_gpu(
+    matrix: ti.types.ndarray(ndim=2),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=2)
+):
+  num_row = out.shape[0]
+  num_col = matrix.shape[0]
+  num_batch = out.shape[1]
+  weight0 = weight[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_col * 32):
+    i_col = i >> 5
+    index = i & 31
+    i_row = step * index - 1
+    end = ti.min(i_row + step, num_row)
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_row += inc
+    while i_row < end:
+      for b in range(num_batch):
+        out[i_row, b] += weight0 * matrix[i_col, b]
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_row += inc
+
+
+@ti.kernel
+def _mm_prob_homo_outdim_parallel_gpu(
+    matrix: ti.types.ndarray(ndim=2),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=2)
+):
+  num_row = out.shape[0]
+  num_col = matrix.shape[0]
+  num_batch = out.shape[1]
+  weight0 = weight[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.u32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_row * 32):
+    i_row = i >> 5
+    i_thread = i & 31
+    i_col = step * i_thread - 1
+    end_col = ti.min(i_col + step, num_col)
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_col += inc
+    while i_col < end_col:
+      for b in range(num_batch):
+        out[i_row, b] += weight0 * matrix[i_col, b]
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_col += inc
+
+
+@ti.kernel
+def _mm_prob_uniform_cpu(
+    matrix: ti.types.ndarray(ndim=2),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=2)
+):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = out.shape[0]
+  num_col = matrix.shape[0]
+  num_batch = out.shape[1]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  num_tile = (num_batch + _mm_col_tile - 1) // _mm_col_tile
+
+  for i_col, i_tile in ti.ndrange(num_col, num_tile):
+    end_b = ti.min((i_tile + 1) * _mm_col_tile, num_batch)
+    key = lfsr88_key(seed + i_col)
+    key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+    while i_row < num_row:
+      key, raw_v = lfsr88_uniform(key, w_min0, w_max0)
+      for b in range(i_tile * _mm_col_tile, end_b):
+        out[i_row, b] += matrix[i_col, b] * raw_v
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_row += inc
+
+
+@ti.kernel
+def _mm_prob_uniform_outdim_parallel_cpu(
+    matrix: ti.types.ndarray(ndim=2),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=2)
+):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = out.shape[0]
+  num_col = matrix.shape[0]
+  num_batch = out.shape[1]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  num_tile = (num_batch + _mm_col_tile - 1) // _mm_col_tile
+
+  for i_row, i_tile in ti.ndrange(num_row, num_tile):
+    end_b = ti.min((i_tile + 1) * _mm_col_tile, num_batch)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      key, raw_v = lfsr88_uniform(key, w_min0, w_max0)
+      for b in range(i_tile * _mm_col_tile, end_b):
+        out[i_row, b] = out[i_row, b] + matrix[i_col, b] * raw_v
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+
+
+@ti.kernel
+def _mm_prob_uniform_gpu(
+    matrix: ti.types.ndarray(ndim=2),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=2)
+):
+  num_row = out.shape[0]
+  num_col = matrix.shape[0]
+  num_batch = out.shape[1]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_col * 32):
+    i_col = i >> 5
+    index = i & 31
+    i_row = step * index - 1
+    end = ti.min(i_row + step, num_row)
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_row += inc
+    while i_row < end:
+      key, raw_v = lfsr88_uniform(key, w_min0, w_max0)
+      for b in range(num_batch):
+        out[i_row, b] += raw_v * matrix[i_col, b]
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_row += inc
+
+
+@ti.kernel
+def _mm_prob_uniform_outdim_parallel_gpu(
+    matrix: ti.types.ndarray(ndim=2),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=2)
+):
+  num_row = out.shape[0]
+  num_col = matrix.shape[0]
+  num_batch = out.shape[1]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.u32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_row * 32):
+    i_row = i >> 5
+    i_thread = i & 31
+    i_col = step * i_thread - 1
+    end_col = ti.min(i_col + step, num_col)
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_col += inc
+    while i_col < end_col:
+      key, raw_v = lfsr88_uniform(key, w_min0, w_max0)
+      for b in range(num_batch):
+        out[i_row, b] += matrix[i_col, b] * raw_v
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_col += inc
+
+
+@ti.kernel
+def _mm_prob_normal_cpu(
+    matrix: ti.types.ndarray(ndim=2),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=2)
+):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = out.shape[0]
+  num_col = matrix.shape[0]
+  num_batch = out.shape[1]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  num_tile = (num_batch + _mm_col_tile - 1) // _mm_col_tile
+
+  for i_col, i_tile in ti.ndrange(num_col, num_tile):
+    end_b = ti.min((i_tile + 1) * _mm_col_tile, num_batch)
+    key = lfsr88_key(seed + i_col)
+    key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+    while i_row < num_row:
+      key, raw_v = lfsr88_normal(key, w_mu0, w_sigma0)
+      for b in range(i_tile * _mm_col_tile, end_b):
+        out[i_row, b] += matrix[i_col, b] * raw_v
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_row += inc
+
+
+@ti.kernel
+def _mm_prob_normal_outdim_parallel_cpu(
+    matrix: ti.types.ndarray(ndim=2),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=2)
+):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = out.shape[0]
+  num_col = matrix.shape[0]
+  num_batch = out.shape[1]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  num_tile = (num_batch + _mm_col_tile - 1) // _mm_col_tile
+
+  for i_row, i_tile in ti.ndrange(num_row, num_tile):
+    end_b = ti.min((i_tile + 1) * _mm_col_tile, num_batch)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      key, raw_v = lfsr88_normal(key, w_mu0, w_sigma0)
+      for b in range(i_tile * _mm_col_tile, end_b):
+        out[i_row, b] = out[i_row, b] + matrix[i_col, b] * raw_v
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+
+
+@ti.kernel
+def _mm_prob_normal_gpu(
+    matrix: ti.types.ndarray(ndim=2),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=2)
+):
+  num_row = out.shape[0]
+  num_col = matrix.shape[0]
+  num_batch = out.shape[1]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_col * 32):
+    i_col = i >> 5
+    index = i & 31
+    i_row = step * index - 1
+    end = ti.min(i_row + step, num_row)
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_row += inc
+    while i_row < end:
+      key, raw_v = lfsr88_normal(key, w_mu0, w_sigma0)
+      for b in range(num_batch):
+        out[i_row, b] += raw_v * matrix[i_col, b]
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_row += inc
+
+
+@ti.kernel
+def _mm_prob_normal_outdim_parallel_gpu(
+    matrix: ti.types.ndarray(ndim=2),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=2)
+):
+  num_row = out.shape[0]
+  num_col = matrix.shape[0]
+  num_batch = out.shape[1]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.u32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_row * 32):
+    i_row = i >> 5
+    i_thread = i & 31
+    i_col = step * i_thread - 1
+    end_col = ti.min(i_col + step, num_col)
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_col += inc
+    while i_col < end_col:
+      key, raw_v = lfsr88_normal(key, w_mu0, w_sigma0)
+      for b in range(num_batch):
+        out[i_row, b] += matrix[i_col, b] * raw_v
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_col += inc
+
+
+def _mm_prob_homo_jvp_matrix(m_dot, matrix, weight, clen, seed, *, outs, shape, transpose, outdim_parallel):
+  shape = _reverse(shape) if transpose else shape
+  return raw_mm_prob_homo(m_dot, weight, clen, seed, shape=shape, transpose=transpose,
+                          outdim_parallel=outdim_parallel)
+
+
+def _mm_prob_homo_jvp_weight(raw_mm):
+  def jvp(w_dot, matrix, weight, clen, seed, *, outs, shape, transpose, outdim_parallel):
+    shape = _reverse(shape) if transpose else shape
+    return raw_mm(matrix, w_dot, clen, seed, shape=shape, transpose=transpose,
+                  outdim_parallel=outdim_parallel)
+
+  return jvp
+
+
+def _mm_prob_homo_transpose(raw_mm):
+  def transpose_rule(ct, matrix, weight, clen, seed, *, outs, shape, transpose, outdim_parallel):
+    assert type(clen) is not ad.UndefinedPrimal, 'Cannot differentiate through clen.'
+    assert type(seed) is not ad.UndefinedPrimal, 'Cannot differentiate through seed.'
+    shape = _reverse(shape) if transpose else shape
+    if ad.is_undefined_primal(matrix):
+      if type(ct[0]) is ad.Zero:
+        return ad.Zero(matrix), weight, clen, seed
+      dm = raw_mm_prob_homo(ct[0], weight, clen, seed, shape=shape,
+                            transpose=not transpose, outdim_parallel=not outdim_parallel)[0]
+      return dm, weight, clen, seed
+    else:
+      if type(ct[0]) is ad.Zero:
+        return matrix, ad.Zero(weight), clen, seed
+      r = raw_mm(matrix, jnp.ones(1, dtype=ct[0].dtype), clen, seed,
+                 shape=shape, transpose=transpose, outdim_parallel=outdim_parallel)[0]
+      return matrix, jnp.sum(r * ct[0], keepdims=True), clen, seed
+
+  return transpose_rule
+
+
+def _define_mm_prob_homo_prim(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_mm_prob_homo_jvp_matrix, _mm_prob_homo_jvp_weight(raw_mm_prob_homo), None, None)
+  prim.def_transpose_rule(_mm_prob_homo_transpose(raw_mm_prob_homo))
+  return prim
+
+
+# outdim_parallel = True
+_mm_prob_homo_outdim_parallel_p = _define_mm_prob_homo_prim(cpu_kernel=_mm_prob_homo_outdim_parallel_cpu,
+                                                            gpu_kernel=_mm_prob_homo_outdim_parallel_gpu)
+
+# outdim_parallel = False
+_mm_prob_homo_p = _define_mm_prob_homo_prim(cpu_kernel=_mm_prob_homo_cpu,
+                                            gpu_kernel=_mm_prob_homo_gpu)
+
+
+# The weights of the uniform and normal connectivity enter through
+# ``w_low + (w_high - w_low) * u`` and ``w_mu + w_sigma * z``, so the product is
+# linear in the two weights jointly, and the tangent of one of them is the product
+# with the other one set to zero.
+
+def _mm_prob_two_weights_jvp(raw_mm, i_weight):
+  def jvp(w_dot, matrix, w1, w2, clen, seed, *, outs, shape, transpose, outdim_parallel):
+    shape = _reverse(shape) if transpose else shape
+    weights = [jnp.zeros_like(w1), jnp.zeros_like(w2)]
+    weights[i_weight] = w_dot
+    return raw_mm(matrix, *weights, clen, seed, shape=shape, transpose=transpose,
+                  outdim_parallel=outdim_parallel)
+
+  return jvp
+
+
+def _mm_prob_two_weights_transpose(raw_mm):
+  def transpose_rule(ct, matrix, w1, w2, clen, seed, *, outs, shape, transpose, outdim_parallel):
+    assert type(clen) is not ad.UndefinedPrimal, 'Cannot differentiate through clen.'
+    assert type(seed) is not ad.UndefinedPrimal, 'Cannot differentiate through seed.'
+    shape = _reverse(shape) if transpose else shape
+    if ad.is_undefined_primal(matrix):
+      if type(ct[0]) is ad.Zero:
+        return ad.Zero(matrix), w1, w2, clen, seed
+      dm = raw_mm(ct[0], w1, w2, clen, seed, shape=shape,
+                  transpose=not transpose, outdim_parallel=not outdim_parallel)[0]
+      return dm, w1, w2, clen, seed
+    else:
+      weights = [w1, w2]
+      for i, w in enumerate(weights):
+        if ad.is_undefined_primal(w):
+          if type(ct[0]) is ad.Zero:
+            weights[i] = ad.Zero(w)
+          else:
+            unit = [jnp.zeros(1, dtype=ct[0].dtype), jnp.zeros(1, dtype=ct[0].dtype)]
+            unit[i] = jnp.ones(1, dtype=ct[0].dtype)
+            r = raw_mm(matrix, *unit, clen, seed, shape=shape, transpose=transpose,
+                       outdim_parallel=outdim_parallel)[0]
+            weights[i] = jnp.sum(r * ct[0], keepdims=True)
+      return matrix, *weights, clen, seed
+
+  return transpose_rule
+
+
+def _mm_prob_uniform_jvp_matrix(m_dot, matrix, w_low, w_high, clen, seed, *,
+                                outs, shape, transpose, outdim_parallel):
+  shape = _reverse(shape) if transpose else shape
+  return raw_mm_prob_uniform(m_dot, w_low, w_high, clen, seed, shape=shape,
+                             transpose=transpose, outdim_parallel=outdim_parallel)
+
+
+def _define_mm_prob_uniform_prim(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_mm_prob_uniform_jvp_matrix,
+              _mm_prob_two_weights_jvp(raw_mm_prob_uniform, 0),
+              _mm_prob_two_weights_jvp(raw_mm_prob_uniform, 1),
+              None,
+              None)
+  prim.def_transpose_rule(_mm_prob_two_weights_transpose(raw_mm_prob_uniform))
+  return prim
+
+
+# outdim_parallel = True
+_mm_prob_uniform_outdim_parallel_p = _define_mm_prob_uniform_prim(
+  cpu_kernel=_mm_prob_uniform_outdim_parallel_cpu,
+  gpu_kernel=_mm_prob_uniform_outdim_parallel_gpu
+)
+
+# outdim_parallel = False
+_mm_prob_uniform_p = _define_mm_prob_uniform_prim(
+  cpu_kernel=_mm_prob_uniform_cpu,
+  gpu_kernel=_mm_prob_uniform_gpu
+)
+
+
+def _mm_prob_normal_jvp_matrix(m_dot, matrix, w_mu, w_sigma, clen, seed, *,
+                               outs, shape, transpose, outdim_parallel):
+  shape = _reverse(shape) if transpose else shape
+  return raw_mm_prob_normal(m_dot, w_mu, w_sigma, clen, seed, shape=shape,
+                            transpose=transpose, outdim_parallel=outdim_parallel)
+
+
+def _define_mm_prob_normal_prim(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_mm_prob_normal_jvp_matrix,
+              _mm_prob_two_weights_jvp(raw_mm_prob_normal, 0),
+              _mm_prob_two_weights_jvp(raw_mm_prob_normal, 1),
+              None,
+              None)
+  prim.def_transpose_rule(_mm_prob_two_weights_transpose(raw_mm_prob_normal))
+  return prim
+
+
+# outdim_parallel = True
+_mm_prob_normal_outdim_parallel_p = _define_mm_prob_normal_prim(
+  cpu_kernel=_mm_prob_normal_outdim_parallel_cpu,
+  gpu_kernel=_mm_prob_normal_outdim_parallel_gpu
+)
+
+# outdim_parallel = False
+_mm_prob_normal_p = _define_mm_prob_normal_prim(
+  cpu_kernel=_mm_prob_normal_cpu,
+  gpu_kernel=_mm_prob_normal_gpu
+)
+
+
+# Batching rules of the matrix-vector operators: a batch of vectors is multiplied
+# as one matrix, instead of calling the matrix-vector kernel once per vector.
+
+def _mv_prob_batched(raw_mm):
+  def matmat(matrix, *args, outs, shape, transpose, outdim_parallel):
+    shape = _reverse(shape) if transpose else shape
+    return raw_mm(matrix, *args, shape=shape, transpose=transpose, outdim_parallel=outdim_parallel)[0]
+
+  return matmat
+
+
+register_vector_batching(_mv_prob_homo_p.primitive, _mv_prob_batched(raw_mm_prob_homo), 0)
+register_vector_batching(_mv_prob_uniform_p.primitive, _mv_prob_batched(raw_mm_prob_uniform), 0)
+register_vector_batching(_mv_prob_uniform_outdim_parallel_p.primitive, _mv_prob_batched(raw_mm_prob_uniform), 0)
+register_vector_batching(_mv_prob_normal_p.primitive, _mv_prob_batched(raw_mm_prob_normal), 0)
+register_vector_batching(_mv_prob_normal_outdim_parallel_p.primitive, _mv_prob_batched(raw_mm_prob_normal), 0)
@@ -206,19 +206,15 @@ def raw_mv_prob_homo(
 ) -> jax.Array:
   mat_shape, out_shape = _non_event_checking(vector, clen, seed, shape, outdim_parallel, transpose, weight)
 
-  if outdim_parallel:
-    prim = _mv_prob_homo_outdim_parallel_p
-  else:
-    prim = _mv_prob_homo_p
-
-  return prim(vector,
-              weight,
-              clen,
-              seed,
-              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=vector.dtype)],
-              shape=mat_shape,
-              transpose=transpose,
-              outdim_parallel=outdim_parallel)
+  # "clen" and "seed" are passed by value to the CPU kernel, and stay on the device for the GPU one
+  return _mv_prob_homo_p(vector,
+                         weight,
+                         clen.astype(jnp.int32),
+                         seed.astype(jnp.uint32),
+                         outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=vector.dtype)],
+                         shape=mat_shape,
+                         transpose=transpose,
+                         outdim_parallel=outdim_parallel)
 
 
 def raw_mv_prob_uniform(
@@ -242,8 +238,8 @@ def raw_mv_prob_uniform(
   return prim(vector,
               w_low,
               w_high,
-              conn_len,
-              seed,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
               outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=vector.dtype)],
               shape=mat_shape,
               transpose=transpose,
@@ -271,8 +267,8 @@ def raw_mv_prob_normal(
   return prim(vector,
               w_mu,
               w_sigma,
-              conn_len,
-              seed,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
               outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=vector.dtype)],
               shape=mat_shape,
               transpose=transpose,
@@ -459,49 +455,36 @@ def _reverse(shape):
 def _mv_prob_homo_cpu(
     vector: ti.types.ndarray(ndim=1),
     weight: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
-    out: ti.types.ndarray(ndim=1)
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1),
+    outdim_parallel: ti.template(),
 ):
   num_row = out.shape[0]
   num_col = vector.shape[0]
   weight0 = weight[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
-  for i_col in range(num_col):
-    key = lfsr88_key(seed0 + i_col)
-    key, i_row = lfsr88_random_integers(key, 0, clen0 - 1)
-    v = vector[i_col] * weight0
-    while i_row < num_row:
-      out[i_row] += v
-      key, inc = lfsr88_random_integers(key, 1, clen0)
-      i_row += inc
-
-
-@ti.kernel
-def _mv_prob_homo_outdim_parallel_cpu(
-    vector: ti.types.ndarray(ndim=1),
-    weight: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
-    out: ti.types.ndarray(ndim=1)
-):
-  num_row = out.shape[0]
-  num_col = vector.shape[0]
-  weight0 = weight[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
-
-  for i_row in range(num_row):
-    r = 0.
-    key = lfsr88_key(seed0 + i_row)
-    key, i_col = lfsr88_random_integers(key, 0, clen0 - 1)
-    while i_col < num_col:
-      r += vector[i_col]
-      key, inc = lfsr88_random_integers(key, 1, clen0)
-      i_col += inc
-    out[i_row] = r * weight0
+  if ti.static(outdim_parallel):
+    for i_row in range(num_row):
+      r = 0.
+      key = lfsr88_key(seed + i_row)
+      key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+      while i_col < num_col:
+        r += vector[i_col]
+        key, inc = lfsr88_random_integers(key, 1, clen)
+        i_col += inc
+      out[i_row] = r * weight0
+  else:
+    for i in range(out.shape[0]):
+      out[i] = 0.
+    for i_col in range(num_col):
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+      v = vector[i_col] * weight0
+      while i_row < num_row:
+        out[i_row] += v
+        key, inc = lfsr88_random_integers(key, 1, clen)
+        i_row += inc
 
 
 @ti.kernel
@@ -510,37 +493,8 @@ def _mv_prob_homo_gpu(
     weight: ti.types.ndarray(ndim=1),
     clen: ti.types.ndarray(ndim=1),
     seed: ti.types.ndarray(ndim=1),
-    out: ti.types.ndarray(ndim=1)
-):
-  num_row = out.shape[0]
-  num_col = vector.shape[0]
-  weight0 = weight[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
-  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
-
-  for i in range(num_col * 32):
-    i_col = i >> 5
-    index = i & 31
-    col_v = vector[i_col]
-    i_row = step * index - 1
-    end = ti.min(i_row + step, num_row)
-    key = lfsr88_key(seed0 + i)
-    key, inc = lfsr88_random_integers(key, 1, clen0)
-    i_row += inc
-    while i_row < end:
-      out[i_row] += weight0 * col_v
-      key, inc = lfsr88_random_integers(key, 1, clen0)
-      i_row += inc
-
-
-@ti.kernel
-def _mv_prob_homo_outdim_parallel_gpu(
-    vector: ti.types.ndarray(ndim=1),
-    weight: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
-    out: ti.types.ndarray(ndim=1)
+    out: ti.types.ndarray(ndim=1),
+    outdim_parallel: ti.template(),
 ):
   num_row = out.shape[0]
   num_col = vector.shape[0]
@@ -549,20 +503,35 @@ def _mv_prob_homo_outdim_parallel_gpu(
   seed0 = seed[0]
   step = ti.u32(ti.max((num_row + 1) >> 5, 1))
 
-  for i in range(num_row * 32):
-    i_row = i >> 5
-    i_thread = i & 31
-    i_col = step * i_thread - 1
-    end_col = ti.min(i_col + step, num_col)
-    r = 0.
-    key = lfsr88_key(seed0 + i)
-    key, inc = lfsr88_random_integers(key, 1, clen0)
-    i_col += inc
-    while i_col < end_col:
-      r += vector[i_col]
+  if ti.static(outdim_parallel):
+    for i in range(num_row * 32):
+      i_row = i >> 5
+      i_thread = i & 31
+      i_col = step * i_thread - 1
+      end_col = ti.min(i_col + step, num_col)
+      r = 0.
+      key = lfsr88_key(seed0 + i)
       key, inc = lfsr88_random_integers(key, 1, clen0)
       i_col += inc
-    out[i_row] += weight0 * r  # TODO: warp-level reduction
+      while i_col < end_col:
+        r += vector[i_col]
+        key, inc = lfsr88_random_integers(key, 1, clen0)
+        i_col += inc
+      out[i_row] += weight0 * r  # TODO: warp-level reduction
+  else:
+    for i in range(num_col * 32):
+      i_col = i >> 5
+      index = i & 31
+      col_v = vector[i_col]
+      i_row = step * index - 1
+      end = ti.min(i_row + step, num_row)
+      key = lfsr88_key(seed0 + i)
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_row += inc
+      while i_row < end:
+        out[i_row] += weight0 * col_v
+        key, inc = lfsr88_random_integers(key, 1, clen0)
+        i_row += inc
 
 
 def _mv_prob_homo_jvp_vector(v_dot, vector, weight, clen, seed, *, outs, shape, transpose, outdim_parallel):
@@ -577,18 +546,20 @@ def _mv_prob_homo_jvp_weight(w_dot, vector, weight, clen, seed, *, outs, shape,
                           outdim_parallel=outdim_parallel)
 
 
+# The CPU kernels assign every element of their output, or zero it in a parallel
+# loop before they scatter into it, so that it need not be zeroed. The GPU kernels
+# reduce into a zeroed output.
+_cpu_overwrite = {'cpu': ('overwrite',), 'gpu': ('zero',)}
+
+
 def _define_mv_prob_homo_prim(cpu_kernel, gpu_kernel):
-  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel)
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
   prim.defjvp(_mv_prob_homo_jvp_vector, _mv_prob_homo_jvp_weight, None, None)
   prim.def_transpose_rule(_mv_prob_homo_transpose)
   return prim
 
 
-# outdim_parallel = True
-_mv_prob_homo_outdim_parallel_p = _define_mv_prob_homo_prim(cpu_kernel=_mv_prob_homo_outdim_parallel_cpu,
-                                                            gpu_kernel=_mv_prob_homo_outdim_parallel_gpu)
-
-# outdim_parallel = False
+# one kernel for both values of outdim_parallel, which is a static parameter
 _mv_prob_homo_p = _define_mv_prob_homo_prim(cpu_kernel=_mv_prob_homo_cpu,
                                             gpu_kernel=_mv_prob_homo_gpu)
 
@@ -598,25 +569,25 @@ def _mv_prob_uniform_cpu(
     vector: ti.types.ndarray(ndim=1),
     w_min: ti.types.ndarray(ndim=1),
     w_max: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
+  for i in range(out.shape[0]):
+    out[i] = 0.
   num_row = out.shape[0]
   num_col = vector.shape[0]
   w_min0 = w_min[0]
   w_max0 = w_max[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_col in range(num_col):
     col_v = vector[i_col]
-    key = lfsr88_key(seed0 + i_col)
-    key, i_row = lfsr88_random_integers(key, 0, clen0 - 1)
+    key = lfsr88_key(seed + i_col)
+    key, i_row = lfsr88_random_integers(key, 0, clen - 1)
     while i_row < num_row:
       key, raw_v = lfsr88_uniform(key, w_min0, w_max0)
       out[i_row] += col_v * raw_v
-      key, inc = lfsr88_random_integers(key, 1, clen0)
+      key, inc = lfsr88_random_integers(key, 1, clen)
       i_row += inc
 
 
@@ -625,25 +596,23 @@ def _mv_prob_uniform_outdim_parallel_cpu(
     vector: ti.types.ndarray(ndim=1),
     w_min: ti.types.ndarray(ndim=1),
     w_max: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
   num_row = out.shape[0]
   num_col = vector.shape[0]
   w_min0 = w_min[0]
   w_max0 = w_max[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_row in range(num_row):
     r = 0.
-    key = lfsr88_key(seed0 + i_row)
-    key, i_col = lfsr88_random_integers(key, 0, clen0 - 1)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
     while i_col < num_col:
       key, raw_v = lfsr88_uniform(key, w_min0, w_max0)
       r += vector[i_col] * raw_v
-      key, inc = lfsr88_random_integers(key, 1, clen0)
+      key, inc = lfsr88_random_integers(key, 1, clen)
       i_col += inc
     out[i_row] = r
 
@@ -737,7 +706,7 @@ def _mv_prob_uniform_jvp_whigh(w_dot, vector, w_low, w_high, clen, seed, *,
 
 
 def _define_mv_prob_uniform_prim(cpu_kernel, gpu_kernel):
-  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel)
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
   prim.defjvp(_mv_prob_uniform_jvp_vector,
               _mv_prob_uniform_jvp_wlow,
               _mv_prob_uniform_jvp_whigh,
@@ -765,25 +734,25 @@ def _mv_prob_normal_cpu(
     vector: ti.types.ndarray(ndim=1),
     w_mu: ti.types.ndarray(ndim=1),
     w_sigma: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
+  for i in range(out.shape[0]):
+    out[i] = 0.
   num_row = out.shape[0]
   num_col = vector.shape[0]
   w_mu0 = w_mu[0]
   w_sigma0 = w_sigma[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_col in range(num_col):
     col_v = vector[i_col]
-    key = lfsr88_key(seed0 + i_col)
-    key, i_row = lfsr88_random_integers(key, 0, clen0 - 1)
+    key = lfsr88_key(seed + i_col)
+    key, i_row = lfsr88_random_integers(key, 0, clen - 1)
     while i_row < num_row:
       key, raw_v = lfsr88_normal(key, w_mu0, w_sigma0)
       out[i_row] += col_v * raw_v
-      key, inc = lfsr88_random_integers(key, 1, clen0)
+      key, inc = lfsr88_random_integers(key, 1, clen)
       i_row += inc
 
 
@@ -792,25 +761,23 @@ def _mv_prob_normal_outdim_parallel_cpu(
     vector: ti.types.ndarray(ndim=1),
     w_mu: ti.types.ndarray(ndim=1),
     w_sigma: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
   num_row = out.shape[0]
   num_col = vector.shape[0]
   w_mu0 = w_mu[0]
   w_sigma0 = w_sigma[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_row in range(num_row):
     r = 0.
-    key = lfsr88_key(seed0 + i_row)
-    key, i_col = lfsr88_random_integers(key, 0, clen0 - 1)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
     while i_col < num_col:
       key, raw_v = lfsr88_normal(key, w_mu0, w_sigma0)
       r += vector[i_col] * raw_v
-      key, inc = lfsr88_random_integers(key, 1, clen0)
+      key, inc = lfsr88_random_integers(key, 1, clen)
       i_col += inc
     out[i_row] = r
 
@@ -901,7 +868,7 @@ def _mv_prob_normal_jvp_w_sigma(w_dot, vector, w_mu, w_sigma, clen, seed, *, out
 
 
 def _define_mv_prob_normal_prim(cpu_kernel, gpu_kernel):
-  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel)
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
   prim.defjvp(_mv_prob_normal_jvp_vector,
               _mv_prob_normal_jvp_w_mu,
               _mv_prob_normal_jvp_w_sigma,
@@ -964,9 +931,13 @@ def _get_connect_matrix_outdim_parallel(
       i_col += inc
 
 
-_get_connect_matrix_p = XLACustomOp(cpu_kernel=_get_connect_matrix, gpu_kernel=_get_connect_matrix)
+# The matrices only assign their connections, the other elements are zeroed.
+_zero = ('zero',)
+_get_connect_matrix_p = XLACustomOp(cpu_kernel=_get_connect_matrix, gpu_kernel=_get_connect_matrix,
+                                     output_init=_zero)
 _get_connect_matrix_outdim_parallel_p = XLACustomOp(cpu_kernel=_get_connect_matrix_outdim_parallel,
-                                                    gpu_kernel=_get_connect_matrix_outdim_parallel)
+                                                    gpu_kernel=_get_connect_matrix_outdim_parallel,
+                                                    output_init=_zero)
 
 
 @ti.kernel
@@ -1020,9 +991,11 @@ def _get_uniform_weight_matrix_outdim_parallel(
 
 
 _get_uniform_weight_matrix_p = XLACustomOp(cpu_kernel=_get_uniform_weight_matrix,
-                                           gpu_kernel=_get_uniform_weight_matrix)
+                                           gpu_kernel=_get_uniform_weight_matrix,
+                                           output_init=_zero)
 _get_uniform_weight_matrix_outdim_parallel_p = XLACustomOp(cpu_kernel=_get_uniform_weight_matrix_outdim_parallel,
-                                                           gpu_kernel=_get_uniform_weight_matrix_outdim_parallel)
+                                                           gpu_kernel=_get_uniform_weight_matrix_outdim_parallel,
+                                                           output_init=_zero)
 
 
 @ti.kernel
@@ -1076,6 +1049,8 @@ def _get_normal_weight_matrix_outdim_parallel(
 
 
 _get_normal_weight_matrix_p = XLACustomOp(cpu_kernel=_get_normal_weight_matrix,
-                                          gpu_kernel=_get_normal_weight_matrix)
+                                          gpu_kernel=_get_normal_weight_matrix,
+                                          output_init=_zero)
 _get_normal_weight_matrix_outdim_parallel_p = XLACustomOp(cpu_kernel=_get_normal_weight_matrix_outdim_parallel,
-                                                          gpu_kernel=_get_normal_weight_matrix_outdim_parallel)
+                                                          gpu_kernel=_get_normal_weight_matrix_outdim_parallel,
+                                                          output_init=_zero)
@@ -0,0 +1,620 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+# Products of the just-in-time connectivity with a matrix of events. Boolean
+# events use the kernels below, which only accumulate the active events. Float
+# events are multiplied by their values with the kernels of ``_jit_csrmm.py``.
+
+from typing import Tuple
+
+import jax
+import taichi as ti
+from jax import numpy as jnp
+
+from braintaichi._misc import _get_dtype
+from braintaichi._primitive._xla_custom_op import XLACustomOp
+from ._jit_csrmm import (_mm_col_tile,
+                         _general_mm_checking,
+                         raw_mm_prob_homo,
+                         raw_mm_prob_uniform,
+                         raw_mm_prob_normal,
+                         _mm_prob_homo_jvp_weight,
+                         _mm_prob_homo_transpose,
+                         _mm_prob_two_weights_jvp,
+                         _mm_prob_two_weights_transpose)
+from ._jit_csrmv import _cpu_overwrite
+from ._taichi_rand import (lfsr88_key, lfsr88_random_integers, lfsr88_uniform, lfsr88_normal)
+
+
+def raw_event_mm_prob_homo(
+    events: jax.Array,
+    weight: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  if events.dtype != jnp.bool_:
+    return raw_mm_prob_homo(events, weight, conn_len, seed, shape=shape,
+                            transpose=transpose, outdim_parallel=outdim_parallel)
+  mat_shape, out_shape = _event_mm_checking(events, conn_len, seed, shape, outdim_parallel, transpose, weight)
+
+  if outdim_parallel:
+    prim = _event_mm_prob_homo_outdim_parallel_bool_p
+  else:
+    prim = _event_mm_prob_homo_bool_p
+
+  return prim(events,
+              weight,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=weight.dtype)],
+              shape=mat_shape,
+              transpose=transpose,
+              outdim_parallel=outdim_parallel)
+
+
+def raw_event_mm_prob_uniform(
+    events: jax.Array,
+    w_low: jax.Array,  # vector with size 1
+    w_high: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  if events.dtype != jnp.bool_:
+    return raw_mm_prob_uniform(events, w_low, w_high, conn_len, seed, shape=shape,
+                               transpose=transpose, outdim_parallel=outdim_parallel)
+  mat_shape, out_shape = _event_mm_checking(events, conn_len, seed, shape, outdim_parallel, transpose,
+                                            w_low, w_high)
+
+  if outdim_parallel:
+    prim = _event_mm_prob_uniform_outdim_parallel_bool_p
+  else:
+    prim = _event_mm_prob_uniform_bool_p
+
+  return prim(events,
+              w_low,
+              w_high,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=w_low.dtype)],
+              shape=mat_shape,
+              transpose=transpose,
+              outdim_parallel=outdim_parallel)
+
+
+def raw_event_mm_prob_normal(
+    events: jax.Array,
+    w_mu: jax.Array,  # vector with size 1
+    w_sigma: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  if events.dtype != jnp.bool_:
+    return raw_mm_prob_normal(events, w_mu, w_sigma, conn_len, seed, shape=shape,
+                              transpose=transpose, outdim_parallel=outdim_parallel)
+  mat_shape, out_shape = _event_mm_checking(events, conn_len, seed, shape, outdim_parallel, transpose,
+                                            w_mu, w_sigma)
+
+  if outdim_parallel:
+    prim = _event_mm_prob_normal_outdim_parallel_bool_p
+  else:
+    prim = _event_mm_prob_normal_bool_p
+
+  return prim(events,
+              w_mu,
+              w_sigma,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=w_mu.dtype)],
+              shape=mat_shape,
+              transpose=transpose,
+              outdim_parallel=outdim_parallel)
+
+
+def _event_mm_checking(events, clen, seed, shape, outdim_parallel, transpose, *weights):
+  assert _get_dtype(events) == jnp.bool_
+  return _general_mm_checking(events, clen, seed, shape, outdim_parallel, transpose, *weights)
+
+
+# -------------
+# CPU function
+# -------------
+# The same (row, tile) decomposition as the matrix-matrix CPU kernels. When no
+# event of a tile is active in a column, the scatter kernels skip the random
+# generation of the column for that tile.
+#
+# -------------
+# GPU function
+# -------------
+# The same warp-based generation as the event matrix-vector GPU kernels, applied
+# to all the columns of the event matrix.
+
+@ti.kernel
+def _event_mm_prob_homo_bool_cpu(
+    events: ti.types.ndarray(ndim=2),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=2)
+):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  num_batch = out.shape[1]
+  weight0 = weight[0]
+  num_tile = (num_batch + _mm_col_tile - 1) // _mm_col_tile
+
+  for i_col, i_tile in ti.ndrange(num_col, num_tile):
+    start_b = i_tile * _mm_col_tile
+    end_b = ti.min(start_b + _mm_col_tile, num_batch)
+    num_active = 0
+    for b in range(start_b, end_b):
+      if events[i_col, b]:
+        num_active += 1
+    if num_active > 0:
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+      while i_row < num_row:
+        for b in range(start_b, end_b):
+          if events[i_col, b]:
+            out[i_row, b] += weight0
+        key, inc = lfsr88_random_integers(key, 1, clen)
+        i_row += inc
+
+
+@ti.kernel
+def _event_mm_prob_homo_outdim_parallel_bool_cpu(
+    events: ti.types.ndarray(ndim=2),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=2)
+):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  num_batch = out.shape[1]
+  weight0 = weight[0]
+  num_tile = (num_batch + _mm_col_tile - 1) // _mm_col_tile
+
+  for i_row, i_tile in ti.ndrange(num_row, num_tile):
+    start_b = i_tile * _mm_col_tile
+    end_b = ti.min(start_b + _mm_col_tile, num_batch)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      for b in range(start_b, end_b):
+        if events[i_col, b]:
+          out[i_row, b] = out[i_row, b] + weight0
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+
+
+@ti.kernel
+def _event_mm_prob_homo_bool_gpu(
+    events: ti.types.ndarray(ndim=2),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=2)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  num_batch = out.shape[1]
+  weight0 = weight[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_col * 32):
+    i_col = i >> 5
+    index = i & 31
+    i_row = step * index - 1
+    end = ti.min(i_row + step, num_row)
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_row += inc
+    while i_row < end:
+      for b in range(num_batch):
+        if events[i_col, b]:
+          out[i_row, b] += weight0
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_row += inc
+
+
+@ti.kernel
+def _event_mm_prob_homo_outdim_parallel_bool_gpu(
+    events: ti.types.ndarray(ndim=2),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=2)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  num_batch = out.shape[1]
+  weight0 = weight[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_row * 32):
+    i_row = i >> 5
+    index = i & 31
+    i_col = step * index - 1
+    end_col = ti.min(i_col + step, num_col)
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_col += inc
+    while i_col < end_col:
+      for b in range(num_batch):
+        if events[i_col, b]:
+          out[i_row, b] += weight0
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_col += inc
+
+
+@ti.kernel
+def _event_mm_prob_uniform_bool_cpu(
+    events: ti.types.ndarray(ndim=2),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=2)
+):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  num_batch = out.shape[1]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  num_tile = (num_batch + _mm_col_tile - 1) // _mm_col_tile
+
+  for i_col, i_tile in ti.ndrange(num_col, num_tile):
+    start_b = i_tile * _mm_col_tile
+    end_b = ti.min(start_b + _mm_col_tile, num_batch)
+    num_active = 0
+    for b in range(start_b, end_b):
+      if events[i_col, b]:
+        num_active += 1
+    if num_active > 0:
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+      while i_row < num_row:
+        key, raw_v = lfsr88_uniform(key, w_min0, w_max0)
+        for b in range(start_b, end_b):
+          if events[i_col, b]:
+            out[i_row, b] += raw_v
+        key, inc = lfsr88_random_integers(key, 1, clen)
+        i_row += inc
+
+
+@ti.kernel
+def _event_mm_prob_uniform_outdim_parallel_bool_cpu(
+    events: ti.types.ndarray(ndim=2),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=2)
+):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  num_batch = out.shape[1]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  num_tile = (num_batch + _mm_col_tile - 1) // _mm_col_tile
+
+  for i_row, i_tile in ti.ndrange(num_row, num_tile):
+    start_b = i_tile * _mm_col_tile
+    end_b = ti.min(start_b + _mm_col_tile, num_batch)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      key, raw_v = lfsr88_uniform(key, w_min0, w_max0)
+      for b in range(start_b, end_b):
+        if events[i_col, b]:
+          out[i_row, b] = out[i_row, b] + raw_v
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+
+
+@ti.kernel
+def _event_mm_prob_uniform_bool_gpu(
+    events: ti.types.ndarray(ndim=2),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=2)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  num_batch = out.shape[1]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_col * 32):
+    i_col = i >> 5
+    index = i & 31
+    i_row = step * index - 1
+    end = ti.min(i_row + step, num_row)
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_row += inc
+    while i_row < end:
+      key, raw_v = lfsr88_uniform(key, w_min0, w_max0)
+      for b in range(num_batch):
+        if events[i_col, b]:
+          out[i_row, b] += raw_v
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_row += inc
+
+
+@ti.kernel
+def _event_mm_prob_uniform_outdim_parallel_bool_gpu(
+    events: ti.types.ndarray(ndim=2),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=2)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  num_batch = out.shape[1]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_row * 32):
+    i_row = i >> 5
+    index = i & 31
+    i_col = step * index - 1
+    end_col = ti.min(i_col + step, num_col)
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_col += inc
+    while i_col < end_col:
+      key, raw_v = lfsr88_uniform(key, w_min0, w_max0)
+      for b in range(num_batch):
+        if events[i_col, b]:
+          out[i_row, b] += raw_v
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_col += inc
+
+
+@ti.kernel
+def _event_mm_prob_normal_bool_cpu(
+    events: ti.types.ndarray(ndim=2),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=2)
+):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  num_batch = out.shape[1]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  num_tile = (num_batch + _mm_col_tile - 1) // _mm_col_tile
+
+  for i_col, i_tile in ti.ndrange(num_col, num_tile):
+    start_b = i_tile * _mm_col_tile
+    end_b = ti.min(start_b + _mm_col_tile, num_batch)
+    num_active = 0
+    for b in range(start_b, end_b):
+      if events[i_col, b]:
+        num_active += 1
+    if num_active > 0:
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+      while i_row < num_row:
+        key, raw_v = lfsr88_normal(key, w_mu0, w_sigma0)
+        for b in range(start_b, end_b):
+          if events[i_col, b]:
+            out[i_row, b] += raw_v
+        key, inc = lfsr88_random_integers(key, 1, clen)
+        i_row += inc
+
+
+@ti.kernel
+def _event_mm_prob_normal_outdim_parallel_bool_cpu(
+    events: ti.types.ndarray(ndim=2),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=2)
+):
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  num_batch = out.shape[1]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  num_tile = (num_batch + _mm_col_tile - 1) // _mm_col_tile
+
+  for i_row, i_tile in ti.ndrange(num_row, num_tile):
+    start_b = i_tile * _mm_col_tile
+    end_b = ti.min(start_b + _mm_col_tile, num_batch)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      key, raw_v = lfsr88_normal(key, w_mu0, w_sigma0)
+      for b in range(start_b, end_b):
+        if events[i_col, b]:
+          out[i_row, b] = out[i_row, b] + raw_v
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+
+
+@ti.kernel
+def _event_mm_prob_normal_bool_gpu(
+    events: ti.types.ndarray(ndim=2),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=2)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  num_batch = out.shape[1]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_col * 32):
+    i_col = i >> 5
+    index = i & 31
+    i_row = step * index - 1
+    end = ti.min(i_row + step, num_row)
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_row += inc
+    while i_row < end:
+      key, raw_v = lfsr88_normal(key, w_mu0, w_sigma0)
+      for b in range(num_batch):
+        if events[i_col, b]:
+          out[i_row, b] += raw_v
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_row += inc
+
+
+@ti.kernel
+def _event_mm_prob_normal_outdim_parallel_bool_gpu(
+    events: ti.types.ndarray(ndim=2),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=2)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  num_batch = out.shape[1]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_row * 32):
+    i_row = i >> 5
+    index = i & 31
+    i_col = step * index - 1
+    end_col = ti.min(i_col + step, num_col)
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_col += inc
+    while i_col < end_col:
+      key, raw_v = lfsr88_normal(key, w_mu0, w_sigma0)
+      for b in range(num_batch):
+        if events[i_col, b]:
+          out[i_row, b] += raw_v
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_col += inc
+
+
+# Boolean events carry no tangent, so only the weights are differentiated.
+
+def _define_event_mm_prob_homo_prim(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(None, _mm_prob_homo_jvp_weight(raw_event_mm_prob_homo), None, None)
+  prim.def_transpose_rule(_mm_prob_homo_transpose(raw_event_mm_prob_homo))
+  return prim
+
+
+def _define_event_mm_prob_two_weights_prim(raw_event_mm, cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(None,
+              _mm_prob_two_weights_jvp(raw_event_mm, 0),
+              _mm_prob_two_weights_jvp(raw_event_mm, 1),
+              None,
+              None)
+  prim.def_transpose_rule(_mm_prob_two_weights_transpose(raw_event_mm))
+  return prim
+
+
+# outdim_parallel = True
+_event_mm_prob_homo_outdim_parallel_bool_p = _define_event_mm_prob_homo_prim(
+  cpu_kernel=_event_mm_prob_homo_outdim_parallel_bool_cpu,
+  gpu_kernel=_event_mm_prob_homo_outdim_parallel_bool_gpu
+)
+
+# outdim_parallel = False
+_event_mm_prob_homo_bool_p = _define_event_mm_prob_homo_prim(
+  cpu_kernel=_event_mm_prob_homo_bool_cpu,
+  gpu_kernel=_event_mm_prob_homo_bool_gpu
+)
+
+# outdim_parallel = True
+_event_mm_prob_uniform_outdim_parallel_bool_p = _define_event_mm_prob_two_weights_prim(
+  raw_event_mm_prob_uniform,
+  cpu_kernel=_event_mm_prob_uniform_outdim_parallel_bool_cpu,
+  gpu_kernel=_event_mm_prob_uniform_outdim_parallel_bool_gpu
+)
+
+# outdim_parallel = False
+_event_mm_prob_uniform_bool_p = _define_event_mm_prob_two_weights_prim(
+  raw_event_mm_prob_uniform,
+  cpu_kernel=_event_mm_prob_uniform_bool_cpu,
+  gpu_kernel=_event_mm_prob_uniform_bool_gpu
+)
+
+# outdim_parallel = True
+_event_mm_prob_normal_outdim_parallel_bool_p = _define_event_mm_prob_two_weights_prim(
+  raw_event_mm_prob_normal,
+  cpu_kernel=_event_mm_prob_normal_outdim_parallel_bool_cpu,
+  gpu_kernel=_event_mm_prob_normal_outdim_parallel_bool_gpu
+)
+
+# outdim_parallel = False
+_event_mm_prob_normal_bool_p = _define_event_mm_prob_two_weights_prim(
+  raw_event_mm_prob_normal,
+  cpu_kernel=_event_mm_prob_normal_bool_cpu,
+  gpu_kernel=_event_mm_prob_normal_bool_gpu
+)
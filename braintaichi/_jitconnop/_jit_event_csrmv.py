@@ -22,15 +22,22 @@ import jax
 import taichi as ti
 from jax import numpy as jnp
 
+from braintaichi._eventop._event_packed import is_packed
 from braintaichi._misc import _get_dtype
+from braintaichi._primitive._batch_utils import register_vector_batching
 from braintaichi._primitive._xla_custom_op import XLACustomOp
 from ._jit_csrmv import (_general_checking,
+                         _cpu_overwrite,
                          raw_mv_prob_homo,
                          raw_mv_prob_uniform,
                          raw_mv_prob_normal,
                          _mv_prob_homo_transpose,
                          _mv_prob_uniform_transpose,
                          _mv_prob_normal_transpose)
+from ._jit_event_csrmm import raw_event_mm_prob_homo, raw_event_mm_prob_uniform, raw_event_mm_prob_normal
+from ._jit_packed_event_csrmv import (raw_packed_event_mv_prob_homo,
+                                      raw_packed_event_mv_prob_uniform,
+                                      raw_packed_event_mv_prob_normal)
 from ._taichi_rand import (lfsr88_key, lfsr88_random_integers, lfsr88_uniform, lfsr88_normal)
 
 
@@ -47,23 +54,23 @@ from ._taichi_rand import (lfsr88_key, lfsr88_random_integers, lfsr88_uniform, l
 def _event_mv_prob_homo_bool_cpu(
     events: ti.types.ndarray(ndim=1),
     weight: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
+  for i in range(out.shape[0]):
+    out[i] = 0.
   num_row = out.shape[0]
   num_col = events.shape[0]
   weight0 = weight[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_col in range(num_col):
     if events[i_col]:
-      key = lfsr88_key(seed0 + i_col)
-      key, i_row = lfsr88_random_integers(key, 0, clen0 - 1)
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
       while i_row < num_row:
         out[i_row] += weight0
-        key, inc = lfsr88_random_integers(key, 1, clen0)
+        key, inc = lfsr88_random_integers(key, 1, clen)
         i_row += inc
 
 
@@ -71,24 +78,22 @@ def _event_mv_prob_homo_bool_cpu(
 def _event_mv_prob_homo_outdim_parallel_bool_cpu(
     events: ti.types.ndarray(ndim=1),
     weight: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
   num_row = out.shape[0]
   num_col = events.shape[0]
   weight0 = weight[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_row in range(num_row):
     r = 0.
-    key = lfsr88_key(seed0 + i_row)
-    key, i_col = lfsr88_random_integers(key, 0, clen0 - 1)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
     while i_col < num_col:
       if events[i_col]:
         r += weight0
-      key, inc = lfsr88_random_integers(key, 1, clen0)
+      key, inc = lfsr88_random_integers(key, 1, clen)
       i_col += inc
     out[i_row] = r
 
@@ -178,23 +183,23 @@ def _reverse(shape):
 def _event_mv_prob_homo_cpu(
     events: ti.types.ndarray(ndim=1),
     weight: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
+  for i in range(out.shape[0]):
+    out[i] = 0.
   num_row = out.shape[0]
   num_col = events.shape[0]
   weight0 = weight[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_col in range(num_col):
     if events[i_col] != 0.:
-      key = lfsr88_key(seed0 + i_col)
-      key, i_row = lfsr88_random_integers(key, 0, clen0 - 1)
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
       while i_row < num_row:
         out[i_row] += weight0
-        key, inc = lfsr88_random_integers(key, 1, clen0)
+        key, inc = lfsr88_random_integers(key, 1, clen)
         i_row += inc
 
 
@@ -202,24 +207,22 @@ def _event_mv_prob_homo_cpu(
 def _event_mv_prob_homo_outdim_parallel_cpu(
     events: ti.types.ndarray(ndim=1),
     weight: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
   num_row = out.shape[0]
   num_col = events.shape[0]
   weight0 = weight[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_row in range(num_row):
     r = 0.
-    key = lfsr88_key(seed0 + i_row)
-    key, i_col = lfsr88_random_integers(key, 0, clen0 - 1)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
     while i_col < num_col:
       if events[i_col] != 0.:
         r += weight0
-      key, inc = lfsr88_random_integers(key, 1, clen0)
+      key, inc = lfsr88_random_integers(key, 1, clen)
       i_col += inc
     out[i_row] = r  # TODO: warp-level reduction
 
@@ -323,6 +326,9 @@ def raw_event_mv_prob_homo(
     transpose: bool = False,
     outdim_parallel: bool = True,
 ) -> jax.Array:
+  if is_packed(events):
+    return raw_packed_event_mv_prob_homo(events, weight, conn_len, seed, shape=shape,
+                                         transpose=transpose, outdim_parallel=outdim_parallel)
   mat_shape, out_shape = _event_checking(events, conn_len, seed, shape, outdim_parallel, transpose, weight)
 
   if outdim_parallel:
@@ -338,8 +344,8 @@ def raw_event_mv_prob_homo(
 
   return prim(events,
               weight,
-              conn_len,
-              seed,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
               outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=weight.dtype)],
               shape=mat_shape,
               transpose=transpose,
@@ -347,7 +353,7 @@ def raw_event_mv_prob_homo(
 
 
 def _define_event_mv_prob_homo_prim(cpu_kernel, gpu_kernel):
-  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel)
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
   prim.defjvp(_event_mv_prob_homo_jvp_events,
               _event_mv_prob_homo_jvp_weight,
               None,
@@ -386,25 +392,25 @@ def _event_mv_prob_uniform_bool_cpu(
     events: ti.types.ndarray(ndim=1),
     w_min: ti.types.ndarray(ndim=1),
     w_max: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
+  for i in range(out.shape[0]):
+    out[i] = 0.
   num_row = out.shape[0]
   num_col = events.shape[0]
   w_min0 = w_min[0]
   w_max0 = w_max[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_col in range(num_col):
     if events[i_col]:
-      key = lfsr88_key(seed0 + i_col)
-      key, i_row = lfsr88_random_integers(key, 0, clen0 - 1)
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
       while i_row < num_row:
         key, row_v = lfsr88_uniform(key, w_min0, w_max0)
         out[i_row] += row_v
-        key, inc = lfsr88_random_integers(key, 1, clen0)
+        key, inc = lfsr88_random_integers(key, 1, clen)
         i_row += inc
 
 
@@ -413,26 +419,24 @@ def _event_mv_prob_uniform_outdim_parallel_bool_cpu(
     events: ti.types.ndarray(ndim=1),
     w_min: ti.types.ndarray(ndim=1),
     w_max: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
   num_row = out.shape[0]
   num_col = events.shape[0]
   w_min0 = w_min[0]
   w_max0 = w_max[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_row in range(num_row):
     r = 0.
-    key = lfsr88_key(seed0 + i_row)
-    key, i_col = lfsr88_random_integers(key, 0, clen0 - 1)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
     while i_col < num_col:
       key, row_v = lfsr88_uniform(key, w_min0, w_max0)
       if events[i_col]:
         r += row_v
-      key, inc = lfsr88_random_integers(key, 1, clen0)
+      key, inc = lfsr88_random_integers(key, 1, clen)
       i_col += inc
     out[i_row] = r
 
@@ -509,25 +513,25 @@ def _event_mv_prob_uniform_cpu(
     events: ti.types.ndarray(ndim=1),
     w_min: ti.types.ndarray(ndim=1),
     w_max: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
+  for i in range(out.shape[0]):
+    out[i] = 0.
   num_row = out.shape[0]
   num_col = events.shape[0]
   w_min0 = w_min[0]
   w_max0 = w_max[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_col in range(num_col):
     if events[i_col] != 0.:
-      key = lfsr88_key(seed0 + i_col)
-      key, i_row = lfsr88_random_integers(key, 0, clen0 - 1)
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
       while i_row < num_row:
         key, row_v = lfsr88_uniform(key, w_min0, w_max0)
         out[i_row] += row_v
-        key, inc = lfsr88_random_integers(key, 1, clen0)
+        key, inc = lfsr88_random_integers(key, 1, clen)
         i_row += inc
 
 
@@ -536,26 +540,24 @@ def _event_mv_prob_uniform_outdim_parallel_cpu(
     events: ti.types.ndarray(ndim=1),
     w_min: ti.types.ndarray(ndim=1),
     w_max: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
   num_row = out.shape[0]
   num_col = events.shape[0]
   w_min0 = w_min[0]
   w_max0 = w_max[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_row in range(num_row):
     r = 0.
-    key = lfsr88_key(seed0 + i_row)
-    key, i_col = lfsr88_random_integers(key, 0, clen0 - 1)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
     while i_col < num_col:
       key, row_v = lfsr88_uniform(key, w_min0, w_max0)
       if events[i_col] != 0.:
         r += row_v
-      key, inc = lfsr88_random_integers(key, 1, clen0)
+      key, inc = lfsr88_random_integers(key, 1, clen)
       i_col += inc
     out[i_row] = r  # TODO: warp-level reduction
 
@@ -662,6 +664,9 @@ def raw_event_mv_prob_uniform(
     transpose: bool = False,
     outdim_parallel: bool = True,
 ) -> jax.Array:
+  if is_packed(events):
+    return raw_packed_event_mv_prob_uniform(events, w_low, w_high, conn_len, seed, shape=shape,
+                                            transpose=transpose, outdim_parallel=outdim_parallel)
   mat_shape, out_shape = _event_checking(events, conn_len, seed, shape, outdim_parallel, transpose, w_low, w_high)
 
   if outdim_parallel:
@@ -678,8 +683,8 @@ def raw_event_mv_prob_uniform(
   return prim(events,
               w_low,
               w_high,
-              conn_len,
-              seed,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
               outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=w_low.dtype)],
               shape=mat_shape,
               transpose=transpose,
@@ -687,7 +692,7 @@ def raw_event_mv_prob_uniform(
 
 
 def _define_event_mv_prob_uniform_prim(cpu_kernel, gpu_kernel):
-  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel)
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
   prim.defjvp(_event_mv_prob_uniform_jvp_events,
               _event_mv_prob_uniform_jvp_w_low,
               _event_mv_prob_uniform_jvp_w_high,
@@ -727,25 +732,25 @@ def _event_mv_prob_normal_bool_cpu(
     events: ti.types.ndarray(ndim=1),
     w_mu: ti.types.ndarray(ndim=1),
     w_sigma: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
+  for i in range(out.shape[0]):
+    out[i] = 0.
   num_row = out.shape[0]
   num_col = events.shape[0]
   w_mu0 = w_mu[0]
   w_sigma0 = w_sigma[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_col in range(num_col):
     if events[i_col]:
-      key = lfsr88_key(seed0 + i_col)
-      key, i_row = lfsr88_random_integers(key, 0, clen0 - 1)
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
       while i_row < num_row:
         key, row_v = lfsr88_normal(key, w_mu0, w_sigma0)
         out[i_row] += row_v
-        key, inc = lfsr88_random_integers(key, 1, clen0)
+        key, inc = lfsr88_random_integers(key, 1, clen)
         i_row += inc
 
 
@@ -754,26 +759,24 @@ def _event_mv_prob_normal_outdim_parallel_bool_cpu(
     events: ti.types.ndarray(ndim=1),
     w_mu: ti.types.ndarray(ndim=1),
     w_sigma: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
   num_row = out.shape[0]
   num_col = events.shape[0]
   w_mu0 = w_mu[0]
   w_sigma0 = w_sigma[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_row in range(num_row):
     r = 0.
-    key = lfsr88_key(seed0 + i_row)
-    key, i_col = lfsr88_random_integers(key, 0, clen0 - 1)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
     while i_col < num_col:
       key, row_v = lfsr88_normal(key, w_mu0, w_sigma0)
       if events[i_col]:
         r += row_v
-      key, inc = lfsr88_random_integers(key, 1, clen0)
+      key, inc = lfsr88_random_integers(key, 1, clen)
       i_col += inc
     out[i_row] = r
 
@@ -850,25 +853,25 @@ def _event_mv_prob_normal_cpu(
     events: ti.types.ndarray(ndim=1),
     w_mu: ti.types.ndarray(ndim=1),
     w_sigma: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
+  for i in range(out.shape[0]):
+    out[i] = 0.
   num_row = out.shape[0]
   num_col = events.shape[0]
   w_mu0 = w_mu[0]
   w_sigma0 = w_sigma[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_col in range(num_col):
     if events[i_col] != 0.:
-      key = lfsr88_key(seed0 + i_col)
-      key, i_row = lfsr88_random_integers(key, 0, clen0 - 1)
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
       while i_row < num_row:
         key, row_v = lfsr88_normal(key, w_mu0, w_sigma0)
         out[i_row] += row_v
-        key, inc = lfsr88_random_integers(key, 1, clen0)
+        key, inc = lfsr88_random_integers(key, 1, clen)
         i_row += inc
 
 
@@ -877,26 +880,24 @@ def _event_mv_prob_normal_outdim_parallel_cpu(
     events: ti.types.ndarray(ndim=1),
     w_mu: ti.types.ndarray(ndim=1),
     w_sigma: ti.types.ndarray(ndim=1),
-    clen: ti.types.ndarray(ndim=1),
-    seed: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
     out: ti.types.ndarray(ndim=1)
 ):
   num_row = out.shape[0]
   num_col = events.shape[0]
   w_mu0 = w_mu[0]
   w_sigma0 = w_sigma[0]
-  clen0 = clen[0]
-  seed0 = seed[0]
 
   for i_row in range(num_row):
     r = 0.
-    key = lfsr88_key(seed0 + i_row)
-    key, i_col = lfsr88_random_integers(key, 0, clen0 - 1)
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
     while i_col < num_col:
       key, row_v = lfsr88_normal(key, w_mu0, w_sigma0)
       if events[i_col] != 0.:
         r += row_v
-      key, inc = lfsr88_random_integers(key, 1, clen0)
+      key, inc = lfsr88_random_integers(key, 1, clen)
       i_col += inc
     out[i_row] = r
 
@@ -1003,6 +1004,9 @@ def raw_event_mv_prob_normal(
     transpose: bool = False,
     outdim_parallel: bool = True,
 ) -> jax.Array:
+  if is_packed(events):
+    return raw_packed_event_mv_prob_normal(events, w_mu, w_sigma, conn_len, seed, shape=shape,
+                                           transpose=transpose, outdim_parallel=outdim_parallel)
   mat_shape, out_shape = _event_checking(events, conn_len, seed, shape, outdim_parallel, transpose, w_mu, w_sigma)
 
   if outdim_parallel:
@@ -1019,8 +1023,8 @@ def raw_event_mv_prob_normal(
   return prim(events,
               w_mu,
               w_sigma,
-              conn_len,
-              seed,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
               outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=w_mu.dtype)],
               shape=mat_shape,
               transpose=transpose,
@@ -1028,7 +1032,7 @@ def raw_event_mv_prob_normal(
 
 
 def _define_event_mv_prob_normal_prim(cpu_kernel, gpu_kernel):
-  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel)
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
   prim.defjvp(_event_mv_prob_normal_jvp_events,
               _event_mv_prob_normal_jvp_w_mu,
               _event_mv_prob_normal_jvp_w_sigma,
@@ -1061,3 +1065,29 @@ _event_mv_prob_normal_p = _define_event_mv_prob_normal_prim(
   cpu_kernel=_event_mv_prob_normal_cpu,
   gpu_kernel=_event_mv_prob_normal_gpu
 )
+
+
+# Batching rules: a batch of boolean event vectors is multiplied as one event
+# matrix, which generates the random connectivity once for all the vectors. The
+# batches of float events keep the general batching rule.
+
+def _event_mv_prob_bool_batched(raw_mm):
+  def matmat(events, *args, outs, shape, transpose, outdim_parallel):
+    shape = _reverse(shape) if transpose else shape
+    return raw_mm(events, *args, shape=shape, transpose=transpose, outdim_parallel=outdim_parallel)[0]
+
+  return matmat
+
+
+register_vector_batching(_event_mv_prob_homo_bool_p.primitive,
+                         _event_mv_prob_bool_batched(raw_event_mm_prob_homo), 0)
+register_vector_batching(_event_mv_prob_homo_outdim_parallel_bool_p.primitive,
+                         _event_mv_prob_bool_batched(raw_event_mm_prob_homo), 0)
+register_vector_batching(_event_mv_prob_uniform_bool_p.primitive,
+                         _event_mv_prob_bool_batched(raw_event_mm_prob_uniform), 0)
+register_vector_batching(_event_mv_prob_uniform_outdim_parallel_bool_p.primitive,
+                         _event_mv_prob_bool_batched(raw_event_mm_prob_uniform), 0)
+register_vector_batching(_event_mv_prob_normal_bool_p.primitive,
+                         _event_mv_prob_bool_batched(raw_event_mm_prob_normal), 0)
+register_vector_batching(_event_mv_prob_normal_outdim_parallel_bool_p.primitive,
+                         _event_mv_prob_bool_batched(raw_event_mm_prob_normal), 0)
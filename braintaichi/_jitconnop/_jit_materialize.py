@@ -0,0 +1,431 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+# Just-in-time connectivity materialized into a CSR matrix.
+#
+# The LFSR88 streams of the matrix-vector kernels are run once, in two passes: the
+# first one counts the connections of each stream, and the second one writes their
+# positions (and weights) into a CSR matrix whose rows are the streams. The later
+# products with the same seed, probability and weights reuse the cached matrix
+# through the CSR kernels, instead of regenerating it.
+#
+# The matrix is generated on the host, with the streams of the CPU kernels, as it is
+# a constant of the products whatever the platform they are compiled for. On CPU,
+# the materialized matrix is therefore the just-in-time generated one, and the
+# products with ``outdim_parallel=True`` also sum in the same order and are
+# bit-for-bit equal to the just-in-time ones. The other products only differ by
+# their summation order. The GPU kernels split every stream into sub-streams, so
+# that on GPU the materialized matrix is another draw of the same distribution.
+
+import os
+import threading
+from collections import OrderedDict
+from typing import Tuple
+
+import jax
+import numpy as np
+import taichi as ti
+from jax import numpy as jnp
+
+from braintaichi._eventop._event_csrmv import raw_csrmv_taichi as raw_event_csrmv_taichi
+from braintaichi._primitive._xla_custom_op import XLACustomOp
+from braintaichi._sparseop._sparse_csrmv import raw_csrmv_taichi
+from ._jit_csrmv import _non_event_checking
+from ._jit_event_csrmv import _event_checking
+from ._taichi_rand import (lfsr88_key, lfsr88_next_key, lfsr88_random_integers, lfsr88_uniform, lfsr88_normal)
+
+# Whether the just-in-time connectivity of the matrix-vector products is generated
+# once into a cached CSR matrix ("on"), or regenerated by every call ("off"). "auto"
+# materializes the matrices which fit in "jitconn_materialize_budget" bytes. Either
+# way, the connectivity is regenerated when the seed, the connection probability or
+# the random weights are traced values.
+jitconn_materialize = os.environ.get('BRAINTAICHI_JITCONN_MATERIALIZE', 'off')
+
+# the largest materialized matrix in "auto" mode, in bytes
+jitconn_materialize_budget = int(os.environ.get('BRAINTAICHI_JITCONN_MATERIALIZE_BUDGET', 1 << 26))
+
+# the number of materialized matrices kept in the cache
+_cache_size = 64
+
+_cache = OrderedDict()
+_cache_lock = threading.Lock()
+
+def _is_traced(*args) -> bool:
+  return any(isinstance(arg, jax.core.Tracer) for arg in args)
+
+
+def use_materialized(
+    conn_len: jax.Array,
+    seed: jax.Array,
+    *random_weights: jax.Array,
+    shape: Tuple[int, int],
+) -> bool:
+  mode = jitconn_materialize
+  if mode not in ('auto', 'on', 'off'):
+    raise ValueError(f'Unknown jitconn materialize mode: {mode}. Should be "auto", "on" or "off".')
+  if mode == 'off' or _is_traced(conn_len, seed, *random_weights):
+    return False
+  if mode == 'on':
+    return True
+
+  # each stream connects one in "(conn_len + 1) / 2" positions on average
+  nnz = shape[0] * shape[1] * 2 / (int(np.asarray(conn_len)[0]) + 1)
+  value_size = np.dtype(random_weights[0].dtype).itemsize if len(random_weights) else 0
+  num_byte = nnz * (4 + value_size) + 4 * (max(shape) + 1)
+  return num_byte <= jitconn_materialize_budget
+
+
+def raw_materialized_mv_prob_homo(
+    vector: jax.Array,
+    weight: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  mat_shape, out_shape = _checking(vector, conn_len, seed, shape, outdim_parallel, transpose, weight)
+  indices, indptr, _ = _materialize('homo', (), conn_len, seed, mat_shape, outdim_parallel)
+  return _csr_matvec(weight, indices, indptr, vector, mat_shape, out_shape, outdim_parallel)
+
+
+def raw_materialized_mv_prob_uniform(
+    vector: jax.Array,
+    w_low: jax.Array,
+    w_high: jax.Array,
+    conn_len: jax.Array,
+    seed: jax.Array,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  mat_shape, out_shape = _checking(vector, conn_len, seed, shape, outdim_parallel, transpose, w_low, w_high)
+  indices, indptr, values = _materialize('uniform', (w_low, w_high), conn_len, seed, mat_shape, outdim_parallel)
+  return _csr_matvec(values, indices, indptr, vector, mat_shape, out_shape, outdim_parallel)
+
+
+def raw_materialized_mv_prob_normal(
+    vector: jax.Array,
+    w_mu: jax.Array,
+    w_sigma: jax.Array,
+    conn_len: jax.Array,
+    seed: jax.Array,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  mat_shape, out_shape = _checking(vector, conn_len, seed, shape, outdim_parallel, transpose, w_mu, w_sigma)
+  indices, indptr, values = _materialize('normal', (w_mu, w_sigma), conn_len, seed, mat_shape, outdim_parallel)
+  return _csr_matvec(values, indices, indptr, vector, mat_shape, out_shape, outdim_parallel)
+
+
+def _checking(vector, conn_len, seed, shape, outdim_parallel, transpose, *weights):
+  if vector.dtype == jnp.bool_:
+    return _event_checking(vector, conn_len, seed, shape, outdim_parallel, transpose, *weights)
+  else:
+    return _non_event_checking(vector, conn_len, seed, shape, outdim_parallel, transpose, *weights)
+
+
+def _csr_matvec(values, indices, indptr, vector, mat_shape, out_shape, outdim_parallel):
+  if indices.shape[0] == 0:
+    return [jnp.zeros(out_shape, dtype=values.dtype)]
+
+  # the rows of the CSR matrix are the streams: the rows of "M" when
+  # "outdim_parallel=True", and its columns otherwise
+  num_row, num_col = mat_shape
+  if outdim_parallel:
+    csr_shape, csr_transpose = (num_row, num_col), False
+  else:
+    csr_shape, csr_transpose = (num_col, num_row), True
+  if vector.dtype == jnp.bool_:
+    raw_csrmv = raw_event_csrmv_taichi
+  else:
+    raw_csrmv = raw_csrmv_taichi
+  return raw_csrmv(values, indices, indptr, vector, shape=csr_shape, transpose=csr_transpose)[:1]
+
+
+def _materialize(dist, weights, conn_len, seed, mat_shape, outdim_parallel):
+  key = (dist, tuple(mat_shape), outdim_parallel,
+         int(np.asarray(conn_len)[0]), int(np.asarray(seed)[0]),
+         tuple((np.asarray(w).dtype.name, np.asarray(w)[0].item()) for w in weights))
+  with _cache_lock:
+    if key in _cache:
+      _cache.move_to_end(key)
+      return _cache[key]
+
+  num_row, num_col = mat_shape
+  if outdim_parallel:
+    num_stream, length = num_row, num_col
+  else:
+    num_stream, length = num_col, num_row
+  count_prim, fill_prim = _prims[(dist, outdim_parallel)]
+
+  with jax.ensure_compile_time_eval(), jax.default_device(jax.devices('cpu')[0]):
+    length = jnp.asarray([length], dtype=jnp.int32)
+    num_draw = jnp.asarray([_num_draws[dist]], dtype=jnp.int32)
+    counts = count_prim(conn_len.astype(jnp.int32), seed.astype(jnp.uint32), length, num_draw,
+                        outs=[jax.ShapeDtypeStruct((num_stream,), jnp.int32)])[0]
+    indptr = jnp.concatenate([jnp.zeros(1, dtype=jnp.int32), jnp.cumsum(counts, dtype=jnp.int32)])
+    nnz = int(indptr[-1])
+    outs = [jax.ShapeDtypeStruct((nnz,), jnp.int32)]
+    if len(weights):
+      outs.append(jax.ShapeDtypeStruct((nnz,), weights[0].dtype))
+    if nnz > 0:
+      res = fill_prim(*weights, conn_len.astype(jnp.int32), seed.astype(jnp.uint32), length, indptr, outs=outs)
+    else:
+      res = [jnp.zeros(out.shape, out.dtype) for out in outs]
+    indices = res[0]
+    values = res[1] if len(weights) else None
+
+  with _cache_lock:
+    _cache[key] = (indices, indptr, values)
+    while len(_cache) > _cache_size:
+      _cache.popitem(last=False)
+  return indices, indptr, values
+
+
+# The counting kernels advance each stream past the "num_draw" keys drawn for the
+# weight of every connection, so that they visit the same positions as the
+# matrix-vector kernels of all the distributions.
+
+@ti.kernel
+def _count_cpu(
+    clen: ti.i32,
+    seed: ti.u32,
+    length: ti.types.ndarray(ndim=1),
+    num_draw: ti.types.ndarray(ndim=1),
+    counts: ti.types.ndarray(ndim=1)
+):
+  num_row = length[0]
+  num_col = counts.shape[0]
+  num_draw0 = num_draw[0]
+
+  for i_col in range(num_col):
+    n = 0
+    key = lfsr88_key(seed + i_col)
+    key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+    while i_row < num_row:
+      n += 1
+      for _ in range(num_draw0):
+        key = lfsr88_next_key(key)
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_row += inc
+    counts[i_col] = n
+
+
+@ti.kernel
+def _count_outdim_parallel_cpu(
+    clen: ti.i32,
+    seed: ti.u32,
+    length: ti.types.ndarray(ndim=1),
+    num_draw: ti.types.ndarray(ndim=1),
+    counts: ti.types.ndarray(ndim=1)
+):
+  num_row = counts.shape[0]
+  num_col = length[0]
+  num_draw0 = num_draw[0]
+
+  for i_row in range(num_row):
+    n = 0
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      n += 1
+      for _ in range(num_draw0):
+        key = lfsr88_next_key(key)
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+    counts[i_row] = n
+
+
+@ti.kernel
+def _fill_homo_cpu(
+    clen: ti.i32,
+    seed: ti.u32,
+    length: ti.types.ndarray(ndim=1),
+    offsets: ti.types.ndarray(ndim=1),
+    indices: ti.types.ndarray(ndim=1)
+):
+  num_row = length[0]
+  num_col = offsets.shape[0] - 1
+
+  for i_col in range(num_col):
+    j = offsets[i_col]
+    key = lfsr88_key(seed + i_col)
+    key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+    while i_row < num_row:
+      indices[j] = i_row
+      j += 1
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_row += inc
+
+
+@ti.kernel
+def _fill_homo_outdim_parallel_cpu(
+    clen: ti.i32,
+    seed: ti.u32,
+    length: ti.types.ndarray(ndim=1),
+    offsets: ti.types.ndarray(ndim=1),
+    indices: ti.types.ndarray(ndim=1)
+):
+  num_row = offsets.shape[0] - 1
+  num_col = length[0]
+
+  for i_row in range(num_row):
+    j = offsets[i_row]
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      indices[j] = i_col
+      j += 1
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+
+
+@ti.kernel
+def _fill_uniform_cpu(
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    length: ti.types.ndarray(ndim=1),
+    offsets: ti.types.ndarray(ndim=1),
+    indices: ti.types.ndarray(ndim=1),
+    values: ti.types.ndarray(ndim=1)
+):
+  num_row = length[0]
+  num_col = offsets.shape[0] - 1
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+
+  for i_col in range(num_col):
+    j = offsets[i_col]
+    key = lfsr88_key(seed + i_col)
+    key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+    while i_row < num_row:
+      key, raw_v = lfsr88_uniform(key, w_min0, w_max0)
+      indices[j] = i_row
+      values[j] = raw_v
+      j += 1
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_row += inc
+
+
+@ti.kernel
+def _fill_uniform_outdim_parallel_cpu(
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    length: ti.types.ndarray(ndim=1),
+    offsets: ti.types.ndarray(ndim=1),
+    indices: ti.types.ndarray(ndim=1),
+    values: ti.types.ndarray(ndim=1)
+):
+  num_row = offsets.shape[0] - 1
+  num_col = length[0]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+
+  for i_row in range(num_row):
+    j = offsets[i_row]
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      key, raw_v = lfsr88_uniform(key, w_min0, w_max0)
+      indices[j] = i_col
+      values[j] = raw_v
+      j += 1
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+
+
+@ti.kernel
+def _fill_normal_cpu(
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    length: ti.types.ndarray(ndim=1),
+    offsets: ti.types.ndarray(ndim=1),
+    indices: ti.types.ndarray(ndim=1),
+    values: ti.types.ndarray(ndim=1)
+):
+  num_row = length[0]
+  num_col = offsets.shape[0] - 1
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+
+  for i_col in range(num_col):
+    j = offsets[i_col]
+    key = lfsr88_key(seed + i_col)
+    key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+    while i_row < num_row:
+      key, raw_v = lfsr88_normal(key, w_mu0, w_sigma0)
+      indices[j] = i_row
+      values[j] = raw_v
+      j += 1
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_row += inc
+
+
+@ti.kernel
+def _fill_normal_outdim_parallel_cpu(
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    length: ti.types.ndarray(ndim=1),
+    offsets: ti.types.ndarray(ndim=1),
+    indices: ti.types.ndarray(ndim=1),
+    values: ti.types.ndarray(ndim=1)
+):
+  num_row = offsets.shape[0] - 1
+  num_col = length[0]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+
+  for i_row in range(num_row):
+    j = offsets[i_row]
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      key, raw_v = lfsr88_normal(key, w_mu0, w_sigma0)
+      indices[j] = i_col
+      values[j] = raw_v
+      j += 1
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+
+
+# the number of keys drawn for the weight of each connection
+_num_draws = {'homo': 0, 'uniform': 1, 'normal': 2}
+
+_count_p = XLACustomOp(cpu_kernel=_count_cpu)
+_count_outdim_parallel_p = XLACustomOp(cpu_kernel=_count_outdim_parallel_cpu)
+
+_prims = {
+  ('homo', False): (_count_p, XLACustomOp(cpu_kernel=_fill_homo_cpu)),
+  ('homo', True): (_count_outdim_parallel_p, XLACustomOp(cpu_kernel=_fill_homo_outdim_parallel_cpu)),
+  ('uniform', False): (_count_p, XLACustomOp(cpu_kernel=_fill_uniform_cpu)),
+  ('uniform', True): (_count_outdim_parallel_p, XLACustomOp(cpu_kernel=_fill_uniform_outdim_parallel_cpu)),
+  ('normal', False): (_count_p, XLACustomOp(cpu_kernel=_fill_normal_cpu)),
+  ('normal', True): (_count_outdim_parallel_p, XLACustomOp(cpu_kernel=_fill_normal_outdim_parallel_cpu)),
+}
@@ -0,0 +1,630 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+# Just-in-time connectivity operators on bit-packed events, see
+# ``braintaichi._eventop._event_packed``. They generate the same connections as
+# the boolean event operators, so both give the same products. The kernels which
+# go through the columns visit the set bits of the nonzero words only, and the
+# kernels which go through the rows test the bits of the columns they draw.
+
+from typing import Tuple
+
+import jax
+import taichi as ti
+from jax import numpy as jnp
+from jax.interpreters import ad
+
+from braintaichi._eventop._event_packed import is_packed, num_words, as_words32, raw_unpack_events, _ctz, _bit
+from braintaichi._primitive._xla_custom_op import XLACustomOp
+from ._jit_csrmv import (_general_checking,
+                         _cpu_overwrite,
+                         raw_mv_prob_homo,
+                         raw_mv_prob_uniform,
+                         raw_mv_prob_normal,
+                         _mv_prob_uniform_transpose,
+                         _mv_prob_normal_transpose)
+from ._taichi_rand import (lfsr88_key, lfsr88_random_integers, lfsr88_uniform, lfsr88_normal)
+
+__all__ = [
+  'raw_packed_event_mv_prob_homo',
+  'raw_packed_event_mv_prob_uniform',
+  'raw_packed_event_mv_prob_normal',
+]
+
+
+def _reverse(shape):
+  return shape[::-1]
+
+
+def _packed_checking(events, clen, seed, shape, outdim_parallel, transpose, *weights):
+  assert is_packed(events)
+  if events.ndim != 1:
+    raise ValueError('events should be a 1D vector of packed words.')
+  num_event = shape[0] if transpose else shape[1]
+  if events.shape[0] != num_words(num_event, events.dtype):
+    raise ValueError(f'Shape mismatch, {num_event} packed events need {num_words(num_event, events.dtype)} '
+                     f'words, but got {events.shape[0]}.')
+  # check the others as the vector of the unpacked events
+  return _general_checking(jax.ShapeDtypeStruct((num_event,), jnp.bool_),
+                           clen, seed, shape, outdim_parallel, transpose, *weights)
+
+
+def _unpacked(events, shape, transpose, dtype):
+  return raw_unpack_events(events, shape[0] if transpose else shape[1]).astype(dtype)
+
+
+# The padding bits of the last word are zero, so the kernels can go through all the
+# "32 * num_word" columns of the words: the columns after the last event are never
+# set, and their draws do not change the connections of the others.
+
+@ti.kernel
+def _packed_event_mv_prob_homo_cpu(
+    events: ti.types.ndarray(ndim=1),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  for i in range(out.shape[0]):
+    out[i] = 0.
+  num_row = out.shape[0]
+  weight0 = weight[0]
+
+  for i_word in range(events.shape[0]):
+    word = events[i_word]
+    while word != 0:
+      i_col = i_word * 32 + _ctz(word)
+      word &= word - 1
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+      while i_row < num_row:
+        out[i_row] += weight0
+        key, inc = lfsr88_random_integers(key, 1, clen)
+        i_row += inc
+
+
+@ti.kernel
+def _packed_event_mv_prob_homo_outdim_parallel_cpu(
+    events: ti.types.ndarray(ndim=1),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0] * 32
+  weight0 = weight[0]
+
+  for i_row in range(num_row):
+    r = 0.
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      if _bit(events[i_col >> 5], i_col):
+        r += weight0
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+    out[i_row] = r
+
+
+@ti.kernel
+def _packed_event_mv_prob_homo_gpu(
+    events: ti.types.ndarray(ndim=1),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0] * 32
+  weight0 = weight[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_col * 32):
+    i_col = i >> 5
+    if _bit(events[i_col >> 5], i_col):
+      index = i & 31
+      i_row = step * index - 1
+      end = ti.min(i_row + step, num_row)
+      key = lfsr88_key(seed0 + i)
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_row += inc
+      while i_row < end:
+        out[i_row] += weight0
+        key, inc = lfsr88_random_integers(key, 1, clen0)
+        i_row += inc
+
+
+@ti.kernel
+def _packed_event_mv_prob_homo_outdim_parallel_gpu(
+    events: ti.types.ndarray(ndim=1),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0] * 32
+  weight0 = weight[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.u32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_row * 32):
+    i_row = i >> 5
+    index = i & 31
+    i_col = step * index - 1
+    end_col = ti.min(i_col + step, num_col)
+    r = 0.
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_col += inc
+    while i_col < end_col:
+      if _bit(events[i_col >> 5], i_col):
+        r += weight0
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_col += inc
+    out[i_row] += r
+
+
+def _packed_event_mv_prob_homo_jvp_weight(
+    w_dot, events, weight, clen, seed, *, outs, shape, transpose, outdim_parallel
+):
+  shape = _reverse(shape) if transpose else shape
+  return raw_packed_event_mv_prob_homo(events, w_dot, clen, seed,
+                                       shape=shape, transpose=transpose, outdim_parallel=outdim_parallel)
+
+
+def _packed_event_mv_prob_homo_transpose(
+    ct, events, weight, clen, seed, *, outs, shape, transpose, outdim_parallel
+):
+  shape = _reverse(shape) if transpose else shape
+  assert not ad.is_undefined_primal(events), 'Cannot differentiate through packed events.'
+  if ad.is_undefined_primal(weight):
+    if type(ct) is ad.Zero:
+      return events, ad.Zero(weight), clen, seed
+    else:
+      row = raw_mv_prob_homo(ct[0], jnp.ones(1, dtype=ct[0].dtype), clen, seed,
+                             shape=shape, transpose=transpose, outdim_parallel=outdim_parallel)[0]
+      dw = jnp.sum(row * _unpacked(events, shape, transpose, row.dtype), keepdims=True)
+      return events, dw, clen, seed
+  else:
+    assert type(clen) is not ad.UndefinedPrimal, 'Cannot differentiate through clen.'
+    assert type(seed) is not ad.UndefinedPrimal, 'Cannot differentiate through seed.'
+
+
+def raw_packed_event_mv_prob_homo(
+    events: jax.Array,
+    weight: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  mat_shape, out_shape = _packed_checking(events, conn_len, seed, shape, outdim_parallel, transpose, weight)
+  prim = _packed_event_mv_prob_homo_outdim_parallel_p if outdim_parallel else _packed_event_mv_prob_homo_p
+  return prim(as_words32(events),
+              weight,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=weight.dtype)],
+              shape=mat_shape,
+              transpose=transpose,
+              outdim_parallel=outdim_parallel)
+
+
+def _define_packed_event_mv_prob_homo_prim(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(None,
+              _packed_event_mv_prob_homo_jvp_weight,
+              None,
+              None)
+  prim.def_transpose_rule(_packed_event_mv_prob_homo_transpose)
+  return prim
+
+
+# outdim_parallel = True
+_packed_event_mv_prob_homo_outdim_parallel_p = _define_packed_event_mv_prob_homo_prim(
+  cpu_kernel=_packed_event_mv_prob_homo_outdim_parallel_cpu,
+  gpu_kernel=_packed_event_mv_prob_homo_outdim_parallel_gpu
+)
+
+# outdim_parallel = False
+_packed_event_mv_prob_homo_p = _define_packed_event_mv_prob_homo_prim(
+  cpu_kernel=_packed_event_mv_prob_homo_cpu,
+  gpu_kernel=_packed_event_mv_prob_homo_gpu
+)
+
+
+@ti.kernel
+def _packed_event_mv_prob_uniform_cpu(
+    events: ti.types.ndarray(ndim=1),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  for i in range(out.shape[0]):
+    out[i] = 0.
+  num_row = out.shape[0]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+
+  for i_word in range(events.shape[0]):
+    word = events[i_word]
+    while word != 0:
+      i_col = i_word * 32 + _ctz(word)
+      word &= word - 1
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+      while i_row < num_row:
+        key, row_v = lfsr88_uniform(key, w_min0, w_max0)
+        out[i_row] += row_v
+        key, inc = lfsr88_random_integers(key, 1, clen)
+        i_row += inc
+
+
+@ti.kernel
+def _packed_event_mv_prob_uniform_outdim_parallel_cpu(
+    events: ti.types.ndarray(ndim=1),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0] * 32
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+
+  for i_row in range(num_row):
+    r = 0.
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      key, row_v = lfsr88_uniform(key, w_min0, w_max0)
+      if _bit(events[i_col >> 5], i_col):
+        r += row_v
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+    out[i_row] = r
+
+
+@ti.kernel
+def _packed_event_mv_prob_uniform_gpu(
+    events: ti.types.ndarray(ndim=1),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0] * 32
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_col * 32):
+    i_col = i >> 5
+    if _bit(events[i_col >> 5], i_col):
+      index = i & 31
+      i_row = step * index - 1
+      end = ti.min(i_row + step, num_row)
+      key = lfsr88_key(seed0 + i)
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_row += inc
+      while i_row < end:
+        key, row_v = lfsr88_uniform(key, w_min0, w_max0)
+        out[i_row] += row_v
+        key, inc = lfsr88_random_integers(key, 1, clen0)
+        i_row += inc
+
+
+@ti.kernel
+def _packed_event_mv_prob_uniform_outdim_parallel_gpu(
+    events: ti.types.ndarray(ndim=1),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0] * 32
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.u32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_row * 32):
+    i_row = i >> 5
+    index = i & 31
+    i_col = step * index - 1
+    end_col = ti.min(i_col + step, num_col)
+    r = 0.
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_col += inc
+    while i_col < end_col:
+      key, row_v = lfsr88_uniform(key, w_min0, w_max0)
+      if _bit(events[i_col >> 5], i_col):
+        r += row_v
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_col += inc
+    out[i_row] += r
+
+
+def _packed_event_mv_prob_uniform_jvp_w_low(
+    w_dot, events, w_low, w_high, clen, seed, *, outs, shape, transpose, outdim_parallel
+):
+  shape = _reverse(shape) if transpose else shape
+  return raw_mv_prob_uniform(_unpacked(events, shape, transpose, w_dot.dtype), w_dot, w_high, clen, seed,
+                             shape=shape, transpose=transpose, outdim_parallel=outdim_parallel)
+
+
+def _packed_event_mv_prob_uniform_jvp_w_high(
+    w_dot, events, w_low, w_high, clen, seed, *, outs, shape, transpose, outdim_parallel
+):
+  shape = _reverse(shape) if transpose else shape
+  return raw_mv_prob_uniform(_unpacked(events, shape, transpose, w_dot.dtype), w_low, w_dot, clen, seed,
+                             shape=shape, transpose=transpose, outdim_parallel=outdim_parallel)
+
+
+def raw_packed_event_mv_prob_uniform(
+    events: jax.Array,
+    w_low: jax.Array,  # vector with size 1
+    w_high: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  mat_shape, out_shape = _packed_checking(events, conn_len, seed, shape, outdim_parallel, transpose, w_low, w_high)
+  prim = _packed_event_mv_prob_uniform_outdim_parallel_p if outdim_parallel else _packed_event_mv_prob_uniform_p
+  return prim(as_words32(events),
+              w_low,
+              w_high,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=w_low.dtype)],
+              shape=mat_shape,
+              transpose=transpose,
+              outdim_parallel=outdim_parallel)
+
+
+def _define_packed_event_mv_prob_uniform_prim(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(None,
+              _packed_event_mv_prob_uniform_jvp_w_low,
+              _packed_event_mv_prob_uniform_jvp_w_high,
+              None,
+              None)
+  prim.def_transpose_rule(_mv_prob_uniform_transpose)
+  return prim
+
+
+# outdim_parallel = True
+_packed_event_mv_prob_uniform_outdim_parallel_p = _define_packed_event_mv_prob_uniform_prim(
+  cpu_kernel=_packed_event_mv_prob_uniform_outdim_parallel_cpu,
+  gpu_kernel=_packed_event_mv_prob_uniform_outdim_parallel_gpu
+)
+
+# outdim_parallel = False
+_packed_event_mv_prob_uniform_p = _define_packed_event_mv_prob_uniform_prim(
+  cpu_kernel=_packed_event_mv_prob_uniform_cpu,
+  gpu_kernel=_packed_event_mv_prob_uniform_gpu
+)
+
+
+@ti.kernel
+def _packed_event_mv_prob_normal_cpu(
+    events: ti.types.ndarray(ndim=1),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  for i in range(out.shape[0]):
+    out[i] = 0.
+  num_row = out.shape[0]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+
+  for i_word in range(events.shape[0]):
+    word = events[i_word]
+    while word != 0:
+      i_col = i_word * 32 + _ctz(word)
+      word &= word - 1
+      key = lfsr88_key(seed + i_col)
+      key, i_row = lfsr88_random_integers(key, 0, clen - 1)
+      while i_row < num_row:
+        key, row_v = lfsr88_normal(key, w_mu0, w_sigma0)
+        out[i_row] += row_v
+        key, inc = lfsr88_random_integers(key, 1, clen)
+        i_row += inc
+
+
+@ti.kernel
+def _packed_event_mv_prob_normal_outdim_parallel_cpu(
+    events: ti.types.ndarray(ndim=1),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0] * 32
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+
+  for i_row in range(num_row):
+    r = 0.
+    key = lfsr88_key(seed + i_row)
+    key, i_col = lfsr88_random_integers(key, 0, clen - 1)
+    while i_col < num_col:
+      key, row_v = lfsr88_normal(key, w_mu0, w_sigma0)
+      if _bit(events[i_col >> 5], i_col):
+        r += row_v
+      key, inc = lfsr88_random_integers(key, 1, clen)
+      i_col += inc
+    out[i_row] = r
+
+
+@ti.kernel
+def _packed_event_mv_prob_normal_gpu(
+    events: ti.types.ndarray(ndim=1),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0] * 32
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.uint32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_col * 32):
+    i_col = i >> 5
+    if _bit(events[i_col >> 5], i_col):
+      index = i & 31
+      i_row = step * index - 1
+      end = ti.min(i_row + step, num_row)
+      key = lfsr88_key(seed0 + i)
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_row += inc
+      while i_row < end:
+        key, row_v = lfsr88_normal(key, w_mu0, w_sigma0)
+        out[i_row] += row_v
+        key, inc = lfsr88_random_integers(key, 1, clen0)
+        i_row += inc
+
+
+@ti.kernel
+def _packed_event_mv_prob_normal_outdim_parallel_gpu(
+    events: ti.types.ndarray(ndim=1),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0] * 32
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  clen0 = clen[0]
+  seed0 = seed[0]
+  step = ti.u32(ti.max((num_row + 1) >> 5, 1))
+
+  for i in range(num_row * 32):
+    i_row = i >> 5
+    index = i & 31
+    i_col = step * index - 1
+    end_col = ti.min(i_col + step, num_col)
+    r = 0.
+    key = lfsr88_key(seed0 + i)
+    key, inc = lfsr88_random_integers(key, 1, clen0)
+    i_col += inc
+    while i_col < end_col:
+      key, row_v = lfsr88_normal(key, w_mu0, w_sigma0)
+      if _bit(events[i_col >> 5], i_col):
+        r += row_v
+      key, inc = lfsr88_random_integers(key, 1, clen0)
+      i_col += inc
+    out[i_row] += r
+
+
+def _packed_event_mv_prob_normal_jvp_w_mu(
+    w_dot, events, w_mu, w_sigma, clen, seed, *, outs, shape, transpose, outdim_parallel
+):
+  shape = _reverse(shape) if transpose else shape
+  return raw_mv_prob_normal(_unpacked(events, shape, transpose, w_dot.dtype), w_dot, w_sigma, clen, seed,
+                            shape=shape, transpose=transpose, outdim_parallel=outdim_parallel)
+
+
+def _packed_event_mv_prob_normal_jvp_w_sigma(
+    w_dot, events, w_mu, w_sigma, clen, seed, *, outs, shape, transpose, outdim_parallel
+):
+  shape = _reverse(shape) if transpose else shape
+  return raw_mv_prob_normal(_unpacked(events, shape, transpose, w_dot.dtype), w_mu, w_dot, clen, seed,
+                            shape=shape, transpose=transpose, outdim_parallel=outdim_parallel)
+
+
+def raw_packed_event_mv_prob_normal(
+    events: jax.Array,
+    w_mu: jax.Array,  # vector with size 1
+    w_sigma: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  mat_shape, out_shape = _packed_checking(events, conn_len, seed, shape, outdim_parallel, transpose, w_mu, w_sigma)
+  prim = _packed_event_mv_prob_normal_outdim_parallel_p if outdim_parallel else _packed_event_mv_prob_normal_p
+  return prim(as_words32(events),
+              w_mu,
+              w_sigma,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=w_mu.dtype)],
+              shape=mat_shape,
+              transpose=transpose,
+              outdim_parallel=outdim_parallel)
+
+
+def _define_packed_event_mv_prob_normal_prim(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(None,
+              _packed_event_mv_prob_normal_jvp_w_mu,
+              _packed_event_mv_prob_normal_jvp_w_sigma,
+              None,
+              None)
+  prim.def_transpose_rule(_mv_prob_normal_transpose)
+  return prim
+
+
+# outdim_parallel = True
+_packed_event_mv_prob_normal_outdim_parallel_p = _define_packed_event_mv_prob_normal_prim(
+  cpu_kernel=_packed_event_mv_prob_normal_outdim_parallel_cpu,
+  gpu_kernel=_packed_event_mv_prob_normal_outdim_parallel_gpu
+)
+
+# outdim_parallel = False
+_packed_event_mv_prob_normal_p = _define_packed_event_mv_prob_normal_prim(
+  cpu_kernel=_packed_event_mv_prob_normal_cpu,
+  gpu_kernel=_packed_event_mv_prob_normal_gpu
+)
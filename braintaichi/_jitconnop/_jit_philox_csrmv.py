@@ -0,0 +1,1103 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+# Just-in-time connectivity generated with the counter-based Philox-4x32-10.
+#
+# Each row of the matrix :math:`M` is split into chunks of ``_philox_chunk``
+# columns. The connections of the chunk ``c`` of the row ``i`` are drawn at the
+# positions ``(i, c, step)`` of the Philox stream, so every chunk is generated
+# independently of the others, and the same :math:`M` is generated whether the
+# kernels walk it along the rows (``M @ v``) or along the columns (``M^T @ v``).
+
+from typing import Tuple
+
+import jax
+import taichi as ti
+from jax import numpy as jnp
+from jax.interpreters import ad
+
+from braintaichi._eventop._event_packed import is_packed, raw_unpack_events
+from braintaichi._misc import _get_dtype
+from braintaichi._primitive._xla_custom_op import XLACustomOp
+from ._jit_csrmv import _general_checking, _cpu_overwrite
+from ._taichi_rand import (philox_key, philox_bits, uint_to_integer, uint_to_uniform, uints_to_normal)
+
+# the number of columns of each independently generated chunk of a row
+_philox_chunk = 256
+
+
+def raw_philox_mv_prob_homo(
+    vector: jax.Array,
+    weight: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+) -> jax.Array:
+  out_shape = _philox_checking(vector, conn_len, seed, shape, transpose, weight)
+  prim = _philox_mv_prob_homo_transpose_p if transpose else _philox_mv_prob_homo_p
+  return prim(vector,
+              weight,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=vector.dtype)],
+              shape=shape,
+              transpose=transpose)
+
+
+def raw_philox_mv_prob_uniform(
+    vector: jax.Array,
+    w_low: jax.Array,  # vector with size 1
+    w_high: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+) -> jax.Array:
+  out_shape = _philox_checking(vector, conn_len, seed, shape, transpose, w_low, w_high)
+  prim = _philox_mv_prob_uniform_transpose_p if transpose else _philox_mv_prob_uniform_p
+  return prim(vector,
+              w_low,
+              w_high,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=vector.dtype)],
+              shape=shape,
+              transpose=transpose)
+
+
+def raw_philox_mv_prob_normal(
+    vector: jax.Array,
+    w_mu: jax.Array,  # vector with size 1
+    w_sigma: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+) -> jax.Array:
+  out_shape = _philox_checking(vector, conn_len, seed, shape, transpose, w_mu, w_sigma)
+  prim = _philox_mv_prob_normal_transpose_p if transpose else _philox_mv_prob_normal_p
+  return prim(vector,
+              w_mu,
+              w_sigma,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=vector.dtype)],
+              shape=shape,
+              transpose=transpose)
+
+
+def raw_philox_event_mv_prob_homo(
+    events: jax.Array,
+    weight: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+) -> jax.Array:
+  if is_packed(events):
+    events = raw_unpack_events(events, shape[0] if transpose else shape[1])
+  if events.dtype != jnp.bool_:
+    return raw_philox_mv_prob_homo(events, weight, conn_len, seed, shape=shape, transpose=transpose)
+  out_shape = _philox_checking(events, conn_len, seed, shape, transpose, weight)
+  prim = _philox_event_mv_prob_homo_bool_transpose_p if transpose else _philox_event_mv_prob_homo_bool_p
+  return prim(events,
+              weight,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=weight.dtype)],
+              shape=shape,
+              transpose=transpose)
+
+
+def raw_philox_event_mv_prob_uniform(
+    events: jax.Array,
+    w_low: jax.Array,  # vector with size 1
+    w_high: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+) -> jax.Array:
+  if is_packed(events):
+    events = raw_unpack_events(events, shape[0] if transpose else shape[1])
+  if events.dtype != jnp.bool_:
+    return raw_philox_mv_prob_uniform(events, w_low, w_high, conn_len, seed, shape=shape, transpose=transpose)
+  out_shape = _philox_checking(events, conn_len, seed, shape, transpose, w_low, w_high)
+  prim = _philox_event_mv_prob_uniform_bool_transpose_p if transpose else _philox_event_mv_prob_uniform_bool_p
+  return prim(events,
+              w_low,
+              w_high,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=w_low.dtype)],
+              shape=shape,
+              transpose=transpose)
+
+
+def raw_philox_event_mv_prob_normal(
+    events: jax.Array,
+    w_mu: jax.Array,  # vector with size 1
+    w_sigma: jax.Array,  # vector with size 1
+    conn_len: jax.Array,  # vector with size 1
+    seed: jax.Array,  # vector with size 1
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+) -> jax.Array:
+  if is_packed(events):
+    events = raw_unpack_events(events, shape[0] if transpose else shape[1])
+  if events.dtype != jnp.bool_:
+    return raw_philox_mv_prob_normal(events, w_mu, w_sigma, conn_len, seed, shape=shape, transpose=transpose)
+  out_shape = _philox_checking(events, conn_len, seed, shape, transpose, w_mu, w_sigma)
+  prim = _philox_event_mv_prob_normal_bool_transpose_p if transpose else _philox_event_mv_prob_normal_bool_p
+  return prim(events,
+              w_mu,
+              w_sigma,
+              conn_len.astype(jnp.int32),
+              seed.astype(jnp.uint32),
+              outs=[jax.ShapeDtypeStruct(shape=out_shape, dtype=w_mu.dtype)],
+              shape=shape,
+              transpose=transpose)
+
+
+def _philox_checking(vector, clen, seed, shape, transpose, *weights):
+  assert _get_dtype(vector) in [jnp.bool_, jnp.float16, jnp.float32, jnp.float64]
+  _, out_shape = _general_checking(vector, clen, seed, shape, True, transpose, *weights)
+  return out_shape
+
+
+# -------------
+# CPU function
+# -------------
+# ``M @ v`` runs a row per task, which walks all the chunks of its row.
+# ``M^T @ v`` runs a chunk of columns per task, which walks that chunk in all
+# the rows, and owns the outputs of its columns without atomic operations.
+#
+# -------------
+# GPU function
+# -------------
+# Each thread walks one chunk of one row, so that long rows are split among
+# threads in both orientations.
+
+@ti.kernel
+def _philox_mv_prob_homo_cpu(
+    vector: ti.types.ndarray(ndim=1),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = vector.shape[0]
+  weight0 = weight[0]
+  key = philox_key(seed)
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row in range(num_row):
+    r = 0.
+    for i_chunk in range(num_chunk):
+      start_col = i_chunk * _philox_chunk
+      end_col = ti.min(start_col + _philox_chunk, num_col)
+      step = 0
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col = start_col + uint_to_integer(bits[0], 0, clen - 1)
+      while i_col < end_col:
+        r += vector[i_col] * weight0
+        step += 1
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col += uint_to_integer(bits[0], 1, clen)
+    out[i_row] = r
+
+
+@ti.kernel
+def _philox_mv_prob_homo_transpose_cpu(
+    vector: ti.types.ndarray(ndim=1),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  for i in range(out.shape[0]):
+    out[i] = 0.
+  num_row = vector.shape[0]
+  num_col = out.shape[0]
+  weight0 = weight[0]
+  key = philox_key(seed)
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_chunk in range(num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    for i_row in range(num_row):
+      v = vector[i_row]
+      step = 0
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col = start_col + uint_to_integer(bits[0], 0, clen - 1)
+      while i_col < end_col:
+        out[i_col] = out[i_col] + v * weight0
+        step += 1
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col += uint_to_integer(bits[0], 1, clen)
+
+
+@ti.kernel
+def _philox_mv_prob_homo_gpu(
+    vector: ti.types.ndarray(ndim=1),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = vector.shape[0]
+  weight0 = weight[0]
+  clen0 = clen[0]
+  key = philox_key(seed[0])
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row, i_chunk in ti.ndrange(num_row, num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    r = 0.
+    step = 0
+    bits = philox_bits(key, i_row, i_chunk, step)
+    i_col = start_col + uint_to_integer(bits[0], 0, clen0 - 1)
+    while i_col < end_col:
+      r += vector[i_col] * weight0
+      step += 1
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col += uint_to_integer(bits[0], 1, clen0)
+    out[i_row] += r
+
+
+@ti.kernel
+def _philox_mv_prob_homo_transpose_gpu(
+    vector: ti.types.ndarray(ndim=1),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = vector.shape[0]
+  num_col = out.shape[0]
+  weight0 = weight[0]
+  clen0 = clen[0]
+  key = philox_key(seed[0])
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row, i_chunk in ti.ndrange(num_row, num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    v = vector[i_row]
+    step = 0
+    bits = philox_bits(key, i_row, i_chunk, step)
+    i_col = start_col + uint_to_integer(bits[0], 0, clen0 - 1)
+    while i_col < end_col:
+      out[i_col] += v * weight0
+      step += 1
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col += uint_to_integer(bits[0], 1, clen0)
+
+
+@ti.kernel
+def _philox_event_mv_prob_homo_bool_cpu(
+    events: ti.types.ndarray(ndim=1),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  weight0 = weight[0]
+  key = philox_key(seed)
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row in range(num_row):
+    r = 0.
+    for i_chunk in range(num_chunk):
+      start_col = i_chunk * _philox_chunk
+      end_col = ti.min(start_col + _philox_chunk, num_col)
+      step = 0
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col = start_col + uint_to_integer(bits[0], 0, clen - 1)
+      while i_col < end_col:
+        if events[i_col]:
+          r += weight0
+        step += 1
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col += uint_to_integer(bits[0], 1, clen)
+    out[i_row] = r
+
+
+@ti.kernel
+def _philox_event_mv_prob_homo_bool_transpose_cpu(
+    events: ti.types.ndarray(ndim=1),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  for i in range(out.shape[0]):
+    out[i] = 0.
+  num_row = events.shape[0]
+  num_col = out.shape[0]
+  weight0 = weight[0]
+  key = philox_key(seed)
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_chunk in range(num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    for i_row in range(num_row):
+      if events[i_row]:
+        step = 0
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col = start_col + uint_to_integer(bits[0], 0, clen - 1)
+        while i_col < end_col:
+          out[i_col] = out[i_col] + weight0
+          step += 1
+          bits = philox_bits(key, i_row, i_chunk, step)
+          i_col += uint_to_integer(bits[0], 1, clen)
+
+
+@ti.kernel
+def _philox_event_mv_prob_homo_bool_gpu(
+    events: ti.types.ndarray(ndim=1),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  weight0 = weight[0]
+  clen0 = clen[0]
+  key = philox_key(seed[0])
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row, i_chunk in ti.ndrange(num_row, num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    r = 0.
+    step = 0
+    bits = philox_bits(key, i_row, i_chunk, step)
+    i_col = start_col + uint_to_integer(bits[0], 0, clen0 - 1)
+    while i_col < end_col:
+      if events[i_col]:
+        r += weight0
+      step += 1
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col += uint_to_integer(bits[0], 1, clen0)
+    out[i_row] += r
+
+
+@ti.kernel
+def _philox_event_mv_prob_homo_bool_transpose_gpu(
+    events: ti.types.ndarray(ndim=1),
+    weight: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = events.shape[0]
+  num_col = out.shape[0]
+  weight0 = weight[0]
+  clen0 = clen[0]
+  key = philox_key(seed[0])
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row, i_chunk in ti.ndrange(num_row, num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    if events[i_row]:
+      step = 0
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col = start_col + uint_to_integer(bits[0], 0, clen0 - 1)
+      while i_col < end_col:
+        out[i_col] += weight0
+        step += 1
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col += uint_to_integer(bits[0], 1, clen0)
+
+
+@ti.kernel
+def _philox_mv_prob_uniform_cpu(
+    vector: ti.types.ndarray(ndim=1),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = vector.shape[0]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  key = philox_key(seed)
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row in range(num_row):
+    r = 0.
+    for i_chunk in range(num_chunk):
+      start_col = i_chunk * _philox_chunk
+      end_col = ti.min(start_col + _philox_chunk, num_col)
+      step = 0
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col = start_col + uint_to_integer(bits[0], 0, clen - 1)
+      while i_col < end_col:
+        w = uint_to_uniform(bits[1], w_min0, w_max0)
+        r += vector[i_col] * w
+        step += 1
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col += uint_to_integer(bits[0], 1, clen)
+    out[i_row] = r
+
+
+@ti.kernel
+def _philox_mv_prob_uniform_transpose_cpu(
+    vector: ti.types.ndarray(ndim=1),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  for i in range(out.shape[0]):
+    out[i] = 0.
+  num_row = vector.shape[0]
+  num_col = out.shape[0]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  key = philox_key(seed)
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_chunk in range(num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    for i_row in range(num_row):
+      v = vector[i_row]
+      step = 0
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col = start_col + uint_to_integer(bits[0], 0, clen - 1)
+      while i_col < end_col:
+        w = uint_to_uniform(bits[1], w_min0, w_max0)
+        out[i_col] = out[i_col] + v * w
+        step += 1
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col += uint_to_integer(bits[0], 1, clen)
+
+
+@ti.kernel
+def _philox_mv_prob_uniform_gpu(
+    vector: ti.types.ndarray(ndim=1),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = vector.shape[0]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  clen0 = clen[0]
+  key = philox_key(seed[0])
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row, i_chunk in ti.ndrange(num_row, num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    r = 0.
+    step = 0
+    bits = philox_bits(key, i_row, i_chunk, step)
+    i_col = start_col + uint_to_integer(bits[0], 0, clen0 - 1)
+    while i_col < end_col:
+      w = uint_to_uniform(bits[1], w_min0, w_max0)
+      r += vector[i_col] * w
+      step += 1
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col += uint_to_integer(bits[0], 1, clen0)
+    out[i_row] += r
+
+
+@ti.kernel
+def _philox_mv_prob_uniform_transpose_gpu(
+    vector: ti.types.ndarray(ndim=1),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = vector.shape[0]
+  num_col = out.shape[0]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  clen0 = clen[0]
+  key = philox_key(seed[0])
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row, i_chunk in ti.ndrange(num_row, num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    v = vector[i_row]
+    step = 0
+    bits = philox_bits(key, i_row, i_chunk, step)
+    i_col = start_col + uint_to_integer(bits[0], 0, clen0 - 1)
+    while i_col < end_col:
+      w = uint_to_uniform(bits[1], w_min0, w_max0)
+      out[i_col] += v * w
+      step += 1
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col += uint_to_integer(bits[0], 1, clen0)
+
+
+@ti.kernel
+def _philox_event_mv_prob_uniform_bool_cpu(
+    events: ti.types.ndarray(ndim=1),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  key = philox_key(seed)
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row in range(num_row):
+    r = 0.
+    for i_chunk in range(num_chunk):
+      start_col = i_chunk * _philox_chunk
+      end_col = ti.min(start_col + _philox_chunk, num_col)
+      step = 0
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col = start_col + uint_to_integer(bits[0], 0, clen - 1)
+      while i_col < end_col:
+        if events[i_col]:
+          w = uint_to_uniform(bits[1], w_min0, w_max0)
+          r += w
+        step += 1
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col += uint_to_integer(bits[0], 1, clen)
+    out[i_row] = r
+
+
+@ti.kernel
+def _philox_event_mv_prob_uniform_bool_transpose_cpu(
+    events: ti.types.ndarray(ndim=1),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  for i in range(out.shape[0]):
+    out[i] = 0.
+  num_row = events.shape[0]
+  num_col = out.shape[0]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  key = philox_key(seed)
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_chunk in range(num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    for i_row in range(num_row):
+      if events[i_row]:
+        step = 0
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col = start_col + uint_to_integer(bits[0], 0, clen - 1)
+        while i_col < end_col:
+          w = uint_to_uniform(bits[1], w_min0, w_max0)
+          out[i_col] = out[i_col] + w
+          step += 1
+          bits = philox_bits(key, i_row, i_chunk, step)
+          i_col += uint_to_integer(bits[0], 1, clen)
+
+
+@ti.kernel
+def _philox_event_mv_prob_uniform_bool_gpu(
+    events: ti.types.ndarray(ndim=1),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  clen0 = clen[0]
+  key = philox_key(seed[0])
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row, i_chunk in ti.ndrange(num_row, num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    r = 0.
+    step = 0
+    bits = philox_bits(key, i_row, i_chunk, step)
+    i_col = start_col + uint_to_integer(bits[0], 0, clen0 - 1)
+    while i_col < end_col:
+      if events[i_col]:
+        w = uint_to_uniform(bits[1], w_min0, w_max0)
+        r += w
+      step += 1
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col += uint_to_integer(bits[0], 1, clen0)
+    out[i_row] += r
+
+
+@ti.kernel
+def _philox_event_mv_prob_uniform_bool_transpose_gpu(
+    events: ti.types.ndarray(ndim=1),
+    w_min: ti.types.ndarray(ndim=1),
+    w_max: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = events.shape[0]
+  num_col = out.shape[0]
+  w_min0 = w_min[0]
+  w_max0 = w_max[0]
+  clen0 = clen[0]
+  key = philox_key(seed[0])
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row, i_chunk in ti.ndrange(num_row, num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    if events[i_row]:
+      step = 0
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col = start_col + uint_to_integer(bits[0], 0, clen0 - 1)
+      while i_col < end_col:
+        w = uint_to_uniform(bits[1], w_min0, w_max0)
+        out[i_col] += w
+        step += 1
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col += uint_to_integer(bits[0], 1, clen0)
+
+
+@ti.kernel
+def _philox_mv_prob_normal_cpu(
+    vector: ti.types.ndarray(ndim=1),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = vector.shape[0]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  key = philox_key(seed)
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row in range(num_row):
+    r = 0.
+    for i_chunk in range(num_chunk):
+      start_col = i_chunk * _philox_chunk
+      end_col = ti.min(start_col + _philox_chunk, num_col)
+      step = 0
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col = start_col + uint_to_integer(bits[0], 0, clen - 1)
+      while i_col < end_col:
+        w = uints_to_normal(bits[1], bits[2], w_mu0, w_sigma0)
+        r += vector[i_col] * w
+        step += 1
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col += uint_to_integer(bits[0], 1, clen)
+    out[i_row] = r
+
+
+@ti.kernel
+def _philox_mv_prob_normal_transpose_cpu(
+    vector: ti.types.ndarray(ndim=1),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  for i in range(out.shape[0]):
+    out[i] = 0.
+  num_row = vector.shape[0]
+  num_col = out.shape[0]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  key = philox_key(seed)
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_chunk in range(num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    for i_row in range(num_row):
+      v = vector[i_row]
+      step = 0
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col = start_col + uint_to_integer(bits[0], 0, clen - 1)
+      while i_col < end_col:
+        w = uints_to_normal(bits[1], bits[2], w_mu0, w_sigma0)
+        out[i_col] = out[i_col] + v * w
+        step += 1
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col += uint_to_integer(bits[0], 1, clen)
+
+
+@ti.kernel
+def _philox_mv_prob_normal_gpu(
+    vector: ti.types.ndarray(ndim=1),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = vector.shape[0]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  clen0 = clen[0]
+  key = philox_key(seed[0])
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row, i_chunk in ti.ndrange(num_row, num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    r = 0.
+    step = 0
+    bits = philox_bits(key, i_row, i_chunk, step)
+    i_col = start_col + uint_to_integer(bits[0], 0, clen0 - 1)
+    while i_col < end_col:
+      w = uints_to_normal(bits[1], bits[2], w_mu0, w_sigma0)
+      r += vector[i_col] * w
+      step += 1
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col += uint_to_integer(bits[0], 1, clen0)
+    out[i_row] += r
+
+
+@ti.kernel
+def _philox_mv_prob_normal_transpose_gpu(
+    vector: ti.types.ndarray(ndim=1),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = vector.shape[0]
+  num_col = out.shape[0]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  clen0 = clen[0]
+  key = philox_key(seed[0])
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row, i_chunk in ti.ndrange(num_row, num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    v = vector[i_row]
+    step = 0
+    bits = philox_bits(key, i_row, i_chunk, step)
+    i_col = start_col + uint_to_integer(bits[0], 0, clen0 - 1)
+    while i_col < end_col:
+      w = uints_to_normal(bits[1], bits[2], w_mu0, w_sigma0)
+      out[i_col] += v * w
+      step += 1
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col += uint_to_integer(bits[0], 1, clen0)
+
+
+@ti.kernel
+def _philox_event_mv_prob_normal_bool_cpu(
+    events: ti.types.ndarray(ndim=1),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  key = philox_key(seed)
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row in range(num_row):
+    r = 0.
+    for i_chunk in range(num_chunk):
+      start_col = i_chunk * _philox_chunk
+      end_col = ti.min(start_col + _philox_chunk, num_col)
+      step = 0
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col = start_col + uint_to_integer(bits[0], 0, clen - 1)
+      while i_col < end_col:
+        if events[i_col]:
+          w = uints_to_normal(bits[1], bits[2], w_mu0, w_sigma0)
+          r += w
+        step += 1
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col += uint_to_integer(bits[0], 1, clen)
+    out[i_row] = r
+
+
+@ti.kernel
+def _philox_event_mv_prob_normal_bool_transpose_cpu(
+    events: ti.types.ndarray(ndim=1),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.i32,
+    seed: ti.u32,
+    out: ti.types.ndarray(ndim=1)
+):
+  for i in range(out.shape[0]):
+    out[i] = 0.
+  num_row = events.shape[0]
+  num_col = out.shape[0]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  key = philox_key(seed)
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_chunk in range(num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    for i_row in range(num_row):
+      if events[i_row]:
+        step = 0
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col = start_col + uint_to_integer(bits[0], 0, clen - 1)
+        while i_col < end_col:
+          w = uints_to_normal(bits[1], bits[2], w_mu0, w_sigma0)
+          out[i_col] = out[i_col] + w
+          step += 1
+          bits = philox_bits(key, i_row, i_chunk, step)
+          i_col += uint_to_integer(bits[0], 1, clen)
+
+
+@ti.kernel
+def _philox_event_mv_prob_normal_bool_gpu(
+    events: ti.types.ndarray(ndim=1),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = out.shape[0]
+  num_col = events.shape[0]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  clen0 = clen[0]
+  key = philox_key(seed[0])
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row, i_chunk in ti.ndrange(num_row, num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    r = 0.
+    step = 0
+    bits = philox_bits(key, i_row, i_chunk, step)
+    i_col = start_col + uint_to_integer(bits[0], 0, clen0 - 1)
+    while i_col < end_col:
+      if events[i_col]:
+        w = uints_to_normal(bits[1], bits[2], w_mu0, w_sigma0)
+        r += w
+      step += 1
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col += uint_to_integer(bits[0], 1, clen0)
+    out[i_row] += r
+
+
+@ti.kernel
+def _philox_event_mv_prob_normal_bool_transpose_gpu(
+    events: ti.types.ndarray(ndim=1),
+    w_mu: ti.types.ndarray(ndim=1),
+    w_sigma: ti.types.ndarray(ndim=1),
+    clen: ti.types.ndarray(ndim=1),
+    seed: ti.types.ndarray(ndim=1),
+    out: ti.types.ndarray(ndim=1)
+):
+  num_row = events.shape[0]
+  num_col = out.shape[0]
+  w_mu0 = w_mu[0]
+  w_sigma0 = w_sigma[0]
+  clen0 = clen[0]
+  key = philox_key(seed[0])
+  num_chunk = (num_col + _philox_chunk - 1) // _philox_chunk
+
+  for i_row, i_chunk in ti.ndrange(num_row, num_chunk):
+    start_col = i_chunk * _philox_chunk
+    end_col = ti.min(start_col + _philox_chunk, num_col)
+    if events[i_row]:
+      step = 0
+      bits = philox_bits(key, i_row, i_chunk, step)
+      i_col = start_col + uint_to_integer(bits[0], 0, clen0 - 1)
+      while i_col < end_col:
+        w = uints_to_normal(bits[1], bits[2], w_mu0, w_sigma0)
+        out[i_col] += w
+        step += 1
+        bits = philox_bits(key, i_row, i_chunk, step)
+        i_col += uint_to_integer(bits[0], 1, clen0)
+
+
+# The kernels are linear in the vector and, jointly, in the weights. The tangent
+# of one weight is the product with the other weights set to zero.
+
+def _philox_jvp_vector(raw_mv):
+  def jvp(v_dot, vector, *args, outs, shape, transpose):
+    return raw_mv(v_dot, *args, shape=shape, transpose=transpose)
+
+  return jvp
+
+
+def _philox_jvp_weight(raw_mv, i_weight):
+  def jvp(w_dot, vector, *args, outs, shape, transpose):
+    weights = [jnp.zeros_like(w) for w in args[:-2]]
+    weights[i_weight] = w_dot
+    return raw_mv(vector, *weights, *args[-2:], shape=shape, transpose=transpose)
+
+  return jvp
+
+
+def _philox_transpose(raw_mv):
+  def transpose_rule(ct, vector, *args, outs, shape, transpose):
+    weights, clen, seed = list(args[:-2]), args[-2], args[-1]
+    assert type(clen) is not ad.UndefinedPrimal, 'Cannot differentiate through clen.'
+    assert type(seed) is not ad.UndefinedPrimal, 'Cannot differentiate through seed.'
+    if ad.is_undefined_primal(vector):
+      if type(ct[0]) is ad.Zero:
+        return ad.Zero(vector), *weights, clen, seed
+      # the same chunks are walked in the other orientation
+      dv = raw_mv(ct[0], *weights, clen, seed, shape=shape, transpose=not transpose)[0]
+      return dv, *weights, clen, seed
+    for i, w in enumerate(weights):
+      if ad.is_undefined_primal(w):
+        if type(ct[0]) is ad.Zero:
+          weights[i] = ad.Zero(w)
+        else:
+          unit = [jnp.zeros(1, dtype=ct[0].dtype) for _ in weights]
+          unit[i] = jnp.ones(1, dtype=ct[0].dtype)
+          r = raw_mv(vector, *unit, clen, seed, shape=shape, transpose=transpose)[0]
+          weights[i] = jnp.sum(r * ct[0], keepdims=True)
+    return vector, *weights, clen, seed
+
+  return transpose_rule
+
+
+def _define_philox_prim(raw_mv, num_weight, cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_philox_jvp_vector(raw_mv),
+              *[_philox_jvp_weight(raw_mv, i) for i in range(num_weight)],
+              None,
+              None)
+  prim.def_transpose_rule(_philox_transpose(raw_mv))
+  return prim
+
+
+# Boolean events carry no tangent, so only the weights are differentiated.
+
+def _define_philox_event_prim(raw_event_mv, num_weight, cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(None,
+              *[_philox_jvp_weight(raw_event_mv, i) for i in range(num_weight)],
+              None,
+              None)
+  prim.def_transpose_rule(_philox_transpose(raw_event_mv))
+  return prim
+
+
+_philox_mv_prob_homo_p = _define_philox_prim(
+  raw_philox_mv_prob_homo, 1,
+  cpu_kernel=_philox_mv_prob_homo_cpu,
+  gpu_kernel=_philox_mv_prob_homo_gpu
+)
+_philox_mv_prob_homo_transpose_p = _define_philox_prim(
+  raw_philox_mv_prob_homo, 1,
+  cpu_kernel=_philox_mv_prob_homo_transpose_cpu,
+  gpu_kernel=_philox_mv_prob_homo_transpose_gpu
+)
+_philox_mv_prob_uniform_p = _define_philox_prim(
+  raw_philox_mv_prob_uniform, 2,
+  cpu_kernel=_philox_mv_prob_uniform_cpu,
+  gpu_kernel=_philox_mv_prob_uniform_gpu
+)
+_philox_mv_prob_uniform_transpose_p = _define_philox_prim(
+  raw_philox_mv_prob_uniform, 2,
+  cpu_kernel=_philox_mv_prob_uniform_transpose_cpu,
+  gpu_kernel=_philox_mv_prob_uniform_transpose_gpu
+)
+_philox_mv_prob_normal_p = _define_philox_prim(
+  raw_philox_mv_prob_normal, 2,
+  cpu_kernel=_philox_mv_prob_normal_cpu,
+  gpu_kernel=_philox_mv_prob_normal_gpu
+)
+_philox_mv_prob_normal_transpose_p = _define_philox_prim(
+  raw_philox_mv_prob_normal, 2,
+  cpu_kernel=_philox_mv_prob_normal_transpose_cpu,
+  gpu_kernel=_philox_mv_prob_normal_transpose_gpu
+)
+
+# events.dtype = jnp.bool_
+_philox_event_mv_prob_homo_bool_p = _define_philox_event_prim(
+  raw_philox_event_mv_prob_homo, 1,
+  cpu_kernel=_philox_event_mv_prob_homo_bool_cpu,
+  gpu_kernel=_philox_event_mv_prob_homo_bool_gpu
+)
+_philox_event_mv_prob_homo_bool_transpose_p = _define_philox_event_prim(
+  raw_philox_event_mv_prob_homo, 1,
+  cpu_kernel=_philox_event_mv_prob_homo_bool_transpose_cpu,
+  gpu_kernel=_philox_event_mv_prob_homo_bool_transpose_gpu
+)
+_philox_event_mv_prob_uniform_bool_p = _define_philox_event_prim(
+  raw_philox_event_mv_prob_uniform, 2,
+  cpu_kernel=_philox_event_mv_prob_uniform_bool_cpu,
+  gpu_kernel=_philox_event_mv_prob_uniform_bool_gpu
+)
+_philox_event_mv_prob_uniform_bool_transpose_p = _define_philox_event_prim(
+  raw_philox_event_mv_prob_uniform, 2,
+  cpu_kernel=_philox_event_mv_prob_uniform_bool_transpose_cpu,
+  gpu_kernel=_philox_event_mv_prob_uniform_bool_transpose_gpu
+)
+_philox_event_mv_prob_normal_bool_p = _define_philox_event_prim(
+  raw_philox_event_mv_prob_normal, 2,
+  cpu_kernel=_philox_event_mv_prob_normal_bool_cpu,
+  gpu_kernel=_philox_event_mv_prob_normal_bool_gpu
+)
+_philox_event_mv_prob_normal_bool_transpose_p = _define_philox_event_prim(
+  raw_philox_event_mv_prob_normal, 2,
+  cpu_kernel=_philox_event_mv_prob_normal_bool_transpose_cpu,
+  gpu_kernel=_philox_event_mv_prob_normal_bool_transpose_gpu
+)
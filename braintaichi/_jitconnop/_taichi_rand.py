@@ -30,6 +30,11 @@ __all__ = [
   # taichi functions for random number generator with LFSR113 algorithm
   'lfsr113_key', 'lfsr113_next_key', 'lfsr113_normal', 'lfsr113_randn',
   'lfsr113_random_integers', 'lfsr113_randint', 'lfsr113_uniform', 'lfsr113_rand',
+
+  # taichi functions for counter-based random number generator with Philox-4x32-10 algorithm
+  'philox4x32', 'philox_key', 'philox_bits', 'philox_normal', 'philox_randn',
+  'philox_random_integers', 'philox_randint', 'philox_uniform', 'philox_rand',
+  'uint_to_integer', 'uint_to_uniform', 'uint_to_rand', 'uints_to_normal', 'uints_to_randn',
 ]
 
 ti_float = ti.float32 if not jax.config.read('jax_enable_x64') else ti.float64
@@ -340,6 +345,195 @@ def lfsr113_rand(key: ti.types.vector(4, ti.u32)):
   return key, (key[0] ^ key[1] ^ key[2] ^ key[3]) * ti.cast(2.3283064365386963e-10, ti_float)
 
 
+#####################################################
+# Random Number Generator: Philox-4x32-10 algorithm #
+#####################################################
+# Contrary to LFSR88 and LFSR113, Philox is counter-based: every draw is a pure
+# function of a key and of a counter, without any state to step through. A draw
+# at any (i, j, k) position is obtained in O(1), so that a sequence can be split
+# among threads in any way, and generated in any order.
+#
+# Reference:
+#   Salmon, John K., et al. "Parallel random numbers: as easy as 1, 2, 3."
+#   Proceedings of the International Conference for High Performance Computing,
+#   Networking, Storage and Analysis (SC'11), 2011.
+
+_philox_m0 = 0xD2511F53
+_philox_m1 = 0xCD9E8D57
+_philox_w0 = 0x9E3779B9
+_philox_w1 = 0xBB67AE85
+
+
+@ti.func
+def _philox_mulhilo(a: ti.u32, b: ti.u32):
+  p = ti.u64(a) * ti.u64(b)
+  return ti.u32(p >> 32), ti.u32(p & ti.u64(0xFFFFFFFF))
+
+
+@ti.func
+def philox4x32(counter: ti.types.vector(4, ti.u32), key: ti.types.vector(2, ti.u32)) -> ti.types.vector(4, ti.u32):
+  """The Philox-4x32-10 bijection, which maps a 128-bit counter to 128 random bits.
+
+  Args:
+    counter: The counter.
+    key: The key, which selects one of the bijections.
+
+  Returns:
+    ti.math.uvec4: The random bits.
+  """
+  ctr = counter
+  k = key
+  for _ in ti.static(range(10)):
+    hi0, lo0 = _philox_mulhilo(ti.u32(_philox_m0), ctr[0])
+    hi1, lo1 = _philox_mulhilo(ti.u32(_philox_m1), ctr[2])
+    ctr = ti.math.uvec4(hi1 ^ ctr[1] ^ k[0], lo1, hi0 ^ ctr[3] ^ k[1], lo0)
+    k = ti.math.uvec2(k[0] + ti.u32(_philox_w0), k[1] + ti.u32(_philox_w1))
+  return ctr
+
+
+@ti.func
+def philox_key(seed: ti.u32) -> ti.types.vector(2, ti.u32):
+  """Initialize the key of Philox-4x32-10 algorithm.
+
+  Args:
+    seed: int. The seed value for the random number generator.
+
+  Returns:
+    ti.math.uvec2: The key for the Philox random number generator.
+  """
+  return ti.math.uvec2(ti.u32(seed), ti.u32(0))
+
+
+@ti.func
+def philox_bits(key: ti.types.vector(2, ti.u32), i, j, k) -> ti.types.vector(4, ti.u32):
+  """The 128 random bits at the position ``(i, j, k)``.
+
+  Args:
+    key: The key for the random number generator.
+    i: The first coordinate of the position, for instance the row.
+    j: The second coordinate of the position, for instance the column.
+    k: The third coordinate of the position, for instance the index of a draw.
+  """
+  return philox4x32(ti.math.uvec4(ti.u32(i), ti.u32(j), ti.u32(k), ti.u32(0)), key)
+
+
+@ti.func
+def uint_to_rand(x: ti.u32):
+  """Converts 32 random bits to a uniformly distributed random float in [0, 1).
+
+  Only the upper 24 bits are used, which are exactly representable in float32,
+  so that the result is never rounded up to 1.
+  """
+  return ti.cast(x >> 8, ti_float) * ti.cast(5.9604644775390625e-08, ti_float)
+
+
+@ti.func
+def uint_to_uniform(x: ti.u32, low, high):
+  """Converts 32 random bits to a uniformly distributed random float between `low` and `high`."""
+  return ti.cast(uint_to_rand(x) * (high - low) + low, ti_float)
+
+
+@ti.func
+def uint_to_integer(x: ti.u32, low, high):
+  """Converts 32 random bits to a uniformly distributed random integer between `low` and `high` (inclusive)."""
+  return ti.cast(x % (high + 1 - low) + low, ti_int)
+
+
+@ti.func
+def uints_to_randn(x1: ti.u32, x2: ti.u32, epsilon=1e-10):
+  """Converts 64 random bits to a random float with the standard normal distribution (Box–Muller transform)."""
+  u1 = ti.cast(ti.max(uint_to_rand(x1), epsilon), ti_float)
+  u2 = uint_to_rand(x2)
+  mag = ti.cast(ti.sqrt(-2.0 * ti.log(u1)), ti_float)
+  return ti.cast(mag * ti.sin(2 * ti.math.pi * u2), ti_float)
+
+
+@ti.func
+def uints_to_normal(x1: ti.u32, x2: ti.u32, mu, sigma, epsilon=1e-10):
+  """Converts 64 random bits to a random float with the normal distribution ``N(mu, sigma)``."""
+  return ti.cast(mu + sigma * uints_to_randn(x1, x2, epsilon), ti_float)
+
+
+@ti.func
+def philox_normal(key: ti.types.vector(2, ti.u32), i, j, k, mu, sigma, epsilon=1e-10):
+  """
+  Generate a random number of the normal distribution ``N(mu, sigma)`` at the position
+  ``(i, j, k)`` using the Philox-4x32-10 algorithm.
+
+  Args:
+    key: The key for the random number generator.
+    i, j, k: The position of the draw.
+    mu: The mean of the normal distribution.
+    sigma: The standard deviation of the normal distribution.
+    epsilon: The epsilon value to avoid log(0).
+  """
+  bits = philox_bits(key, i, j, k)
+  return uints_to_normal(bits[0], bits[1], mu, sigma, epsilon)
+
+
+@ti.func
+def philox_randn(key: ti.types.vector(2, ti.u32), i, j, k, epsilon=1e-10):
+  """
+  Generate a random number with the standard normal distribution at the position
+  ``(i, j, k)`` using the Philox-4x32-10 algorithm.
+
+  Args:
+    key: The key for the random number generator.
+    i, j, k: The position of the draw.
+    epsilon: The epsilon value to avoid log(0).
+  """
+  bits = philox_bits(key, i, j, k)
+  return uints_to_randn(bits[0], bits[1], epsilon)
+
+
+@ti.func
+def philox_random_integers(key: ti.types.vector(2, ti.u32), i, j, k, low, high):
+  """
+  Generates a uniformly distributed random integer between `low` and `high` (inclusive)
+  at the position ``(i, j, k)`` using the Philox-4x32-10 algorithm.
+
+  Args:
+    key: The key for the random number generator.
+    i, j, k: The position of the draw.
+    low: The lower bound of the range.
+    high: The upper bound of the range.
+  """
+  return uint_to_integer(philox_bits(key, i, j, k)[0], low, high)
+
+
+@ti.func
+def philox_randint(key: ti.types.vector(2, ti.u32), i, j, k, dtype=ti.u32):
+  return dtype(philox_bits(key, i, j, k)[0])
+
+
+@ti.func
+def philox_uniform(key: ti.types.vector(2, ti.u32), i, j, k, low, high):
+  """
+  Generates a uniformly distributed random float between `low` and `high` at the
+  position ``(i, j, k)`` using the Philox-4x32-10 algorithm.
+
+  Args:
+    key: The key for the random number generator.
+    i, j, k: The position of the draw.
+    low: The lower bound of the range.
+    high: The upper bound of the range.
+  """
+  return uint_to_uniform(philox_bits(key, i, j, k)[0], low, high)
+
+
+@ti.func
+def philox_rand(key: ti.types.vector(2, ti.u32), i, j, k):
+  """
+  Generates a uniformly distributed random float between 0 and 1 at the position
+  ``(i, j, k)`` using the Philox-4x32-10 algorithm.
+
+  Args:
+    key: The key for the random number generator.
+    i, j, k: The position of the draw.
+  """
+  return uint_to_rand(philox_bits(key, i, j, k)[0])
+
+
 ###########################
 # Reductions: warp reduce #
 ###########################
@@ -20,8 +20,20 @@ import numpy as np
 from jax import numpy as jnp
 
 from braintaichi._misc import set_module_as
+from ._jit_csrmm import raw_mm_prob_homo, raw_mm_prob_uniform, raw_mm_prob_normal
 from ._jit_csrmv import raw_mv_prob_homo, raw_mv_prob_uniform, raw_mv_prob_normal
+from ._jit_event_csrmm import raw_event_mm_prob_homo, raw_event_mm_prob_uniform, raw_event_mm_prob_normal
 from ._jit_event_csrmv import raw_event_mv_prob_homo, raw_event_mv_prob_uniform, raw_event_mv_prob_normal
+from ._jit_materialize import (use_materialized,
+                               raw_materialized_mv_prob_homo,
+                               raw_materialized_mv_prob_uniform,
+                               raw_materialized_mv_prob_normal)
+from ._jit_philox_csrmv import (raw_philox_mv_prob_homo,
+                                raw_philox_mv_prob_uniform,
+                                raw_philox_mv_prob_normal,
+                                raw_philox_event_mv_prob_homo,
+                                raw_philox_event_mv_prob_uniform,
+                                raw_philox_event_mv_prob_normal)
 
 __all__ = [
   'jitc_mv_prob_homo',
@@ -30,9 +42,21 @@ __all__ = [
   'jitc_event_mv_prob_homo',
   'jitc_event_mv_prob_uniform',
   'jitc_event_mv_prob_normal',
+  'jitc_mm_prob_homo',
+  'jitc_mm_prob_uniform',
+  'jitc_mm_prob_normal',
+  'jitc_event_mm_prob_homo',
+  'jitc_event_mm_prob_uniform',
+  'jitc_event_mm_prob_normal',
 ]
 
 
+def _is_philox(rng: str) -> bool:
+  if rng not in ('lfsr88', 'philox'):
+    raise ValueError(f'Unknown random number generator: {rng}. Should be "lfsr88" or "philox".')
+  return rng == 'philox'
+
+
 @set_module_as('braintaichi')
 def jitc_mv_prob_homo(
     vector: jax.typing.ArrayLike,
@@ -43,6 +67,7 @@ def jitc_mv_prob_homo(
     shape: Tuple[int, int],
     transpose: bool = False,
     outdim_parallel: bool = True,
+    rng: str = 'lfsr88',
 ) -> jax.Array:
   r"""Perform the :math:`y=M@v` operation,
   where :math:`M` is just-in-time randomly generated with a scalar `weight` at each position.
@@ -68,6 +93,17 @@ def jitc_mv_prob_homo(
      matrix generation, you should set ``outdim_parallel=True``, with the sacrifice of
      the speed compared with ``outdim_parallel=False``.
 
+  .. note::
+
+     When the environment variable ``BRAINTAICHI_JITCONN_MATERIALIZE`` is ``"on"``,
+     or ``"auto"`` and the matrix fits in ``BRAINTAICHI_JITCONN_MATERIALIZE_BUDGET``
+     bytes, :math:`M` is generated once into a cached CSR matrix, which the later
+     calls with the same ``seed`` reuse. On CPU, it is the same :math:`M`, but the
+     products may differ in the last bits because of their summation order. On GPU,
+     it is another draw of the same distribution. This requires concrete
+     ``conn_prob`` and ``seed``, and only applies to ``rng='lfsr88'`` and, for the
+     event operators, to boolean events.
+
   Parameters
   ----------
   vector: Array, ndarray
@@ -86,6 +122,13 @@ def jitc_mv_prob_homo(
     Perform the parallel random generations along the out dimension or not.
     It can be used to set the just-in-time generated :math:M^T: is the same
     as the just-in-time generated :math:`M` when ``transpose=True``.
+  rng: str
+    The random number generator of the connectivity. ``'lfsr88'`` generates each
+    row (or column) of :math:`M` as one sequential LFSR88 stream. ``'philox'``
+    generates :math:`M` with the counter-based Philox-4x32-10 in independent chunks
+    of columns, which are processed in parallel. It generates the same :math:`M`
+    for ``transpose=False`` and ``transpose=True``, and ``outdim_parallel`` has
+    no effect.
 
   Returns
   -------
@@ -96,13 +139,19 @@ def jitc_mv_prob_homo(
   if isinstance(weight, float):
     weight = jnp.asarray(weight, dtype=vector.dtype)
   weight = jnp.atleast_1d(jnp.asarray(weight))
-  conn_len = jnp.ceil(1 / conn_prob) * 2 - 1
-  clen = jnp.asarray(jnp.atleast_1d(conn_len), dtype=jnp.int32)
-  if seed is None:
-    with jax.ensure_compile_time_eval():
+  # concrete connectivity can be materialized, see "jitconn_materialize"
+  with jax.ensure_compile_time_eval():
+    conn_len = jnp.ceil(1 / conn_prob) * 2 - 1
+    clen = jnp.asarray(jnp.atleast_1d(conn_len), dtype=jnp.int32)
+    if seed is None:
       seed = np.random.randint(0, int(1e8), 1)
-  seed = jnp.asarray(seed, dtype=jnp.uint32)
-  seed = jnp.atleast_1d(seed)
+    seed = jnp.asarray(seed, dtype=jnp.uint32)
+    seed = jnp.atleast_1d(seed)
+  if _is_philox(rng):
+    return raw_philox_mv_prob_homo(vector, weight, clen, seed, shape=shape, transpose=transpose)[0]
+  if use_materialized(clen, seed, shape=shape):
+    return raw_materialized_mv_prob_homo(vector, weight, clen, seed, shape=shape,
+                                         transpose=transpose, outdim_parallel=outdim_parallel)[0]
   return raw_mv_prob_homo(vector, weight, clen, seed, shape=shape,
                           transpose=transpose, outdim_parallel=outdim_parallel)[0]
 
@@ -118,6 +167,7 @@ def jitc_mv_prob_uniform(
     shape: Tuple[int, int],
     transpose: bool = False,
     outdim_parallel: bool = True,
+    rng: str = 'lfsr88',
 ) -> jax.Array:
   r"""Perform the :math:`y=M@v` operation,
   where :math:`M` is just-in-time randomly generated with a uniform distribution for its value.
@@ -163,6 +213,13 @@ def jitc_mv_prob_uniform(
     Perform the parallel random generations along the out dimension or not.
     It can be used to set the just-in-time generated :math:M^T: is the same
     as the just-in-time generated :math:`M` when ``transpose=True``.
+  rng: str
+    The random number generator of the connectivity. ``'lfsr88'`` generates each
+    row (or column) of :math:`M` as one sequential LFSR88 stream. ``'philox'``
+    generates :math:`M` with the counter-based Philox-4x32-10 in independent chunks
+    of columns, which are processed in parallel. It generates the same :math:`M`
+    for ``transpose=False`` and ``transpose=True``, and ``outdim_parallel`` has
+    no effect.
 
   Returns
   -------
@@ -170,16 +227,22 @@ def jitc_mv_prob_uniform(
     The output of :math:`y = M @ v`.
   """
   vector = jnp.asarray(vector)
-  if isinstance(w_low, float): w_low = jnp.asarray(w_low, dtype=vector.dtype)
-  if isinstance(w_high, float): w_high = jnp.asarray(w_high, dtype=vector.dtype)
-  w_low = jnp.atleast_1d(jnp.asarray(w_low))
-  w_high = jnp.atleast_1d(jnp.asarray(w_high))
-  conn_len = jnp.ceil(1 / conn_prob) * 2 - 1
-  conn_len = jnp.asarray(jnp.atleast_1d(conn_len), dtype=jnp.int32)
-  if seed is None:
-    with jax.ensure_compile_time_eval():
+  # concrete connectivity can be materialized, see "jitconn_materialize"
+  with jax.ensure_compile_time_eval():
+    if isinstance(w_low, float): w_low = jnp.asarray(w_low, dtype=vector.dtype)
+    if isinstance(w_high, float): w_high = jnp.asarray(w_high, dtype=vector.dtype)
+    w_low = jnp.atleast_1d(jnp.asarray(w_low))
+    w_high = jnp.atleast_1d(jnp.asarray(w_high))
+    conn_len = jnp.ceil(1 / conn_prob) * 2 - 1
+    conn_len = jnp.asarray(jnp.atleast_1d(conn_len), dtype=jnp.int32)
+    if seed is None:
       seed = np.random.randint(0, int(1e8), 1)
-  seed = jnp.atleast_1d(jnp.asarray(seed, dtype=jnp.uint32))
+    seed = jnp.atleast_1d(jnp.asarray(seed, dtype=jnp.uint32))
+  if _is_philox(rng):
+    return raw_philox_mv_prob_uniform(vector, w_low, w_high, conn_len, seed, shape=shape, transpose=transpose)[0]
+  if use_materialized(conn_len, seed, w_low, w_high, shape=shape):
+    return raw_materialized_mv_prob_uniform(vector, w_low, w_high, conn_len, seed, shape=shape,
+                                            transpose=transpose, outdim_parallel=outdim_parallel)[0]
   return raw_mv_prob_uniform(vector, w_low, w_high, conn_len, seed, shape=shape,
                              transpose=transpose, outdim_parallel=outdim_parallel)[0]
 
@@ -195,6 +258,7 @@ def jitc_mv_prob_normal(
     shape: Tuple[int, int],
     transpose: bool = False,
     outdim_parallel: bool = True,
+    rng: str = 'lfsr88',
 ) -> jax.Array:
   r"""Perform the :math:`y=M@v` operation,
   where :math:`M` is just-in-time randomly generated with a normal distribution for its value.
@@ -240,6 +304,13 @@ def jitc_mv_prob_normal(
     Perform the parallel random generations along the out dimension or not.
     It can be used to set the just-in-time generated :math:M^T: is the same
     as the just-in-time generated :math:`M` when ``transpose=True``.
+  rng: str
+    The random number generator of the connectivity. ``'lfsr88'`` generates each
+    row (or column) of :math:`M` as one sequential LFSR88 stream. ``'philox'``
+    generates :math:`M` with the counter-based Philox-4x32-10 in independent chunks
+    of columns, which are processed in parallel. It generates the same :math:`M`
+    for ``transpose=False`` and ``transpose=True``, and ``outdim_parallel`` has
+    no effect.
 
   Returns
   -------
@@ -247,8 +318,360 @@ def jitc_mv_prob_normal(
     The output of :math:`y = M @ v`.
   """
   vector = jnp.asarray(vector)
-  if isinstance(w_mu, float): w_mu = jnp.asarray(w_mu, dtype=vector.dtype)
-  if isinstance(w_sigma, float): w_sigma = jnp.asarray(w_sigma, dtype=vector.dtype)
+  # concrete connectivity can be materialized, see "jitconn_materialize"
+  with jax.ensure_compile_time_eval():
+    if isinstance(w_mu, float): w_mu = jnp.asarray(w_mu, dtype=vector.dtype)
+    if isinstance(w_sigma, float): w_sigma = jnp.asarray(w_sigma, dtype=vector.dtype)
+    w_mu = jnp.atleast_1d(jnp.asarray(w_mu))
+    w_sigma = jnp.atleast_1d(jnp.asarray(w_sigma))
+    conn_len = jnp.ceil(1 / conn_prob) * 2 - 1
+    conn_len = jnp.asarray(jnp.atleast_1d(conn_len), dtype=jnp.int32)
+    if seed is None:
+      seed = np.random.randint(0, int(1e8), 1)
+    seed = jnp.atleast_1d(jnp.asarray(seed, dtype=jnp.uint32))
+  if _is_philox(rng):
+    return raw_philox_mv_prob_normal(vector, w_mu, w_sigma, conn_len, seed, shape=shape, transpose=transpose)[0]
+  if use_materialized(conn_len, seed, w_mu, w_sigma, shape=shape):
+    return raw_materialized_mv_prob_normal(vector, w_mu, w_sigma, conn_len, seed, shape=shape,
+                                           transpose=transpose, outdim_parallel=outdim_parallel)[0]
+  return raw_mv_prob_normal(vector, w_mu, w_sigma, conn_len, seed, shape=shape,
+                            transpose=transpose, outdim_parallel=outdim_parallel)[0]
+
+
+@set_module_as('braintaichi')
+def jitc_event_mv_prob_homo(
+    events: jax.Array,
+    weight: float,
+    conn_prob: float,
+    seed: Optional[int] = None,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+    rng: str = 'lfsr88',
+) -> jax.Array:
+  events = jnp.asarray(events)
+  weight = jnp.asarray(weight)
+  if jnp.ndim(weight) < 1:
+    weight = jnp.expand_dims(weight, axis=0)
+  # concrete connectivity can be materialized, see "jitconn_materialize"
+  with jax.ensure_compile_time_eval():
+    conn_len = jnp.ceil(1 / conn_prob) * 2 - 1
+    conn_len = jnp.asarray(jnp.atleast_1d(conn_len), dtype=jnp.int32)
+    if seed is None:
+      seed = np.random.randint(0, int(1e8), 1)
+    seed = jnp.atleast_1d(jnp.asarray(seed, dtype=jnp.uint32))
+  if _is_philox(rng):
+    return raw_philox_event_mv_prob_homo(events, weight, conn_len, seed, shape=shape, transpose=transpose)[0]
+  if events.dtype == jnp.bool_ and use_materialized(conn_len, seed, shape=shape):
+    return raw_materialized_mv_prob_homo(events, weight, conn_len, seed, shape=shape,
+                                         transpose=transpose, outdim_parallel=outdim_parallel)[0]
+  return raw_event_mv_prob_homo(events, weight, conn_len, seed,
+                                shape=shape,
+                                transpose=transpose,
+                                outdim_parallel=outdim_parallel)[0]
+
+
+jitc_event_mv_prob_homo.__doc__ = jitc_mv_prob_homo.__doc__
+
+
+@set_module_as('braintaichi')
+def jitc_event_mv_prob_uniform(
+    events: jax.Array,
+    w_low: float,
+    w_high: float,
+    conn_prob: float,
+    seed: Optional[int] = None,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+    rng: str = 'lfsr88',
+) -> jax.Array:
+  events = jnp.asarray(events)
+  # concrete connectivity can be materialized, see "jitconn_materialize"
+  with jax.ensure_compile_time_eval():
+    if isinstance(w_low, float): w_low = jnp.asarray(w_low)
+    if isinstance(w_high, float): w_high = jnp.asarray(w_high)
+    w_low = jnp.atleast_1d(jnp.asarray(w_low))
+    w_high = jnp.atleast_1d(jnp.asarray(w_high))
+    conn_len = jnp.ceil(1 / conn_prob) * 2 - 1
+    conn_len = jnp.asarray(jnp.atleast_1d(conn_len), dtype=jnp.int32)
+    if seed is None:
+      seed = np.random.randint(0, int(1e8), 1)
+    seed = jnp.atleast_1d(jnp.asarray(seed, dtype=jnp.uint32))
+  if _is_philox(rng):
+    return raw_philox_event_mv_prob_uniform(events, w_low, w_high, conn_len, seed,
+                                            shape=shape, transpose=transpose)[0]
+  if events.dtype == jnp.bool_ and use_materialized(conn_len, seed, w_low, w_high, shape=shape):
+    return raw_materialized_mv_prob_uniform(events, w_low, w_high, conn_len, seed, shape=shape,
+                                            transpose=transpose, outdim_parallel=outdim_parallel)[0]
+  return raw_event_mv_prob_uniform(events, w_low, w_high, conn_len, seed, shape=shape,
+                                   transpose=transpose, outdim_parallel=outdim_parallel)[0]
+
+
+jitc_event_mv_prob_uniform.__doc__ = jitc_mv_prob_uniform.__doc__
+
+
+@set_module_as('braintaichi')
+def jitc_event_mv_prob_normal(
+    events: jax.Array,
+    w_mu: float,
+    w_sigma: float,
+    conn_prob: float,
+    seed: Optional[int] = None,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+    rng: str = 'lfsr88',
+) -> jax.Array:
+  events = jnp.asarray(events)
+  # concrete connectivity can be materialized, see "jitconn_materialize"
+  with jax.ensure_compile_time_eval():
+    if isinstance(w_mu, float): w_mu = jnp.asarray(w_mu)
+    if isinstance(w_sigma, float): w_sigma = jnp.asarray(w_sigma)
+    w_mu = jnp.atleast_1d(jnp.asarray(w_mu))
+    w_sigma = jnp.atleast_1d(jnp.asarray(w_sigma))
+    conn_len = jnp.ceil(1 / conn_prob) * 2 - 1
+    conn_len = jnp.asarray(jnp.atleast_1d(conn_len), dtype=jnp.int32)
+    if seed is None:
+      seed = np.random.randint(0, int(1e8), 1)
+    seed = jnp.atleast_1d(jnp.asarray(seed, dtype=jnp.uint32))
+  if _is_philox(rng):
+    return raw_philox_event_mv_prob_normal(events, w_mu, w_sigma, conn_len, seed,
+                                           shape=shape, transpose=transpose)[0]
+  if events.dtype == jnp.bool_ and use_materialized(conn_len, seed, w_mu, w_sigma, shape=shape):
+    return raw_materialized_mv_prob_normal(events, w_mu, w_sigma, conn_len, seed, shape=shape,
+                                           transpose=transpose, outdim_parallel=outdim_parallel)[0]
+  return raw_event_mv_prob_normal(events, w_mu, w_sigma, conn_len, seed, shape=shape,
+                                  transpose=transpose, outdim_parallel=outdim_parallel)[0]
+
+
+jitc_event_mv_prob_normal.__doc__ = jitc_mv_prob_normal.__doc__
+
+
+@set_module_as('braintaichi')
+def jitc_mm_prob_homo(
+    matrix: jax.typing.ArrayLike,
+    weight: float,
+    conn_prob: float,
+    seed: Optional[int] = None,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  r"""Perform the :math:`Y=M@X` operation,
+  where :math:`M` is just-in-time randomly generated with a scalar `weight` at each position.
+
+  This operator support ``jit()``, ``vmap()``, ``grad()`` and ``pmap()`` etc. transformations
+  on CPU and GPU devices.
+
+  .. warning::
+
+     This API may change in the future.
+
+  Column ``b`` of :math:`Y` is the same as ``jitc_mv_prob_*`` applied to column ``b`` of
+  :math:`X` with the same ``seed``, but the random connectivity is generated once for
+  all the columns of :math:`X` instead of once for each of them.
+
+  When ``transpose=True``, we perform an operation of :math:`Y=M^T@X`.
+
+  .. note::
+
+     Note that the just-in-time generated :math:`M` (`transpose=False`) is
+     different from the generated :math:`M^T` (`transpose=True`).
+
+     If you pursue the same :math:`M` and :math:`M^T` when performing the just-in-time
+     matrix generation, you should set ``outdim_parallel=True``, with the sacrifice of
+     the speed compared with ``outdim_parallel=False``.
+
+  Parameters
+  ----------
+  matrix: Array, ndarray
+    The matrix :math:`X`, with the shape of ``(shape[1], k)``, or ``(shape[0], k)``
+    when ``transpose=True``.
+  weight: float
+    The value of the random matrix.
+  conn_prob: float
+    The connection probability.
+  shape: tuple of int
+    The shape of the random matrix :math:`M`.
+  seed: int
+    The random number generation seed.
+  transpose: bool
+    Transpose the random matrix or not.
+  outdim_parallel: bool
+    Perform the parallel random generations along the out dimension or not.
+    It can be used to set the just-in-time generated :math:M^T: is the same
+    as the just-in-time generated :math:`M` when ``transpose=True``.
+
+  Returns
+  -------
+  out: Array, ndarray
+    The output of :math:`Y = M @ X`.
+  """
+  matrix = jnp.asarray(matrix)
+  if isinstance(weight, float):
+    weight = jnp.asarray(weight, dtype=matrix.dtype)
+  weight = jnp.atleast_1d(jnp.asarray(weight))
+  conn_len = jnp.ceil(1 / conn_prob) * 2 - 1
+  conn_len = jnp.asarray(jnp.atleast_1d(conn_len), dtype=jnp.int32)
+  if seed is None:
+    with jax.ensure_compile_time_eval():
+      seed = np.random.randint(0, int(1e8), 1)
+  seed = jnp.atleast_1d(jnp.asarray(seed, dtype=jnp.uint32))
+  return raw_mm_prob_homo(matrix, weight, conn_len, seed, shape=shape,
+                          transpose=transpose, outdim_parallel=outdim_parallel)[0]
+
+
+@set_module_as('braintaichi')
+def jitc_mm_prob_uniform(
+    matrix: jax.typing.ArrayLike,
+    w_low: float,
+    w_high: float,
+    conn_prob: float,
+    seed: Optional[int] = None,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  r"""Perform the :math:`Y=M@X` operation,
+  where :math:`M` is just-in-time randomly generated with a uniform distribution for its value.
+
+  This operator support ``jit()``, ``vmap()``, ``grad()`` and ``pmap()`` etc. transformations
+  on CPU and GPU devices.
+
+  .. warning::
+
+     This API may change in the future.
+
+  Column ``b`` of :math:`Y` is the same as ``jitc_mv_prob_*`` applied to column ``b`` of
+  :math:`X` with the same ``seed``, but the random connectivity is generated once for
+  all the columns of :math:`X` instead of once for each of them.
+
+  When ``transpose=True``, we perform an operation of :math:`Y=M^T@X`.
+
+  .. note::
+
+     Note that the just-in-time generated :math:`M` (`transpose=False`) is
+     different from the generated :math:`M^T` (`transpose=True`).
+
+     If you pursue the same :math:`M` and :math:`M^T` when performing the just-in-time
+     matrix generation, you should set ``outdim_parallel=True``, with the sacrifice of
+     the speed compared with ``outdim_parallel=False``.
+
+  Parameters
+  ----------
+  matrix: Array, ndarray
+    The matrix :math:`X`, with the shape of ``(shape[1], k)``, or ``(shape[0], k)``
+    when ``transpose=True``.
+  w_low: float
+    Lower boundary of the output interval.
+  w_high: float
+    Upper boundary of the output interval.
+  conn_prob: float
+    The connection probability.
+  shape: tuple of int
+    The shape of the random matrix :math:`M`.
+  seed: int
+    The random number generation seed.
+  transpose: bool
+    Transpose the random matrix or not.
+  outdim_parallel: bool
+    Perform the parallel random generations along the out dimension or not.
+    It can be used to set the just-in-time generated :math:M^T: is the same
+    as the just-in-time generated :math:`M` when ``transpose=True``.
+
+  Returns
+  -------
+  out: Array, ndarray
+    The output of :math:`Y = M @ X`.
+  """
+  matrix = jnp.asarray(matrix)
+  if isinstance(w_low, float): w_low = jnp.asarray(w_low, dtype=matrix.dtype)
+  if isinstance(w_high, float): w_high = jnp.asarray(w_high, dtype=matrix.dtype)
+  w_low = jnp.atleast_1d(jnp.asarray(w_low))
+  w_high = jnp.atleast_1d(jnp.asarray(w_high))
+  conn_len = jnp.ceil(1 / conn_prob) * 2 - 1
+  conn_len = jnp.asarray(jnp.atleast_1d(conn_len), dtype=jnp.int32)
+  if seed is None:
+    with jax.ensure_compile_time_eval():
+      seed = np.random.randint(0, int(1e8), 1)
+  seed = jnp.atleast_1d(jnp.asarray(seed, dtype=jnp.uint32))
+  return raw_mm_prob_uniform(matrix, w_low, w_high, conn_len, seed, shape=shape,
+                             transpose=transpose, outdim_parallel=outdim_parallel)[0]
+
+
+@set_module_as('braintaichi')
+def jitc_mm_prob_normal(
+    matrix: jax.typing.ArrayLike,
+    w_mu: float,
+    w_sigma: float,
+    conn_prob: float,
+    seed: Optional[int] = None,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    outdim_parallel: bool = True,
+) -> jax.Array:
+  r"""Perform the :math:`Y=M@X` operation,
+  where :math:`M` is just-in-time randomly generated with a normal distribution for its value.
+
+  This operator support ``jit()``, ``vmap()``, ``grad()`` and ``pmap()`` etc. transformations
+  on CPU and GPU devices.
+
+  .. warning::
+
+     This API may change in the future.
+
+  Column ``b`` of :math:`Y` is the same as ``jitc_mv_prob_*`` applied to column ``b`` of
+  :math:`X` with the same ``seed``, but the random connectivity is generated once for
+  all the columns of :math:`X` instead of once for each of them.
+
+  When ``transpose=True``, we perform an operation of :math:`Y=M^T@X`.
+
+  .. note::
+
+     Note that the just-in-time generated :math:`M` (`transpose=False`) is
+     different from the generated :math:`M^T` (`transpose=True`).
+
+     If you pursue the same :math:`M` and :math:`M^T` when performing the just-in-time
+     matrix generation, you should set ``outdim_parallel=True``, with the sacrifice of
+     the speed compared with ``outdim_parallel=False``.
+
+  Parameters
+  ----------
+  matrix: Array, ndarray
+    The matrix :math:`X`, with the shape of ``(shape[1], k)``, or ``(shape[0], k)``
+    when ``transpose=True``.
+  w_mu: float
+    Mean of the normal distribution.
+  w_sigma: float
+    Standard deviation of the normal distribution.
+  conn_prob: float
+    The connection probability.
+  shape: tuple of int
+    The shape of the random matrix :math:`M`.
+  seed: int
+    The random number generation seed.
+  transpose: bool
+    Transpose the random matrix or not.
+  outdim_parallel: bool
+    Perform the parallel random generations along the out dimension or not.
+    It can be used to set the just-in-time generated :math:M^T: is the same
+    as the just-in-time generated :math:`M` when ``transpose=True``.
+
+  Returns
+  -------
+  out: Array, ndarray
+    The output of :math:`Y = M @ X`.
+  """
+  matrix = jnp.asarray(matrix)
+  if isinstance(w_mu, float): w_mu = jnp.asarray(w_mu, dtype=matrix.dtype)
+  if isinstance(w_sigma, float): w_sigma = jnp.asarray(w_sigma, dtype=matrix.dtype)
   w_mu = jnp.atleast_1d(jnp.asarray(w_mu))
   w_sigma = jnp.atleast_1d(jnp.asarray(w_sigma))
   conn_len = jnp.ceil(1 / conn_prob) * 2 - 1
@@ -257,12 +680,12 @@ def jitc_mv_prob_normal(
     with jax.ensure_compile_time_eval():
       seed = np.random.randint(0, int(1e8), 1)
   seed = jnp.atleast_1d(jnp.asarray(seed, dtype=jnp.uint32))
-  return raw_mv_prob_normal(vector, w_mu, w_sigma, conn_len, seed, shape=shape,
+  return raw_mm_prob_normal(matrix, w_mu, w_sigma, conn_len, seed, shape=shape,
                             transpose=transpose, outdim_parallel=outdim_parallel)[0]
 
 
 @set_module_as('braintaichi')
-def jitc_event_mv_prob_homo(
+def jitc_event_mm_prob_homo(
     events: jax.Array,
     weight: float,
     conn_prob: float,
@@ -273,26 +696,22 @@ def jitc_event_mv_prob_homo(
     outdim_parallel: bool = True,
 ) -> jax.Array:
   events = jnp.asarray(events)
-  weight = jnp.asarray(weight)
-  if jnp.ndim(weight) < 1:
-    weight = jnp.expand_dims(weight, axis=0)
+  weight = jnp.atleast_1d(jnp.asarray(weight))
   conn_len = jnp.ceil(1 / conn_prob) * 2 - 1
   conn_len = jnp.asarray(jnp.atleast_1d(conn_len), dtype=jnp.int32)
   if seed is None:
     with jax.ensure_compile_time_eval():
       seed = np.random.randint(0, int(1e8), 1)
   seed = jnp.atleast_1d(jnp.asarray(seed, dtype=jnp.uint32))
-  return raw_event_mv_prob_homo(events, weight, conn_len, seed,
-                                shape=shape,
-                                transpose=transpose,
-                                outdim_parallel=outdim_parallel)[0]
+  return raw_event_mm_prob_homo(events, weight, conn_len, seed, shape=shape,
+                                transpose=transpose, outdim_parallel=outdim_parallel)[0]
 
 
-jitc_event_mv_prob_homo.__doc__ = jitc_mv_prob_homo.__doc__
+jitc_event_mm_prob_homo.__doc__ = jitc_mm_prob_homo.__doc__
 
 
 @set_module_as('braintaichi')
-def jitc_event_mv_prob_uniform(
+def jitc_event_mm_prob_uniform(
     events: jax.Array,
     w_low: float,
     w_high: float,
@@ -314,15 +733,15 @@ def jitc_event_mv_prob_uniform(
     with jax.ensure_compile_time_eval():
       seed = np.random.randint(0, int(1e8), 1)
   seed = jnp.atleast_1d(jnp.asarray(seed, dtype=jnp.uint32))
-  return raw_event_mv_prob_uniform(events, w_low, w_high, conn_len, seed, shape=shape,
+  return raw_event_mm_prob_uniform(events, w_low, w_high, conn_len, seed, shape=shape,
                                    transpose=transpose, outdim_parallel=outdim_parallel)[0]
 
 
-jitc_event_mv_prob_uniform.__doc__ = jitc_mv_prob_uniform.__doc__
+jitc_event_mm_prob_uniform.__doc__ = jitc_mm_prob_uniform.__doc__
 
 
 @set_module_as('braintaichi')
-def jitc_event_mv_prob_normal(
+def jitc_event_mm_prob_normal(
     events: jax.Array,
     w_mu: float,
     w_sigma: float,
@@ -344,8 +763,8 @@ def jitc_event_mv_prob_normal(
     with jax.ensure_compile_time_eval():
       seed = np.random.randint(0, int(1e8), 1)
   seed = jnp.atleast_1d(jnp.asarray(seed, dtype=jnp.uint32))
-  return raw_event_mv_prob_normal(events, w_mu, w_sigma, conn_len, seed, shape=shape,
+  return raw_event_mm_prob_normal(events, w_mu, w_sigma, conn_len, seed, shape=shape,
                                   transpose=transpose, outdim_parallel=outdim_parallel)[0]
 
 
-jitc_event_mv_prob_normal.__doc__ = jitc_mv_prob_normal.__doc__
+jitc_event_mm_prob_normal.__doc__ = jitc_mm_prob_normal.__doc__
@@ -19,13 +19,16 @@
 #   2. Define the gradient operators for the primitive operators.
 #   3. Define the custom operators for the primitive operators.
 #   4. Define the custom operators for the primitive operators in XLA.
+#   5. Precompile the kernels of the operators into the AOT cache.
 
 
 from ._ad_support import *
 from ._ad_support import __all__ as __ad_support_all__
 from ._batch_utils import *
 from ._batch_utils import __all__ as __batch_utils_all__
+from ._precompile import *
+from ._precompile import __all__ as __precompile_all__
 from ._xla_custom_op import *
 from ._xla_custom_op import __all__ as __xla_custom_op_all__
 
-__all__ = __ad_support_all__ + __batch_utils_all__ + __xla_custom_op_all__
+__all__ = __ad_support_all__ + __batch_utils_all__ + __xla_custom_op_all__ + __precompile_all__
@@ -24,6 +24,7 @@ from jax.tree_util import tree_flatten, tree_unflatten
 
 __all__ = [
   'register_general_batching',
+  'register_vector_batching',
 ]
 
 
@@ -51,5 +52,29 @@ def register_general_batching(prim):
   batching.primitive_batchers[prim] = partial(_general_batching_rule, prim)
 
 
+def _vector_batching_rule(prim, matmat, vector_index, args, axes, **kwargs):
+  if any(ax is not None for i, ax in enumerate(axes) if i != vector_index):
+    return _general_batching_rule(prim, args, axes, **kwargs)
+  args = list(args)
+  args[vector_index] = jnp.moveaxis(args[vector_index], axes[vector_index], 1)
+  r = matmat(*args, **kwargs)
+  if not prim.multiple_results:
+    return r, 1
+  # the other results are discarded scratch outputs
+  scratch = [jnp.zeros(o.shape, o.dtype) for o in kwargs['outs'][1:]]
+  return [r] + scratch, [1] + [None] * len(scratch)
+
+
+def register_vector_batching(prim, matmat, vector_index):
+  """Batch a matrix-vector primitive over its vector with a matrix-matrix product.
+
+  When only the vector argument at ``vector_index`` is batched, the batch of
+  vectors is stacked into the columns of a matrix and computed by
+  ``matmat(*args, **kwargs)``, which returns the product with the
+  batch on its last axis. Otherwise, it falls back to the general batching rule.
+  """
+  batching.primitive_batchers[prim] = partial(_vector_batching_rule, prim, matmat, vector_index)
+
+
 def _shape_to_layout(shape):
   return tuple(range(len(shape) - 1, -1, -1))
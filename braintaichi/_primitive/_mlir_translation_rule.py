@@ -24,14 +24,17 @@ import pathlib
 import platform
 import re
 import shutil
+import types
 from functools import partial
 from typing import Any, Sequence, Union
 
 import numpy as np
 import taichi as ti
+from jax import numpy as jnp
 from jax.interpreters import mlir
 from jax.lib import xla_client
 from jaxlib.hlo_helpers import custom_call
+from taichi.types.ndarray_type import NdarrayType
 
 from ._batch_utils import _shape_to_layout
 
@@ -41,6 +44,8 @@ try:
 
   for _name, _value in cpu_ops.registrations().items():
     xla_client.register_custom_call_target(_name, _value, platform="cpu")
+  for _name, _value in getattr(cpu_ops, 'ffi_registrations', dict)().items():
+    xla_client.register_custom_call_target(_name, _value, platform="cpu", api_version=1)
 except ImportError:
   cpu_ops = None
 
@@ -50,9 +55,35 @@ try:
 
   for _name, _value in gpu_ops.registrations().items():
     xla_client.register_custom_call_target(_name, _value, platform="gpu")
+  for _name, _value in getattr(gpu_ops, 'ffi_registrations', dict)().items():
+    xla_client.register_custom_call_target(_name, _value, platform="gpu", api_version=1)
 except ImportError:
   gpu_ops = None
 
+# The custom-call flavour used to lower Taichi kernels:
+#
+# - "ffi": the XLA typed FFI. Dtypes and shapes come from the buffers, and the
+#   kernel identity is passed as attributes. Used whenever the extension was
+#   built with the FFI headers.
+# - "legacy": descriptor operands on CPU and an opaque string on GPU.
+custom_call_api = os.environ.get('BRAINTAICHI_CUSTOM_CALL', 'ffi')
+
+
+def _use_ffi(ops) -> bool:
+  if custom_call_api == 'legacy' or ops is None:
+    return False
+  if custom_call_api != 'ffi':
+    raise ValueError(f'Unknown custom call api: {custom_call_api}. Should be "ffi" or "legacy".')
+  return len(getattr(ops, 'ffi_registrations', dict)()) > 0
+
+# How the Taichi kernels are specialized on the shapes of their arguments:
+#
+# - "auto": when every parameter of a kernel is annotated as
+#   ``ti.types.ndarray``, the kernel is compiled once per dtype and ndim, and
+#   the shapes are supplied at launch time. Otherwise, as "off".
+# - "off": the kernel is compiled for the exact shapes of its arguments.
+shape_polymorphic = os.environ.get('BRAINTAICHI_SHAPE_POLYMORPHIC', 'auto')
+
 taichi_cache_path = None
 
 
@@ -107,6 +138,7 @@ def clear_taichi_aot_caches(kernels: Union[str, Sequence[str]] = None):
   kernels: str or list of str
     The name of the kernel to be cleaned. If None, all the kernels will be cleaned.
   """
+  _compiled_kernels.clear()
   if kernels is None:
     global taichi_cache_path
     if taichi_cache_path is None:
@@ -129,9 +161,8 @@ def clear_taichi_aot_caches(kernels: Union[str, Sequence[str]] = None):
       shutil.rmtree(os.path.join(kernels_aot_path, kernel_name))
 
 
-# TODO
-# not a very good way
-# get source with dependencies
+# get source with dependencies, which is only used to report build failures,
+# the cache key uses ``get_kernel_fingerprint()``
 def get_source_with_dependencies(func, visited=None):
   if visited is None:
     visited = set()
@@ -151,6 +182,97 @@ def get_source_with_dependencies(func, visited=None):
   return source
 
 
+# Packages whose functions are identified by name rather than by code: their
+# behavior is pinned by the installed version.
+_library_modules = ('taichi', 'jax', 'jaxlib', 'numpy', 'brainstate', 'brainunit', 'builtins')
+
+
+def _stable_repr(obj) -> str:
+  # a representation that does not depend on memory addresses, so that the
+  # fingerprint is the same in every process
+  if obj is None or isinstance(obj, (bool, int, float, complex, str, bytes, np.dtype, np.generic)):
+    return repr(obj)
+  if isinstance(obj, (tuple, list)):
+    return type(obj).__name__ + '(' + ','.join(_stable_repr(o) for o in obj) + ')'
+  if isinstance(obj, (set, frozenset)):
+    return type(obj).__name__ + '(' + ','.join(sorted(_stable_repr(o) for o in obj)) + ')'
+  if isinstance(obj, dict):
+    return 'dict(' + ','.join(sorted(f'{_stable_repr(k)}:{_stable_repr(v)}' for k, v in obj.items())) + ')'
+  if isinstance(obj, types.ModuleType):
+    return f'<module {obj.__name__}>'
+  if isinstance(obj, type):
+    return f'<class {obj.__module__}.{obj.__qualname__}>'
+  r = repr(obj)
+  if ' at 0x' not in r:
+    return r
+  r = str(obj)
+  if ' at 0x' not in r:
+    return r
+  name = f'{type(obj).__module__}.{type(obj).__qualname__}'
+  if hasattr(obj, '__dict__'):
+    return f'<{name} {_stable_repr(vars(obj))}>'
+  return f'<{name}>'
+
+
+def _update_value_fingerprint(md5, value, visited: set):
+  func = inspect.unwrap(value) if callable(value) else value
+  if isinstance(func, types.FunctionType):
+    module = (func.__module__ or '').split('.')[0]
+    if module not in _library_modules:
+      _update_function_fingerprint(md5, func, visited)
+      return
+    md5.update(f'<function {func.__module__}.{func.__qualname__}>'.encode('utf-8'))
+    return
+  md5.update(_stable_repr(value).encode('utf-8'))
+
+
+def _update_code_fingerprint(md5, code: types.CodeType, func, visited: set):
+  md5.update(code.co_code)
+  md5.update(_stable_repr(code.co_names).encode('utf-8'))
+  md5.update(_stable_repr(code.co_varnames).encode('utf-8'))
+  for const in code.co_consts:
+    if isinstance(const, types.CodeType):
+      _update_code_fingerprint(md5, const, func, visited)
+    else:
+      md5.update(_stable_repr(const).encode('utf-8'))
+  # the global functions and constants the code refers to
+  for name in code.co_names:
+    if name in func.__globals__:
+      md5.update(name.encode('utf-8'))
+      _update_value_fingerprint(md5, func.__globals__[name], visited)
+
+
+def _update_function_fingerprint(md5, func, visited: set):
+  if func in visited:
+    return
+  visited.add(func)
+  md5.update(f'<function {func.__qualname__}>'.encode('utf-8'))
+  _update_code_fingerprint(md5, func.__code__, func, visited)
+  md5.update(_stable_repr(func.__defaults__).encode('utf-8'))
+  md5.update(_stable_repr(func.__kwdefaults__).encode('utf-8'))
+  md5.update(_stable_repr(func.__annotations__).encode('utf-8'))
+  for cell in func.__closure__ or ():
+    try:
+      _update_value_fingerprint(md5, cell.cell_contents, visited)
+    except ValueError:  # an empty cell
+      md5.update(b'<empty cell>')
+
+
+_kernel_fingerprints = {}
+
+
+# the fingerprint of the code of a kernel and of all the functions, constants and
+# closure variables it depends on
+def get_kernel_fingerprint(kernel) -> str:
+  fingerprint = _kernel_fingerprints.get(kernel)
+  if fingerprint is None:
+    md5 = hashlib.md5()
+    _update_function_fingerprint(md5, inspect.unwrap(kernel), set())
+    fingerprint = md5.hexdigest()
+    _kernel_fingerprints[kernel] = fingerprint
+  return fingerprint
+
+
 # check if Metal is supported
 def is_metal_supported():
   # first check if we are on macOS
@@ -182,49 +304,55 @@ def _check_kernel_exist(source_md5_encode: str) -> bool:
 # --- KERNEL AOT BUILD ###
 
 
-def _array_to_field(dtype, shape) -> Any:
+def _to_taichi_dtype(dtype) -> Any:
   if dtype == np.bool_:
-    dtype = bool
+    return bool
   elif dtype == np.int8:
-    dtype = ti.int8
+    return ti.int8
   elif dtype == np.int16:
-    dtype = ti.int16
+    return ti.int16
   elif dtype == np.int32:
-    dtype = ti.int32
+    return ti.int32
   elif dtype == np.int64:
-    dtype = ti.int64
+    return ti.int64
   elif dtype == np.uint8:
-    dtype = ti.uint8
+    return ti.uint8
   elif dtype == np.uint16:
-    dtype = ti.uint16
+    return ti.uint16
   elif dtype == np.uint32:
-    dtype = ti.uint32
+    return ti.uint32
   elif dtype == np.uint64:
-    dtype = ti.uint64
+    return ti.uint64
   elif dtype == np.float16:
-    dtype = ti.float16
+    return ti.float16
+  elif dtype == jnp.bfloat16:
+    # Taichi has no bfloat16, the kernels receive its bits and decode them,
+    # see "bf16_to_f32" in "_sparse_utils.py"
+    return ti.uint16
   elif dtype == np.float32:
-    dtype = ti.float32
+    return ti.float32
   elif dtype == np.float64:
-    dtype = ti.float64
+    return ti.float64
   else:
     raise NotImplementedError(
       f'Currently we do not support dtype {dtype} in Taichi. '
       f'If you think it is necessary, please open an issue at '
       f'https://github.com/chaoming0625/braintaichi/issues/new'
     )
-  return ti.field(dtype=dtype, shape=shape)
 
 
-# build aot kernel
-def _build_kernel(
-    source_md5_encode: str,
-    kernel: callable,
-    ins: dict,
-    outs: dict,
-    device: str
-):
-  # init arch
+def _array_to_field(dtype, shape) -> Any:
+  return ti.field(dtype=_to_taichi_dtype(dtype), shape=shape)
+
+
+def _array_to_ndarray(dtype, ndim) -> Any:
+  # only the dtype and the ndim of the template are compiled into the kernel,
+  # so a tiny array is enough
+  return ti.ndarray(dtype=_to_taichi_dtype(dtype), shape=(1,) * ndim)
+
+
+# init the Taichi arch of a device, return the arch and the device name of the kernels
+def _init_taichi_arch(device: str):
   if device == 'cpu':
     if is_metal_device:
       arch = ti.arm64
@@ -241,6 +369,25 @@ def _build_kernel(
   # check arch is available
   if ti.lang.impl.current_cfg().arch != arch:
     raise RuntimeError(f"Arch {arch} is not available")
+  return arch, device
+
+
+# build aot kernel
+def _build_kernel(
+    source_md5_encode: str,
+    kernel: callable,
+    ins: dict,
+    outs: dict,
+    device: str,
+    polymorphic: bool = False,
+    arch=None,
+    static_args: dict = None,
+):
+  # init arch, unless the caller has already done it for a batch of kernels
+  if arch is None:
+    arch, device = _init_taichi_arch(device)
+  elif device == 'cpu' and is_metal_device:
+    device = 'arm64'
 
   # get kernel name
   kernel_name = kernel.__name__
@@ -250,10 +397,13 @@ def _build_kernel(
 
   # init template_args_dict
   template_args_dict = {}
+  to_template = _array_to_ndarray if polymorphic else _array_to_field
   for key, value in ins.items():
-    template_args_dict[key] = _array_to_field(value[0], value[1])
+    template_args_dict[key] = to_template(value[0], value[1])
   for key, value in outs.items():
-    template_args_dict[key] = _array_to_field(value[0], value[1])
+    template_args_dict[key] = to_template(value[0], value[1])
+  # the values of the static parameters, and placeholders of the scalars
+  template_args_dict.update(static_args or {})
 
   # make aot dir
   kernel_path = os.path.join(kernels_aot_path, source_md5_encode)
@@ -287,6 +437,7 @@ type_number_map = {
   np.dtype('int64'): 9,
   np.dtype('float16'): 10,
   np.dtype('float64'): 11,
+  np.dtype(jnp.bfloat16): 12,
 }
 
 
@@ -295,6 +446,8 @@ def _preprocess_kernel_call_cpu(
     source_md5_encode: str,
     ins: Sequence,
     outs: Sequence,
+    zero_mask: int,
+    scalar_mask: int,
 ) -> list:
   in_out_info = []
   max_dim_count = 0
@@ -312,7 +465,6 @@ def _preprocess_kernel_call_cpu(
   kernel_path = np.array(list(kernel_path), dtype=np.uint8)
 
   # other args
-  in_out_num = np.array([len(ins), len(outs), kernel_path.size], dtype=np.uint32)
   in_out_type_list = np.zeros((len(ins) + len(outs),), dtype=np.uint32)
   in_out_dim_count_list = np.zeros((len(ins) + len(outs),), dtype=np.uint32)
   in_out_elem_count_list = np.zeros((len(ins) + len(outs),), dtype=np.uint32)
@@ -333,6 +485,14 @@ def _preprocess_kernel_call_cpu(
     for j, dim in enumerate(value.shape):
       in_out_shape_list[i + b, j] = dim
 
+  # the launch plan key, which lets the runtime cache the resolved kernel and
+  # the ndarray descriptors of this call site instead of rebuilding them per call
+  plan_key = _launch_plan_key(in_out_type_list, in_out_dim_count_list,
+                              in_out_elem_count_list, in_out_shape_list, kernel_path,
+                              np.array([zero_mask, scalar_mask], dtype=np.uint32))
+  in_out_num = np.array([len(ins), len(outs), kernel_path.size,
+                         plan_key & 0xFFFFFFFF, plan_key >> 32, zero_mask, scalar_mask], dtype=np.uint32)
+
   in_out_info.append(in_out_num)
   in_out_info.append(in_out_type_list)
   in_out_info.append(in_out_dim_count_list)
@@ -343,10 +503,19 @@ def _preprocess_kernel_call_cpu(
   return in_out_info
 
 
+def _launch_plan_key(*descriptors: np.ndarray) -> int:
+  md5 = hashlib.md5()
+  for d in descriptors:
+    md5.update(np.asarray(d.shape, dtype=np.uint32).tobytes())
+    md5.update(d.tobytes())
+  return int.from_bytes(md5.digest()[:8], 'little')
+
+
 def _preprocess_kernel_call_gpu(
     source_md5_encode: str,
     ins: Sequence,
     outs: Sequence,
+    zero_mask: int,
 ) -> bytes:
   # if len(ins) + len(outs) > 8:
   #   raise ValueError('The number of ins and outs must be less than 8!')
@@ -354,7 +523,7 @@ def _preprocess_kernel_call_gpu(
 
   # other args
   param_total_num = len(ins) + len(outs)
-  in_out_num = [len(ins), len(outs)]
+  in_out_num = [len(ins), len(outs), zero_mask]
   in_out_type_list = [0] * param_total_num
   in_out_dim_count_list = [0] * param_total_num
   in_out_elem_count_list = [0] * param_total_num
@@ -391,61 +560,262 @@ def _preprocess_kernel_call_gpu(
   return opaque
 
 
-def _kernel_to_code(kernel, abs_ins, abs_outs, platform):
-  codes = f'[taichi {platform} kernel]\n' + get_source_with_dependencies(kernel)
-  codes += '\n[ins]: {}'.format("-".join([f'{v.dtype}[{v.shape}]' for v in abs_ins]))
-  codes += '\n[outs]: {}'.format("-".join([f'{v.dtype}[{v.shape}]' for v in abs_outs]))
+# The parameters of a kernel are its inputs followed by its outputs, except the
+# static ones:
+#
+# - a parameter annotated with ``ti.template()`` is static. Its value is the keyword
+#   argument of the same name given to the operator, which is compiled into the
+#   kernel and is part of its cache key, so that one kernel covers the variants of
+#   a flag and the compiler folds it.
+# - a parameter annotated with ``ti.i32``, ``ti.u32`` or ``ti.f32`` takes an input of
+#   one element of that dtype, which is passed to the kernel by value. Only the CPU
+#   kernels have them: the GPU ones read such inputs from device arrays, as the
+#   runtime would otherwise copy them to the host and wait at every launch.
+# - the other parameters take arrays.
+_scalar_annotations = {id(ti.i32): np.dtype('int32'),
+                       id(ti.u32): np.dtype('uint32'),
+                       id(ti.f32): np.dtype('float32')}
+
+# kernel -> (the names of the static parameters, the other parameters)
+_kernel_signatures = {}
+
+
+def _kernel_signature(kernel):
+  signature = _kernel_signatures.get(kernel)
+  if signature is None:
+    params = tuple(inspect.signature(kernel).parameters.values())
+    static = tuple(p.name for p in params if isinstance(p.annotation, ti.template))
+    signature = (static, tuple(p for p in params if not isinstance(p.annotation, ti.template)))
+    _kernel_signatures[kernel] = signature
+  return signature
+
+
+def _static_args(kernel, kwargs) -> dict:
+  """The values of the static parameters of a kernel, taken from the keyword arguments of its operator."""
+  static, _ = _kernel_signature(kernel)
+  missing = [name for name in static if name not in kwargs]
+  if len(missing):
+    raise ValueError(f'The static parameters {missing} of the kernel {kernel.__name__} '
+                     f'should be given as keyword arguments of its operator.')
+  return {name: kwargs[name] for name in static}
+
+
+def _scalar_input_mask(kernel, abs_ins) -> int:
+  """The bit mask of the inputs which are passed to the kernel by value."""
+  _, params = _kernel_signature(kernel)
+  mask = 0
+  for i, (param, v) in enumerate(zip(params, abs_ins)):
+    dtype = _scalar_annotations.get(id(param.annotation))
+    if dtype is None:
+      continue
+    if v.dtype != dtype or int(np.prod(v.shape)) != 1:
+      raise ValueError(f'The parameter "{param.name}" of the kernel {kernel.__name__} is a scalar of {dtype}, '
+                       f'but got an input of {v.dtype}{list(v.shape)}.')
+    mask |= 1 << i
+  return mask
+
+
+def _is_shape_polymorphic(kernel) -> bool:
+  if shape_polymorphic == 'off':
+    return False
+  if shape_polymorphic != 'auto':
+    raise ValueError(f'Unknown shape polymorphic mode: {shape_polymorphic}. Should be "auto" or "off".')
+  _, params = _kernel_signature(kernel)
+  return all(isinstance(p.annotation, NdarrayType) or id(p.annotation) in _scalar_annotations for p in params)
+
+
+def _kernel_to_code(kernel, abs_ins, abs_outs, platform, polymorphic=False, static=None):
+  codes = f'[taichi {platform} kernel]\n' + get_kernel_fingerprint(kernel)
+  if static:
+    codes += '\n[static]: {}'.format(",".join(f'{k}={_stable_repr(v)}' for k, v in sorted(static.items())))
+  if polymorphic:
+    codes += '\n[ins]: {}'.format("-".join([f'{v.dtype}[ndim={v.ndim}]' for v in abs_ins]))
+    codes += '\n[outs]: {}'.format("-".join([f'{v.dtype}[ndim={v.ndim}]' for v in abs_outs]))
+  else:
+    codes += '\n[ins]: {}'.format("-".join([f'{v.dtype}[{v.shape}]' for v in abs_ins]))
+    codes += '\n[outs]: {}'.format("-".join([f'{v.dtype}[{v.shape}]' for v in abs_outs]))
   return codes
 
 
-def _compile_kernel(abs_ins, kernel, platform: str, **kwargs):
-  # input and output abstract information
-  abs_outs = kwargs['outs']
-
+def _kernel_build_info(abs_ins, abs_outs, kernel, platform: str, static: dict = None):
   # kernel to code
-  codes = _kernel_to_code(kernel, abs_ins, abs_outs, platform)
+  polymorphic = _is_shape_polymorphic(kernel)
+  codes = _kernel_to_code(kernel, abs_ins, abs_outs, platform, polymorphic, static)
   source_md5_encode = os.path.join(kernel.__name__, encode_md5(codes))
 
-  # create ins, outs dict from kernel's args
+  # create ins, outs dict from kernel's args, where the scalars only need a
+  # placeholder of their type next to the static values
   in_num = len(abs_ins)
-  names = tuple(inspect.signature(kernel).parameters.keys())
+  _, params = _kernel_signature(kernel)
+  scalar_mask = _scalar_input_mask(kernel, abs_ins)
+  static_args = dict(static or {})
+  for i in range(in_num):
+    if (scalar_mask >> i) & 1:
+      static_args[params[i].name] = 0. if abs_ins[i].dtype == np.float32 else 0
+  names = tuple(p.name for p in params)
   in_names, out_names = names[:in_num], names[in_num:]
-  ins_dict = {key: (abs_ins[i].dtype, abs_ins[i].shape) for i, key in enumerate(in_names)}
-  outs_dict = {key: (abs_outs[i].dtype, abs_outs[i].shape) for i, key in enumerate(out_names)}
+  if polymorphic:
+    ins_dict = {key: (abs_ins[i].dtype, abs_ins[i].ndim) for i, key in enumerate(in_names) if key not in static_args}
+    outs_dict = {key: (abs_outs[i].dtype, abs_outs[i].ndim) for i, key in enumerate(out_names)}
+  else:
+    ins_dict = {key: (abs_ins[i].dtype, abs_ins[i].shape) for i, key in enumerate(in_names) if key not in static_args}
+    outs_dict = {key: (abs_outs[i].dtype, abs_outs[i].shape) for i, key in enumerate(out_names)}
+  return source_md5_encode, ins_dict, outs_dict, static_args, polymorphic, codes
+
+
+# (kernel, platform, ins, outs, static values, shape polymorphic mode) -> the key of the built kernel
+_compiled_kernels = {}
+
+
+def _compile_kernel(abs_ins, kernel, platform: str, **kwargs):
+  # input and output abstract information
+  abs_outs = kwargs['outs']
+  static = _static_args(kernel, kwargs)
+
+  # a kernel which was built by this process only needs a dictionary lookup
+  memo_key = (kernel, platform,
+              tuple((v.shape, str(v.dtype)) for v in abs_ins),
+              tuple((v.shape, str(v.dtype)) for v in abs_outs),
+              tuple(static.items()),
+              shape_polymorphic)
+  source_md5_encode = _compiled_kernels.get(memo_key)
+  if source_md5_encode is not None:
+    return source_md5_encode
+
+  source_md5_encode, ins_dict, outs_dict, static_args, polymorphic, codes = _kernel_build_info(
+    abs_ins, abs_outs, kernel, platform, static
+  )
 
   # build kernels
   if not _check_kernel_exist(source_md5_encode):  # TODO: more checking
     try:
-      _build_kernel(source_md5_encode, kernel, ins_dict, outs_dict, platform)
+      _build_kernel(source_md5_encode, kernel, ins_dict, outs_dict, platform, polymorphic, static_args=static_args)
     except Exception as e:
+      codes += '\n[source]:\n' + get_source_with_dependencies(kernel)
       try:
         os.removedirs(os.path.join(kernels_aot_path, source_md5_encode))
       except Exception:
         raise RuntimeError(f'Failed to preprocess info to build kernel:\n\n {codes}') from e
       raise RuntimeError(f'Failed to build kernel:\n\n {codes}') from e
 
-  # returns
-  if platform in ['gpu', 'cuda']:
-    opaque = _preprocess_kernel_call_gpu(source_md5_encode, abs_ins, abs_outs)
-    return opaque
-  elif platform == 'cpu':
-    in_out_info = _preprocess_kernel_call_cpu(source_md5_encode, abs_ins, abs_outs)
-    return in_out_info
-  else:
-    raise ValueError(f'Unknown platform: {platform}')
+  if platform == 'cpu':
+    _preload_kernel_cpu(source_md5_encode)
+  _compiled_kernels[memo_key] = source_md5_encode
+  return source_md5_encode
+
+
+def _preload_kernel_cpu(source_md5_encode: str):
+  # load the module into the runtime now, so that the first launch does not touch the disk
+  preload = getattr(cpu_ops, 'preload_kernel_arm64' if is_metal_device else 'preload_kernel', None)
+  if preload is not None:
+    preload(os.path.join(kernels_aot_path, source_md5_encode))
+
+
+def _ffi_plan_key(kernel_path: str, abs_ins, abs_outs, zero_mask: int, scalar_mask: int) -> int:
+  md5 = hashlib.md5(kernel_path.encode('utf-8'))
+  for v in tuple(abs_ins) + tuple(abs_outs):
+    md5.update(f'{v.dtype}{v.shape};'.encode('utf-8'))
+  md5.update(f'zero={zero_mask};scalar={scalar_mask}'.encode('utf-8'))
+  return int.from_bytes(md5.digest()[:8], 'little', signed=True)
+
+
+# How every output is initialised before the kernel is launched:
+#
+# - "zero": it is zeroed before the launch, for the kernels which accumulate into
+#   it. On CPU, XLA fills a buffer of the full size of the output with zeros, which
+#   the output aliases, see "_zero_operands()". This is one more pass over the
+#   output, on one thread, so the CPU kernels rather zero it in a parallel loop. On
+#   GPU, the runtime zeroes it on the stream.
+# - "overwrite": the kernel writes every element, or zeroes it in its own parallel
+#   loops, so it is left as it is.
+# - "input": the caller provides its contents through an input it aliases, see
+#   "input_output_aliases" of "XLACustomOp".
+#
+# The outputs without a declaration are left as they are, and the aliased ones are
+# inputs.
+output_init_kinds = ('zero', 'overwrite', 'input')
+
+
+def _zero_output_mask(num_out: int, aliases=None, output_init=None) -> int:
+  """The bit mask of the outputs which are zeroed before the launch."""
+  aliased = set(aliases.values()) if aliases else set()
+  output_init = tuple(output_init or ())
+  mask = 0
+  for i in range(num_out):
+    if i not in aliased and i < len(output_init) and output_init[i] == 'zero':
+      mask |= 1 << i
+  return mask
+
+
+def _zero_operands(avals_out, zero_mask: int, first: int):
+  """The zero buffers of the outputs in ``zero_mask``, and the aliases of these
+  outputs to them, given the index ``first`` of the first of these operands.
+
+  The buffers are broadcasts of a zero which XLA fills before the call, so that the
+  CPU runtime does not zero the outputs on the thread which launches the kernel.
+  """
+  zeros, aliases = [], {}
+  for i, aval in enumerate(avals_out):
+    if (zero_mask >> i) & 1:
+      aliases[first + len(zeros)] = i
+      zeros.append((mlir.ir_constant(np.broadcast_to(np.zeros((), aval.dtype), aval.shape)), aval))
+  return zeros, aliases
+
+
+# An output which aliases an input is written into the buffer of that input. It is
+# not zeroed, so the kernel finds the contents of the input in it and can update
+# them in place.
+
+def _taichi_ffi_custom_call(call_target_name, source_md5_encode, c, ins, aliases, zero_mask, scalar_mask=None,
+                            zeros=()):
+  kernel_path = os.path.join(kernels_aot_path, source_md5_encode)
+  i64 = mlir.ir.IntegerType.get_signless(64)
+  backend_config = dict(
+    kernel_path=mlir.ir.StringAttr.get(kernel_path),
+    zero_outputs=mlir.ir.IntegerAttr.get(i64, zero_mask),
+  )
+  if scalar_mask is not None:
+    # the CPU runtimes pass the scalars by value, and cache the launch plan of
+    # every call site under this key
+    backend_config['scalar_inputs'] = mlir.ir.IntegerAttr.get(i64, scalar_mask)
+    backend_config['plan_key'] = mlir.ir.IntegerAttr.get(i64, _ffi_plan_key(kernel_path, c.avals_in, c.avals_out,
+                                                                             zero_mask, scalar_mask))
+  # the zero buffers, if any, follow the inputs
+  return custom_call(
+    call_target_name=call_target_name,
+    operands=list(ins) + [z for z, _ in zeros],
+    operand_layouts=[_shape_to_layout(a.shape) for a in c.avals_in] + [_shape_to_layout(a.shape) for _, a in zeros],
+    result_layouts=[_shape_to_layout(out.shape) for out in c.avals_out],
+    result_types=[mlir.aval_to_ir_type(out) for out in c.avals_out],
+    backend_config=backend_config,
+    operand_output_aliases=dict(aliases) if aliases else None,
+    api_version=4,
+    has_side_effect=False,
+  ).results
 
 
-def _taichi_mlir_cpu_translation_rule(kernel, c, *ins, **kwargs):
+def _taichi_mlir_cpu_translation_rule(kernel, aliases, output_init, c, *ins, **kwargs):
   if cpu_ops is None:
     raise RuntimeError(
       'The CPU kernels do not build correctly. '
       'Please check the installation of braintaichi.'
     )
 
-  in_out_info = _compile_kernel(c.avals_in, kernel, 'cpu', **kwargs)
-  ins = [mlir.ir_constant(v) for v in in_out_info] + list(ins)
-  input_layouts = [_shape_to_layout(arr.shape) for arr in in_out_info] + [_shape_to_layout(a.shape) for a in
-                                                                          c.avals_in]
+  source_md5_encode = _compile_kernel(c.avals_in, kernel, 'cpu', **kwargs)
+  zero_mask = _zero_output_mask(len(c.avals_out), aliases, output_init)
+  scalar_mask = _scalar_input_mask(kernel, c.avals_in)
+  if _use_ffi(cpu_ops):
+    fn = 'taichi_kernel_ffi_call_cpu_arm64' if is_metal_device else 'taichi_kernel_ffi_call_cpu'
+    zeros, zero_aliases = _zero_operands(c.avals_out, zero_mask, len(ins))
+    return _taichi_ffi_custom_call(fn, source_md5_encode, c, ins, {**(aliases or {}), **zero_aliases}, zero_mask,
+                                   scalar_mask, zeros)
+
+  in_out_info = _preprocess_kernel_call_cpu(source_md5_encode, c.avals_in, c.avals_out, zero_mask, scalar_mask)
+  zeros, zero_aliases = _zero_operands(c.avals_out, zero_mask, len(in_out_info) + len(ins))
+  ins = [mlir.ir_constant(v) for v in in_out_info] + list(ins) + [z for z, _ in zeros]
+  input_layouts = ([_shape_to_layout(arr.shape) for arr in in_out_info] +
+                   [_shape_to_layout(a.shape) for a in c.avals_in] +
+                   [_shape_to_layout(a.shape) for _, a in zeros])
   output_layouts = tuple([_shape_to_layout(out.shape) for out in c.avals_out])
   result_types = [mlir.aval_to_ir_type(out) for out in c.avals_out]
   if is_metal_device:
@@ -458,23 +828,36 @@ def _taichi_mlir_cpu_translation_rule(kernel, c, *ins, **kwargs):
       fn = 'taichi_kernel_aot_call_cpu_single_result'
     else:
       fn = 'taichi_kernel_aot_call_cpu'
+  # the operands start with the descriptor constants, and end with the zero buffers
+  operand_output_aliases = {len(in_out_info) + i: o for i, o in aliases.items()} if aliases else {}
+  operand_output_aliases.update(zero_aliases)
   return custom_call(
     call_target_name=fn,
     operands=ins,
     operand_layouts=list(input_layouts),
     result_layouts=list(output_layouts),
     result_types=list(result_types),
+    operand_output_aliases=operand_output_aliases or None,
     has_side_effect=False,
   ).results
 
 
-def _taichi_mlir_gpu_translation_rule(kernel, c, *ins, **kwargs):
+def _taichi_mlir_gpu_translation_rule(kernel, aliases, output_init, c, *ins, **kwargs):
   if gpu_ops is None:
     raise RuntimeError(
       'The GPU kernels are not supported on this device. '
       'Please install the GPU supported version of braintaichi.'
     )
-  opaque = _compile_kernel(c.avals_in, kernel, 'gpu', **kwargs)
+  if _scalar_input_mask(kernel, c.avals_in):
+    raise ValueError(f'The GPU kernel {kernel.__name__} should take its scalars as arrays of one element. '
+                     f'Passing them by value would copy them to the host at every launch.')
+  source_md5_encode = _compile_kernel(c.avals_in, kernel, 'gpu', **kwargs)
+  zero_mask = _zero_output_mask(len(c.avals_out), aliases, output_init)
+  if _use_ffi(gpu_ops):
+    # the GPU runtime has no launch plans, see "gpu_taichi_ffi_call.cu"
+    return _taichi_ffi_custom_call('taichi_kernel_ffi_call_gpu', source_md5_encode, c, ins, aliases, zero_mask)
+
+  opaque = _preprocess_kernel_call_gpu(source_md5_encode, c.avals_in, c.avals_out, zero_mask)
   input_layouts = [_shape_to_layout(a.shape) for a in c.avals_in]
   result_types = [mlir.aval_to_ir_type(out) for out in c.avals_out]
   output_layouts = [_shape_to_layout(out.shape) for out in c.avals_out]
@@ -485,15 +868,16 @@ def _taichi_mlir_gpu_translation_rule(kernel, c, *ins, **kwargs):
     result_layouts=list(output_layouts),
     result_types=list(result_types),
     backend_config=opaque,
+    operand_output_aliases=dict(aliases) if aliases else None,
     has_side_effect=False,
   ).results
 
 
-def register_taichi_aot_mlir_cpu_translation_rule(primitive, cpu_kernel):
-  rule = partial(_taichi_mlir_cpu_translation_rule, cpu_kernel)
+def register_taichi_aot_mlir_cpu_translation_rule(primitive, cpu_kernel, aliases=None, output_init=None):
+  rule = partial(_taichi_mlir_cpu_translation_rule, cpu_kernel, aliases, output_init)
   mlir.register_lowering(primitive, rule, platform='cpu')
 
 
-def register_taichi_aot_mlir_gpu_translation_rule(primitive, gpu_kernel):
-  rule = partial(_taichi_mlir_gpu_translation_rule, gpu_kernel)
+def register_taichi_aot_mlir_gpu_translation_rule(primitive, gpu_kernel, aliases=None, output_init=None):
+  rule = partial(_taichi_mlir_gpu_translation_rule, gpu_kernel, aliases, output_init)
   mlir.register_lowering(primitive, rule, platform='gpu')
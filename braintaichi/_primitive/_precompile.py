@@ -0,0 +1,162 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+import multiprocessing
+import os
+import pickle
+from concurrent.futures import ProcessPoolExecutor
+from typing import Sequence, Union, Tuple, List
+
+import jax
+
+from . import _mlir_translation_rule as rule
+from ._xla_custom_op import XLACustomOp
+
+__all__ = [
+  'precompile',
+]
+
+
+def _to_shaped_arrays(arrays) -> Tuple[jax.core.ShapedArray, ...]:
+  return tuple(jax.core.ShapedArray(a.shape, a.dtype) for a in arrays)
+
+
+def _collect_jobs(ops, signatures, platforms) -> Tuple[List[str], List[tuple]]:
+  keys, jobs = [], {}
+  for op, op_signatures in zip(ops, signatures):
+    if not isinstance(op, XLACustomOp):
+      raise TypeError(f'Only XLACustomOp can be precompiled, but got {type(op)}.')
+    for platform in platforms:
+      if platform == 'cpu':
+        kernel = op.cpu_kernel
+      elif platform == 'gpu':
+        kernel = op.gpu_kernel
+      else:
+        raise ValueError(f'Unknown platform: {platform}. Should be "cpu" or "gpu".')
+      if not callable(kernel):
+        continue
+      for signature in op_signatures:
+        ins, outs = signature[:2]
+        static = rule._static_args(kernel, signature[2] if len(signature) > 2 else {})
+        abs_ins, abs_outs = _to_shaped_arrays(ins), _to_shaped_arrays(outs)
+        key, ins_dict, outs_dict, static_args, polymorphic, _ = rule._kernel_build_info(
+          abs_ins, abs_outs, kernel, platform, static
+        )
+        keys.append(key)
+        if key not in jobs and not rule._check_kernel_exist(key):
+          jobs[key] = (key, kernel, ins_dict, outs_dict, platform, polymorphic, static_args)
+  return keys, list(jobs.values())
+
+
+def _build_kernels(jobs) -> List[Tuple[str, str]]:
+  # one ``ti.init`` per platform for the whole batch, instead of one per kernel
+  failures = []
+  arch, last_platform = None, None
+  for key, kernel, ins_dict, outs_dict, platform, polymorphic, static_args in sorted(jobs, key=lambda job: job[4]):
+    try:
+      if platform != last_platform:
+        arch, _ = rule._init_taichi_arch(platform)
+        last_platform = platform
+      rule._build_kernel(key, kernel, ins_dict, outs_dict, platform, polymorphic, arch=arch,
+                         static_args=static_args)
+    except Exception as e:
+      try:
+        os.removedirs(os.path.join(rule.kernels_aot_path, key))
+      except Exception:
+        pass
+      failures.append((key, f'{type(e).__name__}: {e}'))
+  return failures
+
+
+def _is_picklable(kernel) -> bool:
+  try:
+    pickle.dumps(kernel)
+    return True
+  except Exception:
+    return False
+
+
+def precompile(
+    ops: Union[XLACustomOp, Sequence[XLACustomOp]],
+    signatures: Sequence,
+    platforms: Union[str, Sequence[str]] = 'cpu',
+    num_workers: int = None,
+) -> List[str]:
+  """
+  Build the Taichi kernels of operators into the AOT cache ahead of time.
+
+  Kernels are otherwise compiled lazily when an operator is first lowered by
+  ``jax.jit``. Warming up the cache, for example when building a container
+  image, leaves no compile work for the first run.
+
+  Kernels which are already in the cache are skipped. The remaining ones are
+  split among ``num_workers`` processes, and each process initializes Taichi
+  once for all the kernels it builds.
+
+  Parameters
+  ----------
+  ops: XLACustomOp or sequence of XLACustomOp
+    The operators to compile.
+  signatures: sequence
+    The ``(ins, outs)`` pairs to compile, where ``ins`` and ``outs`` are sequences
+    of objects with ``shape`` and ``dtype``, such as ``jax.ShapeDtypeStruct``.
+    A kernel with static (``ti.template()``) parameters takes ``(ins, outs, static)``
+    triples instead, where ``static`` is the dict of their values. When ``ops``
+    is a sequence, it is a sequence of such lists, one for each operator.
+  platforms: str or sequence of str
+    The platforms to compile for, ``'cpu'`` and/or ``'gpu'``.
+  num_workers: int
+    The number of processes to build kernels in. Defaults to ``os.cpu_count()``.
+    Kernels which can not be pickled are built in the current process.
+
+  Returns
+  -------
+  keys: list of str
+    The cache keys of all the requested kernels.
+  """
+  if isinstance(ops, XLACustomOp):
+    ops, signatures = [ops], [signatures]
+  if len(ops) != len(signatures):
+    raise ValueError(f'Got {len(ops)} operators, but {len(signatures)} lists of signatures.')
+  if isinstance(platforms, str):
+    platforms = [platforms]
+  keys, jobs = _collect_jobs(ops, signatures, platforms)
+  if len(jobs) == 0:
+    return keys
+
+  if num_workers is None:
+    num_workers = os.cpu_count() or 1
+  local_jobs = [job for job in jobs if not _is_picklable(job[1])]
+  remote_jobs = [job for job in jobs if _is_picklable(job[1])]
+  num_workers = min(num_workers, len(remote_jobs))
+  if num_workers <= 1:
+    local_jobs, remote_jobs = jobs, []
+
+  failures = []
+  if len(remote_jobs):
+    # Taichi is not fork-safe, so the workers are spawned
+    chunks = [remote_jobs[i::num_workers] for i in range(num_workers)]
+    with ProcessPoolExecutor(num_workers, mp_context=multiprocessing.get_context('spawn')) as pool:
+      for chunk_failures in pool.map(_build_kernels, chunks):
+        failures.extend(chunk_failures)
+  if len(local_jobs):
+    failures.extend(_build_kernels(local_jobs))
+
+  if len(failures):
+    raise RuntimeError('Failed to build kernels:\n\n' +
+                       '\n'.join(f'{key}: {error}' for key, error in failures))
+  return keys
@@ -16,7 +16,7 @@
 # -*- coding: utf-8 -*-
 
 from functools import partial
-from typing import Callable, Sequence, Tuple, Protocol, Optional, Union
+from typing import Callable, Sequence, Tuple, Protocol, Optional, Union, Dict
 
 import jax
 import numpy as np
@@ -25,6 +25,7 @@ from jax.interpreters import xla, batching, ad, mlir
 from ._ad_support import defjvp
 from ._batch_utils import register_general_batching
 from ._mlir_translation_rule import (
+  output_init_kinds,
   register_taichi_aot_mlir_cpu_translation_rule,  # noqa
   register_taichi_aot_mlir_gpu_translation_rule,  # noqa
 )
@@ -59,6 +60,31 @@ class XLACustomOp:
     jvp_translation: Callable. The JVP translation rule of JAX.
     transpose_translation: Callable. The transpose translation rule of JAX.
     name: str. The primitive name.
+    input_output_aliases: dict. Maps the index of an input to the index of the output
+      which is written into its buffer. Such an output starts with the contents of
+      the input, so that the kernel can update it in place.
+    output_init: sequence of str, or dict. How each output is initialised before the
+      kernel is launched: ``'overwrite'`` (the default) for the kernels which write
+      every element of it, ``'zero'`` for the kernels which accumulate into it, and
+      ``'input'`` for an output aliased to an input. A dict maps ``'cpu'`` and
+      ``'gpu'`` to the sequence of their kernel. On CPU, a ``'zero'`` output costs a
+      zero buffer of its full size, which XLA fills on one thread before the launch,
+      so a CPU kernel which accumulates had better zero its output in a parallel loop
+      of its own and declare it ``'overwrite'``.
+
+  The parameters of the kernels are the inputs followed by the outputs, except the
+  parameters annotated with ``ti.template()``. These are static: their values are
+  the keyword arguments of the same name given to the operator, which are compiled
+  into the kernel and are part of its cache key, so that one kernel source covers
+  all the variants of a flag. The parameters annotated with ``ti.i32``, ``ti.u32``
+  or ``ti.f32`` take an input of one element of that dtype, which is passed to the
+  kernel by value rather than as an array. These are for the CPU kernels only; the
+  GPU kernels take such inputs as arrays, which stay on the device.
+
+  The operator runs on the local shards of its arguments inside ``shard_map``,
+  which is how the sparse operators split a matrix over devices, see
+  :func:`csr_shard`. Under ``jax.jit`` alone, its arguments are gathered on one
+  device.
   """
 
   __module__ = 'braintaichi'
@@ -71,10 +97,17 @@ class XLACustomOp:
       jvp_translation: Callable = None,
       transpose_translation: Callable = None,
       name: str = None,
+      input_output_aliases: Dict[int, int] = None,
+      output_init: Union[Sequence[str], Dict[str, Sequence[str]]] = None,
   ):
     # set cpu_kernel and gpu_kernel
     self.cpu_kernel = cpu_kernel
     self.gpu_kernel = gpu_kernel
+    self.input_output_aliases = dict(input_output_aliases or {})
+    if not isinstance(output_init, dict):
+      output_init = {'cpu': output_init, 'gpu': output_init}
+    self.output_init = {platform: _check_output_init(init, self.input_output_aliases)
+                        for platform, init in output_init.items()}
 
     # primitive
     if name is None:
@@ -87,14 +120,17 @@ class XLACustomOp:
     # abstract evaluation
     self.primitive.def_abstract_eval(_abstract_eval)
     self.primitive.def_impl(partial(xla.apply_primitive, self.primitive))
+    _register_shard_map_rules(self.primitive)
 
     # cpu function
     if cpu_kernel is not None:
-      register_taichi_aot_mlir_cpu_translation_rule(self.primitive, cpu_kernel)
+      register_taichi_aot_mlir_cpu_translation_rule(self.primitive, cpu_kernel, self.input_output_aliases,
+                                                    self.output_init.get('cpu'))
 
     # gpu function
     if gpu_kernel is not None:
-      register_taichi_aot_mlir_gpu_translation_rule(self.primitive, gpu_kernel)
+      register_taichi_aot_mlir_gpu_translation_rule(self.primitive, gpu_kernel, self.input_output_aliases,
+                                                    self.output_init.get('gpu'))
 
     # batching rule
     if batching_translation is None:
@@ -176,12 +212,50 @@ class XLACustomOp:
     mlir.register_lowering(self.primitive, fun, platform)
 
 
+def _check_output_init(output_init, aliases):
+  if output_init is None:
+    return None
+  output_init = tuple(output_init)
+  for i, init in enumerate(output_init):
+    if init not in output_init_kinds:
+      raise ValueError(f'Unknown initialisation of the output {i}: {init}. Should be one of {output_init_kinds}.')
+    if init == 'input' and i not in aliases.values():
+      raise ValueError(f'The output {i} is initialised by an input, but no input is aliased to it.')
+  return output_init
+
+
 def _abstract_eval(*args, **kwargs):
+  # inside "shard_map", the outputs vary over the mesh axes which any input varies over
+  vma = frozenset().union(*(getattr(a, 'vma', frozenset()) for a in args))
+  extra = {'vma': vma} if len(vma) else {}
   return [
-    jax.core.ShapedArray(out_shape.shape, out_shape.dtype)
+    jax.core.ShapedArray(out_shape.shape, out_shape.dtype, **extra)
     for out_shape in kwargs['outs']
   ]
 
 
+def _replication_rule(mesh, *in_rep, **kwargs):
+  # an output is replicated over the mesh axes which all the inputs are replicated over
+  rep = set(mesh.axis_names)
+  for r in in_rep:
+    if r is not None:
+      rep &= set(r)
+  return [rep] * len(kwargs['outs'])
+
+
+def _register_shard_map_rules(primitive):
+  # the replication rules which "shard_map" checks the kernels with, for the
+  # versions of JAX which do not derive them from the abstract evaluation
+  try:
+    from jax.experimental import shard_map
+  except ImportError:
+    return
+  check_rules = getattr(shard_map, '_check_rules', None)
+  if check_rules is not None:
+    check_rules[primitive] = _replication_rule
+  if hasattr(shard_map, 'register_standard_rewrite'):
+    shard_map.register_standard_rewrite(primitive)
+
+
 def _transform_to_shapedarray(a):
   return jax.core.ShapedArray(a.shape, a.dtype)
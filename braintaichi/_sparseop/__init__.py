@@ -13,11 +13,20 @@
 # limitations under the License.
 # ==============================================================================
 
+from ._sparse_compressed import *
+from ._sparse_compressed import __all__ as _sparse_compressed_all
+from ._sparse_plan import *
+from ._sparse_plan import __all__ as _sparse_plan_all
+from ._sparse_sell import *
+from ._sparse_sell import __all__ as _sparse_sell_all
+from ._sparse_shard import *
+from ._sparse_shard import __all__ as _sparse_shard_all
 from ._sparse_utils import *
 from ._sparse_utils import __all__ as _sparse_utils_all
 from .main import *
 from .main import __all__ as _main_all
 
-__all__ = _main_all + _sparse_utils_all
+__all__ = (_main_all + _sparse_utils_all + _sparse_compressed_all + _sparse_plan_all + _sparse_sell_all +
+           _sparse_shard_all)
 
-del _sparse_utils_all, _main_all
+del _sparse_utils_all, _main_all, _sparse_compressed_all, _sparse_plan_all, _sparse_sell_all, _sparse_shard_all
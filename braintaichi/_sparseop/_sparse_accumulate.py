@@ -0,0 +1,359 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+"""
+The accumulating CSR products ``alpha * state + beta * (A @ x)``, which are written
+into the buffer of ``state``, see ``input_output_aliases`` of ``XLACustomOp``.
+
+As the output is not zeroed before the launch, every kernel writes all of it: the
+row kernels assign each row once, and the column kernels first scale the state in
+their own loop and then scatter the products onto it.
+
+``alpha`` and ``beta`` are passed as arrays of shape ``(1,)``, so that they can be
+traced and differentiated.
+"""
+
+from typing import Tuple
+
+import jax
+import taichi as ti
+
+from braintaichi._primitive._xla_custom_op import XLACustomOp
+from ._sparse_compressed import CompressedIndices
+from ._sparse_csrmv import raw_csrmv_taichi
+from ._sparse_plan import CSRPlan
+from ._sparse_utils import _use_atomic_cpu_scatter, is_half
+
+
+def raw_csrmv_accumulate_taichi(
+    state: jax.Array,
+    alpha: jax.Array,
+    beta: jax.Array,
+    data: jax.Array,
+    indices: jax.Array,
+    indptr: jax.Array,
+    vector: jax.Array,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool,
+):
+  # the plans, the compressed indices and the 16-bit values compute the product
+  # with their own kernels, and XLA fuses the epilogue into one pass
+  if isinstance(indices, (CSRPlan, CompressedIndices)) or is_half(data.dtype):
+    r = raw_csrmv_taichi(data, indices, indptr, vector, shape=shape, transpose=transpose)[0]
+    return [alpha[0] * state + beta[0] * r.astype(state.dtype)]
+
+  homo = data.shape[0] == 1
+  if transpose:
+    prim = _csrmv_accumulate_transpose_homo_p if homo else _csrmv_accumulate_transpose_heter_p
+    if _use_atomic_cpu_scatter(shape[1], indices.shape[0]):
+      prim = _csrmv_accumulate_transpose_homo_atomic_p if homo else _csrmv_accumulate_transpose_heter_atomic_p
+  else:
+    prim = _csrmv_accumulate_homo_p if homo else _csrmv_accumulate_heter_p
+  return prim(state,
+              alpha,
+              beta,
+              data,
+              indices,
+              indptr,
+              vector,
+              outs=[jax.ShapeDtypeStruct(state.shape, dtype=state.dtype)],
+              transpose=transpose,
+              shape=shape)
+
+
+# -------------
+# CPU operators
+# -------------
+
+@ti.kernel
+def _csr_matvec_accumulate_transpose_homo_cpu(state: ti.types.ndarray(ndim=1),
+                                              alpha: ti.types.ndarray(ndim=1),
+                                              beta: ti.types.ndarray(ndim=1),
+                                              values: ti.types.ndarray(ndim=1),
+                                              col_indices: ti.types.ndarray(ndim=1),
+                                              row_ptr: ti.types.ndarray(ndim=1),
+                                              vector: ti.types.ndarray(ndim=1),
+                                              out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  value = beta[0] * values[0]
+  for col_i in range(out.shape[0]):
+    out[col_i] = a * state[col_i]
+  ti.loop_config(serialize=True)
+  for row_i in range(row_ptr.shape[0] - 1):
+    v = value * vector[row_i]
+    for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      out[col_indices[j]] += v
+
+
+@ti.kernel
+def _csr_matvec_accumulate_transpose_heter_cpu(state: ti.types.ndarray(ndim=1),
+                                               alpha: ti.types.ndarray(ndim=1),
+                                               beta: ti.types.ndarray(ndim=1),
+                                               values: ti.types.ndarray(ndim=1),
+                                               col_indices: ti.types.ndarray(ndim=1),
+                                               row_ptr: ti.types.ndarray(ndim=1),
+                                               vector: ti.types.ndarray(ndim=1),
+                                               out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  b = beta[0]
+  for col_i in range(out.shape[0]):
+    out[col_i] = a * state[col_i]
+  ti.loop_config(serialize=True)
+  for row_i in range(row_ptr.shape[0] - 1):
+    v = b * vector[row_i]
+    for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      out[col_indices[j]] += v * values[j]
+
+
+@ti.kernel
+def _csr_matvec_accumulate_transpose_homo_atomic_cpu(state: ti.types.ndarray(ndim=1),
+                                                     alpha: ti.types.ndarray(ndim=1),
+                                                     beta: ti.types.ndarray(ndim=1),
+                                                     values: ti.types.ndarray(ndim=1),
+                                                     col_indices: ti.types.ndarray(ndim=1),
+                                                     row_ptr: ti.types.ndarray(ndim=1),
+                                                     vector: ti.types.ndarray(ndim=1),
+                                                     out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  value = beta[0] * values[0]
+  for col_i in range(out.shape[0]):
+    out[col_i] = a * state[col_i]
+  for row_i in range(row_ptr.shape[0] - 1):
+    v = value * vector[row_i]
+    for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      out[col_indices[j]] += v
+
+
+@ti.kernel
+def _csr_matvec_accumulate_transpose_heter_atomic_cpu(state: ti.types.ndarray(ndim=1),
+                                                      alpha: ti.types.ndarray(ndim=1),
+                                                      beta: ti.types.ndarray(ndim=1),
+                                                      values: ti.types.ndarray(ndim=1),
+                                                      col_indices: ti.types.ndarray(ndim=1),
+                                                      row_ptr: ti.types.ndarray(ndim=1),
+                                                      vector: ti.types.ndarray(ndim=1),
+                                                      out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  b = beta[0]
+  for col_i in range(out.shape[0]):
+    out[col_i] = a * state[col_i]
+  for row_i in range(row_ptr.shape[0] - 1):
+    v = b * vector[row_i]
+    for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      out[col_indices[j]] += v * values[j]
+
+
+@ti.kernel
+def _csr_matvec_accumulate_homo_cpu(state: ti.types.ndarray(ndim=1),
+                                    alpha: ti.types.ndarray(ndim=1),
+                                    beta: ti.types.ndarray(ndim=1),
+                                    values: ti.types.ndarray(ndim=1),
+                                    col_indices: ti.types.ndarray(ndim=1),
+                                    row_ptr: ti.types.ndarray(ndim=1),
+                                    vector: ti.types.ndarray(ndim=1),
+                                    out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  value = beta[0] * values[0]
+  for row_i in range(row_ptr.shape[0] - 1):
+    r = 0.
+    for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      r += vector[col_indices[j]]
+    out[row_i] = a * state[row_i] + value * r
+
+
+@ti.kernel
+def _csr_matvec_accumulate_heter_cpu(state: ti.types.ndarray(ndim=1),
+                                     alpha: ti.types.ndarray(ndim=1),
+                                     beta: ti.types.ndarray(ndim=1),
+                                     values: ti.types.ndarray(ndim=1),
+                                     col_indices: ti.types.ndarray(ndim=1),
+                                     row_ptr: ti.types.ndarray(ndim=1),
+                                     vector: ti.types.ndarray(ndim=1),
+                                     out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  b = beta[0]
+  for row_i in range(row_ptr.shape[0] - 1):
+    r = 0.
+    for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      r += values[j] * vector[col_indices[j]]
+    out[row_i] = a * state[row_i] + b * r
+
+
+# -------------
+# GPU operators
+# -------------
+
+# The 32 threads of a row add their partial sums onto the output, so the rows are
+# scaled by their own loop, as in the column kernels.
+
+@ti.kernel
+def _csr_matvec_accumulate_transpose_homo_gpu(state: ti.types.ndarray(ndim=1),
+                                              alpha: ti.types.ndarray(ndim=1),
+                                              beta: ti.types.ndarray(ndim=1),
+                                              values: ti.types.ndarray(ndim=1),
+                                              col_indices: ti.types.ndarray(ndim=1),
+                                              row_ptr: ti.types.ndarray(ndim=1),
+                                              vector: ti.types.ndarray(ndim=1),
+                                              out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  value = beta[0] * values[0]
+  for col_i in range(out.shape[0]):
+    out[col_i] = a * state[col_i]
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    v = value * vector[row_i]
+    j = row_ptr[row_i] + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      out[col_indices[j]] += v
+      j += 32
+
+
+@ti.kernel
+def _csr_matvec_accumulate_transpose_heter_gpu(state: ti.types.ndarray(ndim=1),
+                                               alpha: ti.types.ndarray(ndim=1),
+                                               beta: ti.types.ndarray(ndim=1),
+                                               values: ti.types.ndarray(ndim=1),
+                                               col_indices: ti.types.ndarray(ndim=1),
+                                               row_ptr: ti.types.ndarray(ndim=1),
+                                               vector: ti.types.ndarray(ndim=1),
+                                               out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  b = beta[0]
+  for col_i in range(out.shape[0]):
+    out[col_i] = a * state[col_i]
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    v = b * vector[row_i]
+    j = row_ptr[row_i] + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      out[col_indices[j]] += v * values[j]
+      j += 32
+
+
+@ti.kernel
+def _csr_matvec_accumulate_homo_gpu(state: ti.types.ndarray(ndim=1),
+                                    alpha: ti.types.ndarray(ndim=1),
+                                    beta: ti.types.ndarray(ndim=1),
+                                    values: ti.types.ndarray(ndim=1),
+                                    col_indices: ti.types.ndarray(ndim=1),
+                                    row_ptr: ti.types.ndarray(ndim=1),
+                                    vector: ti.types.ndarray(ndim=1),
+                                    out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  value = beta[0] * values[0]
+  for row_i in range(out.shape[0]):
+    out[row_i] = a * state[row_i]
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    r = 0.
+    j = row_ptr[row_i] + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      r += vector[col_indices[j]]
+      j += 32
+    out[row_i] += value * r
+
+
+@ti.kernel
+def _csr_matvec_accumulate_heter_gpu(state: ti.types.ndarray(ndim=1),
+                                     alpha: ti.types.ndarray(ndim=1),
+                                     beta: ti.types.ndarray(ndim=1),
+                                     values: ti.types.ndarray(ndim=1),
+                                     col_indices: ti.types.ndarray(ndim=1),
+                                     row_ptr: ti.types.ndarray(ndim=1),
+                                     vector: ti.types.ndarray(ndim=1),
+                                     out: ti.types.ndarray(ndim=1)):
+  a = alpha[0]
+  b = beta[0]
+  for row_i in range(out.shape[0]):
+    out[row_i] = a * state[row_i]
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    r = 0.
+    j = row_ptr[row_i] + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      r += values[j] * vector[col_indices[j]]
+      j += 32
+    out[row_i] += b * r
+
+
+# The output is linear in the state and bilinear in the scalars and the product, so
+# the tangents are computed by the plain operators, which have their own transposes.
+
+def _csrmv_product(values, indices, indptr, vector, shape, transpose):
+  return raw_csrmv_taichi(values, indices, indptr, vector, shape=shape, transpose=transpose)[0]
+
+
+def _csrmv_accumulate_jvp_state(state_dot, state, alpha, beta, values, indices, indptr, vector, *, outs,
+                                transpose, shape):
+  return [alpha[0] * state_dot]
+
+
+def _csrmv_accumulate_jvp_alpha(alpha_dot, state, alpha, beta, values, indices, indptr, vector, *, outs,
+                                transpose, shape):
+  return [alpha_dot[0] * state]
+
+
+def _csrmv_accumulate_jvp_beta(beta_dot, state, alpha, beta, values, indices, indptr, vector, *, outs,
+                               transpose, shape):
+  return [beta_dot[0] * _csrmv_product(values, indices, indptr, vector, shape, transpose)]
+
+
+def _csrmv_accumulate_jvp_values(val_dot, state, alpha, beta, values, indices, indptr, vector, *, outs,
+                                 transpose, shape):
+  return [beta[0] * _csrmv_product(val_dot, indices, indptr, vector, shape, transpose)]
+
+
+def _csrmv_accumulate_jvp_vector(vec_dot, state, alpha, beta, values, indices, indptr, vector, *, outs,
+                                 transpose, shape):
+  return [beta[0] * _csrmv_product(values, indices, indptr, vec_dot, shape, transpose)]
+
+
+def _define_op(cpu_kernel, gpu_kernel):
+  # the output is written into the buffer of the state, and starts with its contents
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, input_output_aliases={0: 0},
+                     output_init=('input',))
+  prim.defjvp(_csrmv_accumulate_jvp_state,
+              _csrmv_accumulate_jvp_alpha,
+              _csrmv_accumulate_jvp_beta,
+              _csrmv_accumulate_jvp_values,
+              None,
+              None,
+              _csrmv_accumulate_jvp_vector)
+  return prim
+
+
+_csrmv_accumulate_transpose_homo_p = _define_op(cpu_kernel=_csr_matvec_accumulate_transpose_homo_cpu,
+                                                gpu_kernel=_csr_matvec_accumulate_transpose_homo_gpu)
+_csrmv_accumulate_transpose_heter_p = _define_op(cpu_kernel=_csr_matvec_accumulate_transpose_heter_cpu,
+                                                 gpu_kernel=_csr_matvec_accumulate_transpose_heter_gpu)
+_csrmv_accumulate_transpose_homo_atomic_p = _define_op(cpu_kernel=_csr_matvec_accumulate_transpose_homo_atomic_cpu,
+                                                       gpu_kernel=_csr_matvec_accumulate_transpose_homo_gpu)
+_csrmv_accumulate_transpose_heter_atomic_p = _define_op(cpu_kernel=_csr_matvec_accumulate_transpose_heter_atomic_cpu,
+                                                        gpu_kernel=_csr_matvec_accumulate_transpose_heter_gpu)
+_csrmv_accumulate_homo_p = _define_op(cpu_kernel=_csr_matvec_accumulate_homo_cpu,
+                                      gpu_kernel=_csr_matvec_accumulate_homo_gpu)
+_csrmv_accumulate_heter_p = _define_op(cpu_kernel=_csr_matvec_accumulate_heter_cpu,
+                                       gpu_kernel=_csr_matvec_accumulate_heter_gpu)
@@ -0,0 +1,197 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+# Compressed column indices.
+#
+# The non-zeros of each row are split into blocks of ``2 ** block_shift`` non-zeros,
+# the last one of a row possibly shorter. Each block stores its smallest column in
+# ``bases``, as int32, and each non-zero the distance to it in ``offsets``, as
+# uint16. The blocks of the row ``i`` start at ``block_ptr[i]``, so the column of the
+# non-zero ``j`` is
+#
+#   bases[block_ptr[i] + ((j - indptr[i]) >> block_shift)] + offsets[j]
+#
+# which the kernels decode on the fly with "compressed_col". The indices take
+# ``2 + 4 / 2 ** block_shift`` bytes per non-zero, instead of 4 or 8. The blocks are
+# made as long as their columns span less than 65536, which is easiest with the
+# columns sorted within the rows.
+
+import warnings
+from typing import Tuple
+
+import jax
+import numpy as np
+import taichi as ti
+from jax import numpy as jnp
+
+__all__ = [
+  'CompressedIndices',
+  'compress_indices',
+  'decompress_indices',
+]
+
+
+@jax.tree_util.register_pytree_node_class
+class CompressedIndices:
+  """The column indices of a CSR matrix, compressed by :func:`compress_indices`.
+
+  They can be given to :func:`csrmv`, :func:`event_csrmv`, :func:`csrmm` and
+  :func:`event_csrmm` in place of ``indices``, together with the same ``indptr``.
+  The matrix-vector products decode them on the fly, while the matrix-matrix
+  products decompress them first.
+
+  Attributes
+  ----------
+  offsets: Array
+    The ``uint16`` distance of each non-zero to the base of its block.
+  bases: Array
+    The ``int32`` smallest column of each block.
+  block_ptr: Array
+    The ``int32`` index of the first block of each row.
+  block_shift: Array
+    The ``int32`` log2 of the number of non-zeros of the blocks, of shape ``(1,)``.
+  """
+
+  def __init__(self, offsets, bases, block_ptr, block_shift):
+    self.offsets = offsets
+    self.bases = bases
+    self.block_ptr = block_ptr
+    self.block_shift = block_shift
+
+  @property
+  def shape(self) -> Tuple[int]:
+    return self.offsets.shape
+
+  @property
+  def ndim(self) -> int:
+    return 1
+
+  @property
+  def dtype(self):
+    return self.bases.dtype
+
+  def tree_flatten(self):
+    return (self.offsets, self.bases, self.block_ptr, self.block_shift), None
+
+  @classmethod
+  def tree_unflatten(cls, aux_data, children):
+    return cls(*children)
+
+
+def compress_indices(
+    indices: jax.typing.ArrayLike,
+    indptr: jax.typing.ArrayLike,
+    max_block_size: int = 64,
+) -> CompressedIndices:
+  """Compress the column indices of a CSR matrix into ``uint16`` offsets.
+
+  The non-zeros of each row are split into blocks of up to ``max_block_size``
+  non-zeros, which store their smallest column as ``int32`` and the distance of
+  each non-zero to it as ``uint16``. The largest block size whose blocks all span
+  less than 65536 columns is chosen. The compression runs on the host, once for
+  a given connectivity.
+
+  Parameters
+  ----------
+  indices: ndarray
+    The column indices, of shape ``(nse,)``, which are best sorted within the rows.
+  indptr: ndarray
+    The row pointers, of shape ``(shape[0] + 1,)``.
+  max_block_size: int
+    The largest number of non-zeros of a block, a power of two.
+
+  Returns
+  -------
+  indices : CompressedIndices
+    The compressed indices, to be used with the same ``indptr``.
+  """
+  if max_block_size < 1 or max_block_size & (max_block_size - 1):
+    raise ValueError(f'"max_block_size" should be a power of two, but got {max_block_size}.')
+  indices = np.asarray(indices).astype(np.int64)
+  indptr = np.asarray(indptr).astype(np.int64)
+  if indices.ndim != 1 or indptr.ndim != 1:
+    raise ValueError('indices and indptr should be 1D vectors.')
+  if indices.size and (indices.min() < 0 or indices.max() > np.iinfo(np.int32).max):
+    raise ValueError('The column indices should be in [0, 2 ** 31).')
+
+  nnz = indices.shape[0]
+  counts = np.diff(indptr)
+  rows = np.repeat(np.arange(counts.shape[0]), counts)
+  position = np.arange(nnz) - indptr[rows]
+  shift = int(max_block_size).bit_length() - 1
+  while True:
+    block_ptr = np.concatenate([[0], np.cumsum((counts + (1 << shift) - 1) >> shift)])
+    blocks = block_ptr[rows] + (position >> shift)
+    if nnz == 0:
+      bases = np.zeros(0, dtype=np.int64)
+      break
+    starts = np.flatnonzero(np.diff(blocks, prepend=-1))
+    bases = np.minimum.reduceat(indices, starts)
+    spans = np.maximum.reduceat(indices, starts) - bases
+    if spans.max() < (1 << 16) or shift == 0:
+      break
+    shift -= 1
+
+  compressed = CompressedIndices(offsets=jnp.asarray((indices - bases[blocks]).astype(np.uint16)),
+                                 bases=jnp.asarray(bases.astype(np.int32)),
+                                 block_ptr=jnp.asarray(block_ptr.astype(np.int32)),
+                                 block_shift=jnp.asarray([shift], dtype=jnp.int32))
+  if 2 * nnz + 4 * (bases.shape[0] + block_ptr.shape[0]) >= 4 * nnz > 0:
+    warnings.warn(f'The columns of the blocks are too far apart for compression, the compressed '
+                  f'indices use blocks of {1 << shift} non-zeros and are not smaller than int32 '
+                  f'indices. Sorting the columns within the rows may help.',
+                  UserWarning)
+  return compressed
+
+
+def compressed_to_coo(
+    indices: CompressedIndices,
+    indptr: jax.Array
+) -> Tuple[jax.Array, jax.Array]:
+  """Given compressed CSR (indices, indptr) return COO (row, col)"""
+  nnz = indices.offsets.shape[0]
+  row = jnp.cumsum(jnp.zeros(nnz, dtype=jnp.int32).at[indptr].add(1)) - 1
+  position = jnp.arange(nnz, dtype=jnp.int32) - indptr[row].astype(jnp.int32)
+  blocks = indices.block_ptr[row] + (position >> indices.block_shift[0])
+  return row, indices.bases[blocks] + indices.offsets.astype(jnp.int32)
+
+
+def decompress_indices(
+    indices: CompressedIndices,
+    indptr: jax.typing.ArrayLike
+) -> jax.Array:
+  """Decompress the indices compressed by :func:`compress_indices` into ``int32`` indices.
+
+  Parameters
+  ----------
+  indices: CompressedIndices
+    The compressed indices.
+  indptr: ndarray
+    The row pointers they were compressed with.
+
+  Returns
+  -------
+  indices : Array
+    The ``int32`` column indices, of shape ``(nse,)``.
+  """
+  return compressed_to_coo(indices, jnp.asarray(indptr))[1]
+
+
+@ti.func
+def compressed_col(offsets, bases, block_ptr, shift, row_i, row_start, j):
+  # the column of the non-zero "j" of the row "row_i", which starts at "row_start"
+  return bases[block_ptr[row_i] + ((j - row_start) >> shift)] + ti.cast(offsets[j], ti.i32)
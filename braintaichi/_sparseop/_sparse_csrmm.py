@@ -23,10 +23,16 @@ import numpy as np
 import taichi as ti
 from jax import numpy as jnp
 from jax.experimental.sparse import csr
-from jax.interpreters import ad
+from jax.interpreters import ad, mlir
 
 from braintaichi._primitive._batch_utils import register_general_batching
 from braintaichi._primitive._xla_custom_op import XLACustomOp
+from braintaichi._sparseop._sparse_compressed import CompressedIndices, decompress_indices
+from braintaichi._sparseop._sparse_plan import CSRPlan, plan_values, plan_input, plan_output
+from braintaichi._sparseop._sparse_utils import csr_to_coo, is_half
+
+# the number of dense columns of each parallel task of the heter CPU kernels
+_heter_col_tile = 16
 
 
 def raw_csrmm_taichi(
@@ -40,6 +46,15 @@ def raw_csrmm_taichi(
 ):
   assert len(shape) == 2
 
+  # the products of a plan are computed on its reordered matrix
+  if isinstance(indices, CSRPlan):
+    plan = indices
+    r = raw_csrmm_taichi(plan_values(jnp.atleast_1d(data), plan), plan.indices, plan.indptr,
+                         plan_input(plan, jnp.asarray(matrix), transpose), shape=shape, transpose=transpose)[0]
+    return [plan_output(plan, r, transpose)]
+  # the dense columns amortize the index stream, so compressed indices are decompressed
+  if isinstance(indices, CompressedIndices):
+    indices = decompress_indices(indices, indptr)
   indices = jnp.asarray(indices)
   indptr = jnp.asarray(indptr)
   matrix = jnp.asarray(matrix)
@@ -71,10 +86,23 @@ def raw_csrmm_taichi(
   if indices.shape[0] == 0:
     return [jnp.zeros(result_shape, dtype=data.dtype), ]
 
+  # 16-bit values are computed in float32, only the matrix-vector kernels read them in 16 bits
+  if is_half(data.dtype):
+    r = raw_csrmm_taichi(data.astype(jnp.float32), indices, indptr, matrix.astype(jnp.float32),
+                         shape=shape, transpose=transpose)[0]
+    return [r.astype(data.dtype)]
+
   # homo -> taichi,
-  # heter -> cusparse
+  # heter -> taichi on CPU, cusparse on GPU
   if data.shape[0] != 1:
-    return [_csr_matmat_cusparse_p.bind(data, indices, indptr, matrix, shape=shape, transpose=transpose), ]
+    prim = _csr_matmat_transpose_heter_p if transpose else _csr_matmat_heter_p
+    return prim(data,
+                indices,
+                indptr,
+                matrix,
+                outs=[jax.ShapeDtypeStruct(result_shape, dtype=matrix.dtype)],
+                transpose=transpose,
+                shape=shape)
   else:
     if transpose:
       prim = _csr_matmat_transpose_homo_p
@@ -90,37 +118,55 @@ def raw_csrmm_taichi(
 
 
 # taichi kernels
-# @ti.kernel
-# def _csr_matmat_transpose_heter(values: ti.types.ndarray(ndim=1),
-#                                 col_indices: ti.types.ndarray(ndim=1),
-#                                 row_ptr: ti.types.ndarray(ndim=1),
-#                                 matrix: ti.types.ndarray(ndim=2),
-#                                 out: ti.types.ndarray(ndim=2)):
-#   for row_i in range(row_ptr.shape[0] - 1):
-#     for i in range(row_ptr[row_i], row_ptr[row_i + 1]):
-#       col = col_indices[i]
-#       for j in range(out.shape[1]):
-#         out[col, j] += values[row_i] * matrix[row_i, j]
-#
-# @ti.kernel
-# def _csr_matmat_heter(values: ti.types.ndarray(ndim=1),
-#                       col_indices: ti.types.ndarray(ndim=1),
-#                       row_ptr: ti.types.ndarray(ndim=1),
-#                       matrix: ti.types.ndarray(ndim=2),
-#                       out: ti.types.ndarray(ndim=2)):
-#   for row_i, col_k in ti.ndrange(out.shape[0], out.shape[1]):
-#     r = 0.
-#     for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
-#       r += values[j] * matrix[col_indices[j], col_k]
-#     out[row_i, col_k] = r
-#
-# # transpose heter
-# _csr_matmat_transpose_heter_p = _define_op(cpu_kernel=_csr_matmat_transpose_heter,
-#                                            gpu_kernel=_csr_matmat_transpose_heter)
-#
-# # no transpose heter
-# _csr_matmat_heter_p = _define_op(cpu_kernel=_csr_matmat_heter,
-#                                  gpu_kernel=_csr_matmat_heter)
+
+# The heter CPU kernels split the dense columns into tiles. Each non-zero loads its
+# weight and index once per tile, and the innermost loop runs over the contiguous
+# columns of the tile, so that it vectorizes. The forward kernel is parallel over
+# (row, tile) pairs. The transposed kernel is parallel over tiles, each of which
+# owns its columns of "out", so that the assignments are written out, rather than
+# "+=", and are not compiled into atomics.
+
+@ti.kernel
+def _csr_matmat_transpose_heter_cpu(values: ti.types.ndarray(ndim=1),
+                                    col_indices: ti.types.ndarray(ndim=1),
+                                    row_ptr: ti.types.ndarray(ndim=1),
+                                    matrix: ti.types.ndarray(ndim=2),
+                                    out: ti.types.ndarray(ndim=2)):
+  # matrix: (m, n)
+  # sparse matrix: (m, k)
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  n = out.shape[1]
+  m = row_ptr.shape[0] - 1
+  for tile_i in range((n + _heter_col_tile - 1) // _heter_col_tile):
+    col_end = ti.min((tile_i + 1) * _heter_col_tile, n)
+    for row_i in range(m):
+      for i in range(row_ptr[row_i], row_ptr[row_i + 1]):
+        value = values[i]
+        col = col_indices[i]
+        for j in range(tile_i * _heter_col_tile, col_end):
+          out[col, j] = out[col, j] + value * matrix[row_i, j]
+
+
+@ti.kernel
+def _csr_matmat_heter_cpu(values: ti.types.ndarray(ndim=1),
+                          col_indices: ti.types.ndarray(ndim=1),
+                          row_ptr: ti.types.ndarray(ndim=1),
+                          matrix: ti.types.ndarray(ndim=2),
+                          out: ti.types.ndarray(ndim=2)):
+  # matrix: (k, n)
+  # sparse matrix: (m, k)
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
+  m, n = out.shape
+  for row_i, tile_i in ti.ndrange(m, (n + _heter_col_tile - 1) // _heter_col_tile):
+    col_end = ti.min((tile_i + 1) * _heter_col_tile, n)
+    for i in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      value = values[i]
+      row_k = col_indices[i]
+      for j in range(tile_i * _heter_col_tile, col_end):
+        out[row_i, j] = out[row_i, j] + value * matrix[row_k, j]
+
 
 @ti.kernel
 def _csr_matmat_transpose_homo_cpu(col_indices: ti.types.ndarray(ndim=1),
@@ -129,6 +175,8 @@ def _csr_matmat_transpose_homo_cpu(col_indices: ti.types.ndarray(ndim=1),
                                    out: ti.types.ndarray(ndim=2)):
   # matrix: (k, n)
   # sparse matrix: (m, k)
+  for i, j in ti.ndrange(out.shape[0], out.shape[1]):
+    out[i, j] = 0.
   n = out.shape[1]
   m = row_ptr.shape[0] - 1
   for j in range(n):  # parallize along the n dimension
@@ -183,8 +231,46 @@ def _csr_matmat_transpose(
   return col_indices, row_ptr, (ad.Zero(matrix) if type(ct[0]) is ad.Zero else ct_matrix[0])
 
 
-def _define_op(cpu_kernel, gpu_kernel):
-  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel)
+def _csr_matmat_heter_jvp_values(val_dot, values, col_indices, row_ptr, matrix, *, outs, transpose, shape):
+  return raw_csrmm_taichi(val_dot, col_indices, row_ptr, matrix, shape=shape, transpose=transpose)
+
+
+def _csr_matmat_heter_jvp_matrix(mat_dot, values, col_indices, row_ptr, matrix, *, outs, transpose, shape):
+  return raw_csrmm_taichi(values, col_indices, row_ptr, mat_dot, shape=shape, transpose=transpose)
+
+
+def _csr_matmat_heter_transpose(
+    ct, values, col_indices, row_ptr, matrix, *, outs, transpose, shape,
+):
+  if ad.is_undefined_primal(col_indices) or ad.is_undefined_primal(row_ptr):
+    raise ValueError("Cannot transpose with respect to sparse indices.")
+  if ad.is_undefined_primal(matrix):
+    if type(ct[0]) is ad.Zero:
+      return values, col_indices, row_ptr, ad.Zero(matrix)
+    ct_matrix = raw_csrmm_taichi(values, col_indices, row_ptr, ct[0], shape=shape, transpose=not transpose)
+    return values, col_indices, row_ptr, ct_matrix[0]
+  else:
+    if type(ct[0]) is ad.Zero:
+      ct_values = ad.Zero(values)
+    else:
+      row, col = csr_to_coo(col_indices, row_ptr)
+      if transpose:
+        ct_values = (ct[0][col] * matrix[row]).sum(1)
+      else:
+        ct_values = (ct[0][row] * matrix[col]).sum(1)
+    return ct_values, col_indices, row_ptr, matrix
+
+
+# The kernels without transposition assign every element of their output, which
+# therefore need not be zeroed. The CPU kernels with transposition zero it in a
+# parallel loop before they scatter into it, and the GPU ones scatter into a zeroed
+# output.
+_overwrite = ('overwrite',)
+_cpu_overwrite = {'cpu': ('overwrite',), 'gpu': ('zero',)}
+
+
+def _define_op(cpu_kernel, gpu_kernel, output_init=_cpu_overwrite):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=output_init)
   prim.defjvp(None, None, _csr_matmat_jvp_matrix)
   prim.def_transpose_rule(_csr_matmat_transpose)
   return prim
@@ -195,7 +281,25 @@ _csr_matmat_transpose_homo_p = _define_op(cpu_kernel=_csr_matmat_transpose_homo_
                                           gpu_kernel=_csr_matmat_transpose_homo_gpu)
 
 # no transpose homo
-_csr_matmat_homo_p = _define_op(cpu_kernel=_csr_matmat_homo, gpu_kernel=_csr_matmat_homo)
+_csr_matmat_homo_p = _define_op(cpu_kernel=_csr_matmat_homo, gpu_kernel=_csr_matmat_homo, output_init=_overwrite)
+
+def _csr_matmat_cusparse(data, indices, indptr, matrix, *, outs, transpose, shape):
+  return [_csr_matmat_cusparse_p.bind(data, indices, indptr, matrix, shape=shape, transpose=transpose)]
+
+
+def _define_heter_op(cpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, output_init=_overwrite)
+  prim.def_mlir_lowering('gpu', mlir.lower_fun(_csr_matmat_cusparse, multiple_results=True))
+  prim.defjvp(_csr_matmat_heter_jvp_values, None, None, _csr_matmat_heter_jvp_matrix)
+  prim.def_transpose_rule(_csr_matmat_heter_transpose)
+  return prim
+
+
+# transpose heter, cusparse on GPU
+_csr_matmat_transpose_heter_p = _define_heter_op(cpu_kernel=_csr_matmat_transpose_heter_cpu)
+
+# no transpose heter, cusparse on GPU
+_csr_matmat_heter_p = _define_heter_op(cpu_kernel=_csr_matmat_heter_cpu)
 
 # heter CUSPARSE
 _csr_matmat_cusparse_p = csr.csr_matmat_p
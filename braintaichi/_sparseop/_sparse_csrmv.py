@@ -25,9 +25,12 @@ from jax import numpy as jnp
 from jax.experimental.sparse import csr
 from jax.interpreters import ad
 
-from braintaichi._primitive._batch_utils import register_general_batching
+from braintaichi._primitive._batch_utils import register_vector_batching
 from braintaichi._primitive._xla_custom_op import XLACustomOp
-from ._sparse_utils import csr_to_coo
+from ._sparse_compressed import CompressedIndices, compressed_to_coo, decompress_indices, compressed_col
+from ._sparse_csrmm import raw_csrmm_taichi
+from ._sparse_plan import CSRPlan, plan_values, plan_input, plan_output
+from ._sparse_utils import csr_to_coo, _transpose_prim, _scratch_free_lowering, is_half, bf16_to_f32
 
 
 def raw_csrmv_taichi(
@@ -39,28 +42,124 @@ def raw_csrmv_taichi(
     shape: Tuple[int, int],
     transpose: bool = False,
 ):
+  if isinstance(indices, CSRPlan):
+    return _raw_planned_csrmv_taichi(data, indices, vector, shape=shape, transpose=transpose)
+  if isinstance(indices, CompressedIndices):
+    return _raw_compressed_csrmv_taichi(data, indices, indptr, vector, shape=shape, transpose=transpose)
+  if is_half(data.dtype):
+    return _raw_half_csrmv_taichi(data, indices, indptr, vector, shape=shape, transpose=transpose)
+
   out_shape = shape[1] if transpose else shape[0]
-  if data.shape[0] != 1:
-    if jax.devices()[0].platform == 'gpu':
-      return [_csr_matvec_cusparse_p.bind(data, indices, indptr, vector, shape=shape, transpose=transpose)]
-    else:
-      if transpose:
-        prim = _csr_matvec_transpose_heter_p
-      else:
-        prim = _csr_matvec_heter_p
+  outs = [jax.ShapeDtypeStruct((out_shape,), dtype=data.dtype)]
+  # heter -> taichi on CPU, cusparse on GPU, see "_define_heter_op()"
+  homo = data.shape[0] == 1
+  if transpose and homo:
+    prim = _transpose_prim(_csr_matvec_transpose_homo_p, _csr_matvec_transpose_homo_atomic_p,
+                           _csr_matvec_transpose_homo_partial_p, outs, indices.shape[0])
+  elif transpose:
+    prim = _transpose_prim(_csr_matvec_transpose_heter_p, _csr_matvec_transpose_heter_atomic_p,
+                           _csr_matvec_transpose_heter_partial_p, outs, indices.shape[0])
   else:
-    if transpose:
-      prim = _csr_matvec_transpose_homo_p
-    else:
-      prim = _csr_matvec_homo_p
+    prim = _csr_matvec_homo_p if homo else _csr_matvec_heter_p
 
   return prim(data,
               indices,
               indptr,
               vector,
-              outs=[jax.ShapeDtypeStruct((out_shape,), dtype=data.dtype)],
+              outs=outs,
               transpose=transpose,
-              shape=shape)
+              shape=shape)[:1]
+
+
+# 16-bit values are read in 16 bits and accumulated in float32, and the product is
+# rounded to their dtype. The vectors are computed in float32, as they are much
+# smaller than the values.
+
+def _raw_half_csrmv_taichi(data, indices, indptr, vector, *, shape, transpose):
+  vector = vector.astype(jnp.float32)
+  if data.shape[0] == 1:
+    r = raw_csrmv_taichi(data.astype(jnp.float32), indices, indptr, vector, shape=shape, transpose=transpose)[0]
+  else:
+    r = _half_csrmv_f32(data, indices, indptr, vector, shape=shape, transpose=transpose)[0]
+  return [r.astype(data.dtype)]
+
+
+def _half_csrmv_f32(data, indices, indptr, vector, *, shape, transpose):
+  bf16 = data.dtype == jnp.bfloat16
+  outs = [jax.ShapeDtypeStruct((shape[1] if transpose else shape[0],), dtype=jnp.float32)]
+  if transpose and bf16:
+    prim = _transpose_prim(_csr_matvec_transpose_bf16_p, _csr_matvec_transpose_bf16_atomic_p,
+                           _csr_matvec_transpose_bf16_partial_p, outs, indices.shape[0])
+  elif transpose:
+    prim = _transpose_prim(_csr_matvec_transpose_half_p, _csr_matvec_transpose_half_atomic_p,
+                           _csr_matvec_transpose_half_partial_p, outs, indices.shape[0])
+  else:
+    prim = _csr_matvec_bf16_p if bf16 else _csr_matvec_half_p
+  return prim(data,
+              indices,
+              indptr,
+              vector,
+              outs=outs,
+              transpose=transpose,
+              shape=shape)[:1]
+
+
+# The compressed indices are decoded by their own kernels, on CPU and GPU alike.
+# 16-bit values are computed in float32.
+
+def _raw_compressed_csrmv_taichi(data, indices, indptr, vector, *, shape, transpose):
+  if is_half(data.dtype):
+    r = _raw_compressed_csrmv_taichi(data.astype(jnp.float32), indices, indptr, vector.astype(jnp.float32),
+                                     shape=shape, transpose=transpose)[0]
+    return [r.astype(data.dtype)]
+  homo = data.shape[0] == 1
+  outs = [jax.ShapeDtypeStruct((shape[1] if transpose else shape[0],), dtype=data.dtype)]
+  if transpose and homo:
+    prim = _transpose_prim(_csr_matvec_transpose_compressed_homo_p, _csr_matvec_transpose_compressed_homo_atomic_p,
+                           _csr_matvec_transpose_compressed_homo_partial_p, outs, indices.shape[0])
+  elif transpose:
+    prim = _transpose_prim(_csr_matvec_transpose_compressed_heter_p, _csr_matvec_transpose_compressed_heter_atomic_p,
+                           _csr_matvec_transpose_compressed_heter_partial_p, outs, indices.shape[0])
+  else:
+    prim = _csr_matvec_compressed_homo_p if homo else _csr_matvec_compressed_heter_p
+  return prim(data,
+              indices.offsets,
+              indices.bases,
+              indices.block_ptr,
+              indices.block_shift,
+              indptr,
+              vector,
+              outs=outs,
+              transpose=transpose,
+              shape=shape)[:1]
+
+
+# With a plan, both products gather over the rows of a CSR matrix, the reordered
+# one or its transpose, whose parallel tasks are its balanced splits. 16-bit values
+# are computed in float32.
+
+def _raw_planned_csrmv_taichi(data, plan, vector, *, shape, transpose):
+  if is_half(data.dtype):
+    r = _raw_planned_csrmv_taichi(data.astype(jnp.float32), plan, vector.astype(jnp.float32),
+                                  shape=shape, transpose=transpose)[0]
+    return [r.astype(data.dtype)]
+  vector = plan_input(plan, vector, transpose)
+  if transpose:
+    r = planned_csrmv(data, plan.t_value_idx, plan.t_indices, plan.t_indptr, plan.t_splits, vector)[0]
+  else:
+    r = planned_csrmv(data, plan.value_idx, plan.indices, plan.indptr, plan.splits, vector)[0]
+  return [plan_output(plan, r, transpose)]
+
+
+def planned_csrmv(data, value_idx, indices, indptr, splits, vector):
+  """Gather over the rows of the matrix, whose values are read through ``value_idx`` if any."""
+  outs = [jax.ShapeDtypeStruct((indptr.shape[0] - 1,), dtype=data.dtype)]
+  if data.shape[0] == 1:
+    return _csr_matvec_planned_homo_p(data, indices, indptr, splits, vector, outs=outs)
+  elif value_idx is None:
+    return _csr_matvec_planned_heter_p(data, indices, indptr, splits, vector, outs=outs)
+  else:
+    return _csr_matvec_planned_indirect_p(data, value_idx, indices, indptr, splits, vector, outs=outs)
 
 
 # -------------
@@ -72,6 +171,8 @@ def _sparse_csr_matvec_transpose_homo_cpu(values: ti.types.ndarray(ndim=1),
                                           row_ptr: ti.types.ndarray(ndim=1),
                                           vector: ti.types.ndarray(ndim=1),
                                           out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
   value = values[0]
   ti.loop_config(serialize=True)
   for row_i in range(row_ptr.shape[0] - 1):
@@ -85,12 +186,96 @@ def _sparse_csr_matvec_transpose_heter_cpu(values: ti.types.ndarray(ndim=1),
                                            row_ptr: ti.types.ndarray(ndim=1),
                                            vector: ti.types.ndarray(ndim=1),
                                            out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
   ti.loop_config(serialize=True)
   for row_i in range(row_ptr.shape[0] - 1):
     for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
       out[col_indices[j]] += vector[row_i] * values[j]
 
 
+@ti.kernel
+def _sparse_csr_matvec_transpose_homo_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                                 col_indices: ti.types.ndarray(ndim=1),
+                                                 row_ptr: ti.types.ndarray(ndim=1),
+                                                 vector: ti.types.ndarray(ndim=1),
+                                                 out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  value = values[0]
+  for row_i in range(row_ptr.shape[0] - 1):
+    v = value * vector[row_i]
+    for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      out[col_indices[j]] += v
+
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_heter_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                                  col_indices: ti.types.ndarray(ndim=1),
+                                                  row_ptr: ti.types.ndarray(ndim=1),
+                                                  vector: ti.types.ndarray(ndim=1),
+                                                  out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  for row_i in range(row_ptr.shape[0] - 1):
+    v = vector[row_i]
+    for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      out[col_indices[j]] += v * values[j]
+
+
+# Each block of rows zeroes its own row of "partial" and scatters into it. The
+# assignments are written out, rather than "+=", so that they are not compiled
+# into atomics.
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_homo_partial_cpu(values: ti.types.ndarray(ndim=1),
+                                                  col_indices: ti.types.ndarray(ndim=1),
+                                                  row_ptr: ti.types.ndarray(ndim=1),
+                                                  vector: ti.types.ndarray(ndim=1),
+                                                  out: ti.types.ndarray(ndim=1),
+                                                  partial: ti.types.ndarray(ndim=2)):
+  value = values[0]
+  num_row = row_ptr.shape[0] - 1
+  num_block = partial.shape[0]
+  block_size = (num_row + num_block - 1) // num_block
+  for block_i in range(num_block):
+    for col_i in range(partial.shape[1]):
+      partial[block_i, col_i] = 0.
+    for row_i in range(block_i * block_size, ti.min((block_i + 1) * block_size, num_row)):
+      v = value * vector[row_i]
+      for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+        partial[block_i, col_indices[j]] = partial[block_i, col_indices[j]] + v
+  for col_i in range(out.shape[0]):
+    r = 0.
+    for block_i in range(num_block):
+      r += partial[block_i, col_i]
+    out[col_i] = r
+
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_heter_partial_cpu(values: ti.types.ndarray(ndim=1),
+                                                   col_indices: ti.types.ndarray(ndim=1),
+                                                   row_ptr: ti.types.ndarray(ndim=1),
+                                                   vector: ti.types.ndarray(ndim=1),
+                                                   out: ti.types.ndarray(ndim=1),
+                                                   partial: ti.types.ndarray(ndim=2)):
+  num_row = row_ptr.shape[0] - 1
+  num_block = partial.shape[0]
+  block_size = (num_row + num_block - 1) // num_block
+  for block_i in range(num_block):
+    for col_i in range(partial.shape[1]):
+      partial[block_i, col_i] = 0.
+    for row_i in range(block_i * block_size, ti.min((block_i + 1) * block_size, num_row)):
+      v = vector[row_i]
+      for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+        partial[block_i, col_indices[j]] = partial[block_i, col_indices[j]] + v * values[j]
+  for col_i in range(out.shape[0]):
+    r = 0.
+    for block_i in range(num_block):
+      r += partial[block_i, col_i]
+    out[col_i] = r
+
+
 @ti.kernel
 def _sparse_csr_matvec_homo_cpu(values: ti.types.ndarray(ndim=1),
                                 col_indices: ti.types.ndarray(ndim=1),
@@ -194,6 +379,500 @@ def _sparse_csr_matvec_heter_gpu(values: ti.types.ndarray(ndim=1),
     out[row_i] += r  # TODO: warp-level primitive
 
 
+# ----------------
+# bfloat16 values
+# ----------------
+# The float16 values are read by the heter kernels above, which accumulate them in
+# float32. The bfloat16 ones are given as their uint16 bits, and decoded here.
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_bf16_cpu(values: ti.types.ndarray(ndim=1),
+                                          col_indices: ti.types.ndarray(ndim=1),
+                                          row_ptr: ti.types.ndarray(ndim=1),
+                                          vector: ti.types.ndarray(ndim=1),
+                                          out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  ti.loop_config(serialize=True)
+  for row_i in range(row_ptr.shape[0] - 1):
+    for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      out[col_indices[j]] += vector[row_i] * bf16_to_f32(values[j])
+
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_bf16_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                                 col_indices: ti.types.ndarray(ndim=1),
+                                                 row_ptr: ti.types.ndarray(ndim=1),
+                                                 vector: ti.types.ndarray(ndim=1),
+                                                 out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  for row_i in range(row_ptr.shape[0] - 1):
+    v = vector[row_i]
+    for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      out[col_indices[j]] += v * bf16_to_f32(values[j])
+
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_bf16_partial_cpu(values: ti.types.ndarray(ndim=1),
+                                                  col_indices: ti.types.ndarray(ndim=1),
+                                                  row_ptr: ti.types.ndarray(ndim=1),
+                                                  vector: ti.types.ndarray(ndim=1),
+                                                  out: ti.types.ndarray(ndim=1),
+                                                  partial: ti.types.ndarray(ndim=2)):
+  num_row = row_ptr.shape[0] - 1
+  num_block = partial.shape[0]
+  block_size = (num_row + num_block - 1) // num_block
+  for block_i in range(num_block):
+    for col_i in range(partial.shape[1]):
+      partial[block_i, col_i] = 0.
+    for row_i in range(block_i * block_size, ti.min((block_i + 1) * block_size, num_row)):
+      v = vector[row_i]
+      for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+        partial[block_i, col_indices[j]] = partial[block_i, col_indices[j]] + v * bf16_to_f32(values[j])
+  for col_i in range(out.shape[0]):
+    r = 0.
+    for block_i in range(num_block):
+      r += partial[block_i, col_i]
+    out[col_i] = r
+
+
+@ti.kernel
+def _sparse_csr_matvec_bf16_cpu(values: ti.types.ndarray(ndim=1),
+                                col_indices: ti.types.ndarray(ndim=1),
+                                row_ptr: ti.types.ndarray(ndim=1),
+                                vector: ti.types.ndarray(ndim=1),
+                                out: ti.types.ndarray(ndim=1)):
+  for row_i in range(row_ptr.shape[0] - 1):
+    r = 0.
+    for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+      r += bf16_to_f32(values[j]) * vector[col_indices[j]]
+    out[row_i] = r
+
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_bf16_gpu(values: ti.types.ndarray(ndim=1),
+                                          col_indices: ti.types.ndarray(ndim=1),
+                                          row_ptr: ti.types.ndarray(ndim=1),
+                                          vector: ti.types.ndarray(ndim=1),
+                                          out: ti.types.ndarray(ndim=1)):
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    j = row_ptr[row_i] + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      out[col_indices[j]] += bf16_to_f32(values[j]) * vector[row_i]
+      j += 32
+
+
+@ti.kernel
+def _sparse_csr_matvec_bf16_gpu(values: ti.types.ndarray(ndim=1),
+                                col_indices: ti.types.ndarray(ndim=1),
+                                row_ptr: ti.types.ndarray(ndim=1),
+                                vector: ti.types.ndarray(ndim=1),
+                                out: ti.types.ndarray(ndim=1)):
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    r = 0.
+    j = row_ptr[row_i] + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      r += bf16_to_f32(values[j]) * vector[col_indices[j]]
+      j += 32
+    out[row_i] += r
+
+
+# -------------------
+# compressed indices
+# -------------------
+# The columns are decoded from the compressed indices with "compressed_col". The
+# transposed kernels on CPU follow "cpu_transpose_strategy", as with the other
+# indices.
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_compressed_homo_cpu(values: ti.types.ndarray(ndim=1),
+                                                     offsets: ti.types.ndarray(ndim=1),
+                                                     bases: ti.types.ndarray(ndim=1),
+                                                     block_ptr: ti.types.ndarray(ndim=1),
+                                                     block_shift: ti.types.ndarray(ndim=1),
+                                                     row_ptr: ti.types.ndarray(ndim=1),
+                                                     vector: ti.types.ndarray(ndim=1),
+                                                     out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  value = values[0]
+  shift = block_shift[0]
+  ti.loop_config(serialize=True)
+  for row_i in range(row_ptr.shape[0] - 1):
+    v = value * vector[row_i]
+    start = row_ptr[row_i]
+    for j in range(start, row_ptr[row_i + 1]):
+      out[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)] += v
+
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_compressed_heter_cpu(values: ti.types.ndarray(ndim=1),
+                                                      offsets: ti.types.ndarray(ndim=1),
+                                                      bases: ti.types.ndarray(ndim=1),
+                                                      block_ptr: ti.types.ndarray(ndim=1),
+                                                      block_shift: ti.types.ndarray(ndim=1),
+                                                      row_ptr: ti.types.ndarray(ndim=1),
+                                                      vector: ti.types.ndarray(ndim=1),
+                                                      out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  shift = block_shift[0]
+  ti.loop_config(serialize=True)
+  for row_i in range(row_ptr.shape[0] - 1):
+    v = vector[row_i]
+    start = row_ptr[row_i]
+    for j in range(start, row_ptr[row_i + 1]):
+      out[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)] += v * values[j]
+
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_compressed_homo_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                                            offsets: ti.types.ndarray(ndim=1),
+                                                            bases: ti.types.ndarray(ndim=1),
+                                                            block_ptr: ti.types.ndarray(ndim=1),
+                                                            block_shift: ti.types.ndarray(ndim=1),
+                                                            row_ptr: ti.types.ndarray(ndim=1),
+                                                            vector: ti.types.ndarray(ndim=1),
+                                                            out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  value = values[0]
+  shift = block_shift[0]
+  for row_i in range(row_ptr.shape[0] - 1):
+    v = value * vector[row_i]
+    start = row_ptr[row_i]
+    for j in range(start, row_ptr[row_i + 1]):
+      out[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)] += v
+
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_compressed_heter_atomic_cpu(values: ti.types.ndarray(ndim=1),
+                                                             offsets: ti.types.ndarray(ndim=1),
+                                                             bases: ti.types.ndarray(ndim=1),
+                                                             block_ptr: ti.types.ndarray(ndim=1),
+                                                             block_shift: ti.types.ndarray(ndim=1),
+                                                             row_ptr: ti.types.ndarray(ndim=1),
+                                                             vector: ti.types.ndarray(ndim=1),
+                                                             out: ti.types.ndarray(ndim=1)):
+  for col_i in range(out.shape[0]):
+    out[col_i] = 0.
+  shift = block_shift[0]
+  for row_i in range(row_ptr.shape[0] - 1):
+    v = vector[row_i]
+    start = row_ptr[row_i]
+    for j in range(start, row_ptr[row_i + 1]):
+      out[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)] += v * values[j]
+
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_compressed_homo_partial_cpu(values: ti.types.ndarray(ndim=1),
+                                                             offsets: ti.types.ndarray(ndim=1),
+                                                             bases: ti.types.ndarray(ndim=1),
+                                                             block_ptr: ti.types.ndarray(ndim=1),
+                                                             block_shift: ti.types.ndarray(ndim=1),
+                                                             row_ptr: ti.types.ndarray(ndim=1),
+                                                             vector: ti.types.ndarray(ndim=1),
+                                                             out: ti.types.ndarray(ndim=1),
+                                                             partial: ti.types.ndarray(ndim=2)):
+  value = values[0]
+  shift = block_shift[0]
+  num_row = row_ptr.shape[0] - 1
+  num_block = partial.shape[0]
+  block_size = (num_row + num_block - 1) // num_block
+  for block_i in range(num_block):
+    for col_i in range(partial.shape[1]):
+      partial[block_i, col_i] = 0.
+    for row_i in range(block_i * block_size, ti.min((block_i + 1) * block_size, num_row)):
+      v = value * vector[row_i]
+      start = row_ptr[row_i]
+      for j in range(start, row_ptr[row_i + 1]):
+        col_i = compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)
+        partial[block_i, col_i] = partial[block_i, col_i] + v
+  for col_i in range(out.shape[0]):
+    r = 0.
+    for block_i in range(num_block):
+      r += partial[block_i, col_i]
+    out[col_i] = r
+
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_compressed_heter_partial_cpu(values: ti.types.ndarray(ndim=1),
+                                                              offsets: ti.types.ndarray(ndim=1),
+                                                              bases: ti.types.ndarray(ndim=1),
+                                                              block_ptr: ti.types.ndarray(ndim=1),
+                                                              block_shift: ti.types.ndarray(ndim=1),
+                                                              row_ptr: ti.types.ndarray(ndim=1),
+                                                              vector: ti.types.ndarray(ndim=1),
+                                                              out: ti.types.ndarray(ndim=1),
+                                                              partial: ti.types.ndarray(ndim=2)):
+  shift = block_shift[0]
+  num_row = row_ptr.shape[0] - 1
+  num_block = partial.shape[0]
+  block_size = (num_row + num_block - 1) // num_block
+  for block_i in range(num_block):
+    for col_i in range(partial.shape[1]):
+      partial[block_i, col_i] = 0.
+    for row_i in range(block_i * block_size, ti.min((block_i + 1) * block_size, num_row)):
+      v = vector[row_i]
+      start = row_ptr[row_i]
+      for j in range(start, row_ptr[row_i + 1]):
+        col_i = compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)
+        partial[block_i, col_i] = partial[block_i, col_i] + v * values[j]
+  for col_i in range(out.shape[0]):
+    r = 0.
+    for block_i in range(num_block):
+      r += partial[block_i, col_i]
+    out[col_i] = r
+
+
+@ti.kernel
+def _sparse_csr_matvec_compressed_homo_cpu(values: ti.types.ndarray(ndim=1),
+                                           offsets: ti.types.ndarray(ndim=1),
+                                           bases: ti.types.ndarray(ndim=1),
+                                           block_ptr: ti.types.ndarray(ndim=1),
+                                           block_shift: ti.types.ndarray(ndim=1),
+                                           row_ptr: ti.types.ndarray(ndim=1),
+                                           vector: ti.types.ndarray(ndim=1),
+                                           out: ti.types.ndarray(ndim=1)):
+  value = values[0]
+  shift = block_shift[0]
+  for row_i in range(row_ptr.shape[0] - 1):
+    r = 0.
+    start = row_ptr[row_i]
+    for j in range(start, row_ptr[row_i + 1]):
+      r += vector[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)]
+    out[row_i] = r * value
+
+
+@ti.kernel
+def _sparse_csr_matvec_compressed_heter_cpu(values: ti.types.ndarray(ndim=1),
+                                            offsets: ti.types.ndarray(ndim=1),
+                                            bases: ti.types.ndarray(ndim=1),
+                                            block_ptr: ti.types.ndarray(ndim=1),
+                                            block_shift: ti.types.ndarray(ndim=1),
+                                            row_ptr: ti.types.ndarray(ndim=1),
+                                            vector: ti.types.ndarray(ndim=1),
+                                            out: ti.types.ndarray(ndim=1)):
+  shift = block_shift[0]
+  for row_i in range(row_ptr.shape[0] - 1):
+    r = 0.
+    start = row_ptr[row_i]
+    for j in range(start, row_ptr[row_i + 1]):
+      r += values[j] * vector[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)]
+    out[row_i] = r
+
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_compressed_homo_gpu(values: ti.types.ndarray(ndim=1),
+                                                     offsets: ti.types.ndarray(ndim=1),
+                                                     bases: ti.types.ndarray(ndim=1),
+                                                     block_ptr: ti.types.ndarray(ndim=1),
+                                                     block_shift: ti.types.ndarray(ndim=1),
+                                                     row_ptr: ti.types.ndarray(ndim=1),
+                                                     vector: ti.types.ndarray(ndim=1),
+                                                     out: ti.types.ndarray(ndim=1)):
+  value = values[0]
+  shift = block_shift[0]
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    start = row_ptr[row_i]
+    j = start + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      out[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)] += value * vector[row_i]
+      j += 32
+
+
+@ti.kernel
+def _sparse_csr_matvec_transpose_compressed_heter_gpu(values: ti.types.ndarray(ndim=1),
+                                                      offsets: ti.types.ndarray(ndim=1),
+                                                      bases: ti.types.ndarray(ndim=1),
+                                                      block_ptr: ti.types.ndarray(ndim=1),
+                                                      block_shift: ti.types.ndarray(ndim=1),
+                                                      row_ptr: ti.types.ndarray(ndim=1),
+                                                      vector: ti.types.ndarray(ndim=1),
+                                                      out: ti.types.ndarray(ndim=1)):
+  shift = block_shift[0]
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    start = row_ptr[row_i]
+    j = start + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      out[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)] += values[j] * vector[row_i]
+      j += 32
+
+
+@ti.kernel
+def _sparse_csr_matvec_compressed_homo_gpu(values: ti.types.ndarray(ndim=1),
+                                           offsets: ti.types.ndarray(ndim=1),
+                                           bases: ti.types.ndarray(ndim=1),
+                                           block_ptr: ti.types.ndarray(ndim=1),
+                                           block_shift: ti.types.ndarray(ndim=1),
+                                           row_ptr: ti.types.ndarray(ndim=1),
+                                           vector: ti.types.ndarray(ndim=1),
+                                           out: ti.types.ndarray(ndim=1)):
+  value = values[0]
+  shift = block_shift[0]
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    r = 0.
+    start = row_ptr[row_i]
+    j = start + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      r += vector[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)]
+      j += 32
+    out[row_i] += value * r
+
+
+@ti.kernel
+def _sparse_csr_matvec_compressed_heter_gpu(values: ti.types.ndarray(ndim=1),
+                                            offsets: ti.types.ndarray(ndim=1),
+                                            bases: ti.types.ndarray(ndim=1),
+                                            block_ptr: ti.types.ndarray(ndim=1),
+                                            block_shift: ti.types.ndarray(ndim=1),
+                                            row_ptr: ti.types.ndarray(ndim=1),
+                                            vector: ti.types.ndarray(ndim=1),
+                                            out: ti.types.ndarray(ndim=1)):
+  shift = block_shift[0]
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    r = 0.
+    start = row_ptr[row_i]
+    j = start + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      r += values[j] * vector[compressed_col(offsets, bases, block_ptr, shift, row_i, start, j)]
+      j += 32
+    out[row_i] += r
+
+
+# ---------------
+# planned matrix
+# ---------------
+# On CPU, every parallel task walks the rows of its split of "splits", which have
+# about the same number of rows plus non-zeros. On GPU, every row is processed by
+# one warp, and the splits are not read. The "indirect" kernels read the values
+# through "value_idx".
+
+@ti.kernel
+def _sparse_csr_matvec_planned_homo_cpu(values: ti.types.ndarray(ndim=1),
+                                        col_indices: ti.types.ndarray(ndim=1),
+                                        row_ptr: ti.types.ndarray(ndim=1),
+                                        splits: ti.types.ndarray(ndim=1),
+                                        vector: ti.types.ndarray(ndim=1),
+                                        out: ti.types.ndarray(ndim=1)):
+  value = values[0]
+  for part_i in range(splits.shape[0] - 1):
+    for row_i in range(splits[part_i], splits[part_i + 1]):
+      r = 0.
+      for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+        r += vector[col_indices[j]]
+      out[row_i] = r * value
+
+
+@ti.kernel
+def _sparse_csr_matvec_planned_heter_cpu(values: ti.types.ndarray(ndim=1),
+                                         col_indices: ti.types.ndarray(ndim=1),
+                                         row_ptr: ti.types.ndarray(ndim=1),
+                                         splits: ti.types.ndarray(ndim=1),
+                                         vector: ti.types.ndarray(ndim=1),
+                                         out: ti.types.ndarray(ndim=1)):
+  for part_i in range(splits.shape[0] - 1):
+    for row_i in range(splits[part_i], splits[part_i + 1]):
+      r = 0.
+      for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+        r += values[j] * vector[col_indices[j]]
+      out[row_i] = r
+
+
+@ti.kernel
+def _sparse_csr_matvec_planned_indirect_cpu(values: ti.types.ndarray(ndim=1),
+                                            value_idx: ti.types.ndarray(ndim=1),
+                                            col_indices: ti.types.ndarray(ndim=1),
+                                            row_ptr: ti.types.ndarray(ndim=1),
+                                            splits: ti.types.ndarray(ndim=1),
+                                            vector: ti.types.ndarray(ndim=1),
+                                            out: ti.types.ndarray(ndim=1)):
+  for part_i in range(splits.shape[0] - 1):
+    for row_i in range(splits[part_i], splits[part_i + 1]):
+      r = 0.
+      for j in range(row_ptr[row_i], row_ptr[row_i + 1]):
+        r += values[value_idx[j]] * vector[col_indices[j]]
+      out[row_i] = r
+
+
+@ti.kernel
+def _sparse_csr_matvec_planned_homo_gpu(values: ti.types.ndarray(ndim=1),
+                                        col_indices: ti.types.ndarray(ndim=1),
+                                        row_ptr: ti.types.ndarray(ndim=1),
+                                        splits: ti.types.ndarray(ndim=1),
+                                        vector: ti.types.ndarray(ndim=1),
+                                        out: ti.types.ndarray(ndim=1)):
+  value = values[0]
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    r = 0.
+    j = row_ptr[row_i] + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      r += vector[col_indices[j]]
+      j += 32
+    out[row_i] += value * r
+
+
+@ti.kernel
+def _sparse_csr_matvec_planned_heter_gpu(values: ti.types.ndarray(ndim=1),
+                                         col_indices: ti.types.ndarray(ndim=1),
+                                         row_ptr: ti.types.ndarray(ndim=1),
+                                         splits: ti.types.ndarray(ndim=1),
+                                         vector: ti.types.ndarray(ndim=1),
+                                         out: ti.types.ndarray(ndim=1)):
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    r = 0.
+    j = row_ptr[row_i] + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      r += values[j] * vector[col_indices[j]]
+      j += 32
+    out[row_i] += r
+
+
+@ti.kernel
+def _sparse_csr_matvec_planned_indirect_gpu(values: ti.types.ndarray(ndim=1),
+                                            value_idx: ti.types.ndarray(ndim=1),
+                                            col_indices: ti.types.ndarray(ndim=1),
+                                            row_ptr: ti.types.ndarray(ndim=1),
+                                            splits: ti.types.ndarray(ndim=1),
+                                            vector: ti.types.ndarray(ndim=1),
+                                            out: ti.types.ndarray(ndim=1)):
+  for i in range((row_ptr.shape[0] - 1) * 32):
+    row_i = i >> 5
+    index = i & 31
+    r = 0.
+    j = row_ptr[row_i] + index
+    end_index = row_ptr[row_i + 1]
+    while j < end_index:
+      r += values[value_idx[j]] * vector[col_indices[j]]
+      j += 32
+    out[row_i] += r
+
+
 def _sparse_csr_matvec_jvp_values(val_dot, values, col_indices, row_ptr, vector, *, outs, transpose, shape):
   return raw_csrmv_taichi(val_dot, col_indices, row_ptr, vector, shape=shape, transpose=transpose)
 
@@ -225,10 +904,266 @@ def _sparse_csr_matvec_transpose(
     return ct_data, indices, indptr, vector
 
 
+# A batch of vectors is multiplied as one matrix, which streams the sparse
+# structure once for all the vectors.
+
+def _sparse_csr_matvec_batched(values, col_indices, row_ptr, matrix, *, outs, transpose, shape):
+  return raw_csrmm_taichi(values, col_indices, row_ptr, matrix, shape=shape, transpose=transpose)[0]
+
+
+# The CPU kernels assign every element of their output, or zero it in a parallel
+# loop before they scatter into it, so that it need not be zeroed, while their GPU
+# kernels reduce into a zeroed output.
+_cpu_overwrite = {'cpu': ('overwrite',), 'gpu': ('zero',)}
+
+
 def _define_op(cpu_kernel, gpu_kernel):
-  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel)
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
   prim.defjvp(_sparse_csr_matvec_jvp_values, None, None, _sparse_csr_matvec_jvp_vector)
   prim.def_transpose_rule(_sparse_csr_matvec_transpose)
+  register_vector_batching(prim.primitive, _sparse_csr_matvec_batched, 3)
+  return prim
+
+
+# The 16-bit operators output float32, which their rules keep, and their cotangents
+# of the values are rounded to the dtype of the values.
+
+def _half_csr_matvec_jvp_values(val_dot, values, col_indices, row_ptr, vector, *, outs, transpose, shape):
+  return _half_csrmv_f32(val_dot, col_indices, row_ptr, vector, shape=shape, transpose=transpose)
+
+
+def _half_csr_matvec_jvp_vector(vec_dot, values, col_indices, row_ptr, vector, *, outs, transpose, shape):
+  return _half_csrmv_f32(values, col_indices, row_ptr, vec_dot, shape=shape, transpose=transpose)
+
+
+def _half_csr_matvec_transpose(ct, data, indices, indptr, vector, *, outs, transpose, shape):
+  if ad.is_undefined_primal(indices) or ad.is_undefined_primal(indptr):
+    raise ValueError("Cannot transpose with respect to sparse indices.")
+  if ad.is_undefined_primal(vector):
+    if type(ct[0]) is ad.Zero:
+      return data, indices, indptr, ad.Zero(vector)
+    ct_vector = _half_csrmv_f32(data, indices, indptr, ct[0], shape=shape, transpose=not transpose)[0]
+    return data, indices, indptr, ct_vector
+  else:
+    if type(ct[0]) is ad.Zero:
+      ct_data = ad.Zero(data)
+    else:
+      row, col = csr_to_coo(indices, indptr)
+      ct_data = vector[row] * ct[0][col] if transpose else vector[col] * ct[0][row]
+      ct_data = ct_data.astype(data.aval.dtype)
+    return ct_data, indices, indptr, vector
+
+
+def _half_csr_matvec_batched(values, col_indices, row_ptr, matrix, *, outs, transpose, shape):
+  return raw_csrmm_taichi(values.astype(jnp.float32), col_indices, row_ptr, matrix, shape=shape, transpose=transpose)[0]
+
+
+def _define_half_op(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_half_csr_matvec_jvp_values, None, None, _half_csr_matvec_jvp_vector)
+  prim.def_transpose_rule(_half_csr_matvec_transpose)
+  register_vector_batching(prim.primitive, _half_csr_matvec_batched, 3)
+  return prim
+
+
+# The compressed operators take the compressed indices as four arguments, from
+# "offsets" to "block_shift", followed by "indptr" and the vector.
+
+def _compressed_csr_matvec_jvp_values(val_dot, values, offsets, bases, block_ptr, block_shift, indptr, vector, *,
+                                      outs, transpose, shape):
+  indices = CompressedIndices(offsets, bases, block_ptr, block_shift)
+  return _raw_compressed_csrmv_taichi(val_dot, indices, indptr, vector, shape=shape, transpose=transpose)
+
+
+def _compressed_csr_matvec_jvp_vector(vec_dot, values, offsets, bases, block_ptr, block_shift, indptr, vector, *,
+                                      outs, transpose, shape):
+  indices = CompressedIndices(offsets, bases, block_ptr, block_shift)
+  return _raw_compressed_csrmv_taichi(values, indices, indptr, vec_dot, shape=shape, transpose=transpose)
+
+
+def _compressed_csr_matvec_transpose(ct, data, offsets, bases, block_ptr, block_shift, indptr, vector, *,
+                                     outs, transpose, shape):
+  if any(ad.is_undefined_primal(x) for x in (offsets, bases, block_ptr, block_shift, indptr)):
+    raise ValueError("Cannot transpose with respect to sparse indices.")
+  indices = CompressedIndices(offsets, bases, block_ptr, block_shift)
+  if ad.is_undefined_primal(vector):
+    if type(ct[0]) is ad.Zero:
+      ct_vector = ad.Zero(vector)
+    else:
+      ct_vector = _raw_compressed_csrmv_taichi(data, indices, indptr, ct[0], shape=shape, transpose=not transpose)[0]
+    return data, offsets, bases, block_ptr, block_shift, indptr, ct_vector
+  else:
+    if type(ct[0]) is ad.Zero:
+      ct_data = ad.Zero(data)
+    elif data.aval.shape[0] == 1:  # scalar
+      ct_data = _raw_compressed_csrmv_taichi(jnp.ones(1, dtype=ct[0].dtype), indices, indptr, vector,
+                                             shape=shape, transpose=transpose)[0]
+      ct_data = jnp.inner(ct[0], ct_data)
+    else:
+      row, col = compressed_to_coo(indices, indptr)
+      ct_data = vector[row] * ct[0][col] if transpose else vector[col] * ct[0][row]
+    return ct_data, offsets, bases, block_ptr, block_shift, indptr, vector
+
+
+def _compressed_csr_matvec_batched(values, offsets, bases, block_ptr, block_shift, indptr, matrix, *,
+                                   outs, transpose, shape):
+  indices = decompress_indices(CompressedIndices(offsets, bases, block_ptr, block_shift), indptr)
+  return raw_csrmm_taichi(values, indices, indptr, matrix, shape=shape, transpose=transpose)[0]
+
+
+def _define_compressed_op(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_compressed_csr_matvec_jvp_values, None, None, None, None, None, _compressed_csr_matvec_jvp_vector)
+  prim.def_transpose_rule(_compressed_csr_matvec_transpose)
+  register_vector_batching(prim.primitive, _compressed_csr_matvec_batched, 6)
+  return prim
+
+
+# The planned operators compute the product of the matrix they are given, without
+# transposition. Their rules are written with "value_idx", which is None for the
+# operators which read the values directly.
+
+def _values_in_order(values, value_idx):
+  return values if value_idx is None or values.shape[0] == 1 else values[value_idx]
+
+
+def _planned_csr_matvec_transpose_rule(ct, values, value_idx, indices, indptr, splits, vector):
+  if any(ad.is_undefined_primal(x) for x in (value_idx, indices, indptr, splits)):
+    raise ValueError("Cannot transpose with respect to sparse indices.")
+  if ad.is_undefined_primal(vector):
+    if type(ct[0]) is ad.Zero:
+      return ad.Zero(vector)
+    return raw_csrmv_taichi(_values_in_order(values, value_idx), indices, indptr, ct[0],
+                            shape=(indptr.shape[0] - 1, vector.aval.shape[0]), transpose=True)[0]
+  if type(ct[0]) is ad.Zero:
+    return ad.Zero(values)
+  row, col = csr_to_coo(indices, indptr)
+  ct_values = vector[col] * ct[0][row]
+  if values.aval.shape[0] == 1:  # scalar
+    return jnp.sum(ct_values, keepdims=True)
+  if value_idx is None:
+    return ct_values
+  return jnp.zeros(values.aval.shape, ct_values.dtype).at[value_idx].add(ct_values)
+
+
+def _planned_csr_matvec_jvp_values(val_dot, values, indices, indptr, splits, vector, *, outs):
+  return planned_csrmv(val_dot, None, indices, indptr, splits, vector)
+
+
+def _planned_csr_matvec_jvp_vector(vec_dot, values, indices, indptr, splits, vector, *, outs):
+  return planned_csrmv(values, None, indices, indptr, splits, vec_dot)
+
+
+def _planned_csr_matvec_transpose(ct, values, indices, indptr, splits, vector, *, outs):
+  r = _planned_csr_matvec_transpose_rule(ct, values, None, indices, indptr, splits, vector)
+  if ad.is_undefined_primal(vector):
+    return values, indices, indptr, splits, r
+  return r, indices, indptr, splits, vector
+
+
+def _planned_csr_matvec_batched(values, indices, indptr, splits, matrix, *, outs):
+  return raw_csrmm_taichi(values, indices, indptr, matrix, shape=(indptr.shape[0] - 1, matrix.shape[0]))[0]
+
+
+def _indirect_csr_matvec_jvp_values(val_dot, values, value_idx, indices, indptr, splits, vector, *, outs):
+  return planned_csrmv(val_dot, value_idx, indices, indptr, splits, vector)
+
+
+def _indirect_csr_matvec_jvp_vector(vec_dot, values, value_idx, indices, indptr, splits, vector, *, outs):
+  return planned_csrmv(values, value_idx, indices, indptr, splits, vec_dot)
+
+
+def _indirect_csr_matvec_transpose(ct, values, value_idx, indices, indptr, splits, vector, *, outs):
+  r = _planned_csr_matvec_transpose_rule(ct, values, value_idx, indices, indptr, splits, vector)
+  if ad.is_undefined_primal(vector):
+    return values, value_idx, indices, indptr, splits, r
+  return r, value_idx, indices, indptr, splits, vector
+
+
+def _indirect_csr_matvec_batched(values, value_idx, indices, indptr, splits, matrix, *, outs):
+  return raw_csrmm_taichi(values[value_idx], indices, indptr, matrix, shape=(indptr.shape[0] - 1, matrix.shape[0]))[0]
+
+
+def _define_planned_op(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_planned_csr_matvec_jvp_values, None, None, None, _planned_csr_matvec_jvp_vector)
+  prim.def_transpose_rule(_planned_csr_matvec_transpose)
+  register_vector_batching(prim.primitive, _planned_csr_matvec_batched, 4)
+  return prim
+
+
+def _define_indirect_op(cpu_kernel, gpu_kernel):
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, gpu_kernel=gpu_kernel, output_init=_cpu_overwrite)
+  prim.defjvp(_indirect_csr_matvec_jvp_values, None, None, None, None, _indirect_csr_matvec_jvp_vector)
+  prim.def_transpose_rule(_indirect_csr_matvec_transpose)
+  register_vector_batching(prim.primitive, _indirect_csr_matvec_batched, 5)
+  return prim
+
+
+# The "partial" operators have the scratch output as their second result, which
+# is discarded, so its tangent and cotangent are always zero. Their other rules are
+# those of the operators without it.
+
+def _with_zero_partial(jvp_rule):
+  if jvp_rule is None:
+    return None
+
+  def rule(*args, outs, **kwargs):
+    return list(jvp_rule(*args, outs=outs[:1], **kwargs)) + [ad.Zero(jax.core.ShapedArray(outs[1].shape, outs[1].dtype))]
+
+  return rule
+
+
+def _with_partial_cotangent(transpose_rule):
+  def rule(ct, *args, outs, **kwargs):
+    return transpose_rule(ct[:1], *args, outs=outs[:1], **kwargs)
+
+  return rule
+
+
+def _define_partial_op(cpu_kernel, gpu_fun,
+                       jvp_rules=(_sparse_csr_matvec_jvp_values, None, None, _sparse_csr_matvec_jvp_vector),
+                       transpose_rule=_sparse_csr_matvec_transpose,
+                       batched_rule=_sparse_csr_matvec_batched,
+                       batched_arg=3):
+  # on GPU, "gpu_fun" computes the output without the scratch output
+  prim = XLACustomOp(cpu_kernel=cpu_kernel, output_init=('overwrite', 'overwrite'))
+  prim.def_mlir_lowering('gpu', _scratch_free_lowering(gpu_fun))
+  prim.defjvp(*[_with_zero_partial(r) for r in jvp_rules])
+  prim.def_transpose_rule(_with_partial_cotangent(transpose_rule))
+  register_vector_batching(prim.primitive, batched_rule, batched_arg)
+  return prim
+
+
+def _define_half_partial_op(cpu_kernel, gpu_fun):
+  return _define_partial_op(cpu_kernel, gpu_fun, (_half_csr_matvec_jvp_values, None, None, _half_csr_matvec_jvp_vector),
+                            _half_csr_matvec_transpose, _half_csr_matvec_batched, 3)
+
+
+def _define_compressed_partial_op(cpu_kernel, gpu_fun):
+  return _define_partial_op(cpu_kernel, gpu_fun,
+                            (_compressed_csr_matvec_jvp_values, None, None, None, None, None,
+                             _compressed_csr_matvec_jvp_vector),
+                            _compressed_csr_matvec_transpose, _compressed_csr_matvec_batched, 6)
+
+
+# heter cusparse
+def _csr_matvec_cusparse_batched(data, indices, indptr, matrix, *, shape, transpose):
+  return csr.csr_matmat_p.bind(data, indices, indptr, matrix, shape=shape, transpose=transpose)
+
+
+_csr_matvec_cusparse_p = csr.csr_matvec_p
+register_vector_batching(_csr_matvec_cusparse_p, _csr_matvec_cusparse_batched, 3)
+
+
+def _csr_matvec_cusparse(data, indices, indptr, vector, *, outs, transpose, shape):
+  return [_csr_matvec_cusparse_p.bind(data, indices, indptr, vector, shape=shape, transpose=transpose)]
+
+
+def _define_heter_op(cpu_kernel):
+  # the heter operators run the taichi kernels on CPU, and cusparse on GPU
+  prim = _define_op(cpu_kernel=cpu_kernel, gpu_kernel=None)
+  prim.def_mlir_lowering('gpu', _scratch_free_lowering(_csr_matvec_cusparse))
   return prim
 
 
@@ -240,14 +1175,77 @@ _csr_matvec_transpose_homo_p = _define_op(cpu_kernel=_sparse_csr_matvec_transpos
 _csr_matvec_homo_p = _define_op(cpu_kernel=_sparse_csr_matvec_homo_cpu,
                                 gpu_kernel=_sparse_csr_matvec_homo_gpu)
 
-# transpose heter
-_csr_matvec_transpose_heter_p = _define_op(cpu_kernel=_sparse_csr_matvec_transpose_heter_cpu,
-                                           gpu_kernel=_sparse_csr_matvec_transpose_heter_gpu)
+# transpose heter, cusparse on GPU
+_csr_matvec_transpose_heter_p = _define_heter_op(cpu_kernel=_sparse_csr_matvec_transpose_heter_cpu)
 
-# no transpose heter
-_csr_matvec_heter_p = _define_op(cpu_kernel=_sparse_csr_matvec_heter_cpu,
-                                 gpu_kernel=_sparse_csr_matvec_heter_gpu)
+# no transpose heter, cusparse on GPU
+_csr_matvec_heter_p = _define_heter_op(cpu_kernel=_sparse_csr_matvec_heter_cpu)
 
-# heter cusparse
-_csr_matvec_cusparse_p = csr.csr_matvec_p
-register_general_batching(_csr_matvec_cusparse_p)
+# transpose homo, parallel on CPU
+_csr_matvec_transpose_homo_atomic_p = _define_op(cpu_kernel=_sparse_csr_matvec_transpose_homo_atomic_cpu,
+                                                 gpu_kernel=_sparse_csr_matvec_transpose_homo_gpu)
+_csr_matvec_transpose_homo_partial_p = _define_partial_op(cpu_kernel=_sparse_csr_matvec_transpose_homo_partial_cpu,
+                                                          gpu_fun=_csr_matvec_transpose_homo_p)
+
+# transpose heter, parallel on CPU
+_csr_matvec_transpose_heter_atomic_p = _define_heter_op(cpu_kernel=_sparse_csr_matvec_transpose_heter_atomic_cpu)
+_csr_matvec_transpose_heter_partial_p = _define_partial_op(cpu_kernel=_sparse_csr_matvec_transpose_heter_partial_cpu,
+                                                           gpu_fun=_csr_matvec_cusparse)
+
+# 16-bit heter, float16 and bfloat16
+_csr_matvec_transpose_half_p = _define_half_op(cpu_kernel=_sparse_csr_matvec_transpose_heter_cpu,
+                                               gpu_kernel=_sparse_csr_matvec_transpose_heter_gpu)
+_csr_matvec_transpose_half_atomic_p = _define_half_op(cpu_kernel=_sparse_csr_matvec_transpose_heter_atomic_cpu,
+                                                      gpu_kernel=_sparse_csr_matvec_transpose_heter_gpu)
+_csr_matvec_transpose_half_partial_p = _define_half_partial_op(
+  cpu_kernel=_sparse_csr_matvec_transpose_heter_partial_cpu,
+  gpu_fun=_csr_matvec_transpose_half_p
+)
+_csr_matvec_half_p = _define_half_op(cpu_kernel=_sparse_csr_matvec_heter_cpu,
+                                     gpu_kernel=_sparse_csr_matvec_heter_gpu)
+_csr_matvec_transpose_bf16_p = _define_half_op(cpu_kernel=_sparse_csr_matvec_transpose_bf16_cpu,
+                                               gpu_kernel=_sparse_csr_matvec_transpose_bf16_gpu)
+_csr_matvec_transpose_bf16_atomic_p = _define_half_op(cpu_kernel=_sparse_csr_matvec_transpose_bf16_atomic_cpu,
+                                                      gpu_kernel=_sparse_csr_matvec_transpose_bf16_gpu)
+_csr_matvec_transpose_bf16_partial_p = _define_half_partial_op(cpu_kernel=_sparse_csr_matvec_transpose_bf16_partial_cpu,
+                                                               gpu_fun=_csr_matvec_transpose_bf16_p)
+_csr_matvec_bf16_p = _define_half_op(cpu_kernel=_sparse_csr_matvec_bf16_cpu,
+                                     gpu_kernel=_sparse_csr_matvec_bf16_gpu)
+
+# compressed indices
+_csr_matvec_transpose_compressed_homo_p = _define_compressed_op(
+  cpu_kernel=_sparse_csr_matvec_transpose_compressed_homo_cpu,
+  gpu_kernel=_sparse_csr_matvec_transpose_compressed_homo_gpu
+)
+_csr_matvec_transpose_compressed_heter_p = _define_compressed_op(
+  cpu_kernel=_sparse_csr_matvec_transpose_compressed_heter_cpu,
+  gpu_kernel=_sparse_csr_matvec_transpose_compressed_heter_gpu
+)
+_csr_matvec_transpose_compressed_homo_atomic_p = _define_compressed_op(
+  cpu_kernel=_sparse_csr_matvec_transpose_compressed_homo_atomic_cpu,
+  gpu_kernel=_sparse_csr_matvec_transpose_compressed_homo_gpu
+)
+_csr_matvec_transpose_compressed_heter_atomic_p = _define_compressed_op(
+  cpu_kernel=_sparse_csr_matvec_transpose_compressed_heter_atomic_cpu,
+  gpu_kernel=_sparse_csr_matvec_transpose_compressed_heter_gpu
+)
+_csr_matvec_transpose_compressed_homo_partial_p = _define_compressed_partial_op(
+  cpu_kernel=_sparse_csr_matvec_transpose_compressed_homo_partial_cpu,
+  gpu_fun=_csr_matvec_transpose_compressed_homo_p
+)
+_csr_matvec_transpose_compressed_heter_partial_p = _define_compressed_partial_op(
+  cpu_kernel=_sparse_csr_matvec_transpose_compressed_heter_partial_cpu,
+  gpu_fun=_csr_matvec_transpose_compressed_heter_p
+)
+_csr_matvec_compressed_homo_p = _define_compressed_op(cpu_kernel=_sparse_csr_matvec_compressed_homo_cpu,
+                                                      gpu_kernel=_sparse_csr_matvec_compressed_homo_gpu)
+_csr_matvec_compressed_heter_p = _define_compressed_op(cpu_kernel=_sparse_csr_matvec_compressed_heter_cpu,
+                                                       gpu_kernel=_sparse_csr_matvec_compressed_heter_gpu)
+
+# planned matrix
+_csr_matvec_planned_homo_p = _define_planned_op(cpu_kernel=_sparse_csr_matvec_planned_homo_cpu,
+                                                gpu_kernel=_sparse_csr_matvec_planned_homo_gpu)
+_csr_matvec_planned_heter_p = _define_planned_op(cpu_kernel=_sparse_csr_matvec_planned_heter_cpu,
+                                                 gpu_kernel=_sparse_csr_matvec_planned_heter_gpu)
+_csr_matvec_planned_indirect_p = _define_indirect_op(cpu_kernel=_sparse_csr_matvec_planned_indirect_cpu,
+                                                     gpu_kernel=_sparse_csr_matvec_planned_indirect_gpu)
@@ -0,0 +1,225 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+# Connectivity plans.
+#
+# A plan is built once from a CSR matrix ``A`` on the host, and holds:
+#
+# - an optional reordering ``A' = A[row_perm][:, col_perm]``, with the columns
+#   sorted within the rows. The products are computed on ``A'``, the vectors are
+#   permuted into its order and the results back, and the heterogeneous values,
+#   which stay in the order of ``A``, are read through ``value_idx``.
+# - ``A'`` transposed, in CSR, whose non-zeros read the values through
+#   ``t_value_idx``. The transposed products gather over it instead of scattering
+#   with atomics.
+# - the rows of both split into ``splits`` and ``t_splits``, which balance the
+#   number of rows plus non-zeros of the parallel tasks on CPU, as merge-path does.
+#   A task walks all the rows of its split.
+
+import os
+from typing import Optional, Tuple
+
+import jax
+import numpy as np
+from jax import numpy as jnp
+
+__all__ = [
+  'CSRPlan',
+  'csr_plan',
+]
+
+# the number of parallel tasks of each thread on CPU
+_partitions_per_thread = 4
+
+
+@jax.tree_util.register_pytree_node_class
+class CSRPlan:
+  """The connectivity plan of a CSR matrix, built by :func:`csr_plan`.
+
+  It can be given to :func:`csrmv`, :func:`event_csrmv`, :func:`csrmm` and
+  :func:`event_csrmm` in place of ``indices``, in which case ``indptr`` is not
+  read. The values and the vectors stay in the order of the original matrix.
+  """
+
+  def __init__(self, indices, indptr, splits, t_indices, t_indptr, t_splits, t_value_idx,
+               value_idx=None, row_perm=None, col_perm=None, inv_row_perm=None, inv_col_perm=None):
+    self.indices = indices
+    self.indptr = indptr
+    self.splits = splits
+    self.t_indices = t_indices
+    self.t_indptr = t_indptr
+    self.t_splits = t_splits
+    self.t_value_idx = t_value_idx
+    self.value_idx = value_idx
+    self.row_perm = row_perm
+    self.col_perm = col_perm
+    self.inv_row_perm = inv_row_perm
+    self.inv_col_perm = inv_col_perm
+
+  @property
+  def shape(self) -> Tuple[int]:
+    return self.indices.shape
+
+  @property
+  def ndim(self) -> int:
+    return 1
+
+  @property
+  def dtype(self):
+    return self.indices.dtype
+
+  def tree_flatten(self):
+    return ((self.indices, self.indptr, self.splits, self.t_indices, self.t_indptr, self.t_splits,
+             self.t_value_idx, self.value_idx, self.row_perm, self.col_perm, self.inv_row_perm,
+             self.inv_col_perm),
+            None)
+
+  @classmethod
+  def tree_unflatten(cls, aux_data, children):
+    return cls(*children)
+
+
+def _balanced_splits(indptr: np.ndarray, num_partitions: int) -> np.ndarray:
+  # the split "k" is the first row at which the rows plus non-zeros before it reach
+  # "k / num_partitions" of the total
+  num_row = indptr.shape[0] - 1
+  num_partitions = max(min(num_partitions, num_row), 1)
+  work = np.arange(num_row + 1) + indptr
+  targets = np.arange(num_partitions + 1) * (work[-1] / num_partitions)
+  splits = np.searchsorted(work, targets, side='left')
+  splits[-1] = num_row
+  return splits
+
+
+def _to_csr(rows: np.ndarray, cols: np.ndarray, num_row: int) -> Tuple[np.ndarray, np.ndarray]:
+  # the order of the non-zeros by rows then columns, and the row pointers
+  order = np.lexsort((cols, rows))
+  indptr = np.concatenate([[0], np.cumsum(np.bincount(rows, minlength=num_row))])
+  return order, indptr
+
+
+def csr_plan(
+    indices: jax.typing.ArrayLike,
+    indptr: jax.typing.ArrayLike,
+    *,
+    shape: Tuple[int, int],
+    reorder: Optional[str] = None,
+    num_partitions: Optional[int] = None,
+) -> CSRPlan:
+  """Build the connectivity plan of a CSR matrix, once for all its products.
+
+  The plan caches the transposed matrix, so that the transposed products gather
+  without atomics, and splits the rows into parallel tasks of balanced work. It
+  can also reorder the matrix for the locality of the vector reads:
+
+  - ``'rcm'``: the reverse Cuthill-McKee order of a square matrix, applied to both
+    its rows and columns, which reduces its bandwidth.
+  - ``'degree'``: the rows in decreasing number of non-zeros.
+
+  With a reordering, the vectors are permuted at every call, and the
+  heterogeneous values are read through an index of the plan. The plan is built
+  on the host.
+
+  Parameters
+  ----------
+  indices: ndarray
+    The column indices, of shape ``(nse,)``.
+  indptr: ndarray
+    The row pointers, of shape ``(shape[0] + 1,)``.
+  shape: tuple of int
+    The shape of the matrix.
+  reorder: str, optional
+    ``None``, ``'rcm'`` or ``'degree'``.
+  num_partitions: int, optional
+    The number of parallel tasks on CPU. Defaults to four per thread.
+
+  Returns
+  -------
+  plan : CSRPlan
+    The plan, to be given in place of ``indices``.
+  """
+  indices = np.asarray(indices).astype(np.int64)
+  indptr = np.asarray(indptr).astype(np.int64)
+  num_row, num_col = shape
+  if indices.ndim != 1 or indptr.shape != (num_row + 1,):
+    raise ValueError(f'indices should be a 1D vector and indptr of shape ({num_row + 1},).')
+  if num_partitions is None:
+    num_partitions = (os.cpu_count() or 1) * _partitions_per_thread
+
+  nnz = indices.shape[0]
+  rows = np.repeat(np.arange(num_row), np.diff(indptr))
+  value_idx = row_perm = col_perm = None
+  if reorder is None:
+    cols = indices
+  else:
+    if reorder == 'rcm':
+      if num_row != num_col:
+        raise ValueError(f'The "rcm" reordering needs a square matrix, but got {shape}.')
+      from scipy.sparse import csr_matrix
+      from scipy.sparse.csgraph import reverse_cuthill_mckee
+      row_perm = col_perm = reverse_cuthill_mckee(
+        csr_matrix((np.ones(nnz, dtype=np.int8), indices, indptr), shape=shape), symmetric_mode=False
+      ).astype(np.int64)
+    elif reorder == 'degree':
+      row_perm = np.argsort(-np.diff(indptr), kind='stable')
+    else:
+      raise ValueError(f'Unknown reordering: {reorder}. Should be None, "rcm" or "degree".')
+    inv_row_perm = np.argsort(row_perm)
+    rows = inv_row_perm[rows]
+    cols = indices if col_perm is None else np.argsort(col_perm)[indices]
+    value_idx, indptr = _to_csr(rows, cols, num_row)
+    rows, cols = rows[value_idx], cols[value_idx]
+
+  t_value_idx, t_indptr = _to_csr(cols, rows, num_col)
+  t_rows = rows[t_value_idx]
+  if value_idx is not None:
+    t_value_idx = value_idx[t_value_idx]
+
+  def _array(a):
+    return None if a is None else jnp.asarray(a.astype(np.int32))
+
+  return CSRPlan(indices=_array(cols),
+                 indptr=_array(indptr),
+                 splits=_array(_balanced_splits(indptr, num_partitions)),
+                 t_indices=_array(t_rows),
+                 t_indptr=_array(t_indptr),
+                 t_splits=_array(_balanced_splits(t_indptr, num_partitions)),
+                 t_value_idx=_array(t_value_idx),
+                 value_idx=_array(value_idx),
+                 row_perm=_array(row_perm),
+                 col_perm=_array(col_perm),
+                 inv_row_perm=None if row_perm is None else _array(np.argsort(row_perm)),
+                 inv_col_perm=None if col_perm is None else _array(np.argsort(col_perm)))
+
+
+def plan_values(data: jax.Array, plan: CSRPlan) -> jax.Array:
+  """The values in the order of the non-zeros of the plan."""
+  if data.shape[0] == 1 or plan.value_idx is None:
+    return data
+  return data[plan.value_idx]
+
+
+def plan_input(plan: CSRPlan, x: jax.Array, transpose: bool) -> jax.Array:
+  """Permute the vector or the rows of the matrix multiplied by the plan into its order."""
+  perm = plan.row_perm if transpose else plan.col_perm
+  return x if perm is None else x[perm]
+
+
+def plan_output(plan: CSRPlan, y: jax.Array, transpose: bool) -> jax.Array:
+  """Permute the result of a product in the order of the plan back."""
+  perm = plan.inv_col_perm if transpose else plan.inv_row_perm
+  return y if perm is None else y[perm]
@@ -0,0 +1,259 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+# Sliced ELLPACK (SELL-C-sigma).
+#
+# The rows are sorted by decreasing number of non-zeros within windows of "sigma"
+# rows, padded to a multiple of "C", and grouped into slices of "C" consecutive
+# rows. Each slice is padded to the width of its longest row and stored column-major,
+# so that the "k"-th non-zero of the row "lane" of the slice "s" is the slot
+#
+#   slice_ptr[s] + k * C + lane
+#
+# The "C" rows of a slice are thus computed in lockstep over contiguous slots, and
+# the padding slots are those with "k >= row_len[row]". Their columns are 0 and
+# their values are 0.
+#
+# The rows of the products are in the order of the slices, "row_perm" gives the
+# original row of each of them, or "num_row" for the padding rows, and "row_pos" the
+# position of each original row. Both are None without sorting.
+
+from typing import Optional, Tuple
+
+import jax
+import numpy as np
+from jax import numpy as jnp
+
+__all__ = [
+  'SELLIndices',
+  'csr_to_sell',
+  'sell_values',
+]
+
+
+@jax.tree_util.register_pytree_node_class
+class SELLIndices:
+  """The structure of a sparse matrix in the sliced ELLPACK format, built by :func:`csr_to_sell`.
+
+  It is given to :func:`sellmv` and :func:`event_sellmv`, together with values in
+  its order, see :func:`sell_values`.
+
+  Attributes
+  ----------
+  indices: Array
+    The column of each slot, of shape ``(num_slot,)``.
+  slice_ptr: Array
+    The first slot of each slice, of shape ``(num_slice + 1,)``.
+  row_len: Array
+    The number of non-zeros of each row in the order of the slices, of shape
+    ``(num_slice * C,)``.
+  value_idx: Array
+    The index of the value of each slot in the CSR order, or ``nse`` for the
+    padding slots.
+  row_perm: Array, optional
+    The original row of each row in the order of the slices.
+  row_pos: Array, optional
+    The position of each original row in the order of the slices.
+  """
+
+  def __init__(self, indices, slice_ptr, row_len, value_idx, row_perm=None, row_pos=None):
+    self.indices = indices
+    self.slice_ptr = slice_ptr
+    self.row_len = row_len
+    self.value_idx = value_idx
+    self.row_perm = row_perm
+    self.row_pos = row_pos
+
+  @property
+  def shape(self) -> Tuple[int]:
+    return self.indices.shape
+
+  @property
+  def ndim(self) -> int:
+    return 1
+
+  @property
+  def dtype(self):
+    return self.indices.dtype
+
+  @property
+  def slice_size(self) -> int:
+    """The number of rows ``C`` of the slices."""
+    return sell_slice_size(self.slice_ptr, self.row_len)
+
+  def tree_flatten(self):
+    return (self.indices, self.slice_ptr, self.row_len, self.value_idx, self.row_perm, self.row_pos), None
+
+  @classmethod
+  def tree_unflatten(cls, aux_data, children):
+    return cls(*children)
+
+
+def sell_slice_size(slice_ptr, row_len) -> int:
+  # "C" is known from the static shapes
+  return row_len.shape[0] // max(slice_ptr.shape[0] - 1, 1)
+
+
+def csr_to_sell(
+    indices: jax.typing.ArrayLike,
+    indptr: jax.typing.ArrayLike,
+    *,
+    shape: Tuple[int, int],
+    slice_size: int = 8,
+    sort_window: Optional[int] = None,
+) -> SELLIndices:
+  """Convert the structure of a CSR matrix into the sliced ELLPACK format (SELL-C-σ).
+
+  The rows are grouped into slices of ``C = slice_size`` rows, which are padded to
+  the length of their longest row and stored column-major, so that the kernels
+  compute the ``C`` rows of a slice in lockstep: on CPU, the innermost loop runs
+  over the contiguous slots of the ``C`` rows and vectorizes, and on GPU, the
+  threads of the rows read contiguous slots. To reduce the padding, the rows can
+  be sorted by decreasing number of non-zeros within windows of ``σ = sort_window``
+  rows. A fixed number of non-zeros per row needs no padding nor sorting.
+
+  ``C`` is best the number of lanes of the SIMD registers on CPU, such as 8 for
+  ``float32`` with AVX2 or 16 with AVX-512, and 32 on GPU. The conversion runs on
+  the host, once for a given connectivity.
+
+  Parameters
+  ----------
+  indices: ndarray
+    The column indices, of shape ``(nse,)``.
+  indptr: ndarray
+    The row pointers, of shape ``(shape[0] + 1,)``.
+  shape: tuple of int
+    The shape of the matrix.
+  slice_size: int
+    The number of rows ``C`` of a slice.
+  sort_window: int, optional
+    The number of rows ``σ`` within which the rows are sorted, a multiple of
+    ``slice_size``. ``None`` keeps the order of the rows.
+
+  Returns
+  -------
+  indices : SELLIndices
+    The structure of the matrix, to be given to :func:`sellmv` and
+    :func:`event_sellmv`.
+  """
+  if slice_size < 1:
+    raise ValueError(f'"slice_size" should be positive, but got {slice_size}.')
+  if sort_window is not None and (sort_window < slice_size or sort_window % slice_size):
+    raise ValueError(f'"sort_window" should be a multiple of "slice_size" ({slice_size}), but got {sort_window}.')
+  indices = np.asarray(indices).astype(np.int64)
+  indptr = np.asarray(indptr).astype(np.int64)
+  num_row = shape[0]
+  if indices.ndim != 1 or indptr.shape != (num_row + 1,):
+    raise ValueError(f'indices should be a 1D vector and indptr of shape ({num_row + 1},).')
+
+  nnz = indices.shape[0]
+  lengths = np.diff(indptr)
+  num_slice = (num_row + slice_size - 1) // slice_size
+  row_perm = row_pos = None
+  if sort_window is None:
+    row_pos = np.arange(num_row)
+  else:
+    window = np.arange(num_row) // sort_window
+    row_perm = np.lexsort((-lengths, window))
+    row_pos = np.argsort(row_perm)
+
+  row_len = np.zeros(num_slice * slice_size, dtype=np.int64)
+  row_len[row_pos] = lengths
+  widths = row_len.reshape(num_slice, slice_size).max(axis=1, initial=0)
+  slice_ptr = np.concatenate([[0], np.cumsum(widths * slice_size)])
+
+  rows = np.repeat(np.arange(num_row), lengths)
+  position = row_pos[rows]
+  slots = slice_ptr[position // slice_size] + (np.arange(nnz) - indptr[rows]) * slice_size + position % slice_size
+  sell_indices = np.zeros(slice_ptr[-1], dtype=np.int64)
+  sell_indices[slots] = indices
+  value_idx = np.full(slice_ptr[-1], nnz, dtype=np.int64)
+  value_idx[slots] = np.arange(nnz)
+
+  if row_perm is not None:
+    row_perm = np.concatenate([row_perm, np.full(num_slice * slice_size - num_row, num_row)])
+
+  def _array(a):
+    return None if a is None else jnp.asarray(a.astype(np.int32))
+
+  return SELLIndices(indices=_array(sell_indices),
+                     slice_ptr=_array(slice_ptr),
+                     row_len=_array(row_len),
+                     value_idx=_array(value_idx),
+                     row_perm=_array(row_perm),
+                     row_pos=None if sort_window is None else _array(row_pos))
+
+
+def sell_values(
+    data: jax.typing.ArrayLike,
+    indices: SELLIndices,
+) -> jax.Array:
+  """Arrange the values of a CSR matrix in the order of its sliced ELLPACK format.
+
+  The padding slots get zero values. A homogeneous value, of shape ``(1,)``, is
+  returned as it is.
+
+  Parameters
+  ----------
+  data: ndarray
+    The values, of shape ``(nse,)`` or ``(1,)``.
+  indices: SELLIndices
+    The structure built by :func:`csr_to_sell` from the same matrix.
+
+  Returns
+  -------
+  data : Array
+    The values, of shape ``(num_slot,)`` or ``(1,)``.
+  """
+  data = jnp.atleast_1d(jnp.asarray(data))
+  if data.shape[0] == 1:
+    return data
+  return jnp.take(data, indices.value_idx, mode='fill', fill_value=0)
+
+
+def sell_input(indices: SELLIndices, x: jax.Array) -> jax.Array:
+  """The rows of ``x``, indexed by the rows of the matrix, in the order of the slices."""
+  num_row = indices.row_len.shape[0]
+  if indices.row_perm is None:
+    return jnp.pad(x, [(0, num_row - x.shape[0])] + [(0, 0)] * (x.ndim - 1))
+  return jnp.take(x, indices.row_perm, axis=0, mode='fill', fill_value=0)
+
+
+def sell_output(indices: SELLIndices, y: jax.Array, num_row: int) -> jax.Array:
+  """The rows of a product in the order of the slices back in the original order."""
+  if indices.row_pos is None:
+    return y[:num_row]
+  return y[indices.row_pos]
+
+
+def sell_slots(slice_ptr, row_len, num_slot) -> Tuple[jax.Array, jax.Array]:
+  """The row of each slot, in the order of the slices, and whether it is not a padding slot."""
+  size = sell_slice_size(slice_ptr, row_len)
+  slots = jnp.arange(num_slot, dtype=jnp.int32)
+  slices = jnp.searchsorted(slice_ptr, slots, side='right').astype(jnp.int32) - 1
+  offset = slots - slice_ptr[slices]
+  rows = slices * size + offset % size
+  return rows, offset // size < row_len[rows]
+
+
+def sell_matmat(values, indices, slice_ptr, row_len, matrix, *, transpose, num_out):
+  """The product of the matrix and a dense matrix, computed over the slots with jax."""
+  rows, valid = sell_slots(slice_ptr, row_len, indices.shape[0])
+  weights = jnp.where(valid, values[0] if values.shape[0] == 1 else values, 0).astype(matrix.dtype)
+  if transpose:
+    return jax.ops.segment_sum(weights[:, None] * matrix[rows], indices, num_segments=num_out)
+  return jax.ops.segment_sum(weights[:, None] * matrix[indices], rows, num_segments=num_out)
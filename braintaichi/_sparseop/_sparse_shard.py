@@ -0,0 +1,238 @@
+# Copyright 2024- BrainPy Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+# -*- coding: utf-8 -*-
+
+# Row-sharded CSR matrices.
+#
+# The rows are split into "D" blocks of "rows" consecutive rows, one for each device
+# along an axis of a mesh, with the last block padded by empty rows. Each block is
+# a CSR matrix of its own, whose row pointers start at 0 and whose non-zeros are
+# padded to those of the largest block. They are stacked along a first axis of size
+# "D", which is sharded over the mesh axis.
+#
+# The products run under "shard_map":
+#
+# - "A @ x" computes the rows of each block on its device, from the whole "x", and
+#   the result is sharded by rows without any communication.
+# - "x @ A" multiplies each block by its rows of "x", which gives a partial sum of
+#   the whole result on each device. The partial sums are reduced and scattered
+#   over the devices, so that the result is sharded by columns.
+
+from typing import Tuple
+
+import jax
+import numpy as np
+from jax import numpy as jnp
+from jax.sharding import Mesh, NamedSharding, PartitionSpec as P
+
+try:
+  from jax import shard_map
+except ImportError:
+  from jax.experimental.shard_map import shard_map
+
+__all__ = [
+  'ShardedCSR',
+  'csr_shard',
+  'shard_values',
+]
+
+
+@jax.tree_util.register_pytree_node_class
+class ShardedCSR:
+  """The blocks of rows of a CSR matrix over the devices of a mesh axis, built by :func:`csr_shard`.
+
+  It can be given to :func:`csrmv` and :func:`event_csrmv` in place of
+  ``indices``, in which case ``indptr`` is not read. The values are those of the
+  original matrix, or their blocks, see :func:`shard_values`.
+
+  Attributes
+  ----------
+  indices: Array
+    The column indices of each block, of shape ``(D, nse_per_shard)``.
+  indptr: Array
+    The row pointers of each block, of shape ``(D, rows_per_shard + 1)``.
+  value_idx: Array
+    The index of the value of each non-zero in the original matrix, or ``0``
+    for the padding.
+  mesh: Mesh
+    The mesh of the devices.
+  axis_name: str
+    The axis of the mesh which the rows are split over.
+  """
+
+  def __init__(self, indices, indptr, value_idx, mesh: Mesh, axis_name: str):
+    self.indices = indices
+    self.indptr = indptr
+    self.value_idx = value_idx
+    self.mesh = mesh
+    self.axis_name = axis_name
+
+  @property
+  def shape(self) -> Tuple[int]:
+    return self.indices.shape
+
+  @property
+  def ndim(self) -> int:
+    return 2
+
+  @property
+  def dtype(self):
+    return self.indices.dtype
+
+  @property
+  def num_shard(self) -> int:
+    return self.indices.shape[0]
+
+  @property
+  def rows_per_shard(self) -> int:
+    return self.indptr.shape[1] - 1
+
+  def tree_flatten(self):
+    return (self.indices, self.indptr, self.value_idx), (self.mesh, self.axis_name)
+
+  @classmethod
+  def tree_unflatten(cls, aux_data, children):
+    return cls(*children, *aux_data)
+
+
+def csr_shard(
+    indices: jax.typing.ArrayLike,
+    indptr: jax.typing.ArrayLike,
+    *,
+    shape: Tuple[int, int],
+    mesh: Mesh,
+    axis_name: str,
+) -> ShardedCSR:
+  """Split the rows of a CSR matrix over the devices of a mesh axis.
+
+  Each device holds a block of consecutive rows as a CSR matrix of its own. The
+  products with the matrix then run on all the devices: ``A @ x`` computes the
+  rows of each block locally and is sharded by rows, and ``x @ A`` reduces the
+  partial sums of the blocks and scatters them, so that it is sharded by
+  columns. The rows are the presynaptic neurons of a projection, so that the
+  transposed products, which propagate the events, split the postsynaptic ones.
+
+  The splitting runs on the host, once for a given connectivity.
+
+  Parameters
+  ----------
+  indices: ndarray
+    The column indices, of shape ``(nse,)``.
+  indptr: ndarray
+    The row pointers, of shape ``(shape[0] + 1,)``.
+  shape: tuple of int
+    The shape of the matrix.
+  mesh: Mesh
+    The mesh of the devices.
+  axis_name: str
+    The axis of ``mesh`` to split the rows over.
+
+  Returns
+  -------
+  sharded : ShardedCSR
+    The blocks of the matrix, to be given in place of ``indices``.
+  """
+  indices = np.asarray(indices).astype(np.int64)
+  indptr = np.asarray(indptr).astype(np.int64)
+  num_row = shape[0]
+  if indices.ndim != 1 or indptr.shape != (num_row + 1,):
+    raise ValueError(f'indices should be a 1D vector and indptr of shape ({num_row + 1},).')
+  if axis_name not in mesh.shape:
+    raise ValueError(f'Unknown axis {axis_name} of the mesh with the axes {tuple(mesh.shape)}.')
+
+  num_shard = mesh.shape[axis_name]
+  rows = -(-num_row // num_shard)
+  starts = indptr[np.minimum(np.arange(num_shard + 1) * rows, num_row)]
+  nse = max(int(np.max(np.diff(starts))), 1)
+
+  block_indices = np.zeros((num_shard, nse), dtype=np.int32)
+  block_indptr = np.zeros((num_shard, rows + 1), dtype=np.int32)
+  value_idx = np.zeros((num_shard, nse), dtype=np.int32)
+  for k in range(num_shard):
+    ptr = indptr[min(k * rows, num_row): min((k + 1) * rows, num_row) + 1] - starts[k]
+    block_indptr[k, :ptr.shape[0]] = ptr
+    block_indptr[k, ptr.shape[0]:] = ptr[-1]
+    n = starts[k + 1] - starts[k]
+    block_indices[k, :n] = indices[starts[k]: starts[k + 1]]
+    value_idx[k, :n] = np.arange(starts[k], starts[k + 1])
+
+  sharding = NamedSharding(mesh, P(axis_name))
+  return ShardedCSR(indices=jax.device_put(block_indices, sharding),
+                    indptr=jax.device_put(block_indptr, sharding),
+                    value_idx=jax.device_put(value_idx, sharding),
+                    mesh=mesh,
+                    axis_name=axis_name)
+
+
+def shard_values(data: jax.typing.ArrayLike, sharded: ShardedCSR) -> jax.Array:
+  """Split the values of a CSR matrix into the blocks of :func:`csr_shard`.
+
+  The products gather the values of the original matrix into the blocks at every
+  call. Splitting them once saves this gather when they do not change.
+
+  Parameters
+  ----------
+  data: ndarray
+    The values of the original matrix, of shape ``(nse,)``.
+  sharded: ShardedCSR
+    The blocks of the matrix.
+
+  Returns
+  -------
+  data : Array
+    The values of the blocks, of shape ``sharded.shape``.
+  """
+  data = jnp.asarray(data)
+  return jax.device_put(data[sharded.value_idx], NamedSharding(sharded.mesh, P(sharded.axis_name)))
+
+
+def sharded_matvec(op, data, sharded: ShardedCSR, vector, *, shape: Tuple[int, int], transpose: bool):
+  """Multiply a row-sharded matrix by a vector with the matrix-vector product ``op``."""
+  num_row, num_col = shape
+  num_shard, rows = sharded.num_shard, sharded.rows_per_shard
+  axis = sharded.axis_name
+  data = jnp.atleast_1d(data)
+  if data.ndim == 1 and data.shape[0] != 1:
+    data = data[sharded.value_idx]
+  homo = data.ndim == 1
+  data_spec = P() if homo else P(axis)
+
+  if transpose:
+    # the partial sums of all the columns are reduced and scattered by columns
+    cols = -(-num_col // num_shard) * num_shard
+    vector = jnp.pad(vector, (0, num_shard * rows - num_row))
+
+    def local(data, indices, indptr, vector):
+      data = data if homo else data[0]
+      r = op(data, indices[0], indptr[0], vector, shape=(rows, cols), transpose=True)
+      return jax.lax.psum_scatter(r, axis, scatter_dimension=0, tiled=True)
+
+    vector_spec = P(axis)
+    size = num_col
+  else:
+    # the rows of each block are computed on its device
+    def local(data, indices, indptr, vector):
+      data = data if homo else data[0]
+      return op(data, indices[0], indptr[0], vector, shape=(rows, num_col), transpose=False)
+
+    vector_spec = P()
+    size = num_row
+
+  r = shard_map(local,
+                mesh=sharded.mesh,
+                in_specs=(data_spec, P(axis), P(axis), vector_spec),
+                out_specs=P(axis))(data, sharded.indices, sharded.indptr, vector)
+  return r[:size]
@@ -15,10 +15,13 @@
 
 # -*- coding: utf-8 -*-
 
+import os
 import warnings
 from typing import Tuple
 
+import jax
 import numpy as np
+import taichi as ti
 from jax import core, numpy as jnp
 from jax.interpreters import mlir, ad
 from jaxlib import gpu_sparse
@@ -32,6 +35,114 @@ __all__ = [
 ]
 
 
+# How the transposed CSR products scatter into their output on CPU:
+#
+# - "serial": one thread walks all the rows, the fastest for small matrices.
+# - "atomic": the rows are processed in parallel and accumulated with atomic adds.
+# - "partial": the rows are split into blocks which are processed in parallel, each
+#   one accumulating into its own row of a scratch output without atomics. The rows
+#   of the scratch output are then summed in parallel.
+# - "auto": chooses among them by the size of the problem.
+cpu_transpose_strategy = os.environ.get('BRAINTAICHI_CPU_TRANSPOSE', 'auto')
+
+# below this number of non-zeros, the threading overhead exceeds the gain
+_parallel_transpose_min_nnz = 1 << 16
+
+# the largest scratch output of the "partial" strategy, in elements
+_partial_transpose_max_size = 1 << 22
+
+
+def _cpu_transpose_strategy(num_col: int, nnz: int) -> Tuple[str, int]:
+  """Return the scatter strategy of a transposed CSR product on CPU and its number of blocks."""
+  num_thread = os.cpu_count() or 1
+  num_block = max(min(num_thread, nnz // (_parallel_transpose_min_nnz // 4)), 2)
+  strategy = cpu_transpose_strategy
+  if strategy == 'auto':
+    if num_thread == 1 or nnz < _parallel_transpose_min_nnz:
+      strategy = 'serial'
+    elif num_block * num_col <= min(nnz, _partial_transpose_max_size):
+      # zeroing and reducing the scratch output costs less than the scatter itself
+      strategy = 'partial'
+    else:
+      strategy = 'atomic'
+  elif strategy not in ('serial', 'atomic', 'partial'):
+    raise ValueError(f'Unknown CPU transpose strategy: {strategy}. '
+                     f'Should be "auto", "serial", "atomic" or "partial".')
+  return strategy, num_block
+
+
+def _transpose_prim(serial, atomic, partial, outs: list, nnz: int):
+  """The operator of a transposed product among its serial, atomic and partial ones.
+
+  The scratch output of the partial one, with the dtype of the output, is appended
+  to ``outs``.
+  """
+  num_col = outs[0].shape[0]
+  strategy, num_block = _cpu_transpose_strategy(num_col, nnz)
+  if strategy == 'atomic':
+    return atomic
+  if strategy == 'partial':
+    outs.append(jax.ShapeDtypeStruct((num_block, num_col), dtype=outs[0].dtype))
+    return partial
+  return serial
+
+
+def _use_atomic_cpu_scatter(num_out: int, nnz: int) -> bool:
+  """Whether a transposed product without a "partial" kernel scatters with atomic adds.
+
+  Such products run their atomic kernel on CPU whenever the strategy is not "serial".
+  """
+  return _cpu_transpose_strategy(num_out, nnz)[0] != 'serial'
+
+
+# The strategies are chosen when the products are traced, whatever the platform
+# they are compiled for. Their operators only differ on CPU: on GPU, the atomic
+# ones have the same kernel as the serial ones, and the ones with a scratch output
+# are lowered to an operator without it, see "_scratch_free_lowering()".
+
+def _scratch_free_lowering(fun):
+  """The lowering rule which computes the first output of an operator with ``fun``,
+  which takes the same arguments without the scratch outputs which follow it.
+
+  The scratch outputs are zeros, which XLA removes, as the callers discard them.
+  """
+
+  def rule(*ins, outs, **kwargs):
+    res = list(fun(*ins, outs=outs[:1], **kwargs))
+    return res + [jnp.zeros(out.shape, out.dtype) for out in outs[1:]]
+
+  return mlir.lower_fun(rule, multiple_results=True)
+
+
+# The 16-bit values, which the CSR kernels read in 16 bits and accumulate in float32.
+# Taichi has no bfloat16, so the kernels receive the bits of bfloat16 values as
+# uint16 and decode them with "bf16_to_f32".
+_half_dtypes = (jnp.float16, jnp.bfloat16)
+
+
+def is_half(dtype) -> bool:
+  return dtype in _half_dtypes
+
+
+@ti.func
+def bf16_to_f32(bits):
+  # a bfloat16 is the upper half of a float32
+  return ti.bit_cast(ti.cast(bits, ti.u32) << 16, ti.f32)
+
+
+def _check_accumulate_state(state, data, *, shape, transpose):
+  """Check the state which an accumulating product is written into."""
+  num_out = shape[1] if transpose else shape[0]
+  if state.shape != (num_out,):
+    raise ValueError(f'The state should have the shape ({num_out},) of the product with the matrix {shape} '
+                     f'and transpose={transpose}, but got {state.shape}.')
+  # the 16-bit values are accumulated in float32
+  dtype = jnp.float32 if is_half(data.dtype) else data.dtype
+  if state.dtype != dtype:
+    raise TypeError(f'The state should have the dtype {dtype} for the values of dtype {data.dtype}, '
+                    f'but got {state.dtype}.')
+
+
 def coo_to_csr(
     pre_ids: jnp.ndarray,
     post_ids: jnp.ndarray,
@@ -20,14 +20,22 @@ import jax
 from jax import numpy as jnp, dtypes, default_backend
 
 from braintaichi._misc import set_module_as
+from ._sparse_accumulate import raw_csrmv_accumulate_taichi
 from ._sparse_coomv import _coomv_cusparse_p
 from ._sparse_csrmm import raw_csrmm_taichi
 from ._sparse_csrmv import raw_csrmv_taichi
+from ._sparse_plan import CSRPlan
+from ._sparse_sell import SELLIndices
+from ._sparse_shard import ShardedCSR, sharded_matvec
+from ._sparse_sellmv import raw_sellmv_taichi
+from ._sparse_utils import _check_accumulate_state
 
 __all__ = [
   'coomv',
   'csrmv',
+  'csrmv_accumulate',
   'csrmm',
+  'sellmv',
 ]
 
 
@@ -120,8 +128,10 @@ def csrmm(
 
   Args:
       data : array of shape ``(nse,)``.
-      indices : array of shape ``(nse,)``
-      indptr : array of shape ``(shape[0] + 1,)`` and dtype ``indices.dtype``
+      indices : array of shape ``(nse,)``, its compressed form, see
+                :func:`compress_indices`, or its plan, see :func:`csr_plan`
+      indptr : array of shape ``(shape[0] + 1,)`` and dtype ``indices.dtype``,
+               not read with a plan
       B : array of shape ``(shape[0] if transpose else shape[1], cols)`` and
       dtype ``data.dtype``
       shape : length-2 tuple representing the matrix shape
@@ -153,11 +163,15 @@ def csrmv(
   Parameters
   ----------
   data: ndarray, float
-    An array of shape ``(nse,)``.
-  indices: ndarray
-    An array of shape ``(nse,)``.
+    An array of shape ``(nse,)``. ``float16`` and ``bfloat16`` values are
+    read in 16 bits and accumulated in ``float32``.
+  indices: ndarray, CompressedIndices, CSRPlan, ShardedCSR
+    An array of shape ``(nse,)``, its compressed form, see
+    :func:`compress_indices`, its plan, see :func:`csr_plan`, or its rows
+    split over devices, see :func:`csr_shard`.
   indptr: ndarray
     An array of shape ``(shape[0] + 1,)`` and dtype ``indices.dtype``.
+    It is not read with a plan or a sharded matrix.
   vector: ndarray
     An array of shape ``(shape[0] if transpose else shape[1],)``
     and dtype ``data.dtype``.
@@ -183,13 +197,29 @@ def csrmv(
     the matrix vector product.
   """
 
+  if isinstance(indices, ShardedCSR):
+    return sharded_matvec(csrmv, data, indices, vector, shape=shape, transpose=transpose)
+
+  data, indptr, vector = _check_csrmv(data, indices, indptr, vector)
+
+  # if the shape of indices is (0,), then we return a zero vector
+  if indices.shape[0] == 0:
+    return jnp.zeros(shape[1] if transpose else shape[0], dtype=data.dtype)
+
+  return raw_csrmv_taichi(data, indices, indptr, vector, shape=shape, transpose=transpose)[0]
+
+
+def _check_csrmv(data, indices, indptr, vector):
   data = jnp.atleast_1d(data)
+  # a plan has its own row pointers
+  if isinstance(indices, CSRPlan):
+    indptr = indices.indptr
 
   if vector.dtype == jnp.bool_:
     vector = jnp.asarray(vector, dtype=data.dtype)
 
-  if data.dtype not in [jnp.float16, jnp.float32, jnp.float64]:
-    raise TypeError('Only support float16, float32 or float64 type. '
+  if data.dtype not in [jnp.float16, jnp.bfloat16, jnp.float32, jnp.float64]:
+    raise TypeError('Only support float16, bfloat16, float32 or float64 type. '
                     f'But we got {data.dtype}.')
   if data.dtype != vector.dtype:
     raise TypeError('The types of data and vector should be the same. '
@@ -199,9 +229,139 @@ def csrmv(
     raise ValueError('indices should be a 1D vector with integer type.')
   if not jnp.issubdtype(indptr.dtype, jnp.integer):
     raise ValueError('indptr should be a 1D vector with integer type.')
+  return data, indptr, vector
 
-  # if the shape of indices is (0,), then we return a zero vector
+
+@set_module_as('braintaichi')
+def csrmv_accumulate(
+    state: jax.typing.ArrayLike,
+    data: Union[jax.typing.ArrayLike, u.Quantity],
+    indices: jax.typing.ArrayLike,
+    indptr: jax.typing.ArrayLike,
+    vector: jax.typing.ArrayLike,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+    alpha: Union[float, jax.typing.ArrayLike] = 1.,
+    beta: Union[float, jax.typing.ArrayLike] = 1.,
+):
+  """Accumulate the product of CSR sparse matrix and a dense vector into a state.
+
+  It computes ``alpha * state + beta * csrmv(data, indices, indptr, vector)`` in
+  one kernel, which writes the result into the buffer of ``state`` through XLA
+  input/output aliasing, so that the output is neither allocated nor zeroed. To
+  update the buffer in place rather than a copy of it, ``state`` should be donated
+  to the jitted function, such as with ``jax.jit(..., donate_argnums=...)``, or be
+  carried by a loop.
+
+  This function supports JAX transformations, including `jit()`, `grad()`,
+  `vmap()` and `pmap()`.
+
+  Parameters
+  ----------
+  state: ndarray
+    An array of shape ``(shape[1] if transpose else shape[0],)`` and dtype
+    ``data.dtype``, or ``float32`` for 16-bit values.
+  data: ndarray, float
+    An array of shape ``(nse,)`` or ``(1,)``.
+  indices: ndarray, CompressedIndices, CSRPlan
+    An array of shape ``(nse,)``, its compressed form, see
+    :func:`compress_indices`, or its plan, see :func:`csr_plan`.
+  indptr: ndarray
+    An array of shape ``(shape[0] + 1,)`` and dtype ``indices.dtype``.
+    It is not read with a plan.
+  vector: ndarray
+    An array of shape ``(shape[0] if transpose else shape[1],)``
+    and dtype ``data.dtype``.
+  shape: tuple of int
+    A length-2 tuple representing the matrix shape.
+  transpose: bool
+    A boolean specifying whether to transpose the sparse matrix
+    before computing.
+  alpha: float, ndarray
+    The scale of the state.
+  beta: float, ndarray
+    The scale of the product.
+
+  Returns
+  -------
+  y : ndarry
+    The array ``alpha * state + beta * (A @ vector)`` of the shape and dtype of ``state``.
+  """
+  data, indptr, vector = _check_csrmv(data, indices, indptr, vector)
+  state = jnp.asarray(state)
+  _check_accumulate_state(state, data, shape=shape, transpose=transpose)
+  alpha = jnp.reshape(jnp.asarray(alpha, dtype=state.dtype), (1,))
+  beta = jnp.reshape(jnp.asarray(beta, dtype=state.dtype), (1,))
+
+  # without non-zeros, only the state is scaled
+  if indices.shape[0] == 0:
+    return alpha[0] * state
+
+  return raw_csrmv_accumulate_taichi(state, alpha, beta, data, indices, indptr, vector,
+                                     shape=shape, transpose=transpose)[0]
+
+
+@set_module_as('braintaichi')
+def sellmv(
+    data: Union[jax.typing.ArrayLike, u.Quantity],
+    indices: SELLIndices,
+    vector: jax.typing.ArrayLike,
+    *,
+    shape: Tuple[int, int],
+    transpose: bool = False,
+):
+  """Product of a sparse matrix in the sliced ELLPACK format and a dense vector.
+
+  The ``C`` rows of each slice are computed in lockstep, see :func:`csr_to_sell`.
+
+  This function supports JAX transformations, including `jit()`, `grad()`,
+  `vmap()` and `pmap()`.
+
+  Parameters
+  ----------
+  data: ndarray, float
+    An array of shape ``(num_slot,)`` in the order of ``indices``, see
+    :func:`sell_values`, or of shape ``(1,)``.
+  indices: SELLIndices
+    The structure of the matrix, see :func:`csr_to_sell`.
+  vector: ndarray
+    An array of shape ``(shape[0] if transpose else shape[1],)``
+    and dtype ``data.dtype``.
+  shape: tuple of int
+    A length-2 tuple representing the matrix shape.
+  transpose: bool
+    A boolean specifying whether to transpose the sparse matrix
+    before computing.
+
+  Returns
+  -------
+  y : ndarry
+    The array of shape ``(shape[1] if transpose else shape[0],)`` representing
+    the matrix vector product.
+  """
+  data = jnp.atleast_1d(data)
+  vector = jnp.asarray(vector)
+  if not isinstance(indices, SELLIndices):
+    raise TypeError(f'indices should be built by "csr_to_sell", but got {type(indices)}.')
+  if vector.dtype == jnp.bool_:
+    vector = jnp.asarray(vector, dtype=data.dtype)
+
+  if data.dtype not in [jnp.float16, jnp.bfloat16, jnp.float32, jnp.float64]:
+    raise TypeError('Only support float16, bfloat16, float32 or float64 type. '
+                    f'But we got {data.dtype}.')
+  if data.dtype != vector.dtype:
+    raise TypeError('The types of data and vector should be the same. '
+                    f'But we got {data.dtype} != {vector.dtype}.')
+  if data.ndim != 1 or data.shape[0] not in [1, indices.shape[0]]:
+    raise ValueError('The size of data should be 1 or be consistent with indices. '
+                     f'But we got {data.shape} != {indices.shape}.')
+  if vector.shape != (shape[0] if transpose else shape[1],):
+    raise ValueError(f'Shape mismatch, the vector {vector.shape} with the matrix {shape} '
+                     f'and transpose={transpose}.')
+
+  # without non-zeros, return a zero vector
   if indices.shape[0] == 0:
     return jnp.zeros(shape[1] if transpose else shape[0], dtype=data.dtype)
 
-  return raw_csrmv_taichi(data, indices, indptr, vector, shape=shape, transpose=transpose)[0]
+  return raw_sellmv_taichi(data, indices, vector, shape=shape, transpose=transpose)[0]
@@ -14,132 +14,484 @@ std::map<uint32_t, TiDataType> taichiTypeMap_ARM64 = {
     {8, TI_DATA_TYPE_I16},
     {9, TI_DATA_TYPE_I64},
     {10, TI_DATA_TYPE_F16},
-    {11, TI_DATA_TYPE_F64}
+    {11, TI_DATA_TYPE_F64},
+    // Taichi has no bfloat16, so its bits are passed as uint16 and decoded by the kernels
+    {12, TI_DATA_TYPE_U16}
 };
 
-void push_input_ARM64(const uint32_t type_id, const void* value, uint32_t dim_count, uint32_t elem_count, uint32_t* shape) {
-    switch (type_id)
+TiDataType getTiDataTypeFromMap_ARM64(uint32_t typeIndex) {
+    return taichiTypeMap_ARM64[typeIndex];
+}
+
+size_t getTiDataTypeSize_ARM64(uint32_t typeIndex) {
+    switch (typeIndex)
     {
-    case 0:
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<int>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
+    case 0: return sizeof(int);
+    case 1: return sizeof(float);
+    case 2: return sizeof(bool);
+    case 3: return sizeof(uint8_t);
+    case 4: return sizeof(uint16_t);
+    case 5: return sizeof(uint32_t);
+    case 6: return sizeof(uint64_t);
+    case 7: return sizeof(int8_t);
+    case 8: return sizeof(int16_t);
+    case 9: return sizeof(int64_t);
+    case 10: return sizeof(uint16_t);
+    case 11: return sizeof(double);
+    case 12: return sizeof(uint16_t);
+    default: return 0;
+    }
+}
+
+// --- AOT module cache ---
+//
+// The limits default to BRAINTAICHI_CPU_MODULE_CACHE_ENTRIES (256) and
+// BRAINTAICHI_CPU_MODULE_CACHE_BYTES (unlimited), and apply to each lane.
+
+static size_t env_limit_ARM64(const char *name, size_t default_value) {
+    const char *env = std::getenv(name);
+    if (env == nullptr) return default_value;
+    long long value = std::strtoll(env, nullptr, 10);
+    return value > 0 ? static_cast<size_t>(value) : 0;
+}
+
+static std::atomic<size_t> module_cache_max_entries_ARM64(env_limit_ARM64("BRAINTAICHI_CPU_MODULE_CACHE_ENTRIES", 256));
+static std::atomic<size_t> module_cache_max_bytes_ARM64(env_limit_ARM64("BRAINTAICHI_CPU_MODULE_CACHE_BYTES", 0));
+static std::atomic<uint64_t> module_cache_hits_ARM64(0);
+static std::atomic<uint64_t> module_cache_misses_ARM64(0);
+static std::atomic<uint64_t> module_cache_evictions_ARM64(0);
+static std::atomic<uint64_t> module_cache_entries_ARM64(0);
+static std::atomic<uint64_t> module_cache_bytes_ARM64(0);
+
+static size_t aot_module_bytes_ARM64(const std::string& kernel_aot_path) {
+    std::error_code error;
+    size_t bytes = 0;
+    for (std::filesystem::recursive_directory_iterator it(kernel_aot_path, error), end; !error && it != end; it.increment(error)) {
+        if (it->is_regular_file(error)) {
+            bytes += static_cast<size_t>(it->file_size(error));
+        }
+    }
+    return bytes;
+}
+
+std::shared_ptr<ti::Kernel> TaichiKernel_ARM64::get_kernel(const std::string& kernel_aot_path) {
+    auto it = modules_.find(kernel_aot_path);
+    if (it != modules_.end()) {
+        module_cache_hits_ARM64.fetch_add(1, std::memory_order_relaxed);
+        module_lru_.splice(module_lru_.begin(), module_lru_, it->second.lru);
+        return it->second.kernel;
+    }
+    module_cache_misses_ARM64.fetch_add(1, std::memory_order_relaxed);
+    return load_module(kernel_aot_path).kernel;
+}
+
+TaichiModuleEntry_ARM64& TaichiKernel_ARM64::load_module(const std::string& kernel_aot_path) {
+    TaichiModuleEntry_ARM64 entry;
+    entry.module = runtime_.load_aot_module(kernel_aot_path.c_str());
+    ti::check_last_error();
+    entry.kernel = std::make_shared<ti::Kernel>(entry.module.get_kernel("taichi_kernel_arm64"));
+    ti::check_last_error();
+    entry.bytes = aot_module_bytes_ARM64(kernel_aot_path);
+
+    module_lru_.push_front(kernel_aot_path);
+    entry.lru = module_lru_.begin();
+    module_bytes_ += entry.bytes;
+    module_cache_entries_ARM64.fetch_add(1, std::memory_order_relaxed);
+    module_cache_bytes_ARM64.fetch_add(entry.bytes, std::memory_order_relaxed);
+    TaichiModuleEntry_ARM64 &loaded = modules_[kernel_aot_path] = std::move(entry);
+    evict_modules();
+    return loaded;
+}
+
+void TaichiKernel_ARM64::evict_module(const std::string& kernel_aot_path) {
+    auto it = modules_.find(kernel_aot_path);
+    if (it == modules_.end()) {
+        return;
+    }
+
+    // the plans of the module's kernel go with it, together with their imported buffers
+    std::vector<uint64_t> plan_keys;
+    for (const auto &plan : launch_plans_) {
+        if (plan.second.kernel == it->second.kernel) {
+            plan_keys.push_back(plan.first);
+        }
+    }
+    for (uint64_t plan_key : plan_keys) {
+        evict_plan(plan_key);
+    }
+
+    module_bytes_ -= it->second.bytes;
+    module_cache_entries_ARM64.fetch_sub(1, std::memory_order_relaxed);
+    module_cache_bytes_ARM64.fetch_sub(it->second.bytes, std::memory_order_relaxed);
+    module_cache_evictions_ARM64.fetch_add(1, std::memory_order_relaxed);
+    module_lru_.erase(it->second.lru);
+    modules_.erase(it);
+}
 
-    case 1:
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<float>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
+// The most recently used module, i.e. the one just loaded, is always kept.
+void TaichiKernel_ARM64::evict_modules() {
+    const size_t max_entries = module_cache_max_entries_ARM64.load(std::memory_order_relaxed);
+    const size_t max_bytes = module_cache_max_bytes_ARM64.load(std::memory_order_relaxed);
+    while (module_lru_.size() > 1 &&
+           ((max_entries > 0 && modules_.size() > max_entries) ||
+            (max_bytes > 0 && module_bytes_ > max_bytes))) {
+        evict_module(std::string(module_lru_.back()));
+    }
+}
 
-    case 2:
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<bool>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
+TaichiModuleCacheStats_ARM64 get_module_cache_stats_ARM64() {
+    TaichiModuleCacheStats_ARM64 stats;
+    stats.hits = module_cache_hits_ARM64.load(std::memory_order_relaxed);
+    stats.misses = module_cache_misses_ARM64.load(std::memory_order_relaxed);
+    stats.evictions = module_cache_evictions_ARM64.load(std::memory_order_relaxed);
+    stats.entries = module_cache_entries_ARM64.load(std::memory_order_relaxed);
+    stats.bytes = module_cache_bytes_ARM64.load(std::memory_order_relaxed);
+    return stats;
+}
 
-    case 3:
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<uint8_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
+void set_module_cache_limits_ARM64(size_t max_entries, size_t max_bytes) {
+    module_cache_max_entries_ARM64.store(max_entries, std::memory_order_relaxed);
+    module_cache_max_bytes_ARM64.store(max_bytes, std::memory_order_relaxed);
+}
 
-    case 4:
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<uint16_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
+// --- runtime lanes ---
+//
+// A Taichi runtime runs one kernel at a time (its thread pool has a single
+// master), so concurrent custom calls each check out their own lane. A thread
+// keeps coming back to the lane it used last, which keeps that lane's plans and
+// imported buffers hot. Lanes are created on demand, up to
+// BRAINTAICHI_CPU_RUNTIME_LANES (default 4).
 
-    case 5:
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<uint32_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
+static const uint32_t kMaxLanes_ARM64 = 64;
+static std::atomic<TaichiKernel_ARM64*> lanes_ARM64[kMaxLanes_ARM64] = {};
+static std::atomic<uint32_t> lane_count_ARM64(0);
+static std::atomic<uint32_t> lane_hint_ARM64(0);
+static std::mutex lane_grow_mutex_ARM64;
+static uint32_t lanes_opening_ARM64 = 0;  // guarded by lane_grow_mutex_ARM64
 
-    case 6:
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<uint64_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
+static uint32_t max_lane_count_ARM64() {
+    static const uint32_t count = []() {
+        const char *env = std::getenv("BRAINTAICHI_CPU_RUNTIME_LANES");
+        long value = env ? std::strtol(env, nullptr, 10) : 4;
+        if (value < 1) value = 1;
+        if (value > kMaxLanes_ARM64) value = kMaxLanes_ARM64;
+        return static_cast<uint32_t>(value);
+    }();
+    return count;
+}
 
-    case 7:
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<int8_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
+// The modules to load into new lanes, the most recently preloaded first. Only
+// as many as the module cache holds are kept, the others would be evicted again
+// right away. Guarded by lane_grow_mutex_ARM64.
+static std::list<std::string> preloaded_kernels_ARM64;
+static std::unordered_map<std::string, std::list<std::string>::iterator> preloaded_kernel_index_ARM64;
 
-    case 8:
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<int16_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
+static void add_preloaded_kernel_ARM64(const std::string& kernel_aot_path) {
+    auto it = preloaded_kernel_index_ARM64.find(kernel_aot_path);
+    if (it != preloaded_kernel_index_ARM64.end()) {
+        preloaded_kernels_ARM64.splice(preloaded_kernels_ARM64.begin(), preloaded_kernels_ARM64, it->second);
+        return;
+    }
+    preloaded_kernels_ARM64.push_front(kernel_aot_path);
+    preloaded_kernel_index_ARM64[kernel_aot_path] = preloaded_kernels_ARM64.begin();
+    const size_t max_entries = module_cache_max_entries_ARM64.load(std::memory_order_relaxed);
+    while (max_entries > 0 && preloaded_kernels_ARM64.size() > max_entries) {
+        preloaded_kernel_index_ARM64.erase(preloaded_kernels_ARM64.back());
+        preloaded_kernels_ARM64.pop_back();
+    }
+}
 
-    case 9:
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<int64_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
+static void init_first_lane_ARM64() {
+    if (lane_count_ARM64.load(std::memory_order_acquire) == 0) {
+        std::lock_guard<std::mutex> guard(lane_grow_mutex_ARM64);
+        if (lane_count_ARM64.load(std::memory_order_relaxed) == 0) {
+            lanes_ARM64[0].store(taichi_kernel_ARM64, std::memory_order_relaxed);
+            lane_count_ARM64.store(1, std::memory_order_release);
+        }
+    }
+}
 
-    case 10:
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<float>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
+// Open a lane and load the preloaded modules into it, the most recent ones last
+// so that they are the last to be evicted. It is loaded before it is published,
+// without holding lane_grow_mutex_ARM64, so the other threads are not held up.
+static TaichiKernel_ARM64* open_lane_ARM64(const std::vector<std::string>& kernel_aot_paths) {
+    TaichiKernel_ARM64 *lane = new TaichiKernel_ARM64();
+    for (auto it = kernel_aot_paths.rbegin(); it != kernel_aot_paths.rend(); ++it) {
+        try {
+            lane->get_kernel(*it);
+        } catch (const std::exception &) {
+            // the launch that needs it will load it and report the error
+        }
+    }
+    return lane;
+}
 
-    case 11:
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<double>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
+TaichiKernel_ARM64* acquire_taichi_kernel_ARM64() {
+    init_first_lane_ARM64();
 
-    default:
-        break;
+    thread_local uint32_t preferred = lane_hint_ARM64.fetch_add(1, std::memory_order_relaxed);
+    uint32_t n = lane_count_ARM64.load(std::memory_order_acquire);
+    for (uint32_t k = 0; k < n; k++) {
+        uint32_t i = (preferred + k) % n;
+        TaichiKernel_ARM64 *lane = lanes_ARM64[i].load(std::memory_order_acquire);
+        if (lane->mutex_.try_lock()) {
+            preferred = i;
+            return lane;
+        }
     }
+
+    // every lane is busy: open a new one if we may, otherwise wait for ours
+    bool open = false;
+    std::vector<std::string> kernel_aot_paths;
+    {
+        std::lock_guard<std::mutex> guard(lane_grow_mutex_ARM64);
+        n = lane_count_ARM64.load(std::memory_order_relaxed);
+        if (n + lanes_opening_ARM64 < max_lane_count_ARM64()) {
+            lanes_opening_ARM64++;
+            kernel_aot_paths.assign(preloaded_kernels_ARM64.begin(), preloaded_kernels_ARM64.end());
+            open = true;
+        }
+    }
+    if (open) {
+        TaichiKernel_ARM64 *lane = open_lane_ARM64(kernel_aot_paths);
+        lane->mutex_.lock();
+        std::lock_guard<std::mutex> guard(lane_grow_mutex_ARM64);
+        lanes_opening_ARM64--;
+        n = lane_count_ARM64.load(std::memory_order_relaxed);
+        lanes_ARM64[n].store(lane, std::memory_order_release);
+        lane_count_ARM64.store(n + 1, std::memory_order_release);
+        preferred = n;
+        return lane;
+    }
+    TaichiKernel_ARM64 *lane = lanes_ARM64[preferred % n].load(std::memory_order_acquire);
+    lane->mutex_.lock();
+    return lane;
+}
+
+void release_taichi_kernel_ARM64(TaichiKernel_ARM64* lane) {
+    lane->mutex_.unlock();
 }
 
-void push_output_ARM64(const uint32_t type_id, const void* value, uint32_t dim_count, uint32_t elem_count, uint32_t* shape) {
-    switch (type_id)
+void preload_taichi_kernel_ARM64(const std::string& kernel_aot_path) {
+    init_first_lane_ARM64();
+    uint32_t n;
     {
-    case 0:
-        memset(const_cast<void*>(value), 0, sizeof(int) * elem_count);
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<int>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
-    
-    case 1:
-        memset(const_cast<void*>(value), 0, sizeof(float) * elem_count);
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<float>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
-
-    case 2:
-        memset(const_cast<void*>(value), 0, sizeof(bool) * elem_count);
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<bool>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
-
-    case 3:
-        memset(const_cast<void*>(value), 0, sizeof(uint8_t) * elem_count);
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<uint8_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
-
-    case 4:
-        memset(const_cast<void*>(value), 0, sizeof(uint16_t) * elem_count);
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<uint16_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
-
-    case 5:
-        memset(const_cast<void*>(value), 0, sizeof(uint32_t) * elem_count);
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<uint32_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
-
-    case 6:
-        memset(const_cast<void*>(value), 0, sizeof(uint64_t) * elem_count);
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<uint64_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
-
-    case 7:
-        memset(const_cast<void*>(value), 0, sizeof(int8_t) * elem_count);
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<int8_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
-
-    case 8:
-        memset(const_cast<void*>(value), 0, sizeof(int16_t) * elem_count);
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<int16_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
-
-    case 9:
-        memset(const_cast<void*>(value), 0, sizeof(int64_t) * elem_count);
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<int64_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
-
-    case 10:
-        memset(const_cast<void*>(value), 0, sizeof(float) * elem_count);
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<float>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
-
-    case 11:
-        memset(const_cast<void*>(value), 0, sizeof(double) * elem_count);
-        taichi_kernel_ARM64->kernel->push_arg(createNdArrayFromRawMemory_ARM64<double>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
-        break;
-    default:
-        break;
+        std::lock_guard<std::mutex> guard(lane_grow_mutex_ARM64);
+        add_preloaded_kernel_ARM64(kernel_aot_path);
+        n = lane_count_ARM64.load(std::memory_order_relaxed);
+    }
+    // the busy lanes load it at their first launch that needs it
+    for (uint32_t i = 0; i < n; i++) {
+        TaichiKernel_ARM64 *lane = lanes_ARM64[i].load(std::memory_order_acquire);
+        if (lane->mutex_.try_lock()) {
+            std::lock_guard<std::mutex> guard(lane->mutex_, std::adopt_lock);
+            lane->get_kernel(kernel_aot_path);
+        }
     }
 }
 
-TiDataType getTiDataTypeFromMap_ARM64(uint32_t typeIndex) {
-    return taichiTypeMap_ARM64[typeIndex];
-}
\ No newline at end of file
+// --- launch specs ---
+//
+// Specs are immutable once published, so they live in a copy-on-write map that
+// readers load atomically without taking a lock. Writers are rare (one per new
+// call site) and serialize on a mutex.
+
+typedef std::unordered_map<uint64_t, std::shared_ptr<const TaichiLaunchSpec_ARM64>> LaunchSpecMap_ARM64;
+static std::shared_ptr<const LaunchSpecMap_ARM64> launch_specs_ARM64 = std::make_shared<LaunchSpecMap_ARM64>();
+static std::mutex launch_specs_mutex_ARM64;
+
+static const size_t launch_specs_max_entries_ARM64 = env_limit_ARM64("BRAINTAICHI_CPU_LAUNCH_SPECS", 4096);
+static std::list<uint64_t> launch_spec_order_ARM64;  // the oldest spec first, guarded by launch_specs_mutex_ARM64
+
+std::shared_ptr<const TaichiLaunchSpec_ARM64> find_launch_spec_ARM64(uint64_t plan_key) {
+    std::shared_ptr<const LaunchSpecMap_ARM64> specs = std::atomic_load(&launch_specs_ARM64);
+    auto it = specs->find(plan_key);
+    if (it != specs->end()) {
+        return it->second;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const TaichiLaunchSpec_ARM64> publish_launch_spec_ARM64(uint64_t plan_key, std::shared_ptr<const TaichiLaunchSpec_ARM64> spec) {
+    std::lock_guard<std::mutex> guard(launch_specs_mutex_ARM64);
+    std::shared_ptr<const LaunchSpecMap_ARM64> specs = std::atomic_load(&launch_specs_ARM64);
+    auto it = specs->find(plan_key);
+    if (it != specs->end()) {
+        return it->second;
+    }
+    std::shared_ptr<LaunchSpecMap_ARM64> updated = std::make_shared<LaunchSpecMap_ARM64>(*specs);
+    (*updated)[plan_key] = spec;
+    launch_spec_order_ARM64.push_back(plan_key);
+    while (launch_specs_max_entries_ARM64 > 0 && launch_spec_order_ARM64.size() > launch_specs_max_entries_ARM64) {
+        updated->erase(launch_spec_order_ARM64.front());
+        launch_spec_order_ARM64.pop_front();
+    }
+    std::atomic_store(&launch_specs_ARM64, std::shared_ptr<const LaunchSpecMap_ARM64>(updated));
+    return spec;
+}
+
+std::shared_ptr<TaichiLaunchSpec_ARM64> make_launch_spec_ARM64(const std::string& kernel_path, uint32_t in_num, uint32_t out_num) {
+    std::shared_ptr<TaichiLaunchSpec_ARM64> spec = std::make_shared<TaichiLaunchSpec_ARM64>();
+    spec->kernel_path = kernel_path;
+    spec->in_num = in_num;
+    spec->out_num = out_num;
+    spec->args.resize(in_num + out_num);
+    spec->byte_sizes.resize(in_num + out_num);
+    return spec;
+}
+
+void set_launch_spec_arg_ARM64(TaichiLaunchSpec_ARM64& spec, uint32_t i, uint32_t type_id,
+                          uint32_t dim_count, uint32_t elem_count, const uint32_t* shape) {
+    if (i < spec.in_num && ((spec.scalar_mask >> i) & 1)) {
+        // a 32-bit scalar, whose value is read from its buffer at every launch
+        spec.args[i].type = type_id == 1 ? TI_ARGUMENT_TYPE_F32 : TI_ARGUMENT_TYPE_I32;
+        spec.byte_sizes[i] = sizeof(int32_t);
+        return;
+    }
+    TiNdArray &ndarray = spec.args[i].value.ndarray;
+    spec.args[i].type = TI_ARGUMENT_TYPE_NDARRAY;
+    ndarray.memory = TI_NULL_HANDLE;
+    ndarray.shape.dim_count = dim_count;
+    for (uint32_t j = 0; j < dim_count; j++) {
+        ndarray.shape.dims[j] = shape[j];
+    }
+    ndarray.elem_shape.dim_count = 0;
+    ndarray.elem_type = getTiDataTypeFromMap_ARM64(type_id);
+    spec.byte_sizes[i] = getTiDataTypeSize_ARM64(type_id) * elem_count;
+}
+
+// Parse the descriptor constants emitted by "_preprocess_kernel_call_cpu()".
+static std::shared_ptr<const TaichiLaunchSpec_ARM64> parse_launch_spec_ARM64(const void **in) {
+    const uint32_t *in_out_num = reinterpret_cast<const uint32_t *>(in[0]);
+    const uint32_t in_num = in_out_num[0];
+    const uint32_t out_num = in_out_num[1];
+    const uint32_t *type_list = reinterpret_cast<const uint32_t *>(in[1]);
+    const uint32_t *dim_count_list = reinterpret_cast<const uint32_t *>(in[2]);
+    const uint32_t *elem_count_list = reinterpret_cast<const uint32_t *>(in[3]);
+    const uint32_t *shape_list = reinterpret_cast<const uint32_t *>(in[4]);
+    const char* kernel_name = reinterpret_cast<const char *>(in[5]);
+    const uint32_t scalar_mask = in_out_num[6];
+
+    // shape_list is a 2d array and the shape of it is (in_num+out_num, the max of dim_count)
+    uint32_t max_dim_count = 0;
+    for (uint32_t i = 0; i < in_num + out_num; i++) {
+        if (dim_count_list[i] > max_dim_count) {
+            max_dim_count = dim_count_list[i];
+        }
+    }
+
+    std::shared_ptr<TaichiLaunchSpec_ARM64> spec = make_launch_spec_ARM64(kernel_name, in_num, out_num);
+    spec->scalar_mask = scalar_mask;
+    for (uint32_t i = 0; i < in_num + out_num; i++) {
+        set_launch_spec_arg_ARM64(*spec, i, type_list[i], dim_count_list[i], elem_count_list[i],
+                             shape_list + i * max_dim_count);
+    }
+    return spec;
+}
+
+// --- launch plans ---
+
+static const size_t launch_plans_max_entries_ARM64 = env_limit_ARM64("BRAINTAICHI_CPU_LAUNCH_PLANS", 1024);
+
+void TaichiKernel_ARM64::evict_plan(uint64_t plan_key) {
+    auto it = launch_plans_.find(plan_key);
+    if (it == launch_plans_.end()) {
+        return;
+    }
+    for (TiArgument &arg : it->second.args) {
+        if (arg.type == TI_ARGUMENT_TYPE_NDARRAY && arg.value.ndarray.memory != TI_NULL_HANDLE) {
+            ti_free_memory(runtime_, arg.value.ndarray.memory);
+        }
+    }
+    plan_lru_.erase(it->second.lru);
+    launch_plans_.erase(it);
+}
+
+// The most recently used plan, i.e. the one just added, is always kept.
+void TaichiKernel_ARM64::evict_plans() {
+    while (launch_plans_max_entries_ARM64 > 0 && plan_lru_.size() > 1 && launch_plans_.size() > launch_plans_max_entries_ARM64) {
+        evict_plan(plan_lru_.back());
+    }
+}
+
+TaichiLaunchPlan_ARM64* find_launch_plan_ARM64(TaichiKernel_ARM64* lane, uint64_t plan_key) {
+    auto it = lane->launch_plans_.find(plan_key);
+    if (it != lane->launch_plans_.end()) {
+        lane->plan_lru_.splice(lane->plan_lru_.begin(), lane->plan_lru_, it->second.lru);
+        return &it->second;
+    }
+    return nullptr;
+}
+
+TaichiLaunchPlan_ARM64& add_launch_plan_ARM64(TaichiKernel_ARM64* lane, uint64_t plan_key, std::shared_ptr<const TaichiLaunchSpec_ARM64> spec) {
+    // resolve the kernel first, as loading it may evict other modules and their plans
+    std::shared_ptr<ti::Kernel> kernel = lane->get_kernel(spec->kernel_path);
+    TaichiLaunchPlan_ARM64 &plan = lane->launch_plans_[plan_key];
+    plan.spec = spec;
+    plan.kernel = kernel;
+    plan.args = spec->args;
+    plan.buffers.assign(spec->args.size(), nullptr);
+    lane->plan_lru_.push_front(plan_key);
+    plan.lru = lane->plan_lru_.begin();
+    lane->evict_plans();
+    return plan;
+}
+
+TaichiLaunchPlan_ARM64& get_launch_plan_ARM64(TaichiKernel_ARM64* lane, const void **in) {
+    // the plan key is the hash of the descriptor constants, see "_preprocess_kernel_call_cpu()"
+    const uint32_t *in_out_num = reinterpret_cast<const uint32_t *>(in[0]);
+    const uint64_t plan_key = (static_cast<uint64_t>(in_out_num[4]) << 32) | in_out_num[3];
+
+    TaichiLaunchPlan_ARM64 *plan = find_launch_plan_ARM64(lane, plan_key);
+    if (plan != nullptr) {
+        return *plan;
+    }
+    std::shared_ptr<const TaichiLaunchSpec_ARM64> spec = find_launch_spec_ARM64(plan_key);
+    if (!spec) {
+        spec = publish_launch_spec_ARM64(plan_key, parse_launch_spec_ARM64(in));
+    }
+    return add_launch_plan_ARM64(lane, plan_key, spec);
+}
+
+// Import the buffer only when XLA hands us a different one than last time. The
+// scalars are copied by value, as their buffer may be reused with another value.
+void bind_plan_buffer_ARM64(TaichiKernel_ARM64* lane, TaichiLaunchPlan_ARM64& plan, uint32_t i, const void* buffer) {
+    if (i < plan.spec->in_num && ((plan.spec->scalar_mask >> i) & 1)) {
+        // the bits of an int32 or a float32
+        std::memcpy(&plan.args[i].value.i32, buffer, sizeof(int32_t));
+        return;
+    }
+    if (plan.buffers[i] == buffer) {
+        return;
+    }
+    TiNdArray &ndarray = plan.args[i].value.ndarray;
+    if (ndarray.memory != TI_NULL_HANDLE) {
+        ti_free_memory(lane->runtime_, ndarray.memory);
+    }
+    ndarray.memory = ti_import_cpu_memory(lane->runtime_, const_cast<void*>(buffer), plan.spec->byte_sizes[i]);
+    plan.buffers[i] = buffer;
+}
+
+// The outputs are not zeroed here. Those which the kernel accumulates into alias
+// the zero buffers which XLA passes after the inputs, see "_zero_operands()", and
+// the others are written in full by the kernel, or keep the contents of the input
+// they alias.
+void bind_plan_output_ARM64(TaichiKernel_ARM64* lane, TaichiLaunchPlan_ARM64& plan, uint32_t i, void* buffer) {
+    bind_plan_buffer_ARM64(lane, plan, plan.spec->in_num + i, buffer);
+}
+
+void launch_plan_ARM64(TaichiKernel_ARM64* lane, TaichiLaunchPlan_ARM64& plan) {
+    plan.kernel->launch(static_cast<uint32_t>(plan.args.size()), plan.args.data());
+    lane->runtime_.wait();
+    ti::check_last_error();
+}
+
+void launch_with_plan_ARM64(TaichiKernel_ARM64* lane, TaichiLaunchPlan_ARM64& plan, void **out, const void **in) {
+    for (uint32_t i = 0; i < plan.spec->in_num; i++) {
+        bind_plan_buffer_ARM64(lane, plan, i, in[6 + i]);
+    }
+    for (uint32_t i = 0; i < plan.spec->out_num; i++) {
+        bind_plan_output_ARM64(lane, plan, i, out[i]);
+    }
+    launch_plan_ARM64(lane, plan);
+}
@@ -5,6 +5,9 @@
 #include "pybind11_kernel_helpers.h"
 #include "cpu_taichi_kernel_call.h"
 #include "cpu_arm64_taichi_kernel_call.h"
+#include "cpu_taichi_ffi_call.h"
+#include "cpu_taichi_aot_kernel.h"
+#include "cpu_arm64_taichi_aot_kernel.h"
 
 using namespace brain_taichi;
 
@@ -20,8 +23,44 @@ namespace {
       return dict;
     }
 
+    // Empty when the extension is built without the XLA FFI headers.
+    pybind11::dict FfiRegistrations() {
+      pybind11::dict dict;
+
+#ifdef BRAINTAICHI_XLA_FFI
+      dict["taichi_kernel_ffi_call_cpu"] = EncapsulateFfiHandler(taichi_kernel_ffi_call_cpu);
+      dict["taichi_kernel_ffi_call_cpu_arm64"] = EncapsulateFfiHandler(taichi_kernel_ffi_call_cpu_arm64);
+#endif
+
+      return dict;
+    }
+
+    // The counters of the x64 and ARM64 runtimes, only one of which is used on a machine.
+    pybind11::dict ModuleCacheStats() {
+      TaichiModuleCacheStats x64 = get_module_cache_stats();
+      TaichiModuleCacheStats_ARM64 arm64 = get_module_cache_stats_ARM64();
+      pybind11::dict dict;
+      dict["hits"] = x64.hits + arm64.hits;
+      dict["misses"] = x64.misses + arm64.misses;
+      dict["evictions"] = x64.evictions + arm64.evictions;
+      dict["entries"] = x64.entries + arm64.entries;
+      dict["bytes"] = x64.bytes + arm64.bytes;
+      return dict;
+    }
+
+    void SetModuleCacheLimits(size_t max_entries, size_t max_bytes) {
+      set_module_cache_limits(max_entries, max_bytes);
+      set_module_cache_limits_ARM64(max_entries, max_bytes);
+    }
+
     PYBIND11_MODULE(cpu_ops, m) {
         m.def("registrations", &Registrations);
+        m.def("ffi_registrations", &FfiRegistrations);
+        m.def("preload_kernel", &preload_taichi_kernel, pybind11::call_guard<pybind11::gil_scoped_release>());
+        m.def("preload_kernel_arm64", &preload_taichi_kernel_ARM64, pybind11::call_guard<pybind11::gil_scoped_release>());
+        m.def("module_cache_stats", &ModuleCacheStats);
+        m.def("set_module_cache_limits", &SetModuleCacheLimits,
+              pybind11::arg("max_entries"), pybind11::arg("max_bytes") = 0);
     }
 
 }  // namespace
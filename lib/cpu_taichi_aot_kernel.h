@@ -5,105 +5,138 @@
 #include <fstream>
 #include <ostream>
 #include <map>
+#include <list>
 #include <typeinfo>
 #include <typeindex>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 #include <filesystem>
 #include <memory>
+#include <unordered_map>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+// The immutable part of a launch, parsed once from the descriptor constants of
+// one call site and shared by every runtime lane.
+struct TaichiLaunchSpec {
+    std::string kernel_path;
+    uint32_t in_num = 0;
+    uint32_t out_num = 0;
+    std::vector<TiArgument> args;
+    std::vector<size_t> byte_sizes;
+    uint64_t scalar_mask = 0;  // the inputs passed by value, set before their args
+};
+
+// The per-lane part of a launch: the kernel resolved in the lane's runtime and
+// the argument staging, with the memory handles imported for the last buffers.
+struct TaichiLaunchPlan {
+    std::shared_ptr<const TaichiLaunchSpec> spec;
+    std::shared_ptr<ti::Kernel> kernel;
+    std::vector<TiArgument> args;
+    std::vector<const void*> buffers;
+    std::list<uint64_t>::iterator lru;
+};
+
+// An AOT module loaded into a lane, together with the kernel it provides. The
+// kernel borrows the module, so it is declared after it and released first.
+struct TaichiModuleEntry {
+    ti::AotModule module;
+    std::shared_ptr<ti::Kernel> kernel;
+    size_t bytes = 0;
+    std::list<std::string>::iterator lru;
+};
 
 struct TaichiKernel{
     ti::Runtime runtime_;
-    std::shared_ptr<ti::Kernel> kernel;
-    ti::Kernel kernel_;
-    ti::AotModule module_;
-    std::map<std::string, std::shared_ptr<ti::Kernel>> kernel_cache;
-    std::string current_kernel_path_;
+    std::unordered_map<std::string, TaichiModuleEntry> modules_;
+    std::list<std::string> module_lru_;  // the most recently used module first
+    size_t module_bytes_ = 0;
+    std::unordered_map<uint64_t, TaichiLaunchPlan> launch_plans_;
+    std::list<uint64_t> plan_lru_;  // the most recently used plan first
+    std::mutex mutex_;
 
     TaichiKernel(){
         runtime_ = ti::Runtime(TI_ARCH_X64);
     }
 
-    void load_from_kernel_aot_path(const char* kernel_aot_path) {
-        module_ = runtime_.load_aot_module(kernel_aot_path);
-        ti::check_last_error();
-        kernel_ = module_.get_kernel("taichi_kernel_cpu");
-        ti::check_last_error();
-    }
+    // Defined in the .cc file, as they account for the process-wide module cache.
+    std::shared_ptr<ti::Kernel> get_kernel(const std::string& kernel_aot_path);
+    TaichiModuleEntry& load_module(const std::string& kernel_aot_path);
+    void evict_module(const std::string& kernel_aot_path);
+    void evict_modules();
+    void evict_plan(uint64_t plan_key);
+    void evict_plans();
+};
 
-    std::shared_ptr<ti::Kernel>& get_kernel(const std::string& kernel_aot_path) {
-        auto it = kernel_cache.find(kernel_aot_path);
-        if (it == kernel_cache.end()) {
-            load_from_kernel_aot_path(kernel_aot_path.c_str());
-            auto kernel_ptr = std::make_shared<ti::Kernel>(std::move(kernel_));
-            kernel_cache[kernel_aot_path] = kernel_ptr;
-            current_kernel_path_ = kernel_aot_path;
-            return kernel_cache[kernel_aot_path];
-        }
-        current_kernel_path_ = kernel_aot_path;
-        return it->second;
-    }
+extern TaichiKernel *taichi_kernel;
 
-    void load(const char* kernel_aot_path) {
-        if (current_kernel_path_ == kernel_aot_path) {
-            return;
-        }
-        kernel = get_kernel(kernel_aot_path);
-    }
+TiDataType getTiDataTypeFromMap(uint32_t typeIndex);
 
-    void clear_args() {
-        if (kernel)
-            kernel->clear_args();
-    }
+size_t getTiDataTypeSize(uint32_t typeIndex);
 
-    void launch(){
-        if (kernel) {
-            kernel->launch();
-            runtime_.wait();
-            ti::check_last_error();
-        }
-    }
+// Check out a runtime lane that no other thread is launching on.
+TaichiKernel* acquire_taichi_kernel();
+
+void release_taichi_kernel(TaichiKernel* lane);
+
+struct TaichiKernelLease {
+    TaichiKernel* lane;
+
+    TaichiKernelLease() : lane(acquire_taichi_kernel()) {}
+    ~TaichiKernelLease() { release_taichi_kernel(lane); }
+    TaichiKernelLease(const TaichiKernelLease&) = delete;
+    TaichiKernelLease& operator=(const TaichiKernelLease&) = delete;
 };
 
-extern TaichiKernel *taichi_kernel;
+// Every lane keeps its own modules, bounded by the entry and byte limits shared
+// by all lanes, and evicts the least recently used ones beyond them. A limit of
+// zero means unlimited.
+struct TaichiModuleCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t entries;
+    uint64_t bytes;
+};
 
-void push_input(const uint32_t type_id, const void* value, uint32_t dim_count, uint32_t elem_count, uint32_t* shape);
+TaichiModuleCacheStats get_module_cache_stats();
 
-void push_output(const uint32_t type_id, const void* value, uint32_t dim_count, uint32_t elem_count, uint32_t* shape);
+void set_module_cache_limits(size_t max_entries, size_t max_bytes);
 
-TiDataType getTiDataTypeFromMap(uint32_t typeIndex);
+// Load a module into every idle lane ahead of its first launch. The busy lanes
+// load it at their first launch that needs it, and lanes opened later before
+// they are used. As many modules as the module cache holds are remembered.
+void preload_taichi_kernel(const std::string& kernel_aot_path);
 
+// Specs are keyed by the plan key and shared by all lanes; lookups never lock. At
+// most BRAINTAICHI_CPU_LAUNCH_SPECS (default 4096) of them are kept, the oldest
+// ones being dropped first. The plans keep the specs they were built from.
+std::shared_ptr<const TaichiLaunchSpec> find_launch_spec(uint64_t plan_key);
 
+std::shared_ptr<const TaichiLaunchSpec> publish_launch_spec(uint64_t plan_key, std::shared_ptr<const TaichiLaunchSpec> spec);
 
-template<typename data_type>
-ti::NdArray<data_type> createNdArrayFromRawMemory(void* raw_memory, 
-                                                  uint32_t dim_count, 
-                                                  uint32_t element_count,
-                                                  uint32_t dtype,
-                                                  uint32_t* shape) {
-// #ifdef TI_WITH_LLVM
+std::shared_ptr<TaichiLaunchSpec> make_launch_spec(const std::string& kernel_path, uint32_t in_num, uint32_t out_num);
 
-    // import raw memory
-    size_t memory_size = sizeof(data_type) * element_count;
-    auto memory = ti_import_cpu_memory(taichi_kernel->runtime_, raw_memory, memory_size);
+void set_launch_spec_arg(TaichiLaunchSpec& spec, uint32_t i, uint32_t type_id,
+                          uint32_t dim_count, uint32_t elem_count, const uint32_t* shape);
 
-    // prepare tiNdArray
-    TiNdArray tiNdArray;
-    tiNdArray.memory = memory;
-    tiNdArray.shape.dim_count = dim_count;
-    for (int i = 0; i < dim_count; i++) {
-        tiNdArray.shape.dims[i] = shape[i];
-    }
-    tiNdArray.elem_shape.dim_count = 0;
-    tiNdArray.elem_type = getTiDataTypeFromMap(dtype);
-    auto ti_memory = ti::Memory(taichi_kernel->runtime_, memory, memory_size, false);
-
-    // create NdArray
-    auto ndarray = ti::NdArray<data_type>(std::move(ti_memory), tiNdArray);
-    return ndarray;
-// #else
-//     TI_NOT_IMPLEMENTED
-// #endif
-}
+// Plans are owned by a lane, so they are only touched while holding its lease.
+// Every lane keeps at most BRAINTAICHI_CPU_LAUNCH_PLANS (default 1024) of them, and
+// evicts the least recently used ones beyond, together with their imported buffers.
+TaichiLaunchPlan* find_launch_plan(TaichiKernel* lane, uint64_t plan_key);
+
+TaichiLaunchPlan& add_launch_plan(TaichiKernel* lane, uint64_t plan_key, std::shared_ptr<const TaichiLaunchSpec> spec);
+
+TaichiLaunchPlan& get_launch_plan(TaichiKernel* lane, const void **in);
+
+void bind_plan_buffer(TaichiKernel* lane, TaichiLaunchPlan& plan, uint32_t i, const void* buffer);
+
+void bind_plan_output(TaichiKernel* lane, TaichiLaunchPlan& plan, uint32_t i, void* buffer);
+
+void launch_plan(TaichiKernel* lane, TaichiLaunchPlan& plan);
+
+void launch_with_plan(TaichiKernel* lane, TaichiLaunchPlan& plan, void **out, const void **in);
 
 #endif //TAICHI_KERNEL_CPU_H
\ No newline at end of file
@@ -0,0 +1,126 @@
+// The typed-FFI flavour of "taichi_kernel_aot_call_cpu". XLA hands over the
+// buffers together with their dtypes and shapes, and the kernel identity comes
+// in as attributes, so no descriptor operands have to be marshalled.
+
+#ifdef BRAINTAICHI_XLA_FFI
+
+#include "cpu_taichi_ffi_call.h"
+#include "cpu_taichi_aot_kernel.h"
+#include "cpu_arm64_taichi_aot_kernel.h"
+#include "kernel_helpers_ffi.h"
+#include <bitset>
+#include <exception>
+#include <string>
+#include <string_view>
+
+namespace ffi = xla::ffi;
+
+namespace brain_taichi {
+
+    // The x64 and ARM64 runtimes expose the same plan API under suffixed names.
+    template<typename Lane, typename Plan, typename Spec,
+             std::shared_ptr<const Spec> (*find_spec)(uint64_t),
+             std::shared_ptr<const Spec> (*publish_spec)(uint64_t, std::shared_ptr<const Spec>),
+             std::shared_ptr<Spec> (*make_spec)(const std::string&, uint32_t, uint32_t),
+             void (*set_spec_arg)(Spec&, uint32_t, uint32_t, uint32_t, uint32_t, const uint32_t*),
+             Plan* (*find_plan)(Lane*, uint64_t),
+             Plan& (*add_plan)(Lane*, uint64_t, std::shared_ptr<const Spec>),
+             void (*bind_buffer)(Lane*, Plan&, uint32_t, const void*),
+             void (*bind_output)(Lane*, Plan&, uint32_t, void*),
+             void (*launch)(Lane*, Plan&)>
+    static ffi::Error ffi_call(Lane *lane, ffi::RemainingArgs args, ffi::RemainingRets rets,
+                               std::string_view kernel_path, int64_t plan_key, int64_t zero_outputs,
+                               int64_t scalar_inputs) {
+        const uint64_t key = static_cast<uint64_t>(plan_key);
+        // the zero buffers of the outputs in "zero_outputs" follow the inputs
+        const uint32_t zero_num = static_cast<uint32_t>(std::bitset<64>(static_cast<uint64_t>(zero_outputs)).count());
+        const uint32_t in_num = static_cast<uint32_t>(args.size()) - zero_num;
+        const uint32_t out_num = static_cast<uint32_t>(rets.size());
+
+        try {
+            Plan *plan = find_plan(lane, key);
+            if (plan == nullptr) {
+                std::shared_ptr<const Spec> spec = find_spec(key);
+                if (!spec) {
+                    std::shared_ptr<Spec> created = make_spec(std::string(kernel_path), in_num, out_num);
+                    created->scalar_mask = static_cast<uint64_t>(scalar_inputs);
+                    uint32_t type_id, dim_count, shape[16];
+                    for (uint32_t i = 0; i < in_num; i++) {
+                        auto buffer = args.get<ffi::AnyBuffer>(i);
+                        if (buffer.has_error()) return buffer.error();
+                        ffi::Error error = FfiBufferDescriptor(*buffer, i, 16, &type_id, &dim_count, shape);
+                        if (error.failure()) return error;
+                        set_spec_arg(*created, i, type_id, dim_count, buffer->element_count(), shape);
+                    }
+                    for (uint32_t i = 0; i < out_num; i++) {
+                        auto buffer = rets.get<ffi::AnyBuffer>(i);
+                        if (buffer.has_error()) return buffer.error();
+                        ffi::Error error = FfiBufferDescriptor(**buffer, in_num + i, 16, &type_id, &dim_count, shape);
+                        if (error.failure()) return error;
+                        set_spec_arg(*created, in_num + i, type_id, dim_count, (*buffer)->element_count(), shape);
+                    }
+                    spec = publish_spec(key, created);
+                }
+                plan = &add_plan(lane, key, spec);
+            }
+
+            for (uint32_t i = 0; i < in_num; i++) {
+                auto buffer = args.get<ffi::AnyBuffer>(i);
+                if (buffer.has_error()) return buffer.error();
+                bind_buffer(lane, *plan, i, buffer->untyped_data());
+            }
+            for (uint32_t i = 0; i < out_num; i++) {
+                auto buffer = rets.get<ffi::AnyBuffer>(i);
+                if (buffer.has_error()) return buffer.error();
+                bind_output(lane, *plan, i, (*buffer)->untyped_data());
+            }
+            launch(lane, *plan);
+        } catch (const std::exception &e) {
+            return ffi::Error(ffi::ErrorCode::kInternal, e.what());
+        }
+        return ffi::Error::Success();
+    }
+
+    static ffi::Error taichi_kernel_ffi_call_cpu_impl(ffi::RemainingArgs args, ffi::RemainingRets rets,
+                                                      std::string_view kernel_path, int64_t plan_key,
+                                                      int64_t zero_outputs, int64_t scalar_inputs) {
+        TaichiKernelLease lease;
+        return ffi_call<TaichiKernel, TaichiLaunchPlan, TaichiLaunchSpec,
+                        find_launch_spec, publish_launch_spec, make_launch_spec, set_launch_spec_arg,
+                        find_launch_plan, add_launch_plan, bind_plan_buffer, bind_plan_output, launch_plan>(
+            lease.lane, args, rets, kernel_path, plan_key, zero_outputs, scalar_inputs);
+    }
+
+    static ffi::Error taichi_kernel_ffi_call_cpu_arm64_impl(ffi::RemainingArgs args, ffi::RemainingRets rets,
+                                                            std::string_view kernel_path, int64_t plan_key,
+                                                            int64_t zero_outputs, int64_t scalar_inputs) {
+        TaichiKernelLease_ARM64 lease;
+        return ffi_call<TaichiKernel_ARM64, TaichiLaunchPlan_ARM64, TaichiLaunchSpec_ARM64,
+                        find_launch_spec_ARM64, publish_launch_spec_ARM64, make_launch_spec_ARM64,
+                        set_launch_spec_arg_ARM64, find_launch_plan_ARM64, add_launch_plan_ARM64,
+                        bind_plan_buffer_ARM64, bind_plan_output_ARM64, launch_plan_ARM64>(
+            lease.lane, args, rets, kernel_path, plan_key, zero_outputs, scalar_inputs);
+    }
+
+    XLA_FFI_DEFINE_HANDLER_SYMBOL(
+        taichi_kernel_ffi_call_cpu, taichi_kernel_ffi_call_cpu_impl,
+        ffi::Ffi::Bind()
+            .RemainingArgs()
+            .RemainingRets()
+            .Attr<std::string_view>("kernel_path")
+            .Attr<int64_t>("plan_key")
+            .Attr<int64_t>("zero_outputs")
+            .Attr<int64_t>("scalar_inputs"));
+
+    XLA_FFI_DEFINE_HANDLER_SYMBOL(
+        taichi_kernel_ffi_call_cpu_arm64, taichi_kernel_ffi_call_cpu_arm64_impl,
+        ffi::Ffi::Bind()
+            .RemainingArgs()
+            .RemainingRets()
+            .Attr<std::string_view>("kernel_path")
+            .Attr<int64_t>("plan_key")
+            .Attr<int64_t>("zero_outputs")
+            .Attr<int64_t>("scalar_inputs"));
+}
+
+#endif // BRAINTAICHI_XLA_FFI
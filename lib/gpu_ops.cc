@@ -6,6 +6,7 @@
 
 #include "pybind11_kernel_helpers.h"
 #include "gpu_taichi_kernel_call.cuh"
+#include "gpu_taichi_ffi_call.cuh"
 
 using namespace brain_taichi;
 
@@ -18,8 +19,20 @@ namespace {
         return dict;
     }
 
+    // Empty when the extension is built without the XLA FFI headers.
+    pybind11::dict FfiRegistrations() {
+        pybind11::dict dict;
+
+#ifdef BRAINTAICHI_XLA_FFI
+        dict["taichi_kernel_ffi_call_gpu"] = EncapsulateFfiHandler(taichi_kernel_ffi_call_gpu);
+#endif
+
+        return dict;
+    }
+
     PYBIND11_MODULE(gpu_ops, m)
     {
         m.def("registrations", &Registrations);
+        m.def("ffi_registrations", &FfiRegistrations);
     }
 } // namespace
@@ -19,7 +19,9 @@ std::map<uint32_t, TiDataType> taichiTypeMap = {
     {8, TI_DATA_TYPE_I16},
     {9, TI_DATA_TYPE_I64},
     {10, TI_DATA_TYPE_F16},
-    {11, TI_DATA_TYPE_F64}
+    {11, TI_DATA_TYPE_F64},
+    // Taichi has no bfloat16, so its bits are passed as uint16 and decoded by the kernels
+    {12, TI_DATA_TYPE_U16}
 };
 
 void push_input(const uint32_t type_id, const void* value, uint32_t dim_count, uint32_t elem_count, uint32_t* shape) {
@@ -66,13 +68,17 @@ void push_input(const uint32_t type_id, const void* value, uint32_t dim_count, u
         break;
 
     case 10:
-        taichi_kernel->kernel->push_arg(createNdArrayFromRawMemory<float>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
+        taichi_kernel->kernel->push_arg(createNdArrayFromRawMemory<uint16_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
         break;
 
     case 11:
         taichi_kernel->kernel->push_arg(createNdArrayFromRawMemory<double>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
         break;
 
+    case 12:
+        taichi_kernel->kernel->push_arg(createNdArrayFromRawMemory<uint16_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
+        break;
+
     default:
         break;
     }
@@ -132,8 +138,8 @@ void push_output(const uint32_t type_id, const void* value, uint32_t dim_count,
         break;
 
     case 10:
-        cudaMemset(const_cast<void*>(value), 0, elem_count * sizeof(float));
-        taichi_kernel->kernel->push_arg(createNdArrayFromRawMemory<float>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
+        cudaMemset(const_cast<void*>(value), 0, elem_count * sizeof(uint16_t));
+        taichi_kernel->kernel->push_arg(createNdArrayFromRawMemory<uint16_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
         break;
 
     case 11:
@@ -141,6 +147,11 @@ void push_output(const uint32_t type_id, const void* value, uint32_t dim_count,
         taichi_kernel->kernel->push_arg(createNdArrayFromRawMemory<double>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
         break;
 
+    case 12:
+        cudaMemset(const_cast<void*>(value), 0, elem_count * sizeof(uint16_t));
+        taichi_kernel->kernel->push_arg(createNdArrayFromRawMemory<uint16_t>(const_cast<void*>(value), dim_count, elem_count, type_id, shape));
+        break;
+
     default:
         break;
     }
@@ -166,6 +177,9 @@ OpaqueStruct parseOpaque(const char* opaque, std::size_t opque_len) {
         data.in_num = std::stoul(num);
         std::getline(nums, num, ',');
         data.out_num = std::stoul(num);
+        if (std::getline(nums, num, ',')) {
+            data.zero_mask = std::stoul(num);
+        }
     }
 
     // Helper function to parse a list of uint32_t
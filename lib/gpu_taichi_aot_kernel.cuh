@@ -81,6 +81,7 @@ TiDataType getTiDataTypeFromMap(uint32_t typeIndex);
 struct OpaqueStruct {
     uint32_t in_num;
     uint32_t out_num;
+    uint32_t zero_mask = ~uint32_t(0);  // the outputs zeroed before the launch
     std::vector<uint32_t> type_list;
     std::vector<uint32_t> ndim_list;
     std::vector<uint32_t> shape_list;
@@ -0,0 +1,76 @@
+// The typed-FFI flavour of "taichi_kernel_aot_call_gpu". Dtypes and shapes come
+// from the buffers and the kernel path from an attribute, so nothing has to be
+// parsed out of an opaque string on every launch. Unlike the CPU handler, it has
+// no launch plans nor lanes: like the legacy target, it pushes every argument to
+// the single global runtime at each launch, and is not reentrant.
+
+#ifdef BRAINTAICHI_XLA_FFI
+
+#include "gpu_taichi_ffi_call.cuh"
+#include "gpu_taichi_aot_kernel.cuh"
+#include "kernel_helpers_ffi.h"
+#include <cuda_runtime_api.h>
+#include <exception>
+#include <string>
+#include <string_view>
+
+namespace ffi = xla::ffi;
+
+namespace brain_taichi {
+    static ffi::Error taichi_kernel_ffi_call_gpu_impl(cudaStream_t stream,
+                                                      ffi::RemainingArgs args,
+                                                      ffi::RemainingRets rets,
+                                                      std::string_view kernel_path,
+                                                      int64_t zero_outputs) {
+        cudaStreamSynchronize(stream);
+        taichi_kernel->set_cuda_stream(stream);
+
+        uint32_t type_id, dim_count, shape[8];
+        try {
+            // Load the taichi kernel
+            taichi_kernel->load(std::string(kernel_path).c_str());
+
+            // push the input data
+            for (size_t i = 0; i < args.size(); i++) {
+                auto buffer = args.get<ffi::AnyBuffer>(i);
+                if (buffer.has_error()) return buffer.error();
+                ffi::Error error = FfiBufferDescriptor(*buffer, i, 8, &type_id, &dim_count, shape);
+                if (error.failure()) return error;
+                push_input(type_id, buffer->untyped_data(), dim_count, buffer->element_count(), shape);
+            }
+
+            // push the output data, where only the outputs in "zero_outputs" are zeroed
+            for (size_t i = 0; i < rets.size(); i++) {
+                auto buffer = rets.get<ffi::AnyBuffer>(i);
+                if (buffer.has_error()) return buffer.error();
+                ffi::Error error = FfiBufferDescriptor(**buffer, args.size() + i, 8, &type_id, &dim_count, shape);
+                if (error.failure()) return error;
+                void *data = (*buffer)->untyped_data();
+                if ((static_cast<uint64_t>(zero_outputs) >> i) & 1) {
+                    push_output(type_id, data, dim_count, (*buffer)->element_count(), shape);
+                } else {
+                    push_input(type_id, data, dim_count, (*buffer)->element_count(), shape);
+                }
+            }
+
+            taichi_kernel->launch();
+            taichi_kernel->runtime_.wait();
+            taichi_kernel->clear_args();
+        } catch (const std::exception &e) {
+            taichi_kernel->clear_args();
+            return ffi::Error(ffi::ErrorCode::kInternal, e.what());
+        }
+        return ffi::Error::Success();
+    }
+
+    XLA_FFI_DEFINE_HANDLER_SYMBOL(
+        taichi_kernel_ffi_call_gpu, taichi_kernel_ffi_call_gpu_impl,
+        ffi::Ffi::Bind()
+            .Ctx<ffi::PlatformStream<cudaStream_t>>()
+            .RemainingArgs()
+            .RemainingRets()
+            .Attr<std::string_view>("kernel_path")
+            .Attr<int64_t>("zero_outputs"));
+}
+
+#endif // BRAINTAICHI_XLA_FFI
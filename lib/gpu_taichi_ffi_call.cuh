@@ -0,0 +1,14 @@
+#ifndef _TAICHI_FFI_CALL_GPU_H
+#define _TAICHI_FFI_CALL_GPU_H
+
+#ifdef BRAINTAICHI_XLA_FFI
+
+#include "xla/ffi/api/ffi.h"
+
+namespace brain_taichi {
+    XLA_FFI_DECLARE_HANDLER_SYMBOL(taichi_kernel_ffi_call_gpu);
+}
+
+#endif // BRAINTAICHI_XLA_FFI
+
+#endif //_TAICHI_FFI_CALL_GPU_H
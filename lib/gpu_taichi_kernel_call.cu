@@ -33,13 +33,21 @@ namespace brain_taichi {
                        shape_list_2d[i]);
         }
 
-        // push the output data
+        // push the output data, where only the outputs in "zero_mask" are zeroed
         for (int i = 0; i < data.out_num; i++) {
-            push_output(data.type_list[i + data.in_num],
-                        buffers[i + data.in_num],
-                        data.ndim_list[i + data.in_num],
-                        data.size_list[i + data.in_num],
-                        shape_list_2d[i + data.in_num]);
+            if (!((data.zero_mask >> i) & 1)) {
+                push_input(data.type_list[i + data.in_num],
+                           buffers[i + data.in_num],
+                           data.ndim_list[i + data.in_num],
+                           data.size_list[i + data.in_num],
+                           shape_list_2d[i + data.in_num]);
+            } else {
+                push_output(data.type_list[i + data.in_num],
+                            buffers[i + data.in_num],
+                            data.ndim_list[i + data.in_num],
+                            data.size_list[i + data.in_num],
+                            shape_list_2d[i + data.in_num]);
+            }
         }
 
         taichi_kernel->launch();
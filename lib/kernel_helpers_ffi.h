@@ -0,0 +1,57 @@
+// Helpers shared by the typed-FFI custom calls on CPU and GPU.
+
+#ifndef _BRAINTAICHI_KERNEL_HELPERS_FFI_H_
+#define _BRAINTAICHI_KERNEL_HELPERS_FFI_H_
+
+#ifdef BRAINTAICHI_XLA_FFI
+
+#include <cstdint>
+#include <string>
+#include "xla/ffi/api/ffi.h"
+
+namespace brain_taichi {
+
+    // the inverse of "type_number_map" in "_mlir_translation_rule.py"
+    inline bool FfiTypeToTypeId(xla::ffi::DataType dtype, uint32_t *type_id) {
+        switch (dtype) {
+            case xla::ffi::DataType::S32: *type_id = 0; return true;
+            case xla::ffi::DataType::F32: *type_id = 1; return true;
+            case xla::ffi::DataType::PRED: *type_id = 2; return true;
+            case xla::ffi::DataType::U8: *type_id = 3; return true;
+            case xla::ffi::DataType::U16: *type_id = 4; return true;
+            case xla::ffi::DataType::U32: *type_id = 5; return true;
+            case xla::ffi::DataType::U64: *type_id = 6; return true;
+            case xla::ffi::DataType::S8: *type_id = 7; return true;
+            case xla::ffi::DataType::S16: *type_id = 8; return true;
+            case xla::ffi::DataType::S64: *type_id = 9; return true;
+            case xla::ffi::DataType::F16: *type_id = 10; return true;
+            case xla::ffi::DataType::F64: *type_id = 11; return true;
+            case xla::ffi::DataType::BF16: *type_id = 12; return true;
+            default: return false;
+        }
+    }
+
+    // Read the dtype and shape of the i-th argument from the buffer itself.
+    inline xla::ffi::Error FfiBufferDescriptor(const xla::ffi::AnyBuffer &buffer, uint32_t i, uint32_t max_dims,
+                                               uint32_t *type_id, uint32_t *dim_count, uint32_t *shape) {
+        if (!FfiTypeToTypeId(buffer.element_type(), type_id)) {
+            return xla::ffi::Error(xla::ffi::ErrorCode::kInvalidArgument,
+                                   "Unsupported dtype for argument " + std::to_string(i) + " of a Taichi kernel.");
+        }
+        auto dims = buffer.dimensions();
+        if (dims.size() > max_dims) {
+            return xla::ffi::Error(xla::ffi::ErrorCode::kInvalidArgument,
+                                   "Too many dimensions for argument " + std::to_string(i) + " of a Taichi kernel.");
+        }
+        *dim_count = static_cast<uint32_t>(dims.size());
+        for (size_t j = 0; j < dims.size(); j++) {
+            shape[j] = static_cast<uint32_t>(dims[j]);
+        }
+        return xla::ffi::Error::Success();
+    }
+
+}  // namespace brain_taichi
+
+#endif // BRAINTAICHI_XLA_FFI
+
+#endif
@@ -22,6 +22,12 @@ namespace brain_taichi {
       return pybind11::capsule(bit_cast<void*>(fn), "xla._CUSTOM_CALL_TARGET");
     }
 
+    // Typed-FFI handlers are registered as plain capsules.
+    template <typename T>
+    pybind11::capsule EncapsulateFfiHandler(T* fn) {
+      return pybind11::capsule(bit_cast<void*>(fn));
+    }
+
 }  // namespace brain_taichi
 
 #endif
@@ -0,0 +1,47 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import numpy as np
+import pytest
+
+from braintaichi._sparseop import _sparse_utils
+
+
+def random_csr(rng, n_pre, n_post, prob, skewed=False):
+  """A random boolean matrix of shape ``(n_pre, n_post)``, with its CSR indices and indptr."""
+  dense = rng.random((n_pre, n_post))
+  if skewed:
+    # skewed in-degrees, as some rows are much denser than the others
+    prob = prob * rng.exponential(1., (n_pre, 1))
+  dense = dense < prob
+  indptr = np.concatenate([[0], np.cumsum(dense.sum(1))]).astype(np.int32)
+  indices = np.nonzero(dense)[1].astype(np.int32)
+  return dense, indices, indptr
+
+
+@pytest.fixture
+def make_csr():
+  """The ``random_csr`` generator of the test matrices."""
+  return random_csr
+
+
+@pytest.fixture(params=['serial', 'atomic', 'partial'])
+def strategy(request):
+  """Force the strategy of the transposed products on CPU, see ``cpu_transpose_strategy``."""
+  old = _sparse_utils.cpu_transpose_strategy
+  _sparse_utils.cpu_transpose_strategy = request.param
+  yield request.param
+  _sparse_utils.cpu_transpose_strategy = old
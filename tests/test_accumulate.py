@@ -0,0 +1,123 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
+import braintaichi as bti
+
+
+def _data(rng, homo, nnz):
+  return jnp.asarray([1.5], dtype=jnp.float32) if homo else jnp.asarray(rng.random(nnz), jnp.float32)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('alpha, beta', [(1., 1.), (0.9, 0.5)])
+def test_csrmv_accumulate(make_csr, strategy, transpose, homo, alpha, beta):
+  rng = np.random.default_rng(0)
+  shape = (300, 200)
+  _, indices, indptr = make_csr(rng, *shape, 0.05)
+  indices, indptr = jnp.asarray(indices), jnp.asarray(indptr)
+  data = _data(rng, homo, indices.shape[0])
+  vector = jnp.asarray(rng.random(shape[0] if transpose else shape[1]), jnp.float32)
+  state = jnp.asarray(rng.random(shape[1] if transpose else shape[0]), jnp.float32)
+
+  r1 = alpha * state + beta * bti.csrmv(data, indices, indptr, vector, shape=shape, transpose=transpose)
+  f = lambda s, v: bti.csrmv_accumulate(s, data, indices, indptr, v, shape=shape, transpose=transpose,
+                                        alpha=alpha, beta=beta)
+  assert np.allclose(r1, f(state, vector), rtol=1e-4, atol=1e-4)
+  assert np.allclose(r1, jax.jit(f)(state, vector), rtol=1e-4, atol=1e-4)
+  # the donated state is updated in place, and the kept one is copied first
+  assert np.allclose(r1, jax.jit(f, donate_argnums=0)(jnp.array(state), vector), rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('events_type', ['bool', 'float', 'packed'])
+def test_event_csrmv_accumulate(make_csr, strategy, transpose, homo, events_type):
+  rng = np.random.default_rng(1)
+  shape = (300, 200)
+  _, indices, indptr = make_csr(rng, *shape, 0.05)
+  indices, indptr = jnp.asarray(indices), jnp.asarray(indptr)
+  data = _data(rng, homo, indices.shape[0])
+  events = jnp.asarray(rng.random(shape[0] if transpose else shape[1]) < 0.2)
+  if events_type == 'float':
+    events = events.astype(jnp.float32)
+  elif events_type == 'packed':
+    events = bti.pack_events(events)
+  state = jnp.asarray(rng.random(shape[1] if transpose else shape[0]), jnp.float32)
+
+  r1 = 0.9 * state + bti.event_csrmv(data, indices, indptr, events, shape=shape, transpose=transpose)
+  f = lambda s: bti.event_csrmv_accumulate(s, data, indices, indptr, events, shape=shape, transpose=transpose,
+                                           alpha=0.9)
+  assert np.allclose(r1, f(state), rtol=1e-4, atol=1e-4)
+  assert np.allclose(r1, jax.jit(f)(state), rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+def test_accumulate_in_scan(make_csr, transpose):
+  # the decay and the input of a conductance over time steps, with the state
+  # carried by the loop
+  rng = np.random.default_rng(2)
+  shape = (300, 200)
+  _, indices, indptr = make_csr(rng, *shape, 0.05)
+  indices, indptr = jnp.asarray(indices), jnp.asarray(indptr)
+  data = _data(rng, False, indices.shape[0])
+  spikes = jnp.asarray(rng.random((20, shape[0] if transpose else shape[1])) < 0.1)
+
+  def separate(g, spk):
+    g = g * 0.9 + bti.event_csrmv(data, indices, indptr, spk, shape=shape, transpose=transpose)
+    return g, g
+
+  def accumulate(g, spk):
+    g = bti.event_csrmv_accumulate(g, data, indices, indptr, spk, shape=shape, transpose=transpose, alpha=0.9)
+    return g, g
+
+  g0 = jnp.zeros(shape[1] if transpose else shape[0], jnp.float32)
+  r1 = jax.lax.scan(separate, g0, spikes)[1]
+  r2 = jax.jit(lambda g: jax.lax.scan(accumulate, g, spikes)[1])(g0)
+  assert np.allclose(r1, r2, rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+def test_accumulate_grad_and_vmap(make_csr, transpose, homo):
+  rng = np.random.default_rng(3)
+  shape = (300, 200)
+  _, indices, indptr = make_csr(rng, *shape, 0.05)
+  indices, indptr = jnp.asarray(indices), jnp.asarray(indptr)
+  data = _data(rng, homo, indices.shape[0])
+  xs = jnp.asarray(rng.random((4, shape[0] if transpose else shape[1])), jnp.float32)
+  states = jnp.asarray(rng.random((4, shape[1] if transpose else shape[0])), jnp.float32)
+
+  def separate(s, d, x, a, b):
+    return a * s + b * bti.csrmv(d, indices, indptr, x, shape=shape, transpose=transpose)
+
+  def accumulate(s, d, x, a, b):
+    return bti.csrmv_accumulate(s, d, indices, indptr, x, shape=shape, transpose=transpose, alpha=a, beta=b)
+
+  args = (states[0], data, xs[0], jnp.float32(0.9), jnp.float32(0.5))
+  loss = lambda f: lambda *a: (f(*a) ** 2).sum()
+  for g1, g2 in zip(jax.grad(loss(separate), argnums=range(5))(*args),
+                    jax.grad(loss(accumulate), argnums=range(5))(*args)):
+    assert np.allclose(g1, g2, rtol=1e-4, atol=1e-4)
+
+  in_axes = (0, None, 0, None, None)
+  assert np.allclose(jax.vmap(separate, in_axes=in_axes)(states, data, xs, 0.9, 0.5),
+                     jax.vmap(accumulate, in_axes=in_axes)(states, data, xs, 0.9, 0.5), rtol=1e-4, atol=1e-4)
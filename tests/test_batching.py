@@ -0,0 +1,88 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
+import braintaichi as bti
+
+
+def _check_batched(f, xs):
+  # the batch is computed by a matrix-matrix kernel, not a loop of matrix-vector ones
+  assert 'scan' not in str(jax.make_jaxpr(jax.vmap(f))(xs))
+  r = jax.jit(jax.vmap(f))(xs)
+  expected = jnp.stack([f(x) for x in xs])
+  assert np.allclose(r, expected, rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('transpose', [True, False])
+def test_csrmv_vmap(make_csr, homo, transpose):
+  rng = np.random.default_rng(0)
+  _, indices, indptr = make_csr(rng, 200, 300, 0.1)
+  indices, indptr = jnp.asarray(indices), jnp.asarray(indptr)
+  data = jnp.asarray([1.5], dtype=jnp.float32) if homo else jnp.asarray(rng.random(indices.shape[0]), dtype=jnp.float32)
+  vectors = jnp.asarray(rng.random((5, 200 if transpose else 300)), dtype=jnp.float32)
+  _check_batched(lambda v: bti.csrmv(data, indices, indptr, v, shape=(200, 300), transpose=transpose), vectors)
+
+
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('transpose', [True, False])
+def test_event_csrmv_vmap(make_csr, homo, transpose):
+  rng = np.random.default_rng(1)
+  _, indices, indptr = make_csr(rng, 200, 300, 0.1)
+  indices, indptr = jnp.asarray(indices), jnp.asarray(indptr)
+  data = jnp.asarray([1.5], dtype=jnp.float32) if homo else jnp.asarray(rng.random(indices.shape[0]), dtype=jnp.float32)
+  events = jnp.asarray(rng.random((5, 200 if transpose else 300)) < 0.2)
+  _check_batched(lambda e: bti.event_csrmv(data, indices, indptr, e, shape=(200, 300), transpose=transpose), events)
+
+
+@pytest.mark.parametrize('dist', ['homo', 'uniform', 'normal'])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('outdim_parallel', [True, False])
+def test_jitc_mv_vmap(dist, transpose, outdim_parallel):
+  rng = np.random.default_rng(2)
+  vectors = jnp.asarray(rng.random((5, 200 if transpose else 300)), dtype=jnp.float32)
+  events = jnp.asarray(rng.random((5, 200 if transpose else 300)) < 0.2)
+  kwargs = dict(conn_prob=0.1, seed=123, shape=(200, 300), transpose=transpose, outdim_parallel=outdim_parallel)
+  if dist == 'homo':
+    f = lambda v: bti.jitc_mv_prob_homo(v, 1.5, **kwargs)
+    f_event = lambda e: bti.jitc_event_mv_prob_homo(e, 1.5, **kwargs)
+  elif dist == 'uniform':
+    f = lambda v: bti.jitc_mv_prob_uniform(v, 0.1, 0.5, **kwargs)
+    f_event = lambda e: bti.jitc_event_mv_prob_uniform(e, 0.1, 0.5, **kwargs)
+  else:
+    f = lambda v: bti.jitc_mv_prob_normal(v, 0.1, 0.5, **kwargs)
+    f_event = lambda e: bti.jitc_event_mv_prob_normal(e, 0.1, 0.5, **kwargs)
+  _check_batched(f, vectors)
+  _check_batched(f_event, events)
+
+
+def test_vmap_grad(make_csr):
+  rng = np.random.default_rng(3)
+  _, indices, indptr = make_csr(rng, 200, 300, 0.1)
+  indices, indptr = jnp.asarray(indices), jnp.asarray(indptr)
+  vectors = jnp.asarray(rng.random((5, 300)), dtype=jnp.float32)
+
+  # gradients of the batched products, which go through the matrix-matrix operators
+  f = lambda v: bti.csrmv(1.5, indices, indptr, v, shape=(200, 300)).sum()
+  assert np.allclose(jax.vmap(jax.grad(f))(vectors), jnp.stack([jax.grad(f)(v) for v in vectors]),
+                     rtol=1e-4, atol=1e-4)
+  g = lambda v: bti.jitc_mv_prob_homo(v, 1.5, 0.1, 123, shape=(200, 300)).sum()
+  assert np.allclose(jax.grad(lambda vs: jax.vmap(g)(vs).sum())(vectors), jnp.stack([jax.grad(g)(v) for v in vectors]),
+                     rtol=1e-4, atol=1e-4)
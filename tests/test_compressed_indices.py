@@ -0,0 +1,118 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
+import braintaichi as bti
+
+
+def test_compress_roundtrip(make_csr):
+  rng = np.random.default_rng(0)
+  dense, indices, indptr = make_csr(rng, 200, 1000, 0.05)
+  compressed = bti.compress_indices(indices, indptr)
+  assert compressed.offsets.dtype == jnp.uint16
+  assert int(compressed.block_shift[0]) == 6
+  assert np.array_equal(np.asarray(bti.decompress_indices(compressed, indptr)), indices)
+
+
+def test_compress_wide_rows():
+  # the columns of a row span more than 65536, so the blocks are shortened
+  rng = np.random.default_rng(1)
+  indptr = np.arange(0, 20 * 64 + 1, 64, dtype=np.int32)
+  indices = np.sort(rng.choice(1 << 20, (20, 64), replace=False), axis=1).astype(np.int32).flatten()
+  compressed = bti.compress_indices(indices, indptr)
+  assert int(compressed.block_shift[0]) < 6
+  assert np.array_equal(np.asarray(bti.decompress_indices(compressed, indptr)), indices)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+def test_csrmv_compressed(make_csr, strategy, transpose, homo):
+  rng = np.random.default_rng(2)
+  shape = (500, 300)
+  dense, indices, indptr = make_csr(rng, *shape, 0.1)
+  data = jnp.asarray([1.5], dtype=jnp.float32) if homo else jnp.asarray(rng.random(indices.shape[0]), jnp.float32)
+  vector = jnp.asarray(rng.random(shape[0] if transpose else shape[1]), jnp.float32)
+  compressed = bti.compress_indices(indices, indptr, max_block_size=8)
+
+  f = lambda ind, v: bti.csrmv(data, ind, indptr, v, shape=shape, transpose=transpose)
+  assert np.allclose(f(indices, vector), f(compressed, vector), rtol=1e-4, atol=1e-4)
+  assert np.allclose(f(indices, vector), jax.jit(f)(compressed, vector), rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('events_type', ['bool', 'float', 'packed'])
+def test_event_csrmv_compressed(make_csr, strategy, transpose, homo, events_type):
+  rng = np.random.default_rng(3)
+  shape = (500, 300)
+  dense, indices, indptr = make_csr(rng, *shape, 0.1)
+  data = jnp.asarray([1.5], dtype=jnp.float32) if homo else jnp.asarray(rng.random(indices.shape[0]), jnp.float32)
+  events = jnp.asarray(rng.random(shape[0] if transpose else shape[1]) < 0.2)
+  if events_type == 'float':
+    events = events.astype(jnp.float32)
+  elif events_type == 'packed':
+    events = bti.pack_events(events)
+  compressed = bti.compress_indices(indices, indptr)
+
+  f = lambda ind: bti.event_csrmv(data, ind, indptr, events, shape=shape, transpose=transpose)
+  assert np.allclose(f(indices), f(compressed), rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('event', [True, False])
+def test_compressed_grad_and_vmap(make_csr, transpose, homo, event):
+  rng = np.random.default_rng(4)
+  shape = (300, 200)
+  dense, indices, indptr = make_csr(rng, *shape, 0.1)
+  data = jnp.asarray([1.5], dtype=jnp.float32) if homo else jnp.asarray(rng.random(indices.shape[0]), jnp.float32)
+  compressed = bti.compress_indices(indices, indptr)
+  xs = rng.random((4, shape[0] if transpose else shape[1]))
+  if event:
+    xs = jnp.asarray(xs < 0.2)
+    op = bti.event_csrmv
+  else:
+    xs = jnp.asarray(xs, dtype=jnp.float32)
+    op = bti.csrmv
+
+  f = lambda d, ind, x: op(d, ind, indptr, x, shape=shape, transpose=transpose)
+  g = jax.grad(lambda d, ind, x: f(d, ind, x).sum())
+  assert np.allclose(g(data, indices, xs[0]), g(data, compressed, xs[0]), rtol=1e-4, atol=1e-4)
+  if not event:
+    gv = jax.grad(lambda x, ind: f(data, ind, x).sum())
+    assert np.allclose(gv(xs[0], indices), gv(xs[0], compressed), rtol=1e-4, atol=1e-4)
+
+  vf = jax.vmap(f, in_axes=(None, None, 0))
+  assert np.allclose(vf(data, indices, xs), vf(data, compressed, xs), rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+def test_csrmm_compressed(make_csr, transpose):
+  rng = np.random.default_rng(5)
+  shape = (200, 150)
+  dense, indices, indptr = make_csr(rng, *shape, 0.1)
+  data = jnp.asarray(rng.random(indices.shape[0]), jnp.float32)
+  matrix = jnp.asarray(rng.random((shape[0] if transpose else shape[1], 10)), jnp.float32)
+  compressed = bti.compress_indices(indices, indptr)
+
+  f = lambda ind: bti.csrmm(data, ind, indptr, matrix, shape=shape, transpose=transpose)
+  assert np.allclose(f(indices), f(compressed), rtol=1e-4, atol=1e-4)
+  g = lambda ind: bti.event_csrmm(data, ind, indptr, matrix > 0.5, shape=shape, transpose=transpose)
+  assert np.allclose(g(indices), g(compressed), rtol=1e-4, atol=1e-4)
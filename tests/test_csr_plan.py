@@ -0,0 +1,133 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
+import braintaichi as bti
+
+
+def _data(rng, homo, nnz):
+  return jnp.asarray([1.5], dtype=jnp.float32) if homo else jnp.asarray(rng.random(nnz), jnp.float32)
+
+
+def test_plan_splits(make_csr):
+  rng = np.random.default_rng(0)
+  dense, indices, indptr = make_csr(rng, 1000, 800, 0.02, skewed=True)
+  plan = bti.csr_plan(indices, indptr, shape=(1000, 800), num_partitions=8)
+  splits = np.asarray(plan.splits)
+  assert splits[0] == 0 and splits[-1] == 1000 and np.all(np.diff(splits) >= 0)
+  # every task has about an eighth of the rows plus non-zeros
+  work = np.arange(1001) + indptr
+  assert np.diff(work[splits]).max() <= (work[-1] / 8) + np.diff(indptr).max() + 1
+
+
+@pytest.mark.parametrize('reorder', [None, 'rcm', 'degree'])
+def test_plan_structure(make_csr, reorder):
+  rng = np.random.default_rng(1)
+  dense, indices, indptr = make_csr(rng, 300, 300, 0.05, skewed=True)
+  plan = bti.csr_plan(indices, indptr, shape=(300, 300), reorder=reorder)
+  data = np.arange(indices.shape[0], dtype=np.float32) + 1.
+  # the transposed matrix holds the same non-zeros
+  mat = bti.csr_to_dense(jnp.asarray(data), jnp.asarray(indices), jnp.asarray(indptr), shape=(300, 300))
+  t_data = jnp.asarray(data)[plan.t_value_idx]
+  t_mat = bti.csr_to_dense(t_data, plan.t_indices, plan.t_indptr, shape=(300, 300))
+  if reorder is not None:
+    mat = mat[plan.row_perm][:, plan.col_perm] if plan.col_perm is not None else mat[plan.row_perm]
+  assert np.array_equal(np.asarray(t_mat), np.asarray(mat).T)
+
+
+@pytest.mark.parametrize('reorder', [None, 'rcm', 'degree'])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+def test_csrmv_plan(make_csr, reorder, transpose, homo):
+  rng = np.random.default_rng(2)
+  shape = (400, 400)
+  dense, indices, indptr = make_csr(rng, *shape, 0.05, skewed=True)
+  data = _data(rng, homo, indices.shape[0])
+  vector = jnp.asarray(rng.random(shape[0] if transpose else shape[1]), jnp.float32)
+  plan = bti.csr_plan(indices, indptr, shape=shape, reorder=reorder)
+
+  f = lambda ind, v: bti.csrmv(data, ind, indptr, v, shape=shape, transpose=transpose)
+  assert np.allclose(f(indices, vector), f(plan, vector), rtol=1e-4, atol=1e-4)
+  assert np.allclose(f(indices, vector), jax.jit(f)(plan, vector), rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('reorder', [None, 'rcm', 'degree'])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('events_type', ['bool', 'float', 'packed'])
+def test_event_csrmv_plan(make_csr, reorder, transpose, homo, events_type):
+  rng = np.random.default_rng(3)
+  shape = (400, 400)
+  dense, indices, indptr = make_csr(rng, *shape, 0.05, skewed=True)
+  data = _data(rng, homo, indices.shape[0])
+  events = jnp.asarray(rng.random(shape[0] if transpose else shape[1]) < 0.2)
+  if events_type == 'float':
+    events = events.astype(jnp.float32)
+  elif events_type == 'packed':
+    events = bti.pack_events(events)
+  plan = bti.csr_plan(indices, indptr, shape=shape, reorder=reorder)
+
+  f = lambda ind: bti.event_csrmv(data, ind, indptr, events, shape=shape, transpose=transpose)
+  assert np.allclose(f(indices), f(plan), rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('reorder', [None, 'rcm'])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('event', [True, False])
+def test_plan_grad_and_vmap(make_csr, reorder, transpose, homo, event):
+  rng = np.random.default_rng(4)
+  shape = (300, 300)
+  dense, indices, indptr = make_csr(rng, *shape, 0.05, skewed=True)
+  data = _data(rng, homo, indices.shape[0])
+  plan = bti.csr_plan(indices, indptr, shape=shape, reorder=reorder)
+  xs = rng.random((4, shape[0] if transpose else shape[1]))
+  if event:
+    xs = jnp.asarray(xs < 0.2)
+    op = bti.event_csrmv
+  else:
+    xs = jnp.asarray(xs, dtype=jnp.float32)
+    op = bti.csrmv
+
+  f = lambda d, ind, x: op(d, ind, indptr, x, shape=shape, transpose=transpose)
+  g = jax.grad(lambda d, ind, x: f(d, ind, x).sum())
+  assert np.allclose(g(data, indices, xs[0]), g(data, plan, xs[0]), rtol=1e-4, atol=1e-4)
+  if not event:
+    gv = jax.grad(lambda x, ind: (f(data, ind, x) ** 2).sum())
+    assert np.allclose(gv(xs[0], indices), gv(xs[0], plan), rtol=1e-4, atol=1e-4)
+
+  vf = jax.vmap(f, in_axes=(None, None, 0))
+  assert np.allclose(vf(data, indices, xs), vf(data, plan, xs), rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('reorder', [None, 'rcm'])
+@pytest.mark.parametrize('transpose', [True, False])
+def test_csrmm_plan(make_csr, reorder, transpose):
+  rng = np.random.default_rng(5)
+  shape = (200, 200)
+  dense, indices, indptr = make_csr(rng, *shape, 0.05, skewed=True)
+  data = jnp.asarray(rng.random(indices.shape[0]), jnp.float32)
+  matrix = jnp.asarray(rng.random((shape[0] if transpose else shape[1], 10)), jnp.float32)
+  plan = bti.csr_plan(indices, indptr, shape=shape, reorder=reorder)
+
+  f = lambda ind: bti.csrmm(data, ind, indptr, matrix, shape=shape, transpose=transpose)
+  assert np.allclose(f(indices), f(plan), rtol=1e-4, atol=1e-4)
+  g = lambda ind: bti.event_csrmm(data, ind, indptr, matrix > 0.5, shape=shape, transpose=transpose)
+  assert np.allclose(g(indices), g(plan), rtol=1e-4, atol=1e-4)
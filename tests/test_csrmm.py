@@ -0,0 +1,58 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
+import braintaichi as bti
+
+
+def _random_heter_csr(make_csr, rng, n_pre, n_post, prob):
+  dense, indices, indptr = make_csr(rng, n_pre, n_post, prob)
+  data = rng.random(indices.shape[0]).astype(np.float32)
+  weights = np.zeros(dense.shape, dtype=np.float32)
+  weights[dense] = data
+  return weights, data, indices, indptr
+
+
+# 37 columns do not divide into the column tiles of the CPU kernels
+@pytest.mark.parametrize('n_col', [1, 37])
+@pytest.mark.parametrize('transpose', [True, False])
+def test_csrmm_heter(make_csr, n_col, transpose):
+  rng = np.random.default_rng(0)
+  weights, data, indices, indptr = _random_heter_csr(make_csr, rng, 200, 300, 0.1)
+  matrix = rng.random((200 if transpose else 300, n_col)).astype(np.float32)
+  dense = weights.T if transpose else weights
+  f = lambda d, m: bti.csrmm(d, jnp.asarray(indices), jnp.asarray(indptr), m,
+                             shape=(200, 300), transpose=transpose)
+
+  r = jax.jit(f)(jnp.asarray(data), jnp.asarray(matrix))
+  assert np.allclose(r, dense @ matrix, rtol=1e-4, atol=1e-4)
+
+  # gradients of the weights and of the dense matrix
+  cotangent = rng.random(r.shape).astype(np.float32)
+  _, f_vjp = jax.vjp(f, jnp.asarray(data), jnp.asarray(matrix))
+  g_data, g_matrix = f_vjp(jnp.asarray(cotangent))
+  g_weights = matrix @ cotangent.T if transpose else cotangent @ matrix.T
+  assert np.allclose(g_data, g_weights[weights != 0], rtol=1e-4, atol=1e-4)
+  assert np.allclose(g_matrix, dense.T @ cotangent, rtol=1e-4, atol=1e-4)
+
+  # forward mode agrees with the dense product
+  tangent = rng.random(matrix.shape).astype(np.float32)
+  _, t = jax.jvp(lambda m: f(jnp.asarray(data), m), (jnp.asarray(matrix),), (jnp.asarray(tangent),))
+  assert np.allclose(t, dense @ tangent, rtol=1e-4, atol=1e-4)
@@ -0,0 +1,93 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
+import braintaichi as bti
+
+
+@pytest.mark.parametrize('homo', [True, False])
+def test_csrmv_transpose(make_csr, strategy, homo):
+  rng = np.random.default_rng(0)
+  dense, indices, indptr = make_csr(rng, 1000, 300, 0.1)
+  vector = rng.random(1000).astype(np.float32)
+  if homo:
+    data, weights = jnp.asarray([1.5], dtype=jnp.float32), 1.5 * dense
+  else:
+    data = rng.random(indices.shape[0]).astype(np.float32)
+    weights = np.zeros(dense.shape, dtype=np.float32)
+    weights[dense] = data
+  f = lambda d, v: bti.csrmv(d, jnp.asarray(indices), jnp.asarray(indptr), v, shape=(1000, 300), transpose=True)
+
+  r = jax.jit(f)(jnp.asarray(data), jnp.asarray(vector))
+  assert np.allclose(r, vector @ weights, rtol=1e-4, atol=1e-4)
+
+  # the gradient with respect to the vector is the non-transposed product
+  g = jax.grad(lambda v: f(jnp.asarray(data), v).sum())(jnp.asarray(vector))
+  assert np.allclose(g, weights.sum(1), rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('homo', [True, False])
+def test_event_csrmv_transpose(make_csr, strategy, homo):
+  rng = np.random.default_rng(1)
+  dense, indices, indptr = make_csr(rng, 1000, 300, 0.1)
+  events = rng.random(1000) < 0.2
+  if homo:
+    data, weights = jnp.asarray([1.5], dtype=jnp.float32), 1.5 * dense
+  else:
+    data = rng.random(indices.shape[0]).astype(np.float32)
+    weights = np.zeros(dense.shape, dtype=np.float32)
+    weights[dense] = data
+  f = jax.jit(lambda d, e: bti.event_csrmv(d, jnp.asarray(indices), jnp.asarray(indptr), e,
+                                           shape=(1000, 300), transpose=True))
+
+  r = f(jnp.asarray(data), jnp.asarray(events))
+  assert np.allclose(r, events @ weights, rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+def test_outputs_not_zeroed_by_runtime(make_csr, strategy, transpose):
+  # the kernels declared to overwrite their outputs, or to zero their scratch
+  # outputs themselves, give the same results on reused buffers
+  rng = np.random.default_rng(2)
+  dense, indices, indptr = make_csr(rng, 1000, 300, 0.1)
+  data = rng.random(indices.shape[0]).astype(np.float32)
+  weights = np.zeros(dense.shape, dtype=np.float32)
+  weights[dense] = data
+  f = jax.jit(lambda d, v: bti.csrmv(d, jnp.asarray(indices), jnp.asarray(indptr), v,
+                                     shape=(1000, 300), transpose=transpose))
+  for seed in range(3):
+    vector = np.random.default_rng(seed).random(1000 if transpose else 300).astype(np.float32)
+    r = f(jnp.asarray(data), jnp.asarray(vector))
+    assert np.allclose(r, vector @ weights if transpose else weights @ vector, rtol=1e-4, atol=1e-4)
+
+
+def test_zero_output_mask():
+  from braintaichi._primitive._mlir_translation_rule import _zero_output_mask
+
+  # only the outputs declared 'zero' are zeroed
+  assert _zero_output_mask(2) == 0
+  assert _zero_output_mask(2, output_init=('zero',)) == 0b01
+  assert _zero_output_mask(2, output_init=('overwrite', 'zero')) == 0b10
+  assert _zero_output_mask(2, aliases={0: 1}, output_init=('zero', 'zero')) == 0b01
+
+  with pytest.raises(ValueError):
+    bti.XLACustomOp(cpu_kernel=None, output_init=('input',))
+  with pytest.raises(ValueError):
+    bti.XLACustomOp(cpu_kernel=None, output_init=('ones',))
@@ -0,0 +1,55 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
+import braintaichi as bti
+
+
+# 37 columns do not divide into the column tiles of the CPU kernels
+@pytest.mark.parametrize('n_col', [1, 37])
+@pytest.mark.parametrize('bool_events', [True, False])
+def test_event_csrmm_transpose(make_csr, strategy, n_col, bool_events):
+  rng = np.random.default_rng(0)
+  dense, indices, indptr = make_csr(rng, 200, 300, 0.1)
+  matrix = rng.random((200, n_col)) < 0.2
+  if not bool_events:
+    matrix = matrix * rng.random((200, n_col)).astype(np.float32)
+  f = lambda d, m: bti.event_csrmm(d, jnp.asarray(indices), jnp.asarray(indptr), m,
+                                   shape=(200, 300), transpose=True)
+
+  r = jax.jit(f)(jnp.asarray([1.5], dtype=jnp.float32), jnp.asarray(matrix))
+  assert np.allclose(r, 1.5 * (dense.T @ matrix), rtol=1e-4, atol=1e-4)
+
+  # the gradient of the weight is the total of the unweighted product
+  g = jax.grad(lambda d: f(d, jnp.asarray(matrix)).sum())(jnp.asarray([1.5], dtype=jnp.float32))
+  assert np.allclose(g, (dense.T @ matrix).sum(), rtol=1e-4)
+
+
+def test_event_csrmm_grad_matrix(make_csr):
+  rng = np.random.default_rng(1)
+  dense, indices, indptr = make_csr(rng, 200, 300, 0.1)
+  matrix = rng.random((300, 16)).astype(np.float32)
+  cotangent = rng.random((200, 16)).astype(np.float32)
+
+  # the transpose rule of the non-transposed product is the transposed product
+  f = lambda m: bti.event_csrmm(1.5, jnp.asarray(indices), jnp.asarray(indptr), m, shape=(200, 300))
+  _, f_vjp = jax.vjp(f, jnp.asarray(matrix))
+  g = f_vjp(jnp.asarray(cotangent))[0]
+  assert np.allclose(g, 1.5 * (dense.T @ cotangent), rtol=1e-4, atol=1e-4)
@@ -14,8 +14,16 @@
 # ==============================================================================
 
 
+import os
+
 import brainstate as bst
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
 import braintaichi as bti
+from braintaichi._eventop import _event_csrmv
 
 
 def test_example1():
@@ -27,3 +35,55 @@ def test_example1():
   print(r)
 
 
+@pytest.fixture(params=['on', 'off'])
+def active_set(request):
+  old = _event_csrmv.event_active_set
+  _event_csrmv.event_active_set = request.param
+  yield request.param
+  _event_csrmv.event_active_set = old
+
+
+# a low rate visits the compacted rows, a high rate falls back to the dense scan
+@pytest.mark.parametrize('rate', [0.01, 0.5])
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('bool_events', [True, False])
+def test_event_csrmv_transpose_active_set(make_csr, active_set, rate, homo, bool_events):
+  rng = np.random.default_rng(2)
+  n_pre, n_post = 5000, 300
+  dense, indices, indptr = make_csr(rng, n_pre, n_post, 0.02)
+  events = rng.random(n_pre) < rate
+  if not bool_events:
+    events = events * rng.random(n_pre).astype(np.float32)
+  if homo:
+    data, weights = jnp.asarray([1.5], dtype=jnp.float32), 1.5 * dense
+  else:
+    data = rng.random(indices.shape[0]).astype(np.float32)
+    weights = np.zeros(dense.shape, dtype=np.float32)
+    weights[dense] = data
+  f = lambda d, e: bti.event_csrmv(d, jnp.asarray(indices), jnp.asarray(indptr), e,
+                                   shape=(n_pre, n_post), transpose=True)
+
+  r = jax.jit(f)(jnp.asarray(data), jnp.asarray(events))
+  assert np.allclose(r, events @ weights, rtol=1e-4, atol=1e-4)
+
+  # the values enter linearly, so their gradient is the product with the events
+  g = jax.grad(lambda d: f(d, jnp.asarray(events)).sum())(jnp.asarray(data))
+  if homo:
+    assert np.allclose(g, (events @ dense).sum(), rtol=1e-4)
+  else:
+    assert np.allclose(g, np.repeat(events, np.diff(indptr)), rtol=1e-4, atol=1e-4)
+
+
+def test_active_set_follows_transpose_strategy(monkeypatch):
+  from braintaichi._sparseop import _sparse_utils
+
+  monkeypatch.setattr(_event_csrmv, 'event_active_set', 'auto')
+  monkeypatch.setattr(os, 'cpu_count', lambda: 8)
+  # too few non-zeros for the transposed products to run in parallel
+  assert not _event_csrmv._use_active_set(100000, 1000, 1000)
+  # a forced strategy keeps its kernels
+  for strategy in ['serial', 'atomic', 'partial']:
+    monkeypatch.setattr(_sparse_utils, 'cpu_transpose_strategy', strategy)
+    assert not _event_csrmv._use_active_set(100000, 1000, 1 << 20)
+  monkeypatch.setattr(_sparse_utils, 'cpu_transpose_strategy', 'auto')
+  assert _event_csrmv._use_active_set(100000, 1000, 1 << 20)
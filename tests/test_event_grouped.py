@@ -0,0 +1,81 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
+import braintaichi as bti
+
+
+def _projections(make_csr, rng, transpose, homo):
+  # three projections of various sizes which share their rows, or their columns
+  sizes = [300, 120, 50]
+  shapes = [(200, s) for s in sizes] if transpose else [(s, 200) for s in sizes]
+  indices, indptr, data = [], [], []
+  for k, shape in enumerate(shapes):
+    _, ind, ptr = make_csr(rng, *shape, 0.05 * (k + 1))
+    ind, ptr = jnp.asarray(ind), jnp.asarray(ptr)
+    indices.append(ind)
+    indptr.append(ptr)
+    data.append(jnp.asarray([1.5 - k], jnp.float32) if homo else jnp.asarray(rng.random(ind.shape[0]), jnp.float32))
+  return data, indices, indptr, shapes
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', ['homo', 'heter', 'mixed'])
+@pytest.mark.parametrize('events_type', ['bool', 'float', 'packed'])
+def test_event_csrmv_grouped(make_csr, strategy, transpose, homo, events_type):
+  rng = np.random.default_rng(0)
+  data, indices, indptr, shapes = _projections(make_csr, rng, transpose, homo == 'homo')
+  if homo == 'mixed':
+    data[1] = jnp.asarray([0.5], jnp.float32)
+  events = jnp.asarray(rng.random(200) < 0.2)
+  if events_type == 'float':
+    events = events.astype(jnp.float32)
+  elif events_type == 'packed':
+    events = bti.pack_events(events)
+
+  f = lambda d: bti.event_csrmv_grouped(d, indices, indptr, events, shapes=shapes, transpose=transpose)
+  for r1, r2, d, ind, ptr, shape in zip(f(data), jax.jit(f)(data), data, indices, indptr, shapes):
+    r = bti.event_csrmv(d, ind, ptr, events, shape=shape, transpose=transpose)
+    assert np.allclose(r, r1, rtol=1e-4, atol=1e-4)
+    assert np.allclose(r, r2, rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+def test_event_csrmv_grouped_grad_and_vmap(make_csr, transpose, homo):
+  rng = np.random.default_rng(1)
+  data, indices, indptr, shapes = _projections(make_csr, rng, transpose, homo)
+  events = jnp.asarray(rng.random((4, 200)) < 0.2)
+
+  def separate(d, e):
+    return [bti.event_csrmv(d[k], indices[k], indptr[k], e, shape=shapes[k], transpose=transpose)
+            for k in range(len(shapes))]
+
+  def grouped(d, e):
+    return bti.event_csrmv_grouped(d, indices, indptr, e, shapes=shapes, transpose=transpose)
+
+  # each projection gets the gradient of its own output
+  loss = lambda f: lambda d, e: sum(((k + 1.) * y ** 2).sum() for k, y in enumerate(f(d, e)))
+  for g1, g2 in zip(jax.grad(loss(separate))(data, events[0]), jax.grad(loss(grouped))(data, events[0])):
+    assert np.allclose(g1, g2, rtol=1e-4, atol=1e-4)
+
+  for r1, r2 in zip(jax.vmap(separate, in_axes=(None, 0))(data, events),
+                    jax.vmap(grouped, in_axes=(None, 0))(data, events)):
+    assert np.allclose(r1, r2, rtol=1e-4, atol=1e-4)
@@ -0,0 +1,101 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
+import braintaichi as bti
+
+# the products are accumulated in float32 and rounded once to the 16-bit dtype
+tolerance = {jnp.float16: 2e-3, jnp.bfloat16: 1e-2}
+
+
+def _data(rng, homo, nnz, dtype):
+  data = jnp.asarray([1.5]) if homo else jnp.asarray(rng.random(nnz))
+  return data.astype(dtype)
+
+
+def _close(r, expected, dtype):
+  assert r.dtype == dtype
+  tol = tolerance[dtype]
+  assert np.allclose(np.asarray(r.astype(jnp.float32)), expected, rtol=tol, atol=tol * np.abs(expected).max())
+
+
+@pytest.mark.parametrize('dtype', [jnp.float16, jnp.bfloat16])
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('transpose', [True, False])
+def test_csrmv_half(make_csr, strategy, dtype, homo, transpose):
+  rng = np.random.default_rng(0)
+  shape = (500, 300)
+  dense, indices, indptr = make_csr(rng, *shape, 0.1)
+  data = _data(rng, homo, indices.shape[0], dtype)
+  vector = jnp.asarray(rng.random(shape[0] if transpose else shape[1])).astype(dtype)
+
+  r = bti.csrmv(data, indices, indptr, vector, shape=shape, transpose=transpose)
+  # the same 16-bit values, computed in float32
+  expected = bti.csrmv(data.astype(jnp.float32), indices, indptr, vector.astype(jnp.float32),
+                       shape=shape, transpose=transpose)
+  _close(r, np.asarray(expected), dtype)
+
+
+@pytest.mark.parametrize('dtype', [jnp.float16, jnp.bfloat16])
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('events_type', ['bool', 'float', 'packed'])
+def test_event_csrmv_half(make_csr, strategy, dtype, homo, transpose, events_type):
+  rng = np.random.default_rng(1)
+  shape = (500, 300)
+  dense, indices, indptr = make_csr(rng, *shape, 0.1)
+  data = _data(rng, homo, indices.shape[0], dtype)
+  events = jnp.asarray(rng.random(shape[0] if transpose else shape[1]) < 0.2)
+  if events_type == 'float':
+    events = events.astype(dtype)
+  elif events_type == 'packed':
+    events = bti.pack_events(events)
+
+  r = bti.event_csrmv(data, indices, indptr, events, shape=shape, transpose=transpose)
+  expected = bti.event_csrmv(data.astype(jnp.float32), indices, indptr,
+                             events.astype(jnp.float32) if events_type == 'float' else events,
+                             shape=shape, transpose=transpose)
+  _close(r, np.asarray(expected), dtype)
+
+
+@pytest.mark.parametrize('dtype', [jnp.float16, jnp.bfloat16])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('event', [True, False])
+def test_half_grad_and_vmap(make_csr, dtype, transpose, event):
+  rng = np.random.default_rng(2)
+  shape = (300, 200)
+  dense, indices, indptr = make_csr(rng, *shape, 0.1)
+  data = _data(rng, False, indices.shape[0], dtype)
+  if event:
+    xs = jnp.asarray(rng.random((4, shape[0] if transpose else shape[1])) < 0.2)
+    f = lambda d, e: bti.event_csrmv(d, indices, indptr, e, shape=shape, transpose=transpose)
+    f32 = lambda d, e: f(d.astype(jnp.float32), e)
+  else:
+    xs = jnp.asarray(rng.random((4, shape[0] if transpose else shape[1]))).astype(dtype)
+    f = lambda d, v: bti.csrmv(d, indices, indptr, v, shape=shape, transpose=transpose)
+    f32 = lambda d, v: f(d.astype(jnp.float32), v.astype(jnp.float32))
+
+  # the gradients of the values keep their dtype
+  g = jax.grad(lambda d, x: f(d, x).astype(jnp.float32).sum())(data, xs[0])
+  expected = jax.grad(lambda d, x: f32(d, x).sum())(data.astype(jnp.float32), xs[0])
+  _close(g, np.asarray(expected), dtype)
+
+  r = jax.vmap(f, in_axes=(None, 0))(data, xs)
+  _close(r, np.asarray(jax.vmap(f32, in_axes=(None, 0))(data, xs)), dtype)
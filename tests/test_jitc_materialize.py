@@ -0,0 +1,106 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
+import braintaichi as bti
+from braintaichi._jitconnop import _jit_materialize
+
+shape = (300, 200)
+conn_prob = 0.1
+seed = 1234
+
+
+def _mv(dist, x, transpose, outdim_parallel):
+  kwargs = dict(shape=shape, transpose=transpose, outdim_parallel=outdim_parallel)
+  event = x.dtype == jnp.bool_
+  if dist == 'homo':
+    f = bti.jitc_event_mv_prob_homo if event else bti.jitc_mv_prob_homo
+    return f(x, 1.5, conn_prob, seed, **kwargs)
+  elif dist == 'uniform':
+    f = bti.jitc_event_mv_prob_uniform if event else bti.jitc_mv_prob_uniform
+    return f(x, -1., 2., conn_prob, seed, **kwargs)
+  else:
+    f = bti.jitc_event_mv_prob_normal if event else bti.jitc_mv_prob_normal
+    return f(x, 0.5, 1., conn_prob, seed, **kwargs)
+
+
+def _both(monkeypatch, f):
+  monkeypatch.setattr(_jit_materialize, 'jitconn_materialize', 'off')
+  streamed = f()
+  monkeypatch.setattr(_jit_materialize, 'jitconn_materialize', 'on')
+  materialized = f()
+  return np.asarray(streamed), np.asarray(materialized)
+
+
+def _check(streamed, materialized, outdim_parallel):
+  if outdim_parallel and jax.default_backend() == 'cpu':
+    # the same connections, summed in the same order
+    assert np.array_equal(streamed, materialized)
+  else:
+    assert np.allclose(streamed, materialized, rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('dist', ['homo', 'uniform', 'normal'])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('outdim_parallel', [True, False])
+@pytest.mark.parametrize('event', [True, False])
+def test_materialized_mv(monkeypatch, dist, transpose, outdim_parallel, event):
+  rng = np.random.default_rng(0)
+  n = shape[0] if transpose else shape[1]
+  if event:
+    x = jnp.asarray(rng.random(n) < 0.3)
+  else:
+    x = jnp.asarray(rng.random(n), dtype=jnp.float32)
+  streamed, materialized = _both(monkeypatch, lambda: _mv(dist, x, transpose, outdim_parallel))
+  _check(streamed, materialized, outdim_parallel)
+
+  # under "jit", the connectivity is materialized at trace time
+  f = jax.jit(lambda x: _mv(dist, x, transpose, outdim_parallel))
+  _check(streamed, np.asarray(f(x)), outdim_parallel)
+
+
+def test_materialized_grad(monkeypatch):
+  x = jnp.asarray(np.random.default_rng(0).random(shape[1]), dtype=jnp.float32)
+  f = jax.grad(lambda x, w: bti.jitc_mv_prob_homo(x, w, conn_prob, seed, shape=shape).sum(), argnums=(0, 1))
+  streamed, materialized = _both(monkeypatch, lambda: f(x, 1.5))
+  assert np.allclose(streamed[0], materialized[0], rtol=1e-4, atol=1e-4)
+  assert np.allclose(streamed[1], materialized[1], rtol=1e-4, atol=1e-4)
+
+
+def test_materialize_cache(monkeypatch):
+  monkeypatch.setattr(_jit_materialize, 'jitconn_materialize', 'on')
+  _jit_materialize._cache.clear()
+  x = jnp.ones(shape[1], dtype=jnp.float32)
+  bti.jitc_mv_prob_uniform(x, 0., 1., conn_prob, seed, shape=shape)
+  bti.jitc_mv_prob_uniform(2 * x, 0., 1., conn_prob, seed, shape=shape)
+  assert len(_jit_materialize._cache) == 1
+  # other weights draw another matrix
+  bti.jitc_mv_prob_uniform(x, 0., 2., conn_prob, seed, shape=shape)
+  assert len(_jit_materialize._cache) == 2
+
+  # traced seeds are regenerated by every call
+  jax.jit(lambda s: bti.jitc_mv_prob_uniform(x, 0., 1., conn_prob, s, shape=shape))(seed)
+  assert len(_jit_materialize._cache) == 2
+
+  # "auto" regenerates the matrices which exceed the budget
+  monkeypatch.setattr(_jit_materialize, 'jitconn_materialize', 'auto')
+  monkeypatch.setattr(_jit_materialize, 'jitconn_materialize_budget', 0)
+  bti.jitc_mv_prob_uniform(x, 0., 1., conn_prob, seed + 1, shape=shape)
+  assert len(_jit_materialize._cache) == 2
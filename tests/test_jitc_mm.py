@@ -0,0 +1,82 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
+import braintaichi as bti
+
+_ops = {
+  'homo': (bti.jitc_mm_prob_homo, bti.jitc_event_mm_prob_homo, bti.jitc_mv_prob_homo, (1.5,)),
+  'uniform': (bti.jitc_mm_prob_uniform, bti.jitc_event_mm_prob_uniform, bti.jitc_mv_prob_uniform, (0.1, 0.5)),
+  'normal': (bti.jitc_mm_prob_normal, bti.jitc_event_mm_prob_normal, bti.jitc_mv_prob_normal, (0.1, 0.5)),
+}
+
+
+def _columns(mv, matrix, *args, **kwargs):
+  return jnp.stack([mv(matrix[:, b], *args, **kwargs) for b in range(matrix.shape[1])], axis=1)
+
+
+@pytest.mark.parametrize('dist', ['homo', 'uniform', 'normal'])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('outdim_parallel', [True, False])
+def test_jitc_mm(dist, transpose, outdim_parallel):
+  mm, event_mm, mv, weights = _ops[dist]
+  rng = np.random.default_rng(0)
+  # more columns than a CPU tile, and a tile which is not full
+  matrix = jnp.asarray(rng.random((200 if transpose else 300, 45)), dtype=jnp.float32)
+  events = jnp.asarray(rng.random(matrix.shape) < 0.2)
+  kwargs = dict(conn_prob=0.1, seed=123, shape=(200, 300), transpose=transpose, outdim_parallel=outdim_parallel)
+
+  r = jax.jit(lambda m: mm(m, *weights, **kwargs))(matrix)
+  assert r.shape == (300 if transpose else 200, 45)
+  assert np.allclose(r, _columns(mv, matrix, *weights, **kwargs), rtol=1e-4, atol=1e-4)
+
+  # boolean events are the same as the 0/1 float matrix
+  r = jax.jit(lambda e: event_mm(e, *weights, **kwargs))(events)
+  expected = mm(events.astype(jnp.float32), *weights, **kwargs)
+  assert np.allclose(r, expected, rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('dist', ['homo', 'uniform', 'normal'])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('outdim_parallel', [True, False])
+def test_jitc_mm_grad(dist, transpose, outdim_parallel):
+  mm, event_mm, mv, weights = _ops[dist]
+  rng = np.random.default_rng(1)
+  matrix = jnp.asarray(rng.random((200 if transpose else 300, 20)), dtype=jnp.float32)
+  events = jnp.asarray(rng.random(matrix.shape) < 0.2)
+  ct = jnp.asarray(rng.random((300 if transpose else 200, 20)), dtype=jnp.float32)
+  kwargs = dict(conn_prob=0.1, seed=123, shape=(200, 300), transpose=transpose, outdim_parallel=outdim_parallel)
+
+  # gradients with respect to the matrix, against the column-wise products
+  f = lambda m, *ws: jnp.sum(mm(m, *ws, **kwargs) * ct)
+  f_columns = lambda m: jnp.sum(_columns(mv, m, *weights, **kwargs) * ct)
+  assert np.allclose(jax.grad(f)(matrix, *weights), jax.grad(f_columns)(matrix), rtol=1e-3, atol=1e-3)
+
+  # the products are linear in the weights, so central differences are exact
+  f_event = lambda *ws: jnp.sum(event_mm(events, *ws, **kwargs) * ct)
+  for g, args in [(f, (matrix,)), (f_event, ())]:
+    grads = jax.grad(g, argnums=tuple(range(len(args), len(args) + len(weights))))(*args, *weights)
+    for i in range(len(weights)):
+      ws_plus = list(weights)
+      ws_minus = list(weights)
+      ws_plus[i] += 1.
+      ws_minus[i] -= 1.
+      expected = (g(*args, *ws_plus) - g(*args, *ws_minus)) / 2.
+      assert np.allclose(grads[i], expected, rtol=1e-3, atol=1e-2)
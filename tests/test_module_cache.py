@@ -0,0 +1,46 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+
+import braintaichi as bti
+from braintaichi import cpu_ops
+
+
+def test_lru_eviction(make_csr):
+  rng = np.random.default_rng(0)
+  dense, indices, indptr = make_csr(rng, 200, 300, 0.1)
+  indices, indptr = jnp.asarray(indices), jnp.asarray(indptr)
+  events = rng.random(200) < 0.2
+  vector = rng.random(300).astype(np.float32)
+
+  f_event = jax.jit(lambda e: bti.event_csrmv(1.5, indices, indptr, e, shape=(200, 300), transpose=True))
+  f_csr = jax.jit(lambda v: bti.csrmv(1.5, indices, indptr, v, shape=(200, 300)))
+
+  cpu_ops.set_module_cache_limits(max_entries=1)
+  try:
+    before = cpu_ops.module_cache_stats()
+    # the two kernels keep evicting each other, and are reloaded on demand
+    for _ in range(3):
+      assert np.allclose(f_event(jnp.asarray(events)), 1.5 * (events @ dense), rtol=1e-4, atol=1e-4)
+      assert np.allclose(f_csr(jnp.asarray(vector)), 1.5 * (dense @ vector), rtol=1e-4, atol=1e-4)
+    after = cpu_ops.module_cache_stats()
+    assert after['evictions'] > before['evictions']
+    assert after['entries'] >= 1
+  finally:
+    cpu_ops.set_module_cache_limits(max_entries=256)
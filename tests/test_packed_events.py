@@ -0,0 +1,120 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+from jax.experimental import enable_x64
+
+import braintaichi as bti
+
+
+@pytest.mark.parametrize('shape', [(100,), (32,), (1,), (70, 5)])
+def test_pack_unpack(shape):
+  events = np.random.default_rng(0).random(shape) < 0.3
+  words = bti.pack_events(events)
+  assert words.dtype == jnp.uint32
+  assert words.shape == ((shape[0] + 31) // 32,) + shape[1:]
+  assert np.array_equal(np.asarray(bti.unpack_events(words, shape[0])), events)
+
+  # the event "i" is the bit "i % 32" of the word "i // 32"
+  bits = np.unpackbits(np.asarray(words).astype('<u4').view(np.uint8), axis=0, bitorder='little')
+  assert np.array_equal(bits[:shape[0]].astype(bool), events)
+  assert not bits[shape[0]:].any()
+
+
+def test_pack_uint64():
+  events = np.random.default_rng(0).random(100) < 0.3
+  with enable_x64():
+    words = bti.pack_events(events, jnp.uint64)
+    assert words.dtype == jnp.uint64
+    assert words.shape == (2,)
+    assert np.array_equal(np.asarray(bti.unpack_events(words, 100)), events)
+    # the same bits as the uint32 words, the low word first
+    assert np.array_equal(np.asarray(words).astype('<u8').view('<u4'), np.asarray(bti.pack_events(events)))
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('rate', [0.01, 0.3])
+def test_event_csrmv_packed(make_csr, strategy, transpose, homo, rate):
+  rng = np.random.default_rng(1)
+  shape = (1000, 300)
+  dense, indices, indptr = make_csr(rng, *shape, 0.1)
+  data = jnp.asarray([1.5], dtype=jnp.float32) if homo else jnp.asarray(rng.random(indices.shape[0]), jnp.float32)
+  events = jnp.asarray(rng.random(shape[0] if transpose else shape[1]) < rate)
+
+  f = lambda e: bti.event_csrmv(data, indices, indptr, e, shape=shape, transpose=transpose)
+  expected = f(events)
+  assert np.allclose(expected, f(bti.pack_events(events)), rtol=1e-4, atol=1e-4)
+  assert np.allclose(expected, jax.jit(f)(bti.pack_events(events)), rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+def test_event_csrmm_packed(make_csr, strategy, transpose, homo):
+  rng = np.random.default_rng(2)
+  shape = (200, 150)
+  dense, indices, indptr = make_csr(rng, *shape, 0.1)
+  data = jnp.asarray([1.5], dtype=jnp.float32) if homo else jnp.asarray(rng.random(indices.shape[0]), jnp.float32)
+  matrix = jnp.asarray(rng.random((shape[0] if transpose else shape[1], 10)) < 0.2)
+
+  expected = bti.event_csrmm(data, indices, indptr, matrix, shape=shape, transpose=transpose)
+  r = bti.event_csrmm(data, indices, indptr, bti.pack_events(matrix), shape=shape, transpose=transpose)
+  assert np.allclose(expected, r, rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+def test_packed_grad_and_vmap(make_csr, transpose, homo):
+  rng = np.random.default_rng(3)
+  shape = (300, 200)
+  dense, indices, indptr = make_csr(rng, *shape, 0.1)
+  data = jnp.asarray([1.5], dtype=jnp.float32) if homo else jnp.asarray(rng.random(indices.shape[0]), jnp.float32)
+  events = jnp.asarray(rng.random((5, shape[0] if transpose else shape[1])) < 0.2)
+  words = jax.vmap(bti.pack_events)(events)
+
+  f = lambda d, e: bti.event_csrmv(d, indices, indptr, e, shape=shape, transpose=transpose)
+  assert np.allclose(jax.vmap(f, in_axes=(None, 0))(data, events),
+                     jax.vmap(f, in_axes=(None, 0))(data, words), rtol=1e-4, atol=1e-4)
+
+  g = jax.grad(lambda d, e: f(d, e).sum())
+  assert np.allclose(g(data, events[0]), g(data, words[0]), rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('dist', ['homo', 'uniform', 'normal'])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('outdim_parallel', [True, False])
+def test_jitc_event_mv_packed(dist, transpose, outdim_parallel):
+  shape = (300, 200)
+  events = jnp.asarray(np.random.default_rng(4).random(shape[0] if transpose else shape[1]) < 0.2)
+  kwargs = dict(shape=shape, transpose=transpose, outdim_parallel=outdim_parallel)
+  if dist == 'homo':
+    f = lambda e: bti.jitc_event_mv_prob_homo(e, 1.5, 0.1, 1234, **kwargs)
+  elif dist == 'uniform':
+    f = lambda e: bti.jitc_event_mv_prob_uniform(e, -1., 2., 0.1, 1234, **kwargs)
+  else:
+    f = lambda e: bti.jitc_event_mv_prob_normal(e, 0.5, 1., 0.1, 1234, **kwargs)
+  # the same connections, summed in the same order on CPU
+  assert np.allclose(f(events), f(bti.pack_events(events)), rtol=1e-5, atol=1e-5)
+
+
+def test_jitc_event_mv_packed_grad():
+  shape = (300, 200)
+  events = jnp.asarray(np.random.default_rng(5).random(shape[1]) < 0.2)
+  g = jax.grad(lambda w, e: bti.jitc_event_mv_prob_homo(e, w, 0.1, 1234, shape=shape).sum())
+  assert np.allclose(g(1.5, events), g(1.5, bti.pack_events(events)), rtol=1e-4, atol=1e-4)
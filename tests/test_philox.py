@@ -0,0 +1,154 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+import taichi as ti
+
+import braintaichi as bti
+
+
+@ti.kernel
+def _philox_cpu(counters: ti.types.ndarray(ndim=2),
+                keys: ti.types.ndarray(ndim=2),
+                out: ti.types.ndarray(ndim=2)):
+  for i in range(out.shape[0]):
+    r = bti.philox4x32(ti.math.uvec4(counters[i, 0], counters[i, 1], counters[i, 2], counters[i, 3]),
+                       ti.math.uvec2(keys[i, 0], keys[i, 1]))
+    for j in ti.static(range(4)):
+      out[i, j] = r[j]
+
+
+@ti.kernel
+def _philox_draws_cpu(seed: ti.types.ndarray(ndim=1),
+                      uniform: ti.types.ndarray(ndim=1),
+                      normal: ti.types.ndarray(ndim=1)):
+  key = bti.philox_key(seed[0])
+  for i in range(uniform.shape[0]):
+    # stateless draws, addressed by their (i, j, k) position
+    uniform[i] = bti.philox_rand(key, i >> 10, i & 1023, 7)
+    normal[i] = bti.philox_randn(key, i >> 10, i & 1023, 7)
+
+
+philox_op = bti.XLACustomOp(cpu_kernel=_philox_cpu)
+philox_draws_op = bti.XLACustomOp(cpu_kernel=_philox_draws_cpu)
+
+
+def test_philox4x32_known_answers():
+  # known answers of Philox-4x32-10 from the Random123 library
+  counters = np.asarray([[0, 0, 0, 0],
+                         [0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff],
+                         [0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344]], dtype=np.uint32)
+  keys = np.asarray([[0, 0],
+                     [0xffffffff, 0xffffffff],
+                     [0xa4093822, 0x299f31d0]], dtype=np.uint32)
+  expected = np.asarray([[0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8],
+                         [0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd],
+                         [0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1]], dtype=np.uint32)
+  r = philox_op(jnp.asarray(counters), jnp.asarray(keys), outs=[jax.ShapeDtypeStruct((3, 4), jnp.uint32)])[0]
+  assert np.array_equal(np.asarray(r), expected)
+
+
+def test_philox_distributions():
+  n = 1 << 20
+  uniform, normal = philox_draws_op(jnp.asarray([1234], dtype=jnp.uint32),
+                                    outs=[jax.ShapeDtypeStruct((n,), jnp.float32),
+                                          jax.ShapeDtypeStruct((n,), jnp.float32)])
+  uniform, normal = np.asarray(uniform), np.asarray(normal)
+
+  assert uniform.min() >= 0. and uniform.max() < 1.
+  assert abs(uniform.mean() - 0.5) < 5e-3
+  assert abs(uniform.var() - 1. / 12) < 5e-3
+  # chi-square test of 64 equal bins, whose 99.9% quantile is about 104
+  counts = np.histogram(uniform, bins=64, range=(0., 1.))[0]
+  chi2 = np.sum((counts - n / 64) ** 2 / (n / 64))
+  assert chi2 < 104.
+  # neighbouring draws are not correlated
+  assert abs(np.corrcoef(uniform[:-1], uniform[1:])[0, 1]) < 5e-3
+
+  assert abs(normal.mean()) < 1e-2
+  assert abs(normal.std() - 1.) < 1e-2
+
+
+_ops = {
+  'homo': (bti.jitc_mv_prob_homo, bti.jitc_event_mv_prob_homo, (1.5,)),
+  'uniform': (bti.jitc_mv_prob_uniform, bti.jitc_event_mv_prob_uniform, (0.1, 0.5)),
+  'normal': (bti.jitc_mv_prob_normal, bti.jitc_event_mv_prob_normal, (0.1, 0.5)),
+}
+
+
+def _dense(mv, weights, shape, transpose, outdim_parallel, conn_prob=0.1):
+  # the dense matrix M, column by column (or row by row when transposed)
+  f = lambda v: mv(v, *weights, conn_prob, 123, shape=shape, transpose=transpose,
+                   outdim_parallel=outdim_parallel, rng='philox')
+  n = shape[0] if transpose else shape[1]
+  r = jax.vmap(f)(jnp.eye(n, dtype=jnp.float32))
+  return r if transpose else r.T
+
+
+@pytest.mark.parametrize('dist', ['homo', 'uniform', 'normal'])
+def test_philox_same_matrix_in_both_orientations(dist):
+  mv, _, weights = _ops[dist]
+  # more columns than one chunk, and a chunk which is not full
+  shape = (200, 700)
+  m = _dense(mv, weights, shape, False, True)
+  for transpose in [True, False]:
+    for outdim_parallel in [True, False]:
+      assert np.allclose(_dense(mv, weights, shape, transpose, outdim_parallel), m, rtol=1e-5, atol=1e-5)
+  assert abs(np.mean(np.asarray(m) != 0.) - 0.1) < 1e-2
+
+
+@pytest.mark.parametrize('dist', ['homo', 'uniform', 'normal'])
+@pytest.mark.parametrize('transpose', [True, False])
+def test_philox_event(dist, transpose):
+  mv, event_mv, weights = _ops[dist]
+  rng = np.random.default_rng(0)
+  events = jnp.asarray(rng.random(200 if transpose else 700) < 0.2)
+  kwargs = dict(conn_prob=0.1, seed=123, shape=(200, 700), transpose=transpose, rng='philox')
+  r = jax.jit(lambda e: event_mv(e, *weights, **kwargs))(events)
+  expected = mv(events.astype(jnp.float32), *weights, **kwargs)
+  assert np.allclose(r, expected, rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('dist', ['homo', 'uniform', 'normal'])
+@pytest.mark.parametrize('transpose', [True, False])
+def test_philox_grad(dist, transpose):
+  mv, event_mv, weights = _ops[dist]
+  rng = np.random.default_rng(1)
+  shape = (200, 700)
+  vector = jnp.asarray(rng.random(200 if transpose else 700), dtype=jnp.float32)
+  events = jnp.asarray(rng.random(vector.shape) < 0.2)
+  ct = jnp.asarray(rng.random(700 if transpose else 200), dtype=jnp.float32)
+  kwargs = dict(conn_prob=0.1, seed=123, shape=shape, transpose=transpose, rng='philox')
+
+  m = _dense(mv, weights, shape, False, True)
+  m = m.T if transpose else m
+  f = lambda v, *ws: jnp.sum(mv(v, *ws, **kwargs) * ct)
+  assert np.allclose(jax.grad(f)(vector, *weights), m.T @ ct, rtol=1e-3, atol=1e-3)
+
+  # the products are linear in the weights, so central differences are exact
+  f_event = lambda *ws: jnp.sum(event_mv(events, *ws, **kwargs) * ct)
+  for g, args in [(f, (vector,)), (f_event, ())]:
+    grads = jax.grad(g, argnums=tuple(range(len(args), len(args) + len(weights))))(*args, *weights)
+    for i in range(len(weights)):
+      ws_plus = list(weights)
+      ws_minus = list(weights)
+      ws_plus[i] += 1.
+      ws_minus[i] -= 1.
+      expected = (g(*args, *ws_plus) - g(*args, *ws_minus)) / 2.
+      assert np.allclose(grads[i], expected, rtol=1e-3, atol=1e-2)
@@ -0,0 +1,68 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import os
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import taichi as ti
+
+import braintaichi as bti
+from braintaichi._primitive import _mlir_translation_rule
+
+
+@ti.kernel
+def _precompile_scale_cpu(x: ti.types.ndarray(ndim=1),
+                          out: ti.types.ndarray(ndim=1)):
+  for i in x:
+    out[i] = 2. * x[i]
+
+
+@ti.kernel
+def _precompile_sum_cpu(x: ti.types.ndarray(ndim=2),
+                        out: ti.types.ndarray(ndim=1)):
+  for i, j in x:
+    out[i] += x[i, j]
+
+
+scale_op = bti.XLACustomOp(cpu_kernel=_precompile_scale_cpu)
+sum_op = bti.XLACustomOp(cpu_kernel=_precompile_sum_cpu, output_init=('zero',))
+
+
+def test_precompile():
+  _mlir_translation_rule.clear_taichi_aot_caches(['_precompile_scale_cpu', '_precompile_sum_cpu'])
+
+  f32, f64 = jnp.float32, jnp.float64
+  keys = bti.precompile(
+    [scale_op, sum_op],
+    [
+      [([jax.ShapeDtypeStruct((10,), f32)], [jax.ShapeDtypeStruct((10,), f32)]),
+       ([jax.ShapeDtypeStruct((10,), f64)], [jax.ShapeDtypeStruct((10,), f64)])],
+      [([jax.ShapeDtypeStruct((4, 5), f32)], [jax.ShapeDtypeStruct((4,), f32)])],
+    ],
+    platforms='cpu',
+    num_workers=2,
+  )
+  assert len(keys) == 3
+  for key in keys:
+    assert os.path.exists(os.path.join(_mlir_translation_rule.kernels_aot_path, key))
+
+  # the cached kernels are used by the lowering without compiling again
+  x = jnp.arange(4 * 5, dtype=f32).reshape(4, 5)
+  r = sum_op(x, outs=[jax.ShapeDtypeStruct((4,), f32)])[0]
+  assert np.allclose(r, np.asarray(x).sum(1))
+  assert len(os.listdir(os.path.join(_mlir_translation_rule.kernels_aot_path, '_precompile_sum_cpu'))) == 1
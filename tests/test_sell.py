@@ -0,0 +1,120 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+
+import braintaichi as bti
+
+
+def _data(rng, homo, nnz):
+  return jnp.asarray([1.5], dtype=jnp.float32) if homo else jnp.asarray(rng.random(nnz), jnp.float32)
+
+
+@pytest.mark.parametrize('sort_window', [None, 32])
+def test_sell_structure(make_csr, sort_window):
+  rng = np.random.default_rng(0)
+  dense, indices, indptr = make_csr(rng, 301, 200, 0.05, skewed=True)
+  sell = bti.csr_to_sell(indices, indptr, shape=(301, 200), slice_size=8, sort_window=sort_window)
+  assert sell.slice_size == 8
+  assert sell.row_len.shape == (304,)
+  # every non-zero has a slot, and the other slots are padding
+  value_idx = np.asarray(sell.value_idx)
+  assert np.array_equal(np.sort(value_idx[value_idx < indices.shape[0]]), np.arange(indices.shape[0]))
+  assert np.array_equal(np.asarray(sell.indices)[value_idx < indices.shape[0]],
+                        indices[value_idx[value_idx < indices.shape[0]]])
+
+
+def test_sell_fixed_degree_no_padding():
+  rng = np.random.default_rng(1)
+  indices = rng.integers(0, 500, (400, 20)).astype(np.int32).flatten()
+  indptr = (np.arange(401) * 20).astype(np.int32)
+  sell = bti.csr_to_sell(indices, indptr, shape=(400, 500), slice_size=16)
+  assert sell.shape == indices.shape
+
+
+@pytest.mark.parametrize('sort_window', [None, 64])
+@pytest.mark.parametrize('slice_size', [4, 8, 32])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+def test_sellmv(make_csr, strategy, sort_window, slice_size, transpose, homo):
+  rng = np.random.default_rng(2)
+  shape = (401, 300)
+  dense, indices, indptr = make_csr(rng, *shape, 0.05, skewed=True)
+  data = _data(rng, homo, indices.shape[0])
+  vector = jnp.asarray(rng.random(shape[0] if transpose else shape[1]), jnp.float32)
+  sell = bti.csr_to_sell(indices, indptr, shape=shape, slice_size=slice_size, sort_window=sort_window)
+
+  r1 = bti.csrmv(data, indices, indptr, vector, shape=shape, transpose=transpose)
+  f = lambda d, ind, v: bti.sellmv(d, ind, v, shape=shape, transpose=transpose)
+  assert np.allclose(r1, f(bti.sell_values(data, sell), sell, vector), rtol=1e-4, atol=1e-4)
+  assert np.allclose(r1, jax.jit(f)(bti.sell_values(data, sell), sell, vector), rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('sort_window', [None, 64])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('events_type', ['bool', 'float', 'packed'])
+def test_event_sellmv(make_csr, strategy, sort_window, transpose, homo, events_type):
+  rng = np.random.default_rng(3)
+  shape = (401, 300)
+  dense, indices, indptr = make_csr(rng, *shape, 0.05, skewed=True)
+  data = _data(rng, homo, indices.shape[0])
+  events = jnp.asarray(rng.random(shape[0] if transpose else shape[1]) < 0.2)
+  if events_type == 'float':
+    events = events.astype(jnp.float32)
+  elif events_type == 'packed':
+    events = bti.pack_events(events)
+  sell = bti.csr_to_sell(indices, indptr, shape=shape, sort_window=sort_window)
+
+  r1 = bti.event_csrmv(data, indices, indptr, events, shape=shape, transpose=transpose)
+  r2 = bti.event_sellmv(bti.sell_values(data, sell), sell, events, shape=shape, transpose=transpose)
+  assert np.allclose(r1, r2, rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('sort_window', [None, 64])
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+@pytest.mark.parametrize('event', [True, False])
+def test_sell_grad_and_vmap(make_csr, sort_window, transpose, homo, event):
+  rng = np.random.default_rng(4)
+  shape = (300, 200)
+  dense, indices, indptr = make_csr(rng, *shape, 0.05, skewed=True)
+  data = _data(rng, homo, indices.shape[0])
+  sell = bti.csr_to_sell(indices, indptr, shape=shape, sort_window=sort_window)
+  xs = rng.random((4, shape[0] if transpose else shape[1]))
+  if event:
+    xs = jnp.asarray(xs < 0.2)
+    csr_op, sell_op = bti.event_csrmv, bti.event_sellmv
+  else:
+    xs = jnp.asarray(xs, dtype=jnp.float32)
+    csr_op, sell_op = bti.csrmv, bti.sellmv
+
+  f1 = lambda d, x: csr_op(d, indices, indptr, x, shape=shape, transpose=transpose)
+  # the gradients flow to the values in the CSR order through "sell_values"
+  f2 = lambda d, x: sell_op(bti.sell_values(d, sell), sell, x, shape=shape, transpose=transpose)
+  g1 = jax.grad(lambda d, x: (f1(d, x) ** 2).sum())
+  g2 = jax.grad(lambda d, x: (f2(d, x) ** 2).sum())
+  assert np.allclose(g1(data, xs[0]), g2(data, xs[0]), rtol=1e-4, atol=1e-4)
+  if not event:
+    gv1 = jax.grad(lambda x: (f1(data, x) ** 2).sum())
+    gv2 = jax.grad(lambda x: (f2(data, x) ** 2).sum())
+    assert np.allclose(gv1(xs[0]), gv2(xs[0]), rtol=1e-4, atol=1e-4)
+
+  assert np.allclose(jax.vmap(f1, in_axes=(None, 0))(data, xs),
+                     jax.vmap(f2, in_axes=(None, 0))(data, xs), rtol=1e-4, atol=1e-4)
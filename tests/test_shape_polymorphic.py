@@ -0,0 +1,48 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+import os
+
+import jax.numpy as jnp
+import numpy as np
+
+import braintaichi as bti
+from braintaichi._eventop import _event_csrmv
+from braintaichi._primitive import _mlir_translation_rule
+from braintaichi._sparseop import _sparse_utils
+
+
+def _num_artifacts(kernel_name):
+  path = os.path.join(_mlir_translation_rule.kernels_aot_path, kernel_name)
+  return len(os.listdir(path)) if os.path.exists(path) else 0
+
+
+def test_one_artifact_for_all_sizes(make_csr, monkeypatch):
+  # the larger sizes would otherwise dispatch to the partial or atomic kernels
+  monkeypatch.setattr(_sparse_utils, 'cpu_transpose_strategy', 'serial')
+  monkeypatch.setattr(_event_csrmv, 'event_active_set', 'off')
+  rng = np.random.default_rng(0)
+  kernel_name = '_event_csr_matvec_cpu'
+  _mlir_translation_rule.clear_taichi_aot_caches(kernel_name)
+
+  for n_pre, n_post in [(100, 200), (300, 50), (1000, 1000)]:
+    dense, indices, indptr = make_csr(rng, n_pre, n_post, 0.1)
+    events = rng.random(n_pre) < 0.2
+    r = bti.event_csrmv(1.5, jnp.asarray(indices), jnp.asarray(indptr), jnp.asarray(events),
+                        shape=(n_pre, n_post), transpose=True)
+    assert np.allclose(r, 1.5 * (events @ dense), rtol=1e-4, atol=1e-4)
+
+  assert _num_artifacts(kernel_name) == 1
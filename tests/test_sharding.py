@@ -0,0 +1,77 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+import os
+
+# several CPU devices, unless the backend was initialised by another test before
+os.environ['XLA_FLAGS'] = os.environ.get('XLA_FLAGS', '') + ' --xla_force_host_platform_device_count=4'
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+from jax.sharding import Mesh
+
+import braintaichi as bti
+
+pytestmark = pytest.mark.skipif(jax.device_count() < 4, reason='needs 4 devices')
+
+
+def _mesh():
+  return Mesh(np.asarray(jax.devices()[:4]), ('x',))
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('homo', [True, False])
+def test_sharded_csrmv(make_csr, transpose, homo):
+  rng = np.random.default_rng(0)
+  # rows and columns which are not multiples of the number of devices
+  shape = (301, 203)
+  dense, indices, indptr = make_csr(rng, *shape, 0.05)
+  indices, indptr = jnp.asarray(indices), jnp.asarray(indptr)
+  data = jnp.asarray([1.5], jnp.float32) if homo else jnp.asarray(rng.random(indices.shape[0]), jnp.float32)
+  vector = jnp.asarray(rng.random(shape[0] if transpose else shape[1]), jnp.float32)
+  sharded = bti.csr_shard(indices, indptr, shape=shape, mesh=_mesh(), axis_name='x')
+
+  r1 = bti.csrmv(data, indices, indptr, vector, shape=shape, transpose=transpose)
+  f = jax.jit(lambda d, v: bti.csrmv(d, sharded, None, v, shape=shape, transpose=transpose))
+  assert np.allclose(r1, f(data, vector), rtol=1e-4, atol=1e-4)
+  if not homo:
+    assert np.allclose(r1, f(bti.shard_values(data, sharded), vector), rtol=1e-4, atol=1e-4)
+
+  # gradients through the shards
+  g1 = jax.grad(lambda v: bti.csrmv(data, indices, indptr, v, shape=shape, transpose=transpose).sum())(vector)
+  g2 = jax.grad(lambda v: f(data, v).sum())(vector)
+  assert np.allclose(g1, g2, rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.parametrize('transpose', [True, False])
+@pytest.mark.parametrize('events_type', ['bool', 'packed'])
+def test_sharded_event_csrmv(make_csr, transpose, events_type):
+  rng = np.random.default_rng(1)
+  shape = (301, 203)
+  dense, indices, indptr = make_csr(rng, *shape, 0.05)
+  indices, indptr = jnp.asarray(indices), jnp.asarray(indptr)
+  data = jnp.asarray(rng.random(indices.shape[0]), jnp.float32)
+  events = jnp.asarray(rng.random(shape[0] if transpose else shape[1]) < 0.2)
+  if events_type == 'packed':
+    events = bti.pack_events(events)
+  sharded = bti.csr_shard(indices, indptr, shape=shape, mesh=_mesh(), axis_name='x')
+
+  r1 = bti.event_csrmv(data, indices, indptr, events, shape=shape, transpose=transpose)
+  r2 = jax.jit(lambda e: bti.event_csrmv(data, sharded, None, e, shape=shape, transpose=transpose))(events)
+  assert np.allclose(r1, r2, rtol=1e-4, atol=1e-4)
+  # the result stays on the devices of the mesh
+  assert len(r2.sharding.device_set) == 4
@@ -0,0 +1,72 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+import os
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+import pytest
+import taichi as ti
+
+import braintaichi as bti
+from braintaichi._primitive import _mlir_translation_rule
+
+
+@ti.kernel
+def _static_affine_cpu(x: ti.types.ndarray(ndim=1),
+                       scale: ti.f32,
+                       offset: ti.i32,
+                       out: ti.types.ndarray(ndim=1),
+                       negate: ti.template()):
+  for i in x:
+    if ti.static(negate):
+      out[i] = -scale * x[i] + offset
+    else:
+      out[i] = scale * x[i] + offset
+
+
+affine_op = bti.XLACustomOp(cpu_kernel=_static_affine_cpu)
+
+
+def test_static_and_scalar_params():
+  _mlir_translation_rule.clear_taichi_aot_caches('_static_affine_cpu')
+  x = jnp.arange(10, dtype=jnp.float32)
+  outs = [jax.ShapeDtypeStruct((10,), jnp.float32)]
+
+  @jax.jit
+  def f(x, scale, offset):
+    scale, offset = jnp.asarray([scale], jnp.float32), jnp.asarray([offset], jnp.int32)
+    return (affine_op(x, scale, offset, outs=outs, negate=False)[0],
+            affine_op(x, scale, offset, outs=outs, negate=True)[0])
+
+  for scale, offset in [(2., 1), (0.5, -3)]:
+    r1, r2 = f(x, scale, offset)
+    assert np.allclose(r1, scale * np.asarray(x) + offset)
+    assert np.allclose(r2, -scale * np.asarray(x) + offset)
+
+  # one artifact for each value of the static parameter, shared by all the scalars
+  path = os.path.join(_mlir_translation_rule.kernels_aot_path, '_static_affine_cpu')
+  assert len(os.listdir(path)) == 2
+
+
+def test_static_param_errors():
+  x = jnp.arange(10, dtype=jnp.float32)
+  outs = [jax.ShapeDtypeStruct((10,), jnp.float32)]
+  with pytest.raises(ValueError):
+    affine_op(x, jnp.ones(1, jnp.float32), jnp.ones(1, jnp.int32), outs=outs)
+  with pytest.raises(ValueError):
+    affine_op(x, jnp.ones(1, jnp.float32), jnp.ones(1, jnp.float32), outs=outs, negate=False)
+
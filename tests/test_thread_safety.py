@@ -0,0 +1,53 @@
+# Copyright 2024 BDP Ecosystem Limited. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+
+from concurrent.futures import ThreadPoolExecutor
+
+import jax
+import jax.numpy as jnp
+import numpy as np
+
+import braintaichi as bti
+
+
+def test_concurrent_launches(make_csr):
+  rng = np.random.default_rng(0)
+
+  # several call sites with different shapes, so that the threads exercise
+  # different launch plans and kernels at the same time
+  cases = []
+  for n_pre, n_post in [(200, 300), (500, 100), (1000, 1000)]:
+    dense, indices, indptr = make_csr(rng, n_pre, n_post, 0.1)
+    events = rng.random(n_pre) < 0.2
+    vector = rng.random(n_post).astype(np.float32)
+    f_event = jax.jit(lambda e, i=indices, p=indptr, s=(n_pre, n_post):
+                      bti.event_csrmv(1.5, i, p, e, shape=s, transpose=True))
+    f_csr = jax.jit(lambda v, i=indices, p=indptr, s=(n_pre, n_post):
+                    bti.csrmv(1.5, i, p, v, shape=s))
+    cases.append((f_event, jnp.asarray(events), 1.5 * (events @ dense)))
+    cases.append((f_csr, jnp.asarray(vector), 1.5 * (dense @ vector)))
+
+  def run(k):
+    f, x, expected = cases[k % len(cases)]
+    for _ in range(20):
+      r = f(x).block_until_ready()
+      if not np.allclose(r, expected, rtol=1e-4, atol=1e-4):
+        return False
+    return True
+
+  with ThreadPoolExecutor(max_workers=16) as pool:
+    results = list(pool.map(run, range(64)))
+  assert all(results)